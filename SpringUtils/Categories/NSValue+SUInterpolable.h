@@ -15,7 +15,22 @@ typedef NSValue * (*SUValueInterpolator)( NSValue* start, NSValue *end, SUInterp
 
 @interface NSValue (SUInterpolable) <SUInterpolable>
 
+/** Registers a function to interpolate values of a type. Registered interpolators take precedence over the built-in
+ *  interpolation of CGAffineTransforms and CATransform3Ds, and over interpolating a structure's fields from its type
+ *  encoding. This method may be called from any thread, and values may be interpolated on other threads while it runs.
+ *
+ *  @param  interpolator    The function which interpolates values of the type. It replaces any previously registered function.
+ *  @param  type            The type's Objective-C type encoding (e.g. `@encode( MyStruct )`).
+ */
+
 + (void)registerInterpolator: (SUValueInterpolator)interpolator forObjCType: (const char *)type;
 
+/** Returns the function registered to interpolate values of a type, or NULL if there is none.
+ *
+ *  @param  type            An Objective-C type encoding.
+ */
+
++ (SUValueInterpolator)registeredInterpolatorForObjCType: (const char *)type;
+
 @end
 
@@ -11,9 +11,14 @@
 #import "NSValue+SUInterpolable.h"
 
 #import "../Utilities/SUValueInterpolation.h"
+#import "../Utilities/SUStructInterpolation.h"
+#import "../Utilities/SUTransformInterpolation.h"
 #import "../Utilities/SUAssociatedObjects.h"
 #import "../Utilities/SURuntimeAssertions.h"
 
+#import <pthread.h>
+#import <QuartzCore/CATransform3D.h>
+
 #if TARGET_OS_IPHONE
 #import <UIKit/UIKit.h> // NSValue CoreGraphics extensions
 #endif
@@ -101,13 +106,9 @@
             return [NSValue valueWithCGRect: rectWithOffsetBetweenRects( fromValue.CGRectValue, toValue.CGRectValue, offset )];
         }
 
-        // TODO: CGAffineTransform, etc
-    
 #endif
     
-    // Unknown value type.
-    
-    // Look for a custom interpolator.
+    // Look for a custom interpolator. These take precedence over the built-in interpolation of transforms.
     
     NSValue * customInterpolation = [NSValue customInterpolatedValueWithObjCType: valueType
                                                                         atOffset: offset
@@ -117,31 +118,213 @@
     if( Nil != customInterpolation )
         return customInterpolation;
     
+    // Transforms are decomposed, and their decompositions interpolated (see SUTransformInterpolation.h).
+    
+    if( 0 == strcmp( valueType, @encode( CGAffineTransform ) ) )
+    {
+        CGAffineTransform start, end;
+        
+        [fromValue getValue: &start];
+        [toValue getValue: &end];
+        
+        CGAffineTransform result = affineTransformWithOffsetBetweenAffineTransforms( start, end, offset );
+        return [NSValue valueWithBytes: &result objCType: valueType];
+    }
+    
+    if( 0 == strcmp( valueType, @encode( CATransform3D ) ) )
+    {
+        CATransform3D start, end;
+        double startMatrix[ 16 ], endMatrix[ 16 ];
+        
+        [fromValue getValue: &start];
+        [toValue getValue: &end];
+        getTransform3DFromCGFloats( &start.m11, startMatrix );
+        getTransform3DFromCGFloats( &end.m11, endMatrix );
+        
+        // Transforms which can't be decomposed snap.
+        
+        if( false == getTransform3DWithOffsetBetweenTransform3Ds( startMatrix, endMatrix, offset, startMatrix ) )
+            return ( offset < 0.5 ) ? fromValue : toValue;
+        
+        getCGFloatsFromTransform3D( startMatrix, &start.m11 );
+        return [NSValue valueWithBytes: &start objCType: valueType];
+    }
+    
+    // Interpolate the structure's fields, as described by its type encoding.
+    
+    NSValue * structInterpolation = [NSValue structInterpolatedValueWithObjCType: valueType
+                                                                        atOffset: offset
+                                                                       fromValue: fromValue
+                                                                         toValue: toValue];
+    
+    if( Nil != structInterpolation )
+        return structInterpolation;
+    
     // Unable to interpolate; just snap between fromValue and toValue.
     
     if( offset < 0.5 ) return fromValue;
     return toValue;
 }
 
+#pragma mark -
+#pragma mark Structure Interpolation
+
+/** Structures up to this size are interpolated in buffers on the stack. */
+
+#define kSUStructInterpolationStackBufferSize   256
+
++ (NSValue *)structInterpolatedValueWithObjCType: (const char *)type
+                                        atOffset: (SUInterpolationOffset)offset
+                                       fromValue: (NSValue *)startVal
+                                         toValue: (NSValue *)endVal {
+    
+    SUStructInterpolationPlan plan = structInterpolationPlanForType( type );
+    
+    if( NULL == plan )
+        return Nil;
+    
+    // The result is written over the start value's bytes. The buffers are doubles, so that any field is aligned.
+    
+    const size_t size = structInterpolationPlanSize( plan );
+    
+    double stackBuffers[ 2 ][ kSUStructInterpolationStackBufferSize / sizeof( double ) ];
+    void * startBytes = ( size <= kSUStructInterpolationStackBufferSize ) ? stackBuffers[ 0 ] : malloc( size * 2 );
+    void * endBytes   = ( size <= kSUStructInterpolationStackBufferSize ) ? stackBuffers[ 1 ] : ( (UInt8 *)startBytes + size );
+    
+    if( NULL == startBytes )
+        return Nil;
+    
+    [startVal getValue: startBytes];
+    [endVal getValue: endBytes];
+    
+    interpolateStructWithPlan( plan, startBytes, endBytes, offset, startBytes );
+    
+    NSValue * result = [NSValue valueWithBytes: startBytes objCType: type];
+    
+    if( startBytes != stackBuffers[ 0 ] )
+        free( startBytes );
+    
+    return result;
+}
+
 #pragma mark -
 #pragma mark Custom Interpolators
 
-static NSMutableDictionary* customInterpolators;
+// Registered interpolators are kept in an immutable snapshot. Registering an interpolator copies the snapshot with the new
+// entry and publishes the copy, so lookups (which happen every frame of every animation) never lock or allocate.
+// Superseded snapshots can't be freed, as a reader might still be using one; registration is rare, so they are leaked.
+
+/** A registered interpolator. The type string is copied when it is registered, and is shared by every later snapshot. */
+
+typedef struct _SUInterpolatorRegistryEntry {
+    
+    const char *        objCType;
+    UInt64              hash;
+    SUValueInterpolator interpolator;
+    
+} SUInterpolatorRegistryEntry;
+
+typedef struct _SUInterpolatorRegistry {
+    
+    NSUInteger                  numberOfEntries;
+    SUInterpolatorRegistryEntry entries[];
+    
+} SUInterpolatorRegistry;
+
+static SUInterpolatorRegistry * interpolatorRegistry;
+static pthread_mutex_t          interpolatorRegistryLock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Hashes a type encoding (FNV-1a). */
+
+SU_INLINE UInt64 hashObjCType( const char * type ) {
+    
+    UInt64 hash = 0xcbf29ce484222325ULL;
+    
+    for( ; '\0' != *type; type++ )
+    {
+        hash = ( hash ^ (UInt8)*type ) * 0x100000001b3ULL;
+    }
+    
+    return hash;
+}
+
+/** Finds a type's entry in a snapshot. Type pointers aren't compared, as a type string may be freed and its memory reused for
+ *  another type; type encodings are short, so hashing one costs little more. */
+
+static const SUInterpolatorRegistryEntry * findInterpolatorRegistryEntry( const SUInterpolatorRegistry * registry, const char * type ) {
+    
+    if( NULL == registry )
+        return NULL;
+    
+    const UInt64 hash = hashObjCType( type );
+    
+    for( NSUInteger i = 0; i < registry->numberOfEntries; i++ )
+    {
+        if( ( hash == registry->entries[ i ].hash ) && ( 0 == strcmp( type, registry->entries[ i ].objCType ) ) )
+            return &( registry->entries[ i ] );
+    }
+    
+    return NULL;
+}
 
 + (void)registerInterpolator: (SUValueInterpolator)interpolator forObjCType: (const char *)type {
     
     SU_ASSERT_NOT_EQUAL( interpolator, NULL )
     SU_ASSERT_NOT_EQUAL( type, NULL )
     
-    if( Nil == customInterpolators )
+    pthread_mutex_lock( &interpolatorRegistryLock );
+    
+    const SUInterpolatorRegistry * registry         = interpolatorRegistry;
+    const SUInterpolatorRegistryEntry * existing    = findInterpolatorRegistryEntry( registry, type );
+    const NSUInteger numberOfEntries                = ( NULL != registry ) ? registry->numberOfEntries : 0;
+    const NSUInteger newNumberOfEntries             = ( NULL != existing ) ? numberOfEntries : ( numberOfEntries + 1 );
+    
+    SUInterpolatorRegistry * newRegistry = malloc( sizeof( SUInterpolatorRegistry ) + ( newNumberOfEntries * sizeof( SUInterpolatorRegistryEntry ) ) );
+    
+    if( NULL == newRegistry )
     {
-        customInterpolators = [[NSMutableDictionary alloc] init];
+        pthread_mutex_unlock( &interpolatorRegistryLock );
+        SU_ASSERT_NOT_EQUAL( newRegistry, NULL )
+        return;
     }
     
-    NSString * typeString   = [NSString stringWithUTF8String: type];
-    NSValue  * wrappedFunc  = [NSValue valueWithPointer: interpolator];
+    if( numberOfEntries > 0 )
+        memcpy( newRegistry->entries, registry->entries, numberOfEntries * sizeof( SUInterpolatorRegistryEntry ) );
+    
+    // Replace the type's interpolator, or add the type.
+    
+    if( NULL != existing )
+    {
+        newRegistry->entries[ existing - registry->entries ].interpolator = interpolator;
+    }
+    else
+    {
+        char * typeCopy = strdup( type );
+        
+        if( NULL == typeCopy )
+        {
+            pthread_mutex_unlock( &interpolatorRegistryLock );
+            free( newRegistry );
+            SU_ASSERT_NOT_EQUAL( typeCopy, NULL )
+            return;
+        }
+        
+        newRegistry->entries[ numberOfEntries ] = (SUInterpolatorRegistryEntry){ typeCopy, hashObjCType( type ), interpolator };
+    }
+    
+    newRegistry->numberOfEntries = newNumberOfEntries;
+    
+    __atomic_store_n( &interpolatorRegistry, newRegistry, __ATOMIC_RELEASE );
+    
+    pthread_mutex_unlock( &interpolatorRegistryLock );
+}
+
++ (SUValueInterpolator)registeredInterpolatorForObjCType: (const char *)type {
+    
+    const SUInterpolatorRegistry * registry     = __atomic_load_n( &interpolatorRegistry, __ATOMIC_ACQUIRE );
+    const SUInterpolatorRegistryEntry * entry   = findInterpolatorRegistryEntry( registry, type );
     
-    customInterpolators[ typeString ] = wrappedFunc;
+    return ( NULL != entry ) ? entry->interpolator : NULL;
 }
 
 + (NSValue *)customInterpolatedValueWithObjCType: (const char *)type
@@ -149,12 +332,11 @@ static NSMutableDictionary* customInterpolators;
                                        fromValue: (NSValue *)startVal
                                          toValue: (NSValue *)endVal {
     
-    NSString * typeString   = [NSString stringWithUTF8String: type];
-    NSValue  * wrappedFunc  = customInterpolators[ typeString ];
+    SUValueInterpolator interpolator = [NSValue registeredInterpolatorForObjCType: type];
     
-    if( Nil != wrappedFunc )
+    if( NULL != interpolator )
     {
-        return ((SUValueInterpolator)wrappedFunc.pointerValue)( startVal, endVal, offset );
+        return interpolator( startVal, endVal, offset );
     }
     
     return Nil;
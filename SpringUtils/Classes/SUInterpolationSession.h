@@ -0,0 +1,117 @@
+//
+//  SUInterpolationSession.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import <Foundation/Foundation.h>
+#import "SUTypes.h"
+
+/** An interpolation between two fixed values, for evaluating at many offsets (e.g. once per frame of an animation).
+ *
+ *  `+[NSNumber interpolatedValueWithOffset:betweenValue:andValue:]` and its NSValue equivalent unbox both values, work out
+ *  how to interpolate their type, and box a new result every time they are called. A session does the unboxing and type
+ *  decoding once, when it is created, and writes its results in to memory provided by the caller:
+ *
+ *  - Numbers are interpolated as doubles (BOOLs snap at an offset of 0.5), and are returned by valueAtOffset:.
+ *  - Structures are interpolated by their type encoding's interpolation plan (see SUStructInterpolation.h), and are written
+ *    by getValue:atOffset:.
+ *  - On iOS, where NSValue interpolates CGPoints, CGSizes and CGRects with pointWithOffsetBetweenPoints() and friends, which
+ *    round each component through a float, sessions do the same (even if an interpolator is registered for them).
+ *  - CGAffineTransforms and CATransform3Ds are decomposed (see SUTransformInterpolation.h), so that each offset only
+ *    interpolates and recomposes them, and are written by getValue:atOffset:.
+ *
+ *  None of these allocates memory. Structures with a registered interpolator (see
+ *  `+[NSValue registerInterpolator:forObjCType:]`), including transforms, are interpolated by calling it and unboxing its result.
+ *
+ *  A session may only be used from one thread at a time.
+ */
+
+@interface SUInterpolationSession : NSObject
+
+/** Creates a session which interpolates between two values.
+ *
+ *  @param  fromValue   The initial value of the interpolation, at offset 0. This may be an NSNumber or an NSValue.
+ *  @param  toValue     The final value of the interpolation, at offset 1. This must be of the same class and type as `fromValue`.
+ *
+ *  @returns            A new interpolation session.
+ */
+
++ (instancetype)sessionWithFromValue: (NSValue *)fromValue toValue: (NSValue *)toValue;
+
+/** Initialises a session which interpolates between two values. This is the designated initialiser.
+ *
+ *  @param  fromValue   The initial value of the interpolation, at offset 0. This may be an NSNumber or an NSValue.
+ *  @param  toValue     The final value of the interpolation, at offset 1. This must be of the same class and type as `fromValue`.
+ *
+ *  @returns            An initialised interpolation session.
+ */
+
+- (instancetype)initWithFromValue: (NSValue *)fromValue toValue: (NSValue *)toValue;
+
+
+//-------------------------------------/
+/** @name Getting Session Information */
+//-------------------------------------/
+
+
+/** The initial value of the interpolation. */
+
+@property ( nonatomic, readonly ) NSValue * fromValue;
+
+/** The final value of the interpolation. */
+
+@property ( nonatomic, readonly ) NSValue * toValue;
+
+/** The type encoding of the values written by getValue:atOffset:. This is `@encode( double )` for numbers (other than BOOLs),
+ *  and the values' own type for structures. */
+
+@property ( nonatomic, readonly ) const char * objCType;
+
+/** The size, in bytes, of the values written by getValue:atOffset:. */
+
+@property ( nonatomic, readonly ) NSUInteger valueSize;
+
+/** Whether the values are numbers, which may be read with valueAtOffset:. */
+
+@property ( nonatomic, readonly, getter = isNumeric ) BOOL numeric;
+
+
+//------------------------------/
+/** @name Interpolating Values */
+//------------------------------/
+
+
+/** Returns the number at a given offset. The values must be numbers.
+ *
+ *  @param  offset  The offset.
+ *
+ *  @returns        The number at distance `offset` in to the interpolation. Offsets of 0 and 1 return the values exactly.
+ */
+
+- (double)valueAtOffset: (SUInterpolationOffset)offset;
+
+/** Writes the value at a given offset in to a buffer.
+ *
+ *  @param  value   A buffer of at least `valueSize` bytes, aligned for the session's objCType. On output, the value at distance
+ *                  `offset` in to the interpolation.
+ *  @param  offset  The offset.
+ */
+
+- (void)getValue: (void *)value atOffset: (SUInterpolationOffset)offset;
+
+/** Returns the value at a given offset, boxed in a new object as `+[NSValue interpolatedValueWithOffset:betweenValue:andValue:]`
+ *  would return it. Offsets of 0 and 1 return the session's values without allocating.
+ *
+ *  @param  offset  The offset.
+ *
+ *  @returns        The value at distance `offset` in to the interpolation.
+ */
+
+- (id)boxedValueAtOffset: (SUInterpolationOffset)offset;
+
+@end
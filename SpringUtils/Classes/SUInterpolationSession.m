@@ -0,0 +1,322 @@
+//
+//  SUInterpolationSession.m
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUInterpolationSession.h"
+
+#import "../Categories/NSValue+SUInterpolable.h"
+#import "../Utilities/SUStructInterpolation.h"
+#import "../Utilities/SUValueInterpolation.h"
+#import "../Utilities/SUTransformInterpolation.h"
+#import "../Utilities/SURuntimeAssertions.h"
+
+#import <QuartzCore/CATransform3D.h>
+
+// Sessions must round exactly as the boxed interpolation methods do, so the compiler may not fuse multiplies and adds.
+
+#pragma STDC FP_CONTRACT OFF
+
+/** How a session interpolates its values, decided when it is created. */
+
+typedef enum _SUInterpolationSessionKind {
+    
+    SUInterpolationSessionKindNumber,       /**< Numbers, interpolated as doubles. */
+    SUInterpolationSessionKindBool,         /**< BOOLs, which snap. */
+    SUInterpolationSessionKindGeometry,     /**< CGPoints, CGSizes and CGRects which NSValue interpolates through floats. */
+    SUInterpolationSessionKindStruct,       /**< Structures with an interpolation plan. */
+    SUInterpolationSessionKindRegistered,   /**< Structures with a registered interpolator. */
+    SUInterpolationSessionKindAffine,       /**< CGAffineTransforms, interpolated by their decompositions. */
+    SUInterpolationSessionKindTransform3D,  /**< CATransform3Ds, interpolated by their decompositions. */
+    SUInterpolationSessionKindSnap,         /**< Values which can't be interpolated, which snap. */
+    
+} SUInterpolationSessionKind;
+
+/** Whether NSValue interpolates values of a type with the CoreGraphics functions, which round each component through a float.
+ *  NSValue can only box these types on iOS; elsewhere it interpolates their fields as doubles. */
+
+static BOOL isFloatGeometryType( const char * type ) {
+    
+#if TARGET_OS_IPHONE
+    return ( 0 == strcmp( type, @encode( CGPoint ) ) ) || ( 0 == strcmp( type, @encode( CGSize ) ) ) || ( 0 == strcmp( type, @encode( CGRect ) ) );
+#else
+    (void)type;
+    return NO;
+#endif
+}
+
+@implementation SUInterpolationSession
+{
+    SUInterpolationSessionKind _kind;
+    
+    // Numbers.
+    
+    double _startNumber;
+    double _numberDelta;
+    double _endNumber;
+    
+    // Structures. Both values' bytes share one buffer.
+    
+    SUStructInterpolationPlan _plan;
+    SUValueInterpolator _interpolator;
+    void * _startBytes;
+    void * _endBytes;
+    
+    // Transforms, decomposed once, so that each offset only interpolates and recomposes them.
+    
+    SUAffineTransformDecomposition _affineDecompositions[ 2 ];
+    SUTransform3DDecomposition _transform3DDecompositions[ 2 ];
+}
+
+#pragma mark -
+#pragma mark Initialisation
+
++ (instancetype)sessionWithFromValue: (NSValue *)fromValue toValue: (NSValue *)toValue {
+    
+    return [[self alloc] initWithFromValue: fromValue toValue: toValue];
+}
+
+- (instancetype)initWithFromValue: (NSValue *)fromValue toValue: (NSValue *)toValue {
+    
+    SU_ASSERT_NOT_EQUAL( fromValue, Nil )
+    SU_ASSERT_NOT_EQUAL( toValue, Nil )
+    SU_ASSERT_MSG( 0 == strcmp( fromValue.objCType, toValue.objCType ),
+                   @"Cannot interpolate; mismatched types between:\n%@, and\n %@", fromValue, toValue )
+    
+    self = [super init];
+    if( self )
+    {
+        _fromValue = fromValue;
+        _toValue   = toValue;
+        _objCType  = fromValue.objCType;
+        
+        if( [fromValue isKindOfClass: [NSNumber class]] )
+        {
+            // Numbers are decoded once, leaving one multiply and add per offset.
+            
+            _kind        = ( 0 == strcmp( _objCType, @encode( BOOL ) ) ) ? SUInterpolationSessionKindBool : SUInterpolationSessionKindNumber;
+            _startNumber = [(NSNumber *)fromValue doubleValue];
+            _endNumber   = [(NSNumber *)toValue doubleValue];
+            _numberDelta = ( _endNumber - _startNumber );
+            _objCType    = ( SUInterpolationSessionKindBool == _kind ) ? @encode( BOOL ) : @encode( double );
+            _valueSize   = ( SUInterpolationSessionKindBool == _kind ) ? sizeof( BOOL ) : sizeof( double );
+        }
+        else
+        {
+            NSUInteger size, alignment;
+            NSGetSizeAndAlignment( _objCType, &size, &alignment );
+            
+            // As with NSValue, points, sizes and rectangles are interpolated before looking for a registered interpolator.
+            
+            const BOOL isGeometry = isFloatGeometryType( _objCType );
+            
+            _interpolator = isGeometry ? NULL : [NSValue registeredInterpolatorForObjCType: _objCType];
+            _plan         = ( ( NULL == _interpolator ) && ( NO == isGeometry ) ) ? structInterpolationPlanForType( _objCType ) : NULL;
+            _valueSize    = ( NULL != _plan ) ? structInterpolationPlanSize( _plan ) : size;
+            
+            if( isGeometry )
+                _kind = SUInterpolationSessionKindGeometry;
+            else if( NULL != _interpolator )
+                _kind = SUInterpolationSessionKindRegistered;
+            else if( NULL != _plan )
+                _kind = SUInterpolationSessionKindStruct;
+            else
+                _kind = SUInterpolationSessionKindSnap;
+            
+            // Both buffers are aligned, as malloc aligns for any type and the size is a multiple of the type's alignment.
+            
+            _startBytes = malloc( _valueSize * 2 );
+            _endBytes   = ( (UInt8 *)_startBytes + _valueSize );
+            
+            SU_ASSERT_NOT_EQUAL( _startBytes, NULL )
+            
+            [fromValue getValue: _startBytes];
+            [toValue getValue: _endBytes];
+            
+            // Transforms are interpolated as NSValue interpolates them: by their decompositions, unless an interpolator has been
+            // registered for them.
+            
+            if( ( NULL == _interpolator ) && ( 0 == strcmp( _objCType, @encode( CGAffineTransform ) ) ) )
+            {
+                decomposeAffineTransform( *(CGAffineTransform *)_startBytes, &_affineDecompositions[ 0 ] );
+                decomposeAffineTransform( *(CGAffineTransform *)_endBytes, &_affineDecompositions[ 1 ] );
+                
+                _kind = SUInterpolationSessionKindAffine;
+            }
+            else if( ( NULL == _interpolator ) && ( 0 == strcmp( _objCType, @encode( CATransform3D ) ) ) )
+            {
+                double startMatrix[ 16 ], endMatrix[ 16 ];
+                
+                getTransform3DFromCGFloats( &( (CATransform3D *)_startBytes )->m11, startMatrix );
+                getTransform3DFromCGFloats( &( (CATransform3D *)_endBytes )->m11, endMatrix );
+                
+                if( decomposeTransform3D( startMatrix, &_transform3DDecompositions[ 0 ] ) &&
+                    decomposeTransform3D( endMatrix, &_transform3DDecompositions[ 1 ] ) )
+                    _kind = SUInterpolationSessionKindTransform3D;
+                else
+                    _kind = SUInterpolationSessionKindSnap;
+            }
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc {
+    
+    free( _startBytes );
+}
+
+#pragma mark -
+#pragma mark Session Information
+
+- (BOOL)isNumeric {
+    
+    return ( SUInterpolationSessionKindNumber == _kind ) || ( SUInterpolationSessionKindBool == _kind );
+}
+
+#pragma mark -
+#pragma mark Interpolating Values
+
+- (double)valueAtOffset: (SUInterpolationOffset)offset {
+    
+    SU_ASSERT_MSG( self.isNumeric, @"Cannot get a number from an interpolation between %@ and %@", _fromValue, _toValue )
+    
+    if( SUInterpolationSessionKindBool == _kind )
+        return ( offset < 0.5f ) ? _startNumber : _endNumber;
+    
+    // Fixed points
+    
+    if( 1 == offset ) return _endNumber;
+    
+    return _startNumber + ( _numberDelta * offset );
+}
+
+- (void)getValue: (void *)value atOffset: (SUInterpolationOffset)offset {
+    
+    switch( _kind )
+    {
+        case SUInterpolationSessionKindNumber:
+        {
+            const double number = [self valueAtOffset: offset];
+            memcpy( value, &number, sizeof( double ) );
+            break;
+        }
+        
+        case SUInterpolationSessionKindBool:
+        {
+            const BOOL flag = ( offset < 0.5f ) ? [(NSNumber *)_fromValue boolValue] : [(NSNumber *)_toValue boolValue];
+            memcpy( value, &flag, sizeof( BOOL ) );
+            break;
+        }
+        
+        case SUInterpolationSessionKindGeometry:
+        {
+            // Every field is a CGFloat, which pointWithOffsetBetweenPoints() and friends interpolate one at a time.
+            
+            const CGFloat * starts = _startBytes;
+            const CGFloat * ends   = _endBytes;
+            CGFloat * results      = value;
+            
+            for( NSUInteger i = 0; i < ( _valueSize / sizeof( CGFloat ) ); i++ )
+            {
+                results[ i ] = floatWithOffsetBetweenFloats( (float)starts[ i ], (float)ends[ i ], offset );
+            }
+            break;
+        }
+        
+        case SUInterpolationSessionKindStruct:
+            interpolateStructWithPlan( _plan, _startBytes, _endBytes, offset, value );
+            break;
+        
+        case SUInterpolationSessionKindRegistered:
+            [_interpolator( _fromValue, _toValue, offset ) getValue: value];
+            break;
+        
+        case SUInterpolationSessionKindAffine:
+        {
+            SUAffineTransformDecomposition decomposition;
+            interpolateAffineTransformDecompositions( &_affineDecompositions[ 0 ], &_affineDecompositions[ 1 ], offset, &decomposition );
+            
+            const CGAffineTransform transform = recomposeAffineTransform( &decomposition );
+            memcpy( value, &transform, sizeof( CGAffineTransform ) );
+            break;
+        }
+        
+        case SUInterpolationSessionKindTransform3D:
+        {
+            SUTransform3DDecomposition decomposition;
+            interpolateTransform3DDecompositions( &_transform3DDecompositions[ 0 ], &_transform3DDecompositions[ 1 ], offset, &decomposition );
+            
+            double matrix[ 16 ];
+            CATransform3D transform;
+            
+            recomposeTransform3D( &decomposition, matrix );
+            getCGFloatsFromTransform3D( matrix, &transform.m11 );
+            memcpy( value, &transform, sizeof( CATransform3D ) );
+            break;
+        }
+        
+        case SUInterpolationSessionKindSnap:
+            memcpy( value, ( offset < 0.5f ) ? _startBytes : _endBytes, _valueSize );
+            break;
+    }
+}
+
+- (id)boxedValueAtOffset: (SUInterpolationOffset)offset {
+    
+    // Fixed points
+    
+    if( 0 == offset ) return _fromValue;
+    if( 1 == offset ) return _toValue;
+    
+    switch( _kind )
+    {
+        case SUInterpolationSessionKindNumber:
+            return @( [self valueAtOffset: offset] );
+        
+        case SUInterpolationSessionKindRegistered:
+            return _interpolator( _fromValue, _toValue, offset );
+        
+        case SUInterpolationSessionKindGeometry:
+        case SUInterpolationSessionKindAffine:
+        case SUInterpolationSessionKindTransform3D:
+        {
+            // A CATransform3D is large enough to hold any of these types.
+            
+            CATransform3D transform;
+            [self getValue: &transform atOffset: offset];
+            
+            return [NSValue valueWithBytes: &transform objCType: _objCType];
+        }
+        
+        case SUInterpolationSessionKindStruct:
+        {
+            // The interpolated value is written to a buffer on the stack, which is made of doubles so that any field is aligned.
+            
+            double stackBuffer[ 32 ];
+            void * bytes = ( _valueSize <= sizeof( stackBuffer ) ) ? stackBuffer : malloc( _valueSize );
+            
+            SU_ASSERT_NOT_EQUAL( bytes, NULL )
+            
+            interpolateStructWithPlan( _plan, _startBytes, _endBytes, offset, bytes );
+            
+            NSValue * value = [NSValue valueWithBytes: bytes objCType: _objCType];
+            
+            if( bytes != stackBuffer )
+                free( bytes );
+            
+            return value;
+        }
+        
+        default:
+            return ( offset < 0.5f ) ? _fromValue : _toValue;
+    }
+}
+
+@end
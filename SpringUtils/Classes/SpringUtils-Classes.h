@@ -14,6 +14,7 @@
 #import "SUWeakMutableSet.h"
 #import "SUClassBuilder.h"
 #import "SUInterceptor.h"
+#import "SUInterpolationSession.h"
 
 #if (TARGET_OS_IPHONE)
     #import "SUAnimator.h"
@@ -0,0 +1,289 @@
+//
+//  SUKeyframeTrack.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUKeyframeTrack.h"
+
+#import <stdlib.h>
+
+/** A track and its arrays share one allocation. Values and tangents are stored component by component, so each is an array of
+ *  `numberOfComponents` runs of `numberOfKeys` floats. */
+
+struct _SUKeyframeTrack {
+    
+    UInt32 numberOfKeys;
+    UInt32 numberOfComponents;
+    
+    const double * times;
+    const float  * values;
+    const float  * tangents;        /**< The slope of each component at each key. NULL if the track has no cubic segments. */
+    const UInt8  * interpolations;  /**< The SUKeyframeInterpolation of the segment starting at each key. */
+    
+};
+
+#pragma mark -
+#pragma mark Creating Tracks
+
+/** Returns the slope of one component from key `from` to key `to`, or 0 if they are at the same time. */
+
+SU_INLINE float keyframeSlope( const double * times, const float * values, UInt32 from, UInt32 to ) {
+    
+    const double duration = ( times[ to ] - times[ from ] );
+    
+    return ( duration > 0 ) ? (float)( ( values[ to ] - values[ from ] ) / duration ) : 0;
+}
+
+SUKeyframeTrack createKeyframeTrack( const double * keyTimes, const float * keyValues, const SUKeyframeInterpolation * interpolations,
+                                     UInt32 numberOfKeys, UInt32 numberOfComponents ) {
+    
+    if( ( 0 == numberOfKeys ) || ( 0 == numberOfComponents ) )
+        return NULL;
+    
+    bool hasCubicSegments = false;
+    
+    for( UInt32 key = 0; key < numberOfKeys; key++ )
+    {
+        if( ( key > 0 ) && ( keyTimes[ key ] < keyTimes[ key - 1 ] ) )
+            return NULL;
+        
+        if( ( NULL != interpolations ) && ( SUKeyframeInterpolationCubic == interpolations[ key ] ) )
+            hasCubicSegments = true;
+    }
+    
+    
+    // ===================
+    //
+    // 1. Lay out the arrays after the track, largest elements first so that each is aligned
+    //
+    // ===================
+    
+    
+    const size_t numberOfValues = ( (size_t)numberOfKeys * numberOfComponents );
+    const size_t timesSize      = ( numberOfKeys * sizeof( double ) );
+    const size_t valuesSize     = ( numberOfValues * sizeof( float ) );
+    const size_t tangentsSize   = hasCubicSegments ? valuesSize : 0;
+    
+    SUKeyframeTrack track = malloc( sizeof( struct _SUKeyframeTrack ) + timesSize + valuesSize + tangentsSize + numberOfKeys );
+    
+    if( NULL == track )
+        return NULL;
+    
+    double * times         = (double *)( track + 1 );
+    float  * values        = (float *)( (UInt8 *)times + timesSize );
+    float  * tangents      = hasCubicSegments ? (float *)( (UInt8 *)values + valuesSize ) : NULL;
+    UInt8  * segmentModes  = ( (UInt8 *)values + valuesSize + tangentsSize );
+    
+    track->numberOfKeys         = numberOfKeys;
+    track->numberOfComponents   = numberOfComponents;
+    track->times                = times;
+    track->values               = values;
+    track->tangents             = tangents;
+    track->interpolations       = segmentModes;
+    
+    
+    // ===================
+    //
+    // 2. Copy the keys, transposing their values to one array per component
+    //
+    // ===================
+    
+    
+    for( UInt32 key = 0; key < numberOfKeys; key++ )
+    {
+        times[ key ]        = keyTimes[ key ];
+        segmentModes[ key ] = (UInt8)( ( NULL != interpolations ) ? interpolations[ key ] : SUKeyframeInterpolationLinear );
+        
+        for( UInt32 component = 0; component < numberOfComponents; component++ )
+        {
+            values[ ( component * numberOfKeys ) + key ] = keyValues[ ( key * numberOfComponents ) + component ];
+        }
+    }
+    
+    
+    // ===================
+    //
+    // 3. Compute the tangents of cubic segments
+    //
+    // ===================
+    
+    
+    // Each key's tangent is the average of the slopes of the segments either side of it (or the slope of its one neighbouring
+    // segment, at the ends). Slopes are per unit of time, so that keys needn't be evenly spaced.
+    
+    for( UInt32 component = 0; hasCubicSegments && ( component < numberOfComponents ); component++ )
+    {
+        const float * componentValues = ( values + ( component * numberOfKeys ) );
+        float * componentTangents     = ( tangents + ( component * numberOfKeys ) );
+        
+        for( UInt32 key = 0; key < numberOfKeys; key++ )
+        {
+            if( 1 == numberOfKeys )
+                componentTangents[ key ] = 0;
+            else if( 0 == key )
+                componentTangents[ key ] = keyframeSlope( times, componentValues, 0, 1 );
+            else if( ( numberOfKeys - 1 ) == key )
+                componentTangents[ key ] = keyframeSlope( times, componentValues, key - 1, key );
+            else
+                componentTangents[ key ] = ( keyframeSlope( times, componentValues, key - 1, key ) + keyframeSlope( times, componentValues, key, key + 1 ) ) * 0.5f;
+        }
+    }
+    
+    return track;
+}
+
+void freeKeyframeTrack( SUKeyframeTrack track ) {
+    
+    free( track );
+}
+
+UInt32 keyframeTrackNumberOfKeys( SUKeyframeTrack track ) {
+    
+    return track->numberOfKeys;
+}
+
+UInt32 keyframeTrackNumberOfComponents( SUKeyframeTrack track ) {
+    
+    return track->numberOfComponents;
+}
+
+#pragma mark -
+#pragma mark Evaluating Tracks
+
+/** Returns the last segment which starts at or before `time`, searching segments [`first`, `end`). */
+
+static UInt32 searchKeyframeSegments( const double * times, double time, UInt32 first, UInt32 end ) {
+    
+    while( ( end - first ) > 1 )
+    {
+        const UInt32 middle = ( first + ( ( end - first ) / 2 ) );
+        
+        if( times[ middle ] <= time )
+            first = middle;
+        else
+            end = middle;
+    }
+    
+    return first;
+}
+
+/** Returns the segment containing `time`, which must be after the first key and before the last. */
+
+SU_INLINE UInt32 keyframeSegmentForTime( SUKeyframeTrack track, double time, SUKeyframeCursor * cursor ) {
+    
+    const double * times          = track->times;
+    const UInt32 numberOfSegments = ( track->numberOfKeys - 1 );
+    
+    if( NULL == cursor )
+        return searchKeyframeSegments( times, time, 0, numberOfSegments );
+    
+    UInt32 segment = ( cursor->segment < numberOfSegments ) ? cursor->segment : ( numberOfSegments - 1 );
+    
+    // Sequential evaluation stays in the same segment, or moves on to the next one.
+    
+    if( times[ segment ] <= time )
+    {
+        if( time >= times[ segment + 1 ] )
+        {
+            if( ( ( segment + 2 ) < track->numberOfKeys ) && ( time < times[ segment + 2 ] ) )
+                segment++;
+            else
+                segment = searchKeyframeSegments( times, time, segment + 1, numberOfSegments );
+        }
+    }
+    else
+    {
+        segment = searchKeyframeSegments( times, time, 0, segment );
+    }
+    
+    cursor->segment = segment;
+    return segment;
+}
+
+void evaluateKeyframeTrack( SUKeyframeTrack track, double time, SUKeyframeCursor * cursor, float * values ) {
+    
+    const UInt32 numberOfKeys = track->numberOfKeys;
+    const double * times      = track->times;
+    
+    // Outside of the keys, the track holds the first or last key's values.
+    
+    if( ( time <= times[ 0 ] ) || ( time >= times[ numberOfKeys - 1 ] ) )
+    {
+        const UInt32 key = ( time <= times[ 0 ] ) ? 0 : ( numberOfKeys - 1 );
+        
+        for( UInt32 component = 0; component < track->numberOfComponents; component++ )
+        {
+            values[ component ] = track->values[ ( component * numberOfKeys ) + key ];
+        }
+        
+        return;
+    }
+    
+    const UInt32 segment                = keyframeSegmentForTime( track, time, cursor );
+    const double duration               = ( times[ segment + 1 ] - times[ segment ] );
+    const SUInterpolationOffset offset  = (SUInterpolationOffset)( ( time - times[ segment ] ) / duration );
+    const float * startValues           = ( track->values + segment );
+    
+    switch( (SUKeyframeInterpolation)track->interpolations[ segment ] )
+    {
+        case SUKeyframeInterpolationStep:
+        {
+            for( UInt32 component = 0; component < track->numberOfComponents; component++ )
+            {
+                values[ component ] = startValues[ component * numberOfKeys ];
+            }
+            break;
+        }
+        
+        case SUKeyframeInterpolationCubic:
+        {
+            // Hermite basis functions, with the tangents scaled from per unit of time to per segment.
+            
+            const float t  = offset;
+            const float t2 = ( t * t );
+            const float t3 = ( t2 * t );
+            
+            const float h00 = ( ( 2 * t3 ) - ( 3 * t2 ) + 1 );
+            const float h10 = ( t3 - ( 2 * t2 ) + t );
+            const float h01 = ( ( 3 * t2 ) - ( 2 * t3 ) );
+            const float h11 = ( t3 - t2 );
+            
+            const float * startTangents = ( track->tangents + segment );
+            
+            for( UInt32 component = 0; component < track->numberOfComponents; component++ )
+            {
+                const size_t index = ( component * numberOfKeys );
+                
+                values[ component ] = ( h00 * startValues[ index ] ) + ( h10 * (float)duration * startTangents[ index ] ) +
+                                      ( h01 * startValues[ index + 1 ] ) + ( h11 * (float)duration * startTangents[ index + 1 ] );
+            }
+            break;
+        }
+        
+        default:
+        {
+            for( UInt32 component = 0; component < track->numberOfComponents; component++ )
+            {
+                const size_t index = ( component * numberOfKeys );
+                
+                values[ component ] = floatWithOffsetBetweenFloats( startValues[ index ], startValues[ index + 1 ], offset );
+            }
+            break;
+        }
+    }
+}
+
+void evaluateKeyframeTracks( const SUKeyframeTrack * tracks, SUKeyframeCursor * cursors, UInt32 numberOfTracks, double time, float * values ) {
+    
+    for( UInt32 i = 0; i < numberOfTracks; i++ )
+    {
+        evaluateKeyframeTrack( tracks[ i ], time, &cursors[ i ], values );
+        
+        values += tracks[ i ]->numberOfComponents;
+    }
+}
@@ -0,0 +1,110 @@
+//
+//  SUKeyframeTrack.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUKeyframeTrack_h
+#define SpringUtils_SUKeyframeTrack_h
+
+#import "SUValueInterpolation.h"
+
+/** Keyframed animation tracks.
+ *
+ *  A track holds the times of its keys, and the values of each of its components at those keys, in a single immutable buffer:
+ *  an array of key times, an array of segment modes, and one array of values (and, for cubic segments, tangents) per component.
+ *  Each segment runs from one key to the next, and is interpolated in its own mode. Before the first key a track holds the
+ *  first key's values, and from the last key on it holds the last key's values.
+ *
+ *  Evaluating a track finds the segment containing the time, using a cursor owned by the caller. When a track is evaluated at
+ *  increasing times, the segment is either the cursor's segment or the one after it, so finding it takes constant time;
+ *  otherwise (e.g. after seeking) it is found by binary search. Tracks may be evaluated on any number of threads at once, as long
+ *  as each thread uses its own cursors. Evaluating a track does not allocate memory.
+ */
+
+typedef struct _SUKeyframeTrack *SUKeyframeTrack;
+
+/** How the values of a segment are interpolated between its keys. */
+
+typedef enum _SUKeyframeInterpolation {
+    
+    SUKeyframeInterpolationLinear   = 0,    /**< Values change linearly from one key to the next. */
+    SUKeyframeInterpolationStep     = 1,    /**< Values hold the first key's values until the next key. */
+    SUKeyframeInterpolationCubic    = 2,    /**< Values follow a cubic Hermite curve, whose tangents at each key are the average of the slopes either side of it. */
+    
+} SUKeyframeInterpolation;
+
+/** Remembers the segment a track was last evaluated in. Initialise cursors to zero (e.g. `SUKeyframeCursor cursor = { 0 };`). */
+
+typedef struct _SUKeyframeCursor {
+    
+    UInt32 segment;
+    
+} SUKeyframeCursor;
+
+
+//-------------------------/
+/** @name Creating Tracks */
+//-------------------------/
+
+
+/** Creates a keyframe track.
+ *
+ *  @param  keyTimes            The time of each key. Times must not decrease; two keys at the same time make the values jump.
+ *  @param  keyValues           The values of each key's components, key by key (i.e. `numberOfComponents` values per key).
+ *  @param  interpolations      The mode of the segment which starts at each key, or NULL to interpolate every segment linearly.
+ *  @param  numberOfKeys        The number of keys.
+ *  @param  numberOfComponents  The number of values at each key (e.g. 2 for a point).
+ *
+ *  @returns                    A new track, or NULL if there are no keys or components, or the key times decrease.
+ *                              You must release this value by calling freeKeyframeTrack().
+ */
+
+SU_EXTERN SUKeyframeTrack createKeyframeTrack( const double * keyTimes, const float * keyValues, const SUKeyframeInterpolation * interpolations,
+                                               UInt32 numberOfKeys, UInt32 numberOfComponents );
+
+/** Frees a keyframe track. */
+
+SU_EXTERN void freeKeyframeTrack( SUKeyframeTrack track );
+
+/** Returns the number of keys in a track. */
+
+SU_EXTERN UInt32 keyframeTrackNumberOfKeys( SUKeyframeTrack track );
+
+/** Returns the number of values at each of a track's keys. */
+
+SU_EXTERN UInt32 keyframeTrackNumberOfComponents( SUKeyframeTrack track );
+
+
+//---------------------------/
+/** @name Evaluating Tracks */
+//---------------------------/
+
+
+/** Evaluates a track at a given time.
+ *
+ *  @param  track   The track.
+ *  @param  time    The time.
+ *  @param  cursor  The cursor to start looking for the time's segment from, which is updated to the segment found. If NULL,
+ *                  the segment is found by binary search.
+ *  @param  values  On output, the value of each of the track's components at the given time.
+ */
+
+SU_EXTERN void evaluateKeyframeTrack( SUKeyframeTrack track, double time, SUKeyframeCursor * cursor, float * values );
+
+/** Evaluates several tracks at the same time, e.g. all of the tracks of an animation for one frame.
+ *
+ *  @param  tracks          The tracks.
+ *  @param  cursors         A cursor for each track.
+ *  @param  numberOfTracks  The number of tracks.
+ *  @param  time            The time.
+ *  @param  values          On output, the values of each track's components, track by track.
+ */
+
+SU_EXTERN void evaluateKeyframeTracks( const SUKeyframeTrack * tracks, SUKeyframeCursor * cursors, UInt32 numberOfTracks, double time, float * values );
+
+#endif
@@ -0,0 +1,579 @@
+//
+//  SUPCMConversion.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUPCMConversion.h"
+#import "SUPCMConversion_Private.h"
+
+#import <math.h>
+#import <stdlib.h>
+#import <string.h>
+
+#if defined( __SSE2__ )
+    #import <emmintrin.h>
+    #define SU_PCM_SSE2 1
+    #if defined( __SSSE3__ )
+        #import <tmmintrin.h>
+        #define SU_PCM_SSSE3 1
+    #endif
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+    #import <arm_neon.h>
+    #define SU_PCM_NEON 1
+#endif
+
+// The vector kernels and their scalar tails perform the same single-precision operations, so results are bit-identical.
+
+#pragma STDC FP_CONTRACT OFF
+
+#pragma mark -
+#pragma mark Converting Sample Types
+
+void convertInt16ToFloat32Kernel( const SInt16 * source, float * destination, size_t numberOfSamples, bool vector ) {
+    
+    const float scale = ( 1.0f / 32768.0f );
+    size_t i = 0;
+    
+#if SU_PCM_SSE2
+    if( vector )
+    {
+        const __m128 scales = _mm_set1_ps( scale );
+        
+        for( ; ( i + 8 ) <= numberOfSamples; i += 8 )
+        {
+            const __m128i packed = _mm_loadu_si128( (const __m128i *)( source + i ) );
+            const __m128  lo     = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( packed, packed ), 16 ) );
+            const __m128  hi     = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( packed, packed ), 16 ) );
+            
+            _mm_storeu_ps( destination + i,     _mm_mul_ps( lo, scales ) );
+            _mm_storeu_ps( destination + i + 4, _mm_mul_ps( hi, scales ) );
+        }
+    }
+#elif SU_PCM_NEON
+    if( vector )
+    {
+        for( ; ( i + 8 ) <= numberOfSamples; i += 8 )
+        {
+            const int16x8_t packed = vld1q_s16( source + i );
+            
+            vst1q_f32( destination + i,     vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_low_s16( packed ) ) ),  scale ) );
+            vst1q_f32( destination + i + 4, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_high_s16( packed ) ) ), scale ) );
+        }
+    }
+#else
+    (void)vector;
+#endif
+    
+    for( ; i < numberOfSamples; i++ )
+    {
+        destination[ i ] = (float)source[ i ] * scale;
+    }
+}
+
+void convertFloat32ToInt16Kernel( const float * source, SInt16 * destination, size_t numberOfSamples, bool vector ) {
+    
+    size_t i = 0;
+    
+#if SU_PCM_SSE2
+    if( vector )
+    {
+        const __m128 scale   = _mm_set1_ps( 32768.0f );
+        const __m128 maximum = _mm_set1_ps( 32767.0f );
+        const __m128 minimum = _mm_set1_ps( -32768.0f );
+        
+        for( ; ( i + 8 ) <= numberOfSamples; i += 8 )
+        {
+            // minps returns its second operand if either is NaN, matching fminf().
+            
+            const __m128 lo = _mm_max_ps( _mm_min_ps( _mm_mul_ps( _mm_loadu_ps( source + i ),     scale ), maximum ), minimum );
+            const __m128 hi = _mm_max_ps( _mm_min_ps( _mm_mul_ps( _mm_loadu_ps( source + i + 4 ), scale ), maximum ), minimum );
+            
+            _mm_storeu_si128( (__m128i *)( destination + i ), _mm_packs_epi32( _mm_cvtps_epi32( lo ), _mm_cvtps_epi32( hi ) ) );
+        }
+    }
+#elif SU_PCM_NEON && defined( __aarch64__ )
+    if( vector )
+    {
+        const float32x4_t maximum = vdupq_n_f32( 32767.0f );
+        const float32x4_t minimum = vdupq_n_f32( -32768.0f );
+        
+        for( ; ( i + 8 ) <= numberOfSamples; i += 8 )
+        {
+            // fminnm/fmaxnm return the numeric operand if the other is NaN, matching fminf() and fmaxf().
+            
+            const float32x4_t lo = vmaxnmq_f32( vminnmq_f32( vmulq_n_f32( vld1q_f32( source + i ),     32768.0f ), maximum ), minimum );
+            const float32x4_t hi = vmaxnmq_f32( vminnmq_f32( vmulq_n_f32( vld1q_f32( source + i + 4 ), 32768.0f ), maximum ), minimum );
+            
+            vst1q_s16( destination + i, vcombine_s16( vqmovn_s32( vcvtnq_s32_f32( lo ) ), vqmovn_s32( vcvtnq_s32_f32( hi ) ) ) );
+        }
+    }
+#else
+    (void)vector;
+#endif
+    
+    for( ; i < numberOfSamples; i++ )
+    {
+        const float scaled  = source[ i ] * 32768.0f;
+        const float clamped = fmaxf( fminf( scaled, 32767.0f ), -32768.0f );
+        
+        destination[ i ] = (SInt16)lrintf( clamped );
+    }
+}
+
+void convertPackedInt24ToFloat32Kernel( const UInt8 * source, float * destination, size_t numberOfSamples, bool vector ) {
+    
+    // Samples are shifted in to the top of a 32-bit integer, which preserves their sign and is exactly representable as a float.
+    
+    const float scale = ( 1.0f / 2147483648.0f );
+    size_t i = 0;
+    
+#if SU_PCM_SSSE3
+    if( vector )
+    {
+        const __m128i shuffle = _mm_setr_epi8( -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11 );
+        const __m128  scales  = _mm_set1_ps( scale );
+        
+        // Each 16-byte load reads 4 samples plus 4 bytes beyond them, so stop while those bytes are still in the buffer.
+        
+        for( ; ( i + 6 ) <= numberOfSamples; i += 4 )
+        {
+            const __m128i packed  = _mm_loadu_si128( (const __m128i *)( source + ( 3 * i ) ) );
+            const __m128  samples = _mm_cvtepi32_ps( _mm_shuffle_epi8( packed, shuffle ) );
+            
+            _mm_storeu_ps( destination + i, _mm_mul_ps( samples, scales ) );
+        }
+    }
+#elif SU_PCM_NEON
+    if( vector )
+    {
+        for( ; ( i + 8 ) <= numberOfSamples; i += 8 )
+        {
+            // Build (b0 << 8) and (b1 | b2 << 8) as 16-bit halves, then zip them in to 32-bit little-endian words.
+            
+            const uint8x8x3_t bytes  = vld3_u8( source + ( 3 * i ) );
+            const uint16x8_t  low16  = vshll_n_u8( bytes.val[ 0 ], 8 );
+            const uint16x8_t  high16 = vorrq_u16( vmovl_u8( bytes.val[ 1 ] ), vshll_n_u8( bytes.val[ 2 ], 8 ) );
+            const uint16x8x2_t words = vzipq_u16( low16, high16 );
+            const uint32x4_t  lo     = vreinterpretq_u32_u16( words.val[ 0 ] );
+            const uint32x4_t  hi     = vreinterpretq_u32_u16( words.val[ 1 ] );
+            
+            vst1q_f32( destination + i,     vmulq_n_f32( vcvtq_f32_s32( vreinterpretq_s32_u32( lo ) ), scale ) );
+            vst1q_f32( destination + i + 4, vmulq_n_f32( vcvtq_f32_s32( vreinterpretq_s32_u32( hi ) ), scale ) );
+        }
+    }
+#else
+    (void)vector;
+#endif
+    
+    for( ; i < numberOfSamples; i++ )
+    {
+        const UInt8 * bytes = source + ( 3 * i );
+        const SInt32 sample = (SInt32)( ( (UInt32)bytes[ 0 ] << 8 ) | ( (UInt32)bytes[ 1 ] << 16 ) | ( (UInt32)bytes[ 2 ] << 24 ) );
+        
+        destination[ i ] = (float)sample * scale;
+    }
+}
+
+void convertInt16ToFloat32( const SInt16 * source, float * destination, size_t numberOfSamples ) {
+    
+    convertInt16ToFloat32Kernel( source, destination, numberOfSamples, true );
+}
+
+void convertFloat32ToInt16( const float * source, SInt16 * destination, size_t numberOfSamples ) {
+    
+    convertFloat32ToInt16Kernel( source, destination, numberOfSamples, true );
+}
+
+void convertPackedInt24ToFloat32( const UInt8 * source, float * destination, size_t numberOfSamples ) {
+    
+    convertPackedInt24ToFloat32Kernel( source, destination, numberOfSamples, true );
+}
+
+#pragma mark -
+#pragma mark Interleaving Float Samples
+
+void interleaveFloat32Kernel( const float * const * sources, UInt32 numberOfChannels, float * destination, size_t numberOfFrames, bool vector ) {
+    
+    size_t i = 0;
+    
+    if( 2 == numberOfChannels )
+    {
+        const float * left  = sources[ 0 ];
+        const float * right = sources[ 1 ];
+        
+#if SU_PCM_SSE2
+        if( vector )
+        {
+            for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+            {
+                const __m128 l = _mm_loadu_ps( left + i );
+                const __m128 r = _mm_loadu_ps( right + i );
+                
+                _mm_storeu_ps( destination + ( 2 * i ),     _mm_unpacklo_ps( l, r ) );
+                _mm_storeu_ps( destination + ( 2 * i ) + 4, _mm_unpackhi_ps( l, r ) );
+            }
+        }
+#elif SU_PCM_NEON
+        if( vector )
+        {
+            for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+            {
+                float32x4x2_t lr;
+                lr.val[ 0 ] = vld1q_f32( left + i );
+                lr.val[ 1 ] = vld1q_f32( right + i );
+                
+                vst2q_f32( destination + ( 2 * i ), lr );
+            }
+        }
+#else
+    (void)vector;
+#endif
+        
+        for( ; i < numberOfFrames; i++ )
+        {
+            destination[ ( 2 * i ) + 0 ] = left[ i ];
+            destination[ ( 2 * i ) + 1 ] = right[ i ];
+        }
+        
+        return;
+    }
+    
+    for( ; i < numberOfFrames; i++ )
+    {
+        for( UInt32 c = 0; c < numberOfChannels; c++ )
+        {
+            destination[ ( i * numberOfChannels ) + c ] = sources[ c ][ i ];
+        }
+    }
+}
+
+void deinterleaveFloat32Kernel( const float * source, UInt32 numberOfChannels, float * const * destinations, size_t numberOfFrames, bool vector ) {
+    
+    size_t i = 0;
+    
+    if( 2 == numberOfChannels )
+    {
+        float * left  = destinations[ 0 ];
+        float * right = destinations[ 1 ];
+        
+#if SU_PCM_SSE2
+        if( vector )
+        {
+            for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+            {
+                const __m128 a = _mm_loadu_ps( source + ( 2 * i ) );
+                const __m128 b = _mm_loadu_ps( source + ( 2 * i ) + 4 );
+                
+                _mm_storeu_ps( left + i,  _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+                _mm_storeu_ps( right + i, _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+            }
+        }
+#elif SU_PCM_NEON
+        if( vector )
+        {
+            for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+            {
+                const float32x4x2_t lr = vld2q_f32( source + ( 2 * i ) );
+                
+                vst1q_f32( left + i,  lr.val[ 0 ] );
+                vst1q_f32( right + i, lr.val[ 1 ] );
+            }
+        }
+#else
+    (void)vector;
+#endif
+        
+        for( ; i < numberOfFrames; i++ )
+        {
+            left[ i ]  = source[ ( 2 * i ) + 0 ];
+            right[ i ] = source[ ( 2 * i ) + 1 ];
+        }
+        
+        return;
+    }
+    
+    for( ; i < numberOfFrames; i++ )
+    {
+        for( UInt32 c = 0; c < numberOfChannels; c++ )
+        {
+            destinations[ c ][ i ] = source[ ( i * numberOfChannels ) + c ];
+        }
+    }
+}
+
+void interleaveFloat32( const float * const * sources, UInt32 numberOfChannels, float * destination, size_t numberOfFrames ) {
+    
+    interleaveFloat32Kernel( sources, numberOfChannels, destination, numberOfFrames, true );
+}
+
+void deinterleaveFloat32( const float * source, UInt32 numberOfChannels, float * const * destinations, size_t numberOfFrames ) {
+    
+    deinterleaveFloat32Kernel( source, numberOfChannels, destinations, numberOfFrames, true );
+}
+
+#pragma mark -
+#pragma mark Mixing Float Channels
+
+void upmixMonoToStereoFloat32Kernel( const float * source, float * destination, size_t numberOfFrames, bool vector ) {
+    
+    size_t i = 0;
+    
+#if SU_PCM_SSE2
+    if( vector )
+    {
+        for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+        {
+            const __m128 m = _mm_loadu_ps( source + i );
+            
+            _mm_storeu_ps( destination + ( 2 * i ),     _mm_unpacklo_ps( m, m ) );
+            _mm_storeu_ps( destination + ( 2 * i ) + 4, _mm_unpackhi_ps( m, m ) );
+        }
+    }
+#elif SU_PCM_NEON
+    if( vector )
+    {
+        for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+        {
+            float32x4x2_t mm;
+            mm.val[ 0 ] = vld1q_f32( source + i );
+            mm.val[ 1 ] = mm.val[ 0 ];
+            
+            vst2q_f32( destination + ( 2 * i ), mm );
+        }
+    }
+#else
+    (void)vector;
+#endif
+    
+    for( ; i < numberOfFrames; i++ )
+    {
+        destination[ ( 2 * i ) + 0 ] = source[ i ];
+        destination[ ( 2 * i ) + 1 ] = source[ i ];
+    }
+}
+
+void downmixStereoToMonoFloat32Kernel( const float * source, float * destination, size_t numberOfFrames, bool vector ) {
+    
+    size_t i = 0;
+    
+#if SU_PCM_SSE2
+    if( vector )
+    {
+        const __m128 half = _mm_set1_ps( 0.5f );
+        
+        for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+        {
+            const __m128 a = _mm_loadu_ps( source + ( 2 * i ) );
+            const __m128 b = _mm_loadu_ps( source + ( 2 * i ) + 4 );
+            const __m128 l = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+            const __m128 r = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+            
+            _mm_storeu_ps( destination + i, _mm_mul_ps( _mm_add_ps( l, r ), half ) );
+        }
+    }
+#elif SU_PCM_NEON
+    if( vector )
+    {
+        for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+        {
+            const float32x4x2_t lr = vld2q_f32( source + ( 2 * i ) );
+            
+            vst1q_f32( destination + i, vmulq_n_f32( vaddq_f32( lr.val[ 0 ], lr.val[ 1 ] ), 0.5f ) );
+        }
+    }
+#else
+    (void)vector;
+#endif
+    
+    for( ; i < numberOfFrames; i++ )
+    {
+        destination[ i ] = ( source[ ( 2 * i ) + 0 ] + source[ ( 2 * i ) + 1 ] ) * 0.5f;
+    }
+}
+
+void upmixMonoToStereoFloat32( const float * source, float * destination, size_t numberOfFrames ) {
+    
+    upmixMonoToStereoFloat32Kernel( source, destination, numberOfFrames, true );
+}
+
+void downmixStereoToMonoFloat32( const float * source, float * destination, size_t numberOfFrames ) {
+    
+    downmixStereoToMonoFloat32Kernel( source, destination, numberOfFrames, true );
+}
+
+#pragma mark -
+#pragma mark Converting Whole Audio Data
+
+AudioStreamBasicDescription canonicalAudioDataFormat( Float64 sampleRate, UInt32 numberOfChannels ) {
+    
+    AudioStreamBasicDescription format = { 0 };
+    
+    format.mSampleRate       = sampleRate;
+    format.mFormatID         = kAudioFormatLinearPCM;
+    format.mFormatFlags      = kAudioFormatFlagsNativeEndian | kAudioFormatFlagIsPacked | kAudioFormatFlagIsFloat;
+    format.mFramesPerPacket  = 1;
+    format.mChannelsPerFrame = numberOfChannels;
+    format.mBitsPerChannel   = ( sizeof( float ) * 8 );
+    format.mBytesPerFrame    = ( sizeof( float ) * numberOfChannels );
+    format.mBytesPerPacket   = format.mBytesPerFrame;
+    
+    return format;
+}
+
+/** Converts a single sample of any supported format. Used for formats without a dedicated kernel. */
+
+static float convertSampleToFloat32( const UInt8 * bytes, UInt32 bytesPerSample, UInt32 bitsPerSample, AudioFormatFlags flags ) {
+    
+    // Assemble the container in to the top of a 32-bit word, respecting its byte order.
+    
+    UInt32 word = 0;
+    
+    for( UInt32 b = 0; b < bytesPerSample; b++ )
+    {
+        const UInt32 significance = ( flags & kAudioFormatFlagIsBigEndian ) ? ( bytesPerSample - 1 - b ) : b;
+        word |= ( (UInt32)bytes[ b ] << ( ( significance * 8 ) + ( 32 - ( bytesPerSample * 8 ) ) ) );
+    }
+    
+    if( flags & kAudioFormatFlagIsFloat )
+    {
+        float value;
+        memcpy( &value, &word, sizeof( value ) );
+        return value;
+    }
+    
+    // Low-aligned samples in a larger container need shifting to the top of the word.
+    
+    if( ( 0 == ( flags & kAudioFormatFlagIsAlignedHigh ) ) && ( bitsPerSample < ( bytesPerSample * 8 ) ) )
+    {
+        word <<= ( ( bytesPerSample * 8 ) - bitsPerSample );
+    }
+    
+    // Unsigned samples are offset by half their range.
+    
+    if( 0 == ( flags & kAudioFormatFlagIsSignedInteger ) )
+    {
+        word ^= 0x80000000;
+    }
+    
+    return (float)(SInt32)word * ( 1.0f / 2147483648.0f );
+}
+
+/** Converts interleaved samples in to floats, without changing the number of channels. */
+
+bool convertSamplesToFloat32( const AudioStreamBasicDescription * format, const void * source, float * destination, size_t numberOfSamples ) {
+    
+    if( ( kAudioFormatLinearPCM != format->mFormatID ) || ( format->mFormatFlags & kAudioFormatFlagIsNonInterleaved ) ||
+        ( 0 == format->mChannelsPerFrame ) || ( 0 != ( format->mBytesPerFrame % format->mChannelsPerFrame ) ) )
+    {
+        return false;
+    }
+    
+    const UInt32 bytesPerSample = ( format->mBytesPerFrame / format->mChannelsPerFrame );
+    const bool   nativeEndian   = ( ( format->mFormatFlags & kAudioFormatFlagIsBigEndian ) == kAudioFormatFlagsNativeEndian );
+    const bool   packed         = ( format->mBitsPerChannel == ( bytesPerSample * 8 ) );
+    const bool   isFloat        = ( 0 != ( format->mFormatFlags & kAudioFormatFlagIsFloat ) );
+    
+    if( ( 0 == bytesPerSample ) || ( bytesPerSample > 4 ) || ( isFloat && ( 4 != bytesPerSample ) ) )
+        return false;
+    
+    if( packed && isFloat && nativeEndian )
+    {
+        memcpy( destination, source, numberOfSamples * sizeof( float ) );
+    }
+    else if( packed && nativeEndian && ( 2 == bytesPerSample ) && ( format->mFormatFlags & kAudioFormatFlagIsSignedInteger ) )
+    {
+        convertInt16ToFloat32( source, destination, numberOfSamples );
+    }
+    else if( packed && ( 0 == ( format->mFormatFlags & kAudioFormatFlagIsBigEndian ) ) && ( 3 == bytesPerSample ) &&
+             ( format->mFormatFlags & kAudioFormatFlagIsSignedInteger ) )
+    {
+        convertPackedInt24ToFloat32( source, destination, numberOfSamples );
+    }
+    else
+    {
+        for( size_t i = 0; i < numberOfSamples; i++ )
+        {
+            destination[ i ] = convertSampleToFloat32( (const UInt8 *)source + ( i * bytesPerSample ), bytesPerSample, format->mBitsPerChannel, format->mFormatFlags );
+        }
+    }
+    
+    return true;
+}
+
+SUSoundEffectData copyAudioDataInCanonicalFormat( SUSoundEffectData audioData, UInt32 numberOfChannels ) {
+    
+    const AudioStreamBasicDescription * sourceFormat = &( audioData->dataFormat );
+    const UInt32 sourceChannels = sourceFormat->mChannelsPerFrame;
+    
+    if( 0 == numberOfChannels )
+        return NULL;
+    
+    if( ( numberOfChannels != sourceChannels ) && ( ( numberOfChannels > 2 ) || ( sourceChannels > 2 ) ) )
+        return NULL;
+    
+    if( ( kAudioFormatLinearPCM != sourceFormat->mFormatID ) || ( 0 == sourceFormat->mBytesPerFrame ) || ( NULL == audioData->audioData ) )
+        return NULL;
+    
+    if( noErr != audioDataLoadingStatus( audioData ) )
+        return NULL;
+    
+    const UInt64 numberOfFrames = ( audioData->numberOfAudioDataBytes / sourceFormat->mBytesPerFrame );
+    
+    if( ( numberOfFrames * sizeof( float ) * ( numberOfChannels > sourceChannels ? numberOfChannels : sourceChannels ) ) > SIZE_T_MAX )
+        return NULL;
+    
+    SUSoundEffectData data = calloc( 1, sizeof( struct _SUSoundEffectData ) );
+    
+    if( NULL == data )
+        return NULL;
+    
+    data->retainCount               = 1;
+    data->dataFormat                = canonicalAudioDataFormat( sourceFormat->mSampleRate, numberOfChannels );
+    data->numberOfAudioDataBytes    = ( numberOfFrames * data->dataFormat.mBytesPerFrame );
+    data->numberOfPackets           = numberOfFrames;
+    data->numberOfFrames            = numberOfFrames;
+    data->maximumPacketSize         = data->dataFormat.mBytesPerPacket;
+    data->audioData                 = malloc( (size_t)data->numberOfAudioDataBytes );
+    
+    if( NULL == data->audioData )
+    {
+        freeAudioData( data );
+        return NULL;
+    }
+    
+    const size_t numberOfSourceSamples = (size_t)( numberOfFrames * sourceChannels );
+    
+    if( numberOfChannels == sourceChannels )
+    {
+        if( false == convertSamplesToFloat32( sourceFormat, audioData->audioData, data->audioData, numberOfSourceSamples ) )
+        {
+            freeAudioData( data );
+            return NULL;
+        }
+    }
+    else
+    {
+        float * samples = malloc( numberOfSourceSamples * sizeof( float ) );
+        
+        if( ( NULL == samples ) || ( false == convertSamplesToFloat32( sourceFormat, audioData->audioData, samples, numberOfSourceSamples ) ) )
+        {
+            free( samples );
+            freeAudioData( data );
+            return NULL;
+        }
+        
+        if( 1 == sourceChannels )
+            upmixMonoToStereoFloat32( samples, data->audioData, (size_t)numberOfFrames );
+        else
+            downmixStereoToMonoFloat32( samples, data->audioData, (size_t)numberOfFrames );
+        
+        free( samples );
+    }
+    
+    return data;
+}
@@ -0,0 +1,106 @@
+//
+//  SUPCMConversion.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUPCMConversion_h
+#define SpringUtils_SUPCMConversion_h
+
+#import "SUSoundCore.h"
+
+// Linear PCM conversion kernels. Where available, these use SSE2/SSSE3 or NEON; otherwise they fall back to scalar loops
+// which produce bit-identical results. Integer samples map to floats in the range [-1, 1).
+
+
+//-------------------------------/
+/** @name Converting Sample Types */
+//-------------------------------/
+
+
+/** Converts native-endian 16-bit integer samples in to 32-bit float samples. */
+
+SU_EXTERN void convertInt16ToFloat32( const SInt16 * source, float * destination, size_t numberOfSamples );
+
+/** Converts 32-bit float samples in to native-endian 16-bit integer samples, rounding to the nearest integer and
+ *  saturating values outside of [-1, 1). */
+
+SU_EXTERN void convertFloat32ToInt16( const float * source, SInt16 * destination, size_t numberOfSamples );
+
+/** Converts packed, little-endian 24-bit integer samples (3 bytes per sample) in to 32-bit float samples. */
+
+SU_EXTERN void convertPackedInt24ToFloat32( const UInt8 * source, float * destination, size_t numberOfSamples );
+
+
+//-----------------------------------/
+/** @name Interleaving Float Samples */
+//-----------------------------------/
+
+
+/** Interleaves planar float samples.
+ *
+ *  @param  sources             An array of `numberOfChannels` pointers to each channel's samples.
+ *  @param  numberOfChannels    The number of channels.
+ *  @param  destination         The buffer to write `numberOfFrames` * `numberOfChannels` interleaved samples in to.
+ *  @param  numberOfFrames      The number of frames to interleave.
+ */
+
+SU_EXTERN void interleaveFloat32( const float * const * sources, UInt32 numberOfChannels, float * destination, size_t numberOfFrames );
+
+/** Deinterleaves float samples in to planar buffers.
+ *
+ *  @param  source              The interleaved samples.
+ *  @param  numberOfChannels    The number of channels.
+ *  @param  destinations        An array of `numberOfChannels` pointers to buffers for each channel's samples.
+ *  @param  numberOfFrames      The number of frames to deinterleave.
+ */
+
+SU_EXTERN void deinterleaveFloat32( const float * source, UInt32 numberOfChannels, float * const * destinations, size_t numberOfFrames );
+
+
+//------------------------------/
+/** @name Mixing Float Channels */
+//------------------------------/
+
+
+/** Duplicates mono float samples in to both channels of interleaved stereo frames. */
+
+SU_EXTERN void upmixMonoToStereoFloat32( const float * source, float * destination, size_t numberOfFrames );
+
+/** Averages the channels of interleaved stereo float frames in to mono samples. */
+
+SU_EXTERN void downmixStereoToMonoFloat32( const float * source, float * destination, size_t numberOfFrames );
+
+
+//------------------------------------/
+/** @name Converting Whole Audio Data */
+//------------------------------------/
+
+
+/** Returns the canonical audio data format: native-endian, interleaved 32-bit float linear PCM.
+ *
+ *  @param  sampleRate          The sample rate.
+ *  @param  numberOfChannels    The number of channels.
+ */
+
+SU_EXTERN AudioStreamBasicDescription canonicalAudioDataFormat( Float64 sampleRate, UInt32 numberOfChannels );
+
+/** Creates a copy of linear PCM audio data in the canonical format.
+ *
+ *  Supported source formats are interleaved 8, 16, 24 and 32-bit integer and 32-bit float samples, in either byte order.
+ *
+ *  @param  audioData           The audio data to convert.
+ *  @param  numberOfChannels    The number of channels in the copy. This must be the same as the source's, unless converting between mono and stereo.
+ *
+ *  @returns                    The converted audio data, or NULL if the audio data's format is unsupported, it is compressed,
+ *                              it has not been read in full, or numberOfChannels is 0.
+ *                              You must release this value by calling freeAudioData().
+ */
+
+SU_EXTERN SUSoundEffectData copyAudioDataInCanonicalFormat( SUSoundEffectData audioData, UInt32 numberOfChannels );
+
+#endif
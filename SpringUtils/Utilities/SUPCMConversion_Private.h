@@ -0,0 +1,26 @@
+//
+//  SUPCMConversion_Private.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUPCMConversion.h"
+
+// Variants of the conversion kernels which can be forced to use their scalar loops, for comparison against the SIMD kernels.
+
+SU_EXTERN void convertInt16ToFloat32Kernel( const SInt16 * source, float * destination, size_t numberOfSamples, bool vector );
+SU_EXTERN void convertFloat32ToInt16Kernel( const float * source, SInt16 * destination, size_t numberOfSamples, bool vector );
+SU_EXTERN void convertPackedInt24ToFloat32Kernel( const UInt8 * source, float * destination, size_t numberOfSamples, bool vector );
+SU_EXTERN void interleaveFloat32Kernel( const float * const * sources, UInt32 numberOfChannels, float * destination, size_t numberOfFrames, bool vector );
+SU_EXTERN void deinterleaveFloat32Kernel( const float * source, UInt32 numberOfChannels, float * const * destinations, size_t numberOfFrames, bool vector );
+SU_EXTERN void upmixMonoToStereoFloat32Kernel( const float * source, float * destination, size_t numberOfFrames, bool vector );
+SU_EXTERN void downmixStereoToMonoFloat32Kernel( const float * source, float * destination, size_t numberOfFrames, bool vector );
+
+/** Converts interleaved linear PCM samples in any supported format (see copyAudioDataInCanonicalFormat()) in to 32-bit float samples.
+ *  Returns false if the format is unsupported. */
+
+SU_EXTERN bool convertSamplesToFloat32( const AudioStreamBasicDescription * format, const void * source, float * destination, size_t numberOfSamples );
@@ -0,0 +1,233 @@
+//
+//  SUSoundAnalysis.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundAnalysis_Private.h"
+#import "SUSoundCompression.h"
+#import "SUPCMConversion_Private.h"
+
+#import <math.h>
+#import <stdlib.h>
+
+#if defined( __SSE2__ )
+    #import <emmintrin.h>
+    #define SU_ANALYSIS_SSE2 1
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+    #import <arm_neon.h>
+    #define SU_ANALYSIS_NEON 1
+#endif
+
+// The vector and scalar kernels must round identically, so the compiler may not fuse multiplies and adds.
+
+#pragma STDC FP_CONTRACT OFF
+
+/** The number of frames converted to floats at a time while scanning. */
+
+#define kSUSoundAnalysisFramesPerRun    4096
+
+#pragma mark -
+#pragma mark Scanning Samples
+
+// Both kernels keep four running peaks and sums of squares, one per vector lane, and combine them in the same order at the
+// end, so that they produce bit-identical results. Any remaining samples are then added one at a time.
+
+void scanFloat32LevelsKernel( const float * samples, size_t numberOfSamples, float silenceThreshold, SUSoundSampleScan * oScan, bool vector ) {
+    
+    float peaks[ 4 ]         = { 0, 0, 0, 0 };
+    float sumsOfSquares[ 4 ] = { 0, 0, 0, 0 };
+    size_t firstAudible      = numberOfSamples;
+    size_t endAudible        = 0;
+    size_t i                 = 0;
+
+#if SU_ANALYSIS_SSE2
+    
+    if( vector )
+    {
+        const __m128 signMask  = _mm_set1_ps( -0.0f );
+        const __m128 threshold = _mm_set1_ps( silenceThreshold );
+        __m128 peak            = _mm_setzero_ps();
+        __m128 sumOfSquares    = _mm_setzero_ps();
+        
+        for( ; ( i + 4 ) <= numberOfSamples; i += 4 )
+        {
+            const __m128 x         = _mm_loadu_ps( samples + i );
+            const __m128 magnitude = _mm_andnot_ps( signMask, x );
+            
+            peak         = _mm_max_ps( peak, magnitude );
+            sumOfSquares = _mm_add_ps( sumOfSquares, _mm_mul_ps( x, x ) );
+            
+            const int audible = _mm_movemask_ps( _mm_cmpgt_ps( magnitude, threshold ) );
+            
+            if( 0 != audible )
+            {
+                if( firstAudible == numberOfSamples )
+                    firstAudible = ( i + __builtin_ctz( audible ) );
+                
+                endAudible = ( i + 32 - __builtin_clz( audible ) );
+            }
+        }
+        
+        _mm_storeu_ps( peaks, peak );
+        _mm_storeu_ps( sumsOfSquares, sumOfSquares );
+    }
+
+#elif SU_ANALYSIS_NEON
+    
+    if( vector )
+    {
+        static const uint32_t laneBits[ 4 ] = { 1, 2, 4, 8 };
+        
+        const uint32x4_t bits        = vld1q_u32( laneBits );
+        const float32x4_t threshold  = vdupq_n_f32( silenceThreshold );
+        float32x4_t peak             = vdupq_n_f32( 0 );
+        float32x4_t sumOfSquares     = vdupq_n_f32( 0 );
+        
+        for( ; ( i + 4 ) <= numberOfSamples; i += 4 )
+        {
+            const float32x4_t x         = vld1q_f32( samples + i );
+            const float32x4_t magnitude = vabsq_f32( x );
+            
+            peak         = vmaxq_f32( peak, magnitude );
+            sumOfSquares = vaddq_f32( sumOfSquares, vmulq_f32( x, x ) );
+            
+            const uint32x4_t laneMask = vandq_u32( vcgtq_f32( magnitude, threshold ), bits );
+            const uint32x2_t pairs    = vorr_u32( vget_low_u32( laneMask ), vget_high_u32( laneMask ) );
+            const int audible         = (int)( vget_lane_u32( pairs, 0 ) | vget_lane_u32( pairs, 1 ) );
+            
+            if( 0 != audible )
+            {
+                if( firstAudible == numberOfSamples )
+                    firstAudible = ( i + __builtin_ctz( audible ) );
+                
+                endAudible = ( i + 32 - __builtin_clz( audible ) );
+            }
+        }
+        
+        vst1q_f32( peaks, peak );
+        vst1q_f32( sumsOfSquares, sumOfSquares );
+    }
+
+#endif
+    
+    // The scalar loop also finishes the vector loop's work when there is no SIMD unit.
+    
+    for( ; ( i + 4 ) <= numberOfSamples; i += 4 )
+    {
+        for( UInt32 lane = 0; lane < 4; lane++ )
+        {
+            const float x         = samples[ i + lane ];
+            const float magnitude = fabsf( x );
+            
+            peaks[ lane ]          = ( peaks[ lane ] > magnitude ) ? peaks[ lane ] : magnitude;
+            sumsOfSquares[ lane ] += ( x * x );
+            
+            if( magnitude > silenceThreshold )
+            {
+                if( firstAudible == numberOfSamples )
+                    firstAudible = ( i + lane );
+                
+                endAudible = ( i + lane + 1 );
+            }
+        }
+    }
+    
+    float peak         = ( ( peaks[ 0 ] > peaks[ 1 ] ) ? peaks[ 0 ] : peaks[ 1 ] );
+    float peakHigh     = ( ( peaks[ 2 ] > peaks[ 3 ] ) ? peaks[ 2 ] : peaks[ 3 ] );
+    float sumOfSquares = ( ( sumsOfSquares[ 0 ] + sumsOfSquares[ 1 ] ) + ( sumsOfSquares[ 2 ] + sumsOfSquares[ 3 ] ) );
+    
+    peak = ( peak > peakHigh ) ? peak : peakHigh;
+    
+    for( ; i < numberOfSamples; i++ )
+    {
+        const float x         = samples[ i ];
+        const float magnitude = fabsf( x );
+        
+        peak          = ( peak > magnitude ) ? peak : magnitude;
+        sumOfSquares += ( x * x );
+        
+        if( magnitude > silenceThreshold )
+        {
+            if( firstAudible == numberOfSamples )
+                firstAudible = i;
+            
+            endAudible = ( i + 1 );
+        }
+    }
+    
+    oScan->firstAudibleSample = firstAudible;
+    oScan->endAudibleSample   = endAudible;
+    oScan->sumOfSquares       = sumOfSquares;
+    oScan->peak               = peak;
+}
+
+#pragma mark -
+#pragma mark Scanning Audio Levels
+
+bool scanAudioDataLevels( SUSoundEffectData audioData, UInt64 firstFrame, UInt64 numberOfFrames, float silenceThreshold, SUSoundLevelScan * oScan ) {
+    
+    const AudioStreamBasicDescription * format = &( audioData->dataFormat );
+    
+    if( ( kAudioFormatLinearPCM != format->mFormatID ) || ( 0 == format->mBytesPerFrame ) || ( 0 == format->mChannelsPerFrame ) || ( NULL != audioData->packetDescriptions ) )
+        return false;
+    
+    if( ( ( NULL == audioData->audioData ) && ( NULL == audioData->compressedAudio ) ) || ( noErr != audioDataLoadingStatus( audioData ) ) )
+        return false;
+    
+    const UInt32 numberOfChannels = format->mChannelsPerFrame;
+    
+    float * samples         = malloc( (size_t)kSUSoundAnalysisFramesPerRun * numberOfChannels * sizeof( float ) );
+    SInt16 * decodedSamples = ( NULL != audioData->compressedAudio ) ? malloc( (size_t)kSUSoundAnalysisFramesPerRun * numberOfChannels * sizeof( SInt16 ) ) : NULL;
+    bool converted          = ( NULL != samples ) && ( ( NULL == audioData->compressedAudio ) || ( NULL != decodedSamples ) );
+    
+    *oScan = (SUSoundLevelScan){ ( firstFrame + numberOfFrames ), firstFrame, 0, 0 };
+    
+    for( UInt64 frame = firstFrame; converted && ( frame < ( firstFrame + numberOfFrames ) ); frame += kSUSoundAnalysisFramesPerRun )
+    {
+        const UInt64 remainingFrames   = ( ( firstFrame + numberOfFrames ) - frame );
+        const UInt64 numberOfRunFrames = ( remainingFrames < kSUSoundAnalysisFramesPerRun ) ? remainingFrames : kSUSoundAnalysisFramesPerRun;
+        const size_t numberOfSamples   = (size_t)( numberOfRunFrames * numberOfChannels );
+        const void * source;
+        
+        if( NULL != decodedSamples )
+        {
+            decodeCompressedAudio( audioData->compressedAudio, frame, numberOfRunFrames, decodedSamples );
+            source = decodedSamples;
+        }
+        else
+        {
+            source = ( (const UInt8 *)audioData->audioData + ( frame * format->mBytesPerFrame ) );
+        }
+        
+        converted = convertSamplesToFloat32( format, source, samples, numberOfSamples );
+        
+        if( false == converted )
+            break;
+        
+        SUSoundSampleScan scan;
+        scanFloat32LevelsKernel( samples, numberOfSamples, silenceThreshold, &scan, true );
+        
+        // Runs are whole frames, so audible samples map to the frames containing them.
+        
+        if( scan.endAudibleSample > 0 )
+        {
+            if( oScan->firstAudibleFrame == ( firstFrame + numberOfFrames ) )
+                oScan->firstAudibleFrame = ( frame + ( scan.firstAudibleSample / numberOfChannels ) );
+            
+            oScan->endAudibleFrame = ( frame + ( ( scan.endAudibleSample + numberOfChannels - 1 ) / numberOfChannels ) );
+        }
+        
+        oScan->sumOfSquares += scan.sumOfSquares;
+        oScan->peak          = ( oScan->peak > scan.peak ) ? oScan->peak : scan.peak;
+    }
+    
+    free( samples );
+    free( decodedSamples );
+    
+    return converted;
+}
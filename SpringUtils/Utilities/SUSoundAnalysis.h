@@ -0,0 +1,52 @@
+//
+//  SUSoundAnalysis.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUSoundAnalysis_h
+#define SpringUtils_SUSoundAnalysis_h
+
+#import "SUSoundCore.h"
+
+// A single-pass scan of linear PCM audio data for its peak and RMS levels and the extent of its audible frames.
+// Most code should use measureAudioDataLevels() and trimAudioDataSilence() (or SUAudioDataReadingLevels and
+// SUAudioDataReadingTrimSilence) rather than these functions; their results are stored in the audio data's levels.
+
+/** The result of scanning a range of frames. Sample values are normalized to [-1, 1]. */
+
+typedef struct _SUSoundLevelScan {
+    
+    UInt64 firstAudibleFrame;   /**< The first frame of the range with a sample louder than the silence threshold, or the end of the range if there is none. */
+    UInt64 endAudibleFrame;     /**< The frame after the last frame of the range with a sample louder than the silence threshold, or the start of the range if there is none. */
+    double sumOfSquares;        /**< The sum of the squares of every sample in the range, over all channels. */
+    float peak;                 /**< The largest sample magnitude in the range, over all channels. */
+    
+} SUSoundLevelScan;
+
+
+//-------------------------------/
+/** @name Scanning Audio Levels */
+//-------------------------------/
+
+
+/** Scans a range of frames of linear PCM audio data for its levels, and for samples louder than a threshold.
+ *
+ *  Samples are converted to floats a run at a time and scanned with SSE2 or NEON. Compressed audio data is decoded as it is read.
+ *
+ *  @param  audioData           The audio data. It must be CBR linear PCM, and must have been read in full (see audioDataLoadingStatus()).
+ *  @param  firstFrame          The first frame of the range.
+ *  @param  numberOfFrames      The number of frames in the range. The range must lie within the audio data.
+ *  @param  silenceThreshold    The largest sample magnitude which is considered silent.
+ *  @param  oScan               On output, the levels of the range.
+ *
+ *  @returns                    true, or false if the audio data's format is unsupported or memory could not be allocated.
+ */
+
+SU_EXTERN bool scanAudioDataLevels( SUSoundEffectData audioData, UInt64 firstFrame, UInt64 numberOfFrames, float silenceThreshold, SUSoundLevelScan * oScan );
+
+#endif
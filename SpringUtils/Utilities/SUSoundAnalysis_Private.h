@@ -0,0 +1,26 @@
+//
+//  SUSoundAnalysis_Private.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundAnalysis.h"
+
+/** The result of scanning a run of interleaved float samples. Indices are of samples, rather than frames. */
+
+typedef struct _SUSoundSampleScan {
+    
+    size_t firstAudibleSample;  /**< The first sample louder than the silence threshold, or the number of samples if there is none. */
+    size_t endAudibleSample;    /**< The sample after the last sample louder than the silence threshold, or 0 if there is none. */
+    float sumOfSquares;
+    float peak;
+    
+} SUSoundSampleScan;
+
+// A variant of the scanning kernel which can be forced to use its scalar loop, for comparison against the SIMD kernel.
+
+SU_EXTERN void scanFloat32LevelsKernel( const float * samples, size_t numberOfSamples, float silenceThreshold, SUSoundSampleScan * oScan, bool vector );
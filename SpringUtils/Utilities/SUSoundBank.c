@@ -0,0 +1,393 @@
+//
+//  SUSoundBank.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundBank.h"
+#import "SUSoundTools_Private.h"
+#import "SUSoundCore_Private.h"
+
+#import <pthread.h>
+#import <unistd.h>
+
+#define SU_SOUND_BANK_MAXIMUM_THREADS   16
+#define SU_SOUND_BANK_ALIGNMENT         16
+
+SU_INLINE size_t alignedSize( size_t size ) {
+    
+    return ( size + ( SU_SOUND_BANK_ALIGNMENT - 1 ) ) & ~(size_t)( SU_SOUND_BANK_ALIGNMENT - 1 );
+}
+
+struct _SUSoundBank {
+    
+    UInt32 numberOfFiles;
+    SUSoundEffectData * audioData;
+    Float64 * fileLoadTimes;
+    
+    SUSoundBankStatistics statistics;
+};
+
+/** The state of a single file while its bank is loading. */
+
+typedef struct _SUSoundBankFile {
+    
+    CFURLRef fileURL;
+    AudioFileID audioFile;
+    
+    struct _SUSoundEffectData properties;   /**< The file's properties, read before the arena is allocated. */
+    size_t arenaOffset;                     /**< The offset of the file's region of the arena. */
+    
+    OSStatus err;
+    Float64 loadTime;
+    
+} SUSoundBankFile;
+
+typedef struct _SUSoundBankLoader {
+    
+    SUSoundBankFile * files;
+    UInt32 numberOfFiles;
+    UInt32 nextFile;                        /**< The index of the next file to be claimed by a worker. Accessed atomically. */
+    
+    struct _SUAudioDataArena * arena;
+    UInt8 * arenaBytes;
+    
+    void (*loadFile)( struct _SUSoundBankLoader * loader, SUSoundBankFile * file );
+    
+} SUSoundBankLoader;
+
+#pragma mark -
+#pragma mark Worker Pool
+
+static void * soundBankWorker( void * context ) {
+    
+    SUSoundBankLoader * loader = context;
+    
+    for( ;; )
+    {
+        const UInt32 index = __atomic_fetch_add( &loader->nextFile, 1, __ATOMIC_RELAXED );
+        
+        if( index >= loader->numberOfFiles )
+            break;
+        
+        SUSoundBankFile * file = &loader->files[ index ];
+        
+        if( noErr != file->err )
+            continue;
+        
+        const CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        loader->loadFile( loader, file );
+        file->loadTime += ( CFAbsoluteTimeGetCurrent() - start );
+    }
+    
+    return NULL;
+}
+
+/** Runs the loader's loadFile function for every file, on the calling thread plus up to `numberOfThreads - 1` workers.
+ *  If workers can't be created, the calling thread loads the remaining files itself. */
+
+static void runSoundBankLoader( SUSoundBankLoader * loader, UInt32 numberOfThreads ) {
+    
+    pthread_t workers[ SU_SOUND_BANK_MAXIMUM_THREADS ];
+    UInt32 numberOfWorkers = 0;
+    
+    loader->nextFile = 0;
+    
+    while( ( numberOfWorkers + 1 ) < numberOfThreads )
+    {
+        if( 0 != pthread_create( &workers[ numberOfWorkers ], NULL, soundBankWorker, loader ) )
+            break;
+        
+        numberOfWorkers++;
+    }
+    
+    soundBankWorker( loader );
+    
+    for( UInt32 i = 0; i < numberOfWorkers; i++ )
+    {
+        pthread_join( workers[ i ], NULL );
+    }
+}
+
+#pragma mark -
+#pragma mark Loading Files
+
+/** The first pass: opens the file and reads its properties, so its region of the arena can be sized. */
+
+static void readSoundBankFileProperties( SUSoundBankLoader * loader, SUSoundBankFile * file ) {
+    
+    file->err = AudioFileOpenURL( file->fileURL, kAudioFileReadPermission, 0, &file->audioFile );
+    
+    if( noErr == file->err )
+    {
+        file->err = readAudioDataProperties( file->audioFile, &file->properties );
+    }
+    
+    if( ( noErr == file->err ) && ( ( file->properties.numberOfAudioDataBytes > SIZE_T_MAX ) || ( file->properties.numberOfPackets > ( SIZE_T_MAX / sizeof( AudioStreamPacketDescription ) ) ) ) )
+    {
+        file->err = kAudioFileUnspecifiedError;
+    }
+}
+
+/** Returns the size of a file's region of the arena: its SUSoundEffectData, packet descriptions, frame index and audio bytes. */
+
+static size_t soundBankFileRegionSize( const struct _SUSoundEffectData * properties ) {
+    
+    size_t size = alignedSize( sizeof( struct _SUSoundEffectData ) );
+    
+    if( 0 == properties->dataFormat.mBytesPerPacket )
+    {
+        size += alignedSize( (size_t)properties->numberOfPackets * sizeof( AudioStreamPacketDescription ) );
+        
+        if( 0 == properties->dataFormat.mFramesPerPacket )
+        {
+            size += alignedSize( (size_t)properties->numberOfPackets * sizeof( UInt64 ) );
+        }
+    }
+    
+    return size + alignedSize( (size_t)properties->numberOfAudioDataBytes );
+}
+
+/** The second pass: reads the file's packets directly in to its region of the arena. */
+
+static void readSoundBankFileData( SUSoundBankLoader * loader, SUSoundBankFile * file ) {
+    
+    UInt8 * region         = ( loader->arenaBytes + file->arenaOffset );
+    SUSoundEffectData data = (SUSoundEffectData)region;
+    size_t offset          = alignedSize( sizeof( struct _SUSoundEffectData ) );
+    
+    *data               = file->properties;
+    data->retainCount   = 1;
+    data->arena         = loader->arena;
+    
+    if( 0 == data->dataFormat.mBytesPerPacket )
+    {
+        data->packetDescriptions = (AudioStreamPacketDescription *)( region + offset );
+        offset += alignedSize( (size_t)data->numberOfPackets * sizeof( AudioStreamPacketDescription ) );
+        
+        if( 0 == data->dataFormat.mFramesPerPacket )
+        {
+            data->packetStartFrames = (UInt64 *)( region + offset );
+            offset += alignedSize( (size_t)data->numberOfPackets * sizeof( UInt64 ) );
+        }
+    }
+    
+    data->audioData = ( region + offset );
+    
+    file->err = readPacketData( file->audioFile, data, data->audioData );
+    
+    if( noErr == file->err )
+    {
+        file->err = buildFrameIndex( data );
+    }
+}
+
+#pragma mark -
+#pragma mark Creating and Freeing Banks
+
+SUSoundBank createSoundBankFromURLs( const CFURLRef * fileURLs, UInt32 numberOfFiles, UInt32 maximumNumberOfThreads ) {
+    
+    const CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    
+    SUSoundBank bank = calloc( 1, sizeof( struct _SUSoundBank ) );
+    SUSoundBankLoader loader = { 0 };
+    
+    loader.numberOfFiles = numberOfFiles;
+    loader.files         = calloc( ( numberOfFiles > 0 ) ? numberOfFiles : 1, sizeof( SUSoundBankFile ) );
+    
+    if( NULL != bank )
+    {
+        bank->numberOfFiles = numberOfFiles;
+        bank->audioData     = calloc( ( numberOfFiles > 0 ) ? numberOfFiles : 1, sizeof( SUSoundEffectData ) );
+        bank->fileLoadTimes = calloc( ( numberOfFiles > 0 ) ? numberOfFiles : 1, sizeof( Float64 ) );
+    }
+    
+    if( ( NULL == bank ) || ( NULL == loader.files ) || ( NULL == bank->audioData ) || ( NULL == bank->fileLoadTimes ) )
+    {
+        free( loader.files );
+        freeSoundBank( bank );
+        return NULL;
+    }
+    
+    for( UInt32 i = 0; i < numberOfFiles; i++ )
+    {
+        loader.files[ i ].fileURL = fileURLs[ i ];
+        loader.files[ i ].err     = ( NULL != fileURLs[ i ] ) ? noErr : kAudioFileUnspecifiedError;
+    }
+    
+    // Use one thread per processor by default, but never more threads than files.
+    
+    UInt32 numberOfThreads = maximumNumberOfThreads;
+    
+    if( 0 == numberOfThreads )
+    {
+        const long numberOfProcessors = sysconf( _SC_NPROCESSORS_ONLN );
+        numberOfThreads = ( numberOfProcessors > 0 ) ? (UInt32)numberOfProcessors : 1;
+    }
+    
+    if( numberOfThreads > numberOfFiles )
+        numberOfThreads = ( numberOfFiles > 0 ) ? numberOfFiles : 1;
+    
+    if( numberOfThreads > SU_SOUND_BANK_MAXIMUM_THREADS )
+        numberOfThreads = SU_SOUND_BANK_MAXIMUM_THREADS;
+    
+    
+    // ===================
+    //
+    // 1. Open the files and read their properties
+    //
+    // ===================
+    
+    
+    loader.loadFile = readSoundBankFileProperties;
+    runSoundBankLoader( &loader, numberOfThreads );
+    
+    
+    // ===================
+    //
+    // 2. Lay out and allocate the arena
+    //
+    // ===================
+    
+    
+    const size_t headerSize = alignedSize( sizeof( struct _SUAudioDataArena ) );
+    size_t arenaSize        = 0;
+    
+    for( UInt32 i = 0; i < numberOfFiles; i++ )
+    {
+        SUSoundBankFile * file = &loader.files[ i ];
+        
+        if( noErr != file->err )
+            continue;
+        
+        const size_t regionSize = soundBankFileRegionSize( &file->properties );
+        
+        if( regionSize > ( SIZE_T_MAX - headerSize - arenaSize ) )
+        {
+            file->err = kAudioFileUnspecifiedError;
+            continue;
+        }
+        
+        file->arenaOffset = arenaSize;
+        arenaSize        += regionSize;
+    }
+    
+    loader.arena = malloc( headerSize + arenaSize );
+    
+    if( NULL != loader.arena )
+    {
+        loader.arena->retainCount = 0;
+        loader.arena->size        = arenaSize;
+        loader.arenaBytes         = ( (UInt8 *)loader.arena + headerSize );
+    }
+    else
+    {
+        for( UInt32 i = 0; i < numberOfFiles; i++ )
+        {
+            loader.files[ i ].err = kAudioFileUnspecifiedError;
+        }
+    }
+    
+    
+    // ===================
+    //
+    // 3. Read each file's packets in to the arena
+    //
+    // ===================
+    
+    
+    loader.loadFile = readSoundBankFileData;
+    runSoundBankLoader( &loader, numberOfThreads );
+    
+    
+    // ===================
+    //
+    // 4. Collect the results
+    //
+    // ===================
+    
+    
+    for( UInt32 i = 0; i < numberOfFiles; i++ )
+    {
+        SUSoundBankFile * file = &loader.files[ i ];
+        
+        if( NULL != file->audioFile )
+        {
+            AudioFileClose( file->audioFile );
+        }
+        
+        bank->statistics.totalFileLoadTime += file->loadTime;
+        
+        if( noErr == file->err )
+        {
+            bank->audioData[ i ]     = (SUSoundEffectData)( loader.arenaBytes + file->arenaOffset );
+            bank->fileLoadTimes[ i ] = file->loadTime;
+            loader.arena->retainCount++;
+        }
+        else
+        {
+            bank->statistics.numberOfFailedFiles++;
+        }
+    }
+    
+    if( NULL != loader.arena )
+    {
+        if( 0 == loader.arena->retainCount )
+            free( loader.arena );
+        else
+            bank->statistics.arenaSize = ( headerSize + arenaSize );
+    }
+    
+    free( loader.files );
+    
+    bank->statistics.numberOfThreads = numberOfThreads;
+    bank->statistics.loadTime        = ( CFAbsoluteTimeGetCurrent() - start );
+    
+    return bank;
+}
+
+void freeSoundBank( SUSoundBank bank ) {
+    
+    if( NULL != bank )
+    {
+        if( NULL != bank->audioData )
+        {
+            for( UInt32 i = 0; i < bank->numberOfFiles; i++ )
+            {
+                freeAudioData( bank->audioData[ i ] );
+            }
+            
+            free( bank->audioData );
+        }
+        
+        free( bank->fileLoadTimes );
+        free( bank );
+    }
+}
+
+#pragma mark -
+#pragma mark Accessing Sound Effects
+
+UInt32 soundBankCount( SUSoundBank bank ) {
+    
+    return bank->numberOfFiles;
+}
+
+const SUSoundEffectData * soundBankAudioData( SUSoundBank bank ) {
+    
+    return bank->audioData;
+}
+
+Float64 soundBankFileLoadTime( SUSoundBank bank, UInt32 index ) {
+    
+    return ( index < bank->numberOfFiles ) ? bank->fileLoadTimes[ index ] : 0;
+}
+
+SUSoundBankStatistics soundBankStatistics( SUSoundBank bank ) {
+    
+    return bank->statistics;
+}
@@ -0,0 +1,89 @@
+//
+//  SUSoundBank.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUSoundBank_h
+#define SpringUtils_SUSoundBank_h
+
+#import "SUSoundTools.h"
+
+/** A set of sound effects which are loaded together, in parallel, in to a single allocation.
+ *
+ *  Files are opened and read on a bounded pool of worker threads. Once every file's size is known, a single arena is
+ *  allocated for all of the bank's SUSoundEffectData instances, their packet tables and their audio bytes, and each worker
+ *  reads its files directly in to its region of the arena.
+ *
+ *  The bank holds one reference to each of its sound effects. They may be retained and used independently of the bank;
+ *  the arena is freed once the bank and every other reference to its sound effects have been released.
+ */
+
+typedef struct _SUSoundBank *SUSoundBank;
+
+/** Timings and sizes describing how a bank was loaded. */
+
+typedef struct _SUSoundBankStatistics {
+    
+    Float64 loadTime;               /**< The wall-clock time (in seconds) taken to load the bank. */
+    Float64 totalFileLoadTime;      /**< The sum of the time (in seconds) spent loading each file. Compare with loadTime to see the benefit of loading in parallel. */
+    
+    UInt64 arenaSize;               /**< The size (in bytes) of the bank's arena. */
+    UInt32 numberOfThreads;         /**< The number of worker threads used to load the bank. */
+    UInt32 numberOfFailedFiles;     /**< The number of files which could not be read. */
+    
+} SUSoundBankStatistics;
+
+
+//----------------------------------/
+/** @name Creating and Freeing Banks */
+//----------------------------------/
+
+
+/** Loads a sound bank from a list of files. This function blocks until every file has been read.
+ *
+ *  @param  fileURLs                The file URLs of the audio files to read.
+ *  @param  numberOfFiles           The number of URLs in `fileURLs`.
+ *  @param  maximumNumberOfThreads  The maximum number of worker threads to load files with. Pass 0 to use one per processor.
+ *
+ *  @returns                        A new sound bank, or NULL if it could not be created. Files which could not be read do not
+ *                                  cause loading to fail; their sound effects are NULL. You must release this value by calling freeSoundBank().
+ */
+
+SU_EXTERN SUSoundBank createSoundBankFromURLs( const CFURLRef * fileURLs, UInt32 numberOfFiles, UInt32 maximumNumberOfThreads );
+
+/** Releases a sound bank and its references to its sound effects.
+ *
+ *  @param  bank    The bank to release. After calling this function, you should no longer use the bank.
+ */
+
+SU_EXTERN void freeSoundBank( SUSoundBank bank );
+
+
+//-------------------------------/
+/** @name Accessing Sound Effects */
+//-------------------------------/
+
+
+/** Returns the number of files the bank was loaded from. */
+
+SU_EXTERN UInt32 soundBankCount( SUSoundBank bank );
+
+/** Returns the bank's array of sound effects, which has an entry for each of the files it was loaded from, in the same order.
+ *  Entries for files which could not be read are NULL. The bank owns the returned references. */
+
+SU_EXTERN const SUSoundEffectData * soundBankAudioData( SUSoundBank bank );
+
+/** Returns the time (in seconds) spent loading the file at the given index, or 0 if it could not be read. */
+
+SU_EXTERN Float64 soundBankFileLoadTime( SUSoundBank bank, UInt32 index );
+
+/** Returns the timings and sizes describing how the bank was loaded. */
+
+SU_EXTERN SUSoundBankStatistics soundBankStatistics( SUSoundBank bank );
+
+#endif
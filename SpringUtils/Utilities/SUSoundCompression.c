@@ -0,0 +1,218 @@
+//
+//  SUSoundCompression.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundCompression.h"
+
+#import <stdlib.h>
+#import <string.h>
+
+// Each channel of a block is stored separately: a 4-byte header holding the block's first sample and the step index
+// to decode the rest with, then one 4-bit code per remaining sample, two to a byte, low nibble first.
+
+#define kSUCompressedAudioHeaderSize        4
+#define kSUCompressedAudioChannelBlockSize  ( kSUCompressedAudioHeaderSize + ( kSUCompressedAudioFramesPerBlock / 2 ) )
+
+static const SInt8 kIMAIndexTable[ 16 ] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static const SInt16 kIMAStepTable[ 89 ] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+/** The state of an IMA ADPCM encoder or decoder for a single channel. */
+
+typedef struct _SUADPCMState {
+    
+    SInt32 predictor;       /**< The previous sample. */
+    SInt32 stepIndex;       /**< The index of the current step size in kIMAStepTable. */
+    
+} SUADPCMState;
+
+/** Applies a 4-bit code to the state, returning the decoded sample. The encoder uses this too, so that it tracks the decoder exactly. */
+
+SU_INLINE SInt16 decodeADPCMCode( SUADPCMState * state, UInt8 code ) {
+    
+    const SInt32 step = kIMAStepTable[ state->stepIndex ];
+    SInt32 difference = ( step >> 3 );
+    
+    if( code & 4 ) difference += step;
+    if( code & 2 ) difference += ( step >> 1 );
+    if( code & 1 ) difference += ( step >> 2 );
+    
+    SInt32 predictor = ( code & 8 ) ? ( state->predictor - difference ) : ( state->predictor + difference );
+    
+    predictor = ( predictor > INT16_MAX ) ? INT16_MAX : ( ( predictor < INT16_MIN ) ? INT16_MIN : predictor );
+    
+    SInt32 stepIndex = ( state->stepIndex + kIMAIndexTable[ code ] );
+    
+    state->predictor = predictor;
+    state->stepIndex = ( stepIndex < 0 ) ? 0 : ( ( stepIndex > 88 ) ? 88 : stepIndex );
+    
+    return (SInt16)predictor;
+}
+
+SU_INLINE UInt8 encodeADPCMSample( SUADPCMState * state, SInt16 sample ) {
+    
+    SInt32 step       = kIMAStepTable[ state->stepIndex ];
+    SInt32 difference = ( sample - state->predictor );
+    UInt8 code        = 0;
+    
+    if( difference < 0 )
+    {
+        code       = 8;
+        difference = -difference;
+    }
+    
+    for( UInt8 bit = 4; bit > 0; bit >>= 1 )
+    {
+        if( difference >= step )
+        {
+            code       |= bit;
+            difference -= step;
+        }
+        
+        step >>= 1;
+    }
+    
+    decodeADPCMCode( state, code );
+    
+    return code;
+}
+
+#pragma mark -
+#pragma mark Encoding and Decoding Audio Data
+
+SUCompressedAudio createCompressedAudio( const SInt16 * samples, UInt32 numberOfChannels, UInt64 numberOfFrames ) {
+    
+    if( ( 0 == numberOfChannels ) || ( 0 == numberOfFrames ) )
+        return NULL;
+    
+    const UInt64 numberOfBlocks = ( ( numberOfFrames - 1 ) / kSUCompressedAudioFramesPerBlock ) + 1;
+    const UInt64 bytesPerBlock  = ( (UInt64)numberOfChannels * kSUCompressedAudioChannelBlockSize );
+    
+    if( ( bytesPerBlock > UINT32_MAX ) || ( numberOfBlocks > ( SIZE_T_MAX / bytesPerBlock ) ) )
+        return NULL;
+    
+    SUCompressedAudio compressedAudio = calloc( 1, sizeof( struct _SUCompressedAudio ) );
+    
+    if( NULL == compressedAudio )
+        return NULL;
+    
+    compressedAudio->bytesPerBlock    = (UInt32)bytesPerBlock;
+    compressedAudio->numberOfChannels = numberOfChannels;
+    compressedAudio->numberOfFrames   = numberOfFrames;
+    compressedAudio->numberOfBlocks   = numberOfBlocks;
+    compressedAudio->blocks           = calloc( (size_t)numberOfBlocks, (size_t)bytesPerBlock );
+    
+    if( NULL == compressedAudio->blocks )
+    {
+        freeCompressedAudio( compressedAudio );
+        return NULL;
+    }
+    
+    for( UInt32 channel = 0; channel < numberOfChannels; channel++ )
+    {
+        // The step index carries over from block to block, so each block starts adapted to the signal.
+        
+        SUADPCMState state = { 0, 0 };
+        
+        for( UInt64 block = 0; block < numberOfBlocks; block++ )
+        {
+            UInt8 * channelBlock    = ( compressedAudio->blocks + ( block * bytesPerBlock ) + ( channel * kSUCompressedAudioChannelBlockSize ) );
+            UInt8 * codes           = ( channelBlock + kSUCompressedAudioHeaderSize );
+            const UInt64 firstFrame = ( block * kSUCompressedAudioFramesPerBlock );
+            const UInt64 lastFrame  = ( ( firstFrame + kSUCompressedAudioFramesPerBlock ) < numberOfFrames ) ? ( firstFrame + kSUCompressedAudioFramesPerBlock ) : numberOfFrames;
+            
+            // Header: the first sample, stored exactly, and the step index.
+            
+            const SInt16 firstSample = samples[ ( firstFrame * numberOfChannels ) + channel ];
+            
+            state.predictor = firstSample;
+            
+            channelBlock[ 0 ] = (UInt8)( (UInt16)firstSample & 0xFF );
+            channelBlock[ 1 ] = (UInt8)( (UInt16)firstSample >> 8 );
+            channelBlock[ 2 ] = (UInt8)state.stepIndex;
+            
+            for( UInt64 frame = ( firstFrame + 1 ); frame < lastFrame; frame++ )
+            {
+                const UInt64 codeIndex = ( frame - firstFrame - 1 );
+                const UInt8 code       = encodeADPCMSample( &state, samples[ ( frame * numberOfChannels ) + channel ] );
+                
+                codes[ codeIndex / 2 ] |= ( codeIndex & 1 ) ? (UInt8)( code << 4 ) : code;
+            }
+        }
+    }
+    
+    return compressedAudio;
+}
+
+void freeCompressedAudio( SUCompressedAudio compressedAudio ) {
+    
+    if( NULL != compressedAudio )
+    {
+        free( compressedAudio->blocks );
+        free( compressedAudio );
+    }
+}
+
+UInt64 compressedAudioSize( SUCompressedAudio compressedAudio ) {
+    
+    return ( sizeof( struct _SUCompressedAudio ) + ( compressedAudio->numberOfBlocks * compressedAudio->bytesPerBlock ) );
+}
+
+void decodeCompressedAudio( SUCompressedAudio compressedAudio, UInt64 firstFrame, UInt64 numberOfFrames, SInt16 * destination ) {
+    
+    const UInt32 numberOfChannels = compressedAudio->numberOfChannels;
+    const UInt64 endFrame         = ( firstFrame + numberOfFrames );
+    
+    for( UInt64 block = ( firstFrame / kSUCompressedAudioFramesPerBlock ); ( block * kSUCompressedAudioFramesPerBlock ) < endFrame; block++ )
+    {
+        const UInt64 blockFirstFrame = ( block * kSUCompressedAudioFramesPerBlock );
+        const UInt64 blockEndFrame   = ( ( blockFirstFrame + kSUCompressedAudioFramesPerBlock ) < endFrame ) ? ( blockFirstFrame + kSUCompressedAudioFramesPerBlock ) : endFrame;
+        
+        // Decoding always starts from the block's first sample; samples before firstFrame are decoded but not written.
+        
+        for( UInt32 channel = 0; channel < numberOfChannels; channel++ )
+        {
+            const UInt8 * channelBlock = ( compressedAudio->blocks + ( block * compressedAudio->bytesPerBlock ) + ( channel * kSUCompressedAudioChannelBlockSize ) );
+            const UInt8 * codes        = ( channelBlock + kSUCompressedAudioHeaderSize );
+            
+            SUADPCMState state = {
+                .predictor = (SInt16)( channelBlock[ 0 ] | ( channelBlock[ 1 ] << 8 ) ),
+                .stepIndex = channelBlock[ 2 ],
+            };
+            
+            SInt16 * output = ( destination + channel );
+            
+            if( blockFirstFrame >= firstFrame )
+                output[ ( blockFirstFrame - firstFrame ) * numberOfChannels ] = (SInt16)state.predictor;
+            
+            for( UInt64 frame = ( blockFirstFrame + 1 ); frame < blockEndFrame; frame++ )
+            {
+                const UInt64 codeIndex = ( frame - blockFirstFrame - 1 );
+                const UInt8 code       = ( codes[ codeIndex / 2 ] >> ( ( codeIndex & 1 ) * 4 ) ) & 0xF;
+                const SInt16 sample    = decodeADPCMCode( &state, code );
+                
+                if( frame >= firstFrame )
+                    output[ ( frame - firstFrame ) * numberOfChannels ] = sample;
+            }
+        }
+    }
+}
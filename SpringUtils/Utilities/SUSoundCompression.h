@@ -0,0 +1,58 @@
+//
+//  SUSoundCompression.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUSoundCompression_h
+#define SpringUtils_SUSoundCompression_h
+
+#import "SUSoundCore.h"
+
+// An IMA ADPCM codec for keeping 16-bit linear PCM audio data resident in a quarter of the memory.
+// Most code should use compressAudioData() (or SUAudioDataReadingCompressed) rather than these functions;
+// compressed audio data is decoded automatically when it fills a buffer.
+
+
+//-----------------------------------------/
+/** @name Encoding and Decoding Audio Data */
+//-----------------------------------------/
+
+
+/** Encodes interleaved, native-endian 16-bit samples as IMA ADPCM.
+ *
+ *  @param  samples             The samples to encode.
+ *  @param  numberOfChannels    The number of interleaved channels.
+ *  @param  numberOfFrames      The number of sample frames.
+ *
+ *  @returns                    The compressed samples, or NULL if they could not be encoded. You must release this value by calling freeCompressedAudio().
+ */
+
+SU_EXTERN SUCompressedAudio createCompressedAudio( const SInt16 * samples, UInt32 numberOfChannels, UInt64 numberOfFrames );
+
+/** Frees compressed audio. */
+
+SU_EXTERN void freeCompressedAudio( SUCompressedAudio compressedAudio );
+
+/** Returns the number of bytes of heap memory used by compressed audio. */
+
+SU_EXTERN UInt64 compressedAudioSize( SUCompressedAudio compressedAudio );
+
+/** Decodes a range of frames of compressed audio as interleaved, native-endian 16-bit samples.
+ *
+ *  Decoding starts from the beginning of the block containing `firstFrame`, so the cost of random access is at most
+ *  kSUCompressedAudioFramesPerBlock frames. This function does not allocate memory, and is safe to call from an audio callback.
+ *
+ *  @param  compressedAudio     The compressed audio.
+ *  @param  firstFrame          The first frame to decode.
+ *  @param  numberOfFrames      The number of frames to decode. The range must lie within the compressed audio.
+ *  @param  destination         A buffer with space for `numberOfFrames` frames of samples.
+ */
+
+SU_EXTERN void decodeCompressedAudio( SUCompressedAudio compressedAudio, UInt64 firstFrame, UInt64 numberOfFrames, SInt16 * destination );
+
+#endif
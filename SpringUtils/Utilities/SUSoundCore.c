@@ -0,0 +1,2065 @@
+//
+//  SUSoundCore.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundCore.h"
+#import "SUSoundCore_Private.h"
+#import "SUSoundInstrumentation_Private.h"
+#import "SUPCMConversion.h"
+#import "SUSoundCompression.h"
+#import "SUSoundWaveform.h"
+#import "SUSoundAnalysis.h"
+
+#import <fcntl.h>
+#import <math.h>
+#import <pthread.h>
+#import <stddef.h>
+#import <stdlib.h>
+#import <string.h>
+#import <unistd.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <time.h>
+
+#pragma mark -
+#pragma mark Deduplicating Audio Data
+
+/** The number of buckets in the table of audio data which reads are deduplicated against. */
+
+#define kSUAudioDataDeduplicationBuckets    256
+
+/** An entry in the deduplication table. Entries are only read or modified while holding the table's lock. */
+
+struct _SUAudioDataDeduplicationEntry {
+    
+    UInt64 hash;
+    UInt64 size;                                        /**< The resident size of the audio data when it was added. */
+    UInt64 numberOfSharedReads;                         /**< The number of reads which have returned the audio data instead of a copy. */
+    SUSoundEffectData audioData;
+    struct _SUAudioDataDeduplicationEntry * next;
+    
+};
+
+static pthread_mutex_t                          deduplicationLock = PTHREAD_MUTEX_INITIALIZER;
+static struct _SUAudioDataDeduplicationEntry *  deduplicationBuckets[ kSUAudioDataDeduplicationBuckets ];
+static SUAudioDataDeduplicationStatistics       deduplicationStatistics;
+
+/** A region of memory which must be equal for two instances of audio data to be shared. */
+
+typedef struct _SUAudioDataRegion {
+    
+    const void * bytes;
+    UInt64 length;
+    
+} SUAudioDataRegion;
+
+/** Lists the regions which describe the audio data's contents: its format, audio bytes, packet layout and measured levels.
+ *  Returns 0 if the audio data cannot be shared. */
+
+static UInt32 getAudioDataRegions( SUSoundEffectData data, SUAudioDataRegion regions[ 6 ] ) {
+    
+    // Mapped pages are already shared, arena buffers can't be freed individually, and progressive reads are still changing.
+    
+    if( ( NULL != data->mappedRegion ) || ( NULL != data->arena ) || ( NULL != data->progressiveLoad ) )
+        return 0;
+    
+    UInt32 numberOfRegions = 0;
+    
+    regions[ numberOfRegions++ ] = (SUAudioDataRegion){ &data->dataFormat, sizeof( AudioStreamBasicDescription ) };
+    
+    if( NULL != data->audioData )
+        regions[ numberOfRegions++ ] = (SUAudioDataRegion){ data->audioData, data->numberOfAudioDataBytes };
+    else if( NULL != data->compressedAudio )
+        regions[ numberOfRegions++ ] = (SUAudioDataRegion){ data->compressedAudio->blocks, data->compressedAudio->numberOfBlocks * data->compressedAudio->bytesPerBlock };
+    else
+        return 0;
+    
+    if( NULL != data->packetDescriptions )
+    {
+        regions[ numberOfRegions++ ] = (SUAudioDataRegion){ data->packetDescriptions, data->numberOfPackets * sizeof( AudioStreamPacketDescription ) };
+    }
+    
+    if( NULL != data->packetTable )
+    {
+        regions[ numberOfRegions++ ] = (SUAudioDataRegion){ data->packetTable->packetSizes, data->numberOfPackets * sizeof( UInt16 ) };
+        
+        if( NULL != data->packetTable->packetFrames )
+            regions[ numberOfRegions++ ] = (SUAudioDataRegion){ data->packetTable->packetFrames, data->numberOfPackets * sizeof( UInt16 ) };
+        else
+            regions[ numberOfRegions++ ] = (SUAudioDataRegion){ &data->packetTable->constantVariableFrames, sizeof( UInt32 ) };
+    }
+    
+    // Audio data whose levels were measured is only shared with reads which measured them too. The flag is not hashed, since
+    // it is followed by padding.
+    
+    if( data->levels.measured )
+    {
+        regions[ numberOfRegions++ ] = (SUAudioDataRegion){ &data->levels, offsetof( SUAudioDataLevels, measured ) };
+    }
+    
+    return numberOfRegions;
+}
+
+SU_INLINE UInt64 rotateLeft64( UInt64 x, int bits ) {
+    
+    return ( ( x << bits ) | ( x >> ( 64 - bits ) ) );
+}
+
+/** Hashes a region of memory, continuing from a previous hash. Uses four independent 64-bit lanes (as in xxHash64),
+ *  so that it runs at several bytes per cycle. */
+
+static UInt64 hashAudioDataRegion( UInt64 hash, SUAudioDataRegion region ) {
+    
+    const UInt64 prime1 = 0x9E3779B185EBCA87ULL, prime2 = 0xC2B2AE3D27D4EB4FULL;
+    const UInt8 * bytes = region.bytes;
+    UInt64 length       = region.length;
+    
+    UInt64 lanes[ 4 ] = { hash + prime1 + prime2, hash + prime2, hash, hash - prime1 };
+    
+    for( ; length >= 32; length -= 32, bytes += 32 )
+    {
+        for( int lane = 0; lane < 4; lane++ )
+        {
+            UInt64 word;
+            memcpy( &word, bytes + ( lane * 8 ), sizeof( word ) );
+            lanes[ lane ] = rotateLeft64( lanes[ lane ] + ( word * prime2 ), 31 ) * prime1;
+        }
+    }
+    
+    hash = rotateLeft64( lanes[ 0 ], 1 ) + rotateLeft64( lanes[ 1 ], 7 ) + rotateLeft64( lanes[ 2 ], 12 ) + rotateLeft64( lanes[ 3 ], 18 ) + region.length;
+    
+    for( ; length > 0; length--, bytes++ )
+    {
+        hash = rotateLeft64( hash ^ ( *bytes * prime1 ), 11 ) * prime2;
+    }
+    
+    hash ^= ( hash >> 33 );
+    hash *= prime2;
+    hash ^= ( hash >> 29 );
+    
+    return hash;
+}
+
+static bool audioDataContentsAreEqual( SUSoundEffectData a, SUSoundEffectData b ) {
+    
+    SUAudioDataRegion regionsA[ 6 ], regionsB[ 6 ];
+    
+    const UInt32 numberOfRegions = getAudioDataRegions( a, regionsA );
+    
+    if( ( numberOfRegions != getAudioDataRegions( b, regionsB ) ) || ( 0 == numberOfRegions ) )
+        return false;
+    
+    if( ( a->numberOfPackets != b->numberOfPackets ) || ( a->numberOfFrames != b->numberOfFrames ) ||
+        ( ( NULL == a->waveform ) != ( NULL == b->waveform ) ) || ( ( NULL == a->packetTable ) != ( NULL == b->packetTable ) ) )
+        return false;
+    
+    for( UInt32 i = 0; i < numberOfRegions; i++ )
+    {
+        if( ( regionsA[ i ].length != regionsB[ i ].length ) || ( 0 != memcmp( regionsA[ i ].bytes, regionsB[ i ].bytes, (size_t)regionsA[ i ].length ) ) )
+            return false;
+    }
+    
+    return true;
+}
+
+/** Adds a reference to audio data in the table, unless its last reference has already been released (in which case it is
+ *  waiting to be removed and freed). */
+
+static bool retainAudioDataIfReferenced( SUSoundEffectData audioData ) {
+    
+    UInt32 retainCount = __atomic_load_n( &audioData->retainCount, __ATOMIC_RELAXED );
+    
+    while( retainCount > 0 )
+    {
+        if( __atomic_compare_exchange_n( &audioData->retainCount, &retainCount, retainCount + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+            return true;
+    }
+    
+    return false;
+}
+
+/** The most resident instances with a matching hash whose contents are compared against a read. */
+
+#define kSUAudioDataDeduplicationCandidates 4
+
+/** Returns resident audio data with the same contents as the newly-read `data`, freeing `data`. If there is none, `data` is
+ *  added to the table and returned.
+ *
+ *  Contents are compared outside the table's lock, so that a read does not hold it while it compares whole payloads. */
+
+static SUSoundEffectData deduplicateAudioData( SUSoundEffectData data ) {
+    
+    SUAudioDataRegion regions[ 6 ];
+    
+    const UInt32 numberOfRegions = getAudioDataRegions( data, regions );
+    
+    if( 0 == numberOfRegions )
+        return data;
+    
+    UInt64 hash = 0;
+    
+    for( UInt32 i = 0; i < numberOfRegions; i++ )
+    {
+        hash = hashAudioDataRegion( hash, regions[ i ] );
+    }
+    
+    struct _SUAudioDataDeduplicationEntry ** bucket = &deduplicationBuckets[ hash % kSUAudioDataDeduplicationBuckets ];
+    
+    // ===================
+    //
+    // 1. Retain the resident audio data with the same hash. Our references keep it from being freed or modified
+    //    (see beginModifyingAudioData()) while its contents are compared.
+    //
+    // ===================
+    
+    
+    SUSoundEffectData candidates[ kSUAudioDataDeduplicationCandidates ];
+    UInt32 numberOfCandidates = 0;
+    
+    SU_LOCK( &deduplicationLock );
+    
+    for( struct _SUAudioDataDeduplicationEntry * entry = *bucket; ( NULL != entry ) && ( numberOfCandidates < kSUAudioDataDeduplicationCandidates ); entry = entry->next )
+    {
+        if( ( hash == entry->hash ) && retainAudioDataIfReferenced( entry->audioData ) )
+            candidates[ numberOfCandidates++ ] = entry->audioData;
+    }
+    
+    pthread_mutex_unlock( &deduplicationLock );
+    
+    // ===================
+    //
+    // 2. Compare their contents
+    //
+    // ===================
+    
+    
+    SUSoundEffectData sharedData = NULL;
+    
+    for( UInt32 i = 0; i < numberOfCandidates; i++ )
+    {
+        if( ( NULL == sharedData ) && audioDataContentsAreEqual( data, candidates[ i ] ) )
+            sharedData = candidates[ i ];
+        else
+            freeAudioData( candidates[ i ] );
+    }
+    
+    // ===================
+    //
+    // 3. Record the shared read, or add the new audio data to the table
+    //
+    // ===================
+    
+    
+    const UInt64 size = audioDataResidentSize( data );
+    struct _SUAudioDataDeduplicationEntry * newEntry = NULL;
+    
+    if( NULL == sharedData )
+    {
+        newEntry = SU_MALLOC( sizeof( struct _SUAudioDataDeduplicationEntry ) );
+        
+        if( NULL == newEntry )
+            return data;
+        
+        *newEntry = (struct _SUAudioDataDeduplicationEntry){ .hash = hash, .size = size, .audioData = data };
+    }
+    
+    SU_LOCK( &deduplicationLock );
+    
+    if( NULL != sharedData )
+    {
+        deduplicationStatistics.numberOfSharedReads++;
+        deduplicationStatistics.numberOfBytesSaved += size;
+        
+        // The shared audio data may have been removed from the table while it was compared.
+        
+        struct _SUAudioDataDeduplicationEntry * entry = sharedData->deduplicationEntry;
+        
+        if( NULL != entry )
+        {
+            entry->numberOfSharedReads++;
+            deduplicationStatistics.numberOfResidentBytesSaved += entry->size;
+        }
+    }
+    else
+    {
+        newEntry->next           = *bucket;
+        *bucket                  = newEntry;
+        data->deduplicationEntry = newEntry;
+    }
+    
+    pthread_mutex_unlock( &deduplicationLock );
+    
+    if( NULL == sharedData )
+        return data;
+    
+    freeAudioData( data );
+    return sharedData;
+}
+
+/** Removes audio data from the deduplication table, so that later reads no longer share it. Called before the audio data
+ *  is freed or modified. */
+
+static void unregisterAudioData( SUSoundEffectData audioData ) {
+    
+    struct _SUAudioDataDeduplicationEntry * entry = audioData->deduplicationEntry;
+    
+    if( NULL == entry )
+        return;
+    
+    SU_LOCK( &deduplicationLock );
+    
+    struct _SUAudioDataDeduplicationEntry ** link = &deduplicationBuckets[ entry->hash % kSUAudioDataDeduplicationBuckets ];
+    
+    while( entry != *link )
+    {
+        link = &( *link )->next;
+    }
+    
+    *link = entry->next;
+    deduplicationStatistics.numberOfResidentBytesSaved -= ( entry->numberOfSharedReads * entry->size );
+    audioData->deduplicationEntry = NULL;
+    
+    pthread_mutex_unlock( &deduplicationLock );
+    
+    free( entry );
+}
+
+/** Prepares audio data to be modified in place. Returns false, leaving it unchanged, if anything else holds a reference to
+ *  it: a shared read, a cache entry or a playing voice may be reading its buffers.
+ *
+ *  The reference count is checked again after the audio data leaves the table, since a concurrent read may have retained
+ *  it to compare contents before then. */
+
+static bool beginModifyingAudioData( SUSoundEffectData audioData ) {
+    
+    if( 1 != __atomic_load_n( &audioData->retainCount, __ATOMIC_ACQUIRE ) )
+        return false;
+    
+    unregisterAudioData( audioData );
+    
+    return ( 1 == __atomic_load_n( &audioData->retainCount, __ATOMIC_ACQUIRE ) );
+}
+
+SUAudioDataDeduplicationStatistics audioDataDeduplicationStatistics( void ) {
+    
+    SU_LOCK( &deduplicationLock );
+    SUAudioDataDeduplicationStatistics statistics = deduplicationStatistics;
+    pthread_mutex_unlock( &deduplicationLock );
+    
+    return statistics;
+}
+
+#pragma mark -
+#pragma mark Loading Steps
+
+OSStatus mapAudioDataRegion( const char * path, SInt64 dataOffset, SUSoundEffectData data ) {
+    
+    if( ( dataOffset < 0 ) || ( 0 == data->numberOfAudioDataBytes ) )
+        return kAudioFileOperationNotSupportedError;
+    
+    int fd = open( path, O_RDONLY );
+    if( fd < 0 )
+        return kAudioFileUnspecifiedError;
+    
+    struct stat fileInfo;
+    
+    if( ( 0 != fstat( fd, &fileInfo ) ) || ( (UInt64)fileInfo.st_size < ( (UInt64)dataOffset + data->numberOfAudioDataBytes ) ) )
+    {
+        close( fd );
+        return kAudioFileInvalidFileError;
+    }
+    
+    // mmap offsets must be page-aligned, so map from the start of the page containing the audio data.
+    
+    const off_t  pageSize      = (off_t)sysconf( _SC_PAGESIZE );
+    const off_t  mappingOffset = ( dataOffset / pageSize ) * pageSize;
+    const size_t mappingLength = (size_t)( ( dataOffset - mappingOffset ) + data->numberOfAudioDataBytes );
+    
+    void * region = mmap( NULL, mappingLength, PROT_READ, MAP_FILE | MAP_PRIVATE, fd, mappingOffset );
+    close( fd );
+    
+    if( MAP_FAILED == region )
+        return kAudioFileUnspecifiedError;
+    
+    data->mappedRegion       = region;
+    data->mappedRegionLength = mappingLength;
+    data->audioData          = ( region + ( dataOffset - mappingOffset ) );
+    
+    return noErr;
+}
+
+OSStatus buildFrameIndex( SUSoundEffectData data ) {
+    
+    const UInt32 framesPerPacket = data->dataFormat.mFramesPerPacket;
+    
+    if( 0 != framesPerPacket )
+    {
+        data->numberOfFrames = ( data->numberOfPackets * framesPerPacket );
+        return noErr;
+    }
+    
+    if( NULL == data->packetDescriptions )
+    {
+        // Unknown frame layout; seeking by time is unavailable.
+        return noErr;
+    }
+    
+    if( NULL == data->packetStartFrames )
+    {
+        data->packetStartFrames = SU_MALLOC( (size_t)data->numberOfPackets * sizeof( UInt64 ) );
+        
+        if( NULL == data->packetStartFrames )
+            return kAudioFileUnspecifiedError;
+    }
+    
+    UInt64 frame = 0;
+    
+    for( UInt64 i = 0; i < data->numberOfPackets; i++ )
+    {
+        data->packetStartFrames[ i ] = frame;
+        frame += data->packetDescriptions[ i ].mVariableFramesInPacket;
+    }
+    
+    data->numberOfFrames = frame;
+    
+    return noErr;
+}
+
+SUSoundEffectData finishReadingAudioData( SUSoundEffectData data, SUAudioDataReadingOptions options ) {
+    
+    if( ( options & SUAudioDataReadingCanonicalFormat ) && ( NULL != data ) )
+    {
+        SUSoundEffectData converted = copyAudioDataInCanonicalFormat( data, data->dataFormat.mChannelsPerFrame );
+        
+        if( NULL != converted )
+        {
+            freeAudioData( data );
+            data = converted;
+        }
+    }
+    
+    if( ( options & SUAudioDataReadingTrimSilence ) && ( NULL != data ) )
+    {
+        trimAudioDataSilence( data, kSUAudioDataSilenceThreshold );
+    }
+    
+    if( ( options & ( SUAudioDataReadingLevels | SUAudioDataReadingTrimSilence ) ) && ( NULL != data ) && ( false == data->levels.measured ) )
+    {
+        measureAudioDataLevels( data );
+    }
+    
+    if( ( options & SUAudioDataReadingWaveform ) && ( NULL != data ) && ( NULL == data->waveform ) )
+    {
+        data->waveform = createSoundWaveform( data );
+    }
+    
+    if( ( options & SUAudioDataReadingCompactPacketTable ) && ( NULL != data ) )
+    {
+        compactAudioDataPacketTable( data );
+    }
+    
+    if( ( options & SUAudioDataReadingCompressed ) && ( NULL != data ) )
+    {
+        compressAudioData( data );
+    }
+    
+    if( ( options & SUAudioDataReadingShared ) && ( NULL != data ) )
+    {
+        data = deduplicateAudioData( data );
+    }
+    
+    return data;
+}
+
+#pragma mark -
+#pragma mark Reading WAV Files
+
+SU_INLINE UInt16 readUInt16LE( const UInt8 * bytes ) {
+    
+    return (UInt16)( bytes[ 0 ] | ( bytes[ 1 ] << 8 ) );
+}
+
+SU_INLINE UInt32 readUInt32LE( const UInt8 * bytes ) {
+    
+    return ( (UInt32)bytes[ 0 ] | ( (UInt32)bytes[ 1 ] << 8 ) | ( (UInt32)bytes[ 2 ] << 16 ) | ( (UInt32)bytes[ 3 ] << 24 ) );
+}
+
+/** Reads exactly `length` bytes at `offset`, retrying short reads. */
+
+static bool readFileBytes( int fd, void * buffer, size_t length, off_t offset ) {
+    
+    while( length > 0 )
+    {
+        const ssize_t bytesRead = pread( fd, buffer, length, offset );
+        
+        if( bytesRead <= 0 )
+            return false;
+        
+        buffer  = ( (UInt8 *)buffer + bytesRead );
+        length -= (size_t)bytesRead;
+        offset += bytesRead;
+    }
+    
+    return true;
+}
+
+/** Fills in the data format from the contents of a WAV 'fmt ' chunk. */
+
+static OSStatus readWAVFormat( const UInt8 * chunk, UInt32 chunkSize, AudioStreamBasicDescription * format ) {
+    
+    enum {
+        kWAVFormatPCM           = 0x0001,
+        kWAVFormatIEEEFloat     = 0x0003,
+        kWAVFormatExtensible    = 0xFFFE,
+    };
+    
+    if( chunkSize < 16 )
+        return kAudioFileInvalidFileError;
+    
+    UInt16 formatTag        = readUInt16LE( chunk + 0 );
+    UInt16 numberOfChannels = readUInt16LE( chunk + 2 );
+    UInt32 sampleRate       = readUInt32LE( chunk + 4 );
+    UInt16 blockAlign       = readUInt16LE( chunk + 12 );
+    UInt16 bitsPerSample    = readUInt16LE( chunk + 14 );
+    
+    // Extensible files store the actual format tag at the start of their sub-format GUID,
+    // and may have fewer valid bits per sample than their container holds.
+    
+    if( kWAVFormatExtensible == formatTag )
+    {
+        if( chunkSize < 40 )
+            return kAudioFileInvalidFileError;
+        
+        const UInt16 validBitsPerSample = readUInt16LE( chunk + 18 );
+        
+        formatTag = readUInt16LE( chunk + 24 );
+        
+        if( ( 0 != validBitsPerSample ) && ( validBitsPerSample < bitsPerSample ) )
+            bitsPerSample = validBitsPerSample;
+    }
+    
+    if( ( 0 == numberOfChannels ) || ( 0 == sampleRate ) || ( 0 == blockAlign ) || ( 0 != ( blockAlign % numberOfChannels ) ) )
+        return kAudioFileInvalidFileError;
+    
+    const UInt32 bytesPerSample = ( blockAlign / numberOfChannels );
+    
+    if( ( 0 == bitsPerSample ) || ( bitsPerSample > ( bytesPerSample * 8 ) ) )
+        return kAudioFileInvalidFileError;
+    
+    memset( format, 0, sizeof( *format ) );
+    
+    format->mSampleRate         = sampleRate;
+    format->mFormatID           = kAudioFormatLinearPCM;
+    format->mFramesPerPacket    = 1;
+    format->mChannelsPerFrame   = numberOfChannels;
+    format->mBitsPerChannel     = bitsPerSample;
+    format->mBytesPerFrame      = blockAlign;
+    format->mBytesPerPacket     = blockAlign;
+    
+    // WAV samples are little-endian. 8-bit integer samples are unsigned; wider ones are signed.
+    // Samples narrower than their container are stored in its most significant bits.
+    
+    if( kWAVFormatIEEEFloat == formatTag )
+    {
+        if( ( 32 != bitsPerSample ) && ( 64 != bitsPerSample ) )
+            return kAudioFileUnsupportedDataFormatError;
+        
+        format->mFormatFlags = kAudioFormatFlagIsFloat;
+    }
+    else if( kWAVFormatPCM == formatTag )
+    {
+        format->mFormatFlags = ( bitsPerSample > 8 ) ? kAudioFormatFlagIsSignedInteger : 0;
+    }
+    else
+    {
+        return kAudioFileUnsupportedDataFormatError;
+    }
+    
+    format->mFormatFlags |= ( bitsPerSample == ( bytesPerSample * 8 ) ) ? kAudioFormatFlagIsPacked : kAudioFormatFlagIsAlignedHigh;
+    
+    return noErr;
+}
+
+/** Finds the format and audio data of the WAV file open as `fd`. */
+
+static OSStatus readWAVChunks( int fd, UInt64 fileSize, SUSoundEffectData data, SInt64 * oDataOffset ) {
+    
+    UInt8 header[ 12 ];
+    
+    if( ( false == readFileBytes( fd, header, sizeof( header ), 0 ) ) ||
+        ( 0 != memcmp( header, "RIFF", 4 ) ) || ( 0 != memcmp( header + 8, "WAVE", 4 ) ) )
+    {
+        return kAudioFileInvalidFileError;
+    }
+    
+    bool   foundFormat = false;
+    UInt64 offset      = sizeof( header );
+    
+    // Chunks are word-aligned. The data chunk is usually the last one, but may precede others.
+    
+    while( ( offset + 8 ) <= fileSize )
+    {
+        UInt8 chunkHeader[ 8 ];
+        
+        if( false == readFileBytes( fd, chunkHeader, sizeof( chunkHeader ), (off_t)offset ) )
+            return kAudioFileInvalidFileError;
+        
+        const UInt64 chunkOffset = ( offset + 8 );
+        UInt64       chunkSize   = readUInt32LE( chunkHeader + 4 );
+        
+        if( 0 == memcmp( chunkHeader, "fmt ", 4 ) )
+        {
+            UInt8 formatChunk[ 40 ];
+            const UInt32 formatChunkSize = ( chunkSize < sizeof( formatChunk ) ) ? (UInt32)chunkSize : sizeof( formatChunk );
+            
+            if( false == readFileBytes( fd, formatChunk, formatChunkSize, (off_t)chunkOffset ) )
+                return kAudioFileInvalidFileError;
+            
+            OSStatus err = readWAVFormat( formatChunk, formatChunkSize, &data->dataFormat );
+            if( noErr != err ) return err;
+            
+            foundFormat = true;
+        }
+        else if( 0 == memcmp( chunkHeader, "data", 4 ) )
+        {
+            if( false == foundFormat )
+                return kAudioFileInvalidFileError;
+            
+            // Files which were not finalised (e.g. when streaming) may have an unknown or truncated data length.
+            
+            if( ( chunkOffset + chunkSize ) > fileSize )
+                chunkSize = ( fileSize - chunkOffset );
+            
+            const UInt32 bytesPerPacket = data->dataFormat.mBytesPerPacket;
+            
+            data->numberOfPackets           = ( chunkSize / bytesPerPacket );
+            data->numberOfAudioDataBytes    = ( data->numberOfPackets * bytesPerPacket );
+            data->maximumPacketSize         = bytesPerPacket;
+            
+            *oDataOffset = (SInt64)chunkOffset;
+            return noErr;
+        }
+        
+        offset = chunkOffset + chunkSize + ( chunkSize & 1 );
+    }
+    
+    return kAudioFileInvalidFileError;
+}
+
+SUSoundEffectData readAudioDataFromWAVFile( const char * path, SUAudioDataReadingOptions options ) {
+    
+    if( NULL == path )
+        return NULL;
+    
+    int fd = open( path, O_RDONLY );
+    
+    if( fd < 0 )
+        return NULL;
+    
+    SUSoundEffectData data = SU_CALLOC( 1, sizeof( struct _SUSoundEffectData ) );
+    
+    if( NULL == data )
+    {
+        close( fd );
+        return NULL;
+    }
+    
+    data->retainCount = 1;
+    
+    OSStatus    err;
+    struct stat fileInfo;
+    SInt64      dataOffset = 0;
+    
+    
+    // ===================
+    //
+    // 1. Read the format and locate the audio data
+    //
+    // ===================
+    
+    
+    err = ( 0 == fstat( fd, &fileInfo ) ) ? readWAVChunks( fd, (UInt64)fileInfo.st_size, data, &dataOffset ) : kAudioFileUnspecifiedError;
+    
+    if( ( noErr == err ) && ( data->numberOfAudioDataBytes > SIZE_T_MAX ) )
+        err = kAudioFileUnspecifiedError;
+    
+    
+    // ===================
+    //
+    // 2. Read (or map) the audio data
+    //
+    // ===================
+    
+    
+    if( noErr == err )
+    {
+        err = kAudioFileOperationNotSupportedError;
+        
+        if( ( options & SUAudioDataReadingMapped ) && ( 0 == ( options & SUAudioDataReadingCanonicalFormat ) ) )
+        {
+            err = mapAudioDataRegion( path, dataOffset, data );
+        }
+        
+        if( noErr != err )
+        {
+            data->audioData = SU_MALLOC( (size_t)data->numberOfAudioDataBytes );
+            
+            if( ( NULL == data->audioData ) || ( false == readFileBytes( fd, data->audioData, (size_t)data->numberOfAudioDataBytes, (off_t)dataOffset ) ) )
+                err = kAudioFileInvalidFileError;
+            else
+                err = noErr;
+        }
+    }
+    
+    close( fd );
+    
+    CHECK_OSSTATUS_FREE_AND_RETURN( err, freeAudioData( data ), NULL )
+    
+    
+    // ===================
+    //
+    // 3. Index packet frames for seeking
+    //
+    // ===================
+    
+    
+    err = buildFrameIndex( data );
+    CHECK_OSSTATUS_FREE_AND_RETURN( err, freeAudioData( data ), NULL )
+    
+    return finishReadingAudioData( data, options );
+}
+
+#pragma mark -
+#pragma mark Compact Packet Tables
+
+/** Returns true if the audio data is VBR, i.e. its playback position is a packet index rather than a byte offset. */
+
+SU_INLINE bool audioDataHasPacketDescriptions( SUSoundEffectData data ) {
+    
+    return ( ( NULL != data->packetDescriptions ) || ( NULL != data->packetTable ) );
+}
+
+SU_INLINE UInt32 packetTableFrames( SUPacketTable table, UInt64 packetIndex ) {
+    
+    return ( NULL != table->packetFrames ) ? table->packetFrames[ packetIndex ] : table->constantVariableFrames;
+}
+
+/** Decodes a packet's start offset by summing the sizes of the packets since the preceding checkpoint. */
+
+static SInt64 packetTableStartOffset( SUPacketTable table, UInt64 packetIndex ) {
+    
+    const UInt64 checkpoint = ( packetIndex / kSUPacketTableCheckpointInterval );
+    SInt64 offset           = table->offsetCheckpoints[ checkpoint ];
+    
+    for( UInt64 i = ( checkpoint * kSUPacketTableCheckpointInterval ); i < packetIndex; i++ )
+    {
+        offset += table->packetSizes[ i ];
+    }
+    
+    return offset;
+}
+
+static UInt64 packetTableSize( SUPacketTable table, UInt64 numberOfPackets ) {
+    
+    const UInt64 numberOfCheckpoints = ( numberOfPackets > 0 ) ? ( ( ( numberOfPackets - 1 ) / kSUPacketTableCheckpointInterval ) + 1 ) : 0;
+    
+    UInt64 size = sizeof( struct _SUPacketTable ) + ( numberOfPackets * sizeof( UInt16 ) ) + ( numberOfCheckpoints * sizeof( SInt64 ) );
+    
+    if( NULL != table->packetFrames )
+    {
+        size += ( numberOfPackets * sizeof( UInt16 ) ) + ( numberOfCheckpoints * sizeof( UInt64 ) );
+    }
+    
+    return size;
+}
+
+static void freePacketTable( SUPacketTable table ) {
+    
+    if( NULL != table )
+    {
+        free( table->packetSizes );
+        free( table->packetFrames );
+        free( table->offsetCheckpoints );
+        free( table->frameCheckpoints );
+        free( table );
+    }
+}
+
+#pragma mark -
+#pragma mark Retaining and Freeing Audio Data
+
+SUSoundEffectData retainAudioData( SUSoundEffectData audioData ) {
+    
+    if( NULL != audioData )
+    {
+        __atomic_fetch_add( &audioData->retainCount, 1, __ATOMIC_RELAXED );
+    }
+    
+    return audioData;
+}
+
+/** Frees audio data whose last reference has been released. */
+
+static void destroyAudioData( SUSoundEffectData audioData ) {
+    
+    unregisterAudioData( audioData );
+    
+    // Instances in an arena share a single allocation with their buffers.
+    
+    if( NULL != audioData->arena )
+    {
+        releaseAudioDataArena( audioData->arena );
+        return;
+    }
+    
+    if( NULL != audioData->mappedRegion )
+    {
+        munmap( audioData->mappedRegion, audioData->mappedRegionLength );
+    }
+    else if( NULL != audioData->audioData )
+    {
+        free( audioData->audioData );
+    }
+    
+    if( NULL != audioData->packetDescriptions )
+    {
+        free( audioData->packetDescriptions );
+    }
+    
+    if( NULL != audioData->packetStartFrames )
+    {
+        free( audioData->packetStartFrames );
+    }
+    
+    freePacketTable( audioData->packetTable );
+    freeCompressedAudio( audioData->compressedAudio );
+    
+    freeSoundWaveform( audioData->waveform );
+    
+    free( audioData->progressiveLoad );
+    free( audioData );
+}
+
+void freeAudioData ( SUSoundEffectData audioData ) {
+    
+    if( NULL != audioData )
+    {
+        if( __atomic_sub_fetch( &audioData->retainCount, 1, __ATOMIC_ACQ_REL ) > 0 )
+            return;
+        
+        destroyAudioData( audioData );
+    }
+}
+
+#pragma mark -
+#pragma mark Retiring Audio Data
+
+/** Audio data whose last reference was released by retireAudioData(), waiting to be freed by the retire thread.
+ *  It is a lock-free stack: releasing threads push on to it, and the retire thread takes the whole stack at once.
+ *
+ *  Releasing threads only try to take the lock to wake the retire thread, so that a real-time thread never blocks on it.
+ *  A wakeup which is missed that way is picked up when the retire thread's wait times out. */
+
+#define kSUAudioDataRetireIntervalNanoseconds   100000000
+
+static SUSoundEffectData    retiredAudioData;
+static pthread_mutex_t      retireLock      = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t       retireCondition = PTHREAD_COND_INITIALIZER;
+static bool                 retireThreadIsRunning;
+
+__attribute__( ( noreturn ) ) static void * audioDataRetireThread( void * context ) {
+    
+    (void)context;
+    
+    SU_LOCK( &retireLock );
+    
+    for( ;; )
+    {
+        SUSoundEffectData audioData = __atomic_exchange_n( &retiredAudioData, NULL, __ATOMIC_ACQUIRE );
+        
+        if( NULL == audioData )
+        {
+            struct timespec deadline;
+            clock_gettime( CLOCK_REALTIME, &deadline );
+            
+            deadline.tv_nsec += kSUAudioDataRetireIntervalNanoseconds;
+            
+            if( deadline.tv_nsec >= 1000000000 )
+            {
+                deadline.tv_sec  += 1;
+                deadline.tv_nsec -= 1000000000;
+            }
+            
+            pthread_cond_timedwait( &retireCondition, &retireLock, &deadline );
+            continue;
+        }
+        
+        pthread_mutex_unlock( &retireLock );
+        
+        while( NULL != audioData )
+        {
+            SUSoundEffectData next = audioData->nextRetired;
+            destroyAudioData( audioData );
+            audioData = next;
+        }
+        
+        SU_LOCK( &retireLock );
+    }
+}
+
+static void createAudioDataRetireThread( void ) {
+    
+    pthread_t thread;
+    
+    if( 0 == pthread_create( &thread, NULL, audioDataRetireThread, NULL ) )
+    {
+        pthread_detach( thread );
+        __atomic_store_n( &retireThreadIsRunning, true, __ATOMIC_RELEASE );
+    }
+}
+
+void startAudioDataRetireThread( void ) {
+    
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    
+    pthread_once( &once, createAudioDataRetireThread );
+}
+
+void retireAudioData( SUSoundEffectData audioData ) {
+    
+    if( NULL == audioData )
+        return;
+    
+    if( __atomic_sub_fetch( &audioData->retainCount, 1, __ATOMIC_ACQ_REL ) > 0 )
+        return;
+    
+    // Without a retire thread, there is nothing to hand the audio data to.
+    
+    if( false == __atomic_load_n( &retireThreadIsRunning, __ATOMIC_ACQUIRE ) )
+    {
+        destroyAudioData( audioData );
+        return;
+    }
+    
+    SUSoundEffectData head = __atomic_load_n( &retiredAudioData, __ATOMIC_RELAXED );
+    
+    do {
+        audioData->nextRetired = head;
+    } while( false == __atomic_compare_exchange_n( &retiredAudioData, &head, audioData, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED ) );
+    
+    if( 0 == pthread_mutex_trylock( &retireLock ) )
+    {
+        pthread_cond_signal( &retireCondition );
+        pthread_mutex_unlock( &retireLock );
+    }
+}
+
+void releaseAudioDataArena( struct _SUAudioDataArena * arena ) {
+    
+    if( 0 == __atomic_sub_fetch( &arena->retainCount, 1, __ATOMIC_ACQ_REL ) )
+    {
+        free( arena );
+    }
+}
+
+UInt64 audioDataResidentSize( SUSoundEffectData audioData ) {
+    
+    UInt64 size = sizeof( struct _SUSoundEffectData );
+    
+    if( ( NULL == audioData->mappedRegion ) && ( NULL != audioData->audioData ) )
+    {
+        size += audioData->numberOfAudioDataBytes;
+    }
+    
+    if( NULL != audioData->compressedAudio )
+    {
+        size += compressedAudioSize( audioData->compressedAudio );
+    }
+    
+    if( NULL != audioData->packetDescriptions )
+    {
+        size += ( audioData->numberOfPackets * sizeof( AudioStreamPacketDescription ) );
+    }
+    
+    if( NULL != audioData->packetStartFrames )
+    {
+        size += ( audioData->numberOfPackets * sizeof( UInt64 ) );
+    }
+    
+    if( NULL != audioData->packetTable )
+    {
+        size += packetTableSize( audioData->packetTable, audioData->numberOfPackets );
+    }
+    
+    if( NULL != audioData->progressiveLoad )
+    {
+        size += sizeof( struct _SUProgressiveLoad );
+    }
+    
+    if( NULL != audioData->waveform )
+    {
+        size += soundWaveformSize( audioData->waveform );
+    }
+    
+    if( NULL != audioData->deduplicationEntry )
+    {
+        size += sizeof( struct _SUAudioDataDeduplicationEntry );
+    }
+    
+    return size;
+}
+
+UInt64 compactAudioDataPacketTable( SUSoundEffectData audioData ) {
+    
+    const AudioStreamPacketDescription * packets = audioData->packetDescriptions;
+    const UInt64 numberOfPackets                 = audioData->numberOfPackets;
+    
+    // Arena buffers can't be freed individually, so there would be nothing to gain.
+    
+    if( ( NULL == packets ) || ( 0 == numberOfPackets ) || ( NULL != audioData->arena ) )
+        return 0;
+    
+    // Packets which haven't been read yet have no descriptions to compact, and shared buffers may be in use.
+    
+    if( ( noErr != audioDataLoadingStatus( audioData ) ) || ( false == beginModifyingAudioData( audioData ) ) )
+        return 0;
+    
+    // Check the packets can be described by the table.
+    
+    bool framesVary = false;
+    
+    for( UInt64 i = 0; i < numberOfPackets; i++ )
+    {
+        if( ( packets[ i ].mDataByteSize > UINT16_MAX ) || ( packets[ i ].mVariableFramesInPacket > UINT16_MAX ) )
+            return 0;
+        
+        if( ( ( i + 1 ) < numberOfPackets ) && ( packets[ i + 1 ].mStartOffset != ( packets[ i ].mStartOffset + packets[ i ].mDataByteSize ) ) )
+            return 0;
+        
+        framesVary |= ( packets[ i ].mVariableFramesInPacket != packets[ 0 ].mVariableFramesInPacket );
+    }
+    
+    // Build the table.
+    
+    const UInt64 numberOfCheckpoints = ( ( numberOfPackets - 1 ) / kSUPacketTableCheckpointInterval ) + 1;
+    
+    SUPacketTable table = SU_CALLOC( 1, sizeof( struct _SUPacketTable ) );
+    
+    if( NULL == table )
+        return 0;
+    
+    table->packetSizes       = SU_MALLOC( (size_t)numberOfPackets * sizeof( UInt16 ) );
+    table->offsetCheckpoints = SU_MALLOC( (size_t)numberOfCheckpoints * sizeof( SInt64 ) );
+    
+    if( framesVary )
+    {
+        table->packetFrames     = SU_MALLOC( (size_t)numberOfPackets * sizeof( UInt16 ) );
+        table->frameCheckpoints = SU_MALLOC( (size_t)numberOfCheckpoints * sizeof( UInt64 ) );
+    }
+    
+    if( ( NULL == table->packetSizes ) || ( NULL == table->offsetCheckpoints ) ||
+        ( framesVary && ( ( NULL == table->packetFrames ) || ( NULL == table->frameCheckpoints ) ) ) )
+    {
+        freePacketTable( table );
+        return 0;
+    }
+    
+    table->constantVariableFrames = framesVary ? 0 : packets[ 0 ].mVariableFramesInPacket;
+    
+    UInt64 frame = 0;
+    
+    for( UInt64 i = 0; i < numberOfPackets; i++ )
+    {
+        if( 0 == ( i % kSUPacketTableCheckpointInterval ) )
+        {
+            table->offsetCheckpoints[ i / kSUPacketTableCheckpointInterval ] = packets[ i ].mStartOffset;
+            
+            if( framesVary )
+                table->frameCheckpoints[ i / kSUPacketTableCheckpointInterval ] = frame;
+        }
+        
+        table->packetSizes[ i ] = (UInt16)packets[ i ].mDataByteSize;
+        
+        if( framesVary )
+            table->packetFrames[ i ] = (UInt16)packets[ i ].mVariableFramesInPacket;
+        
+        frame += packets[ i ].mVariableFramesInPacket;
+    }
+    
+    // Swap it in for the packet descriptions and frame index.
+    
+    const UInt64 previousSize = audioDataResidentSize( audioData );
+    
+    free( audioData->packetDescriptions );
+    free( audioData->packetStartFrames );
+    
+    audioData->packetDescriptions = NULL;
+    audioData->packetStartFrames  = NULL;
+    audioData->packetTable        = table;
+    
+    return ( previousSize - audioDataResidentSize( audioData ) );
+}
+
+#pragma mark -
+#pragma mark Compressed Audio Data
+
+UInt64 compressAudioData( SUSoundEffectData audioData ) {
+    
+    const AudioStreamBasicDescription * format = &( audioData->dataFormat );
+    
+    // Mapped data isn't resident, and arena buffers can't be freed individually, so there would be nothing to gain.
+    
+    if( ( NULL == audioData->audioData ) || ( NULL != audioData->mappedRegion ) || ( NULL != audioData->arena ) )
+        return 0;
+    
+    // Audio bytes which haven't been read yet can't be encoded, and shared buffers may be in use.
+    
+    if( ( noErr != audioDataLoadingStatus( audioData ) ) || ( false == beginModifyingAudioData( audioData ) ) )
+        return 0;
+    
+    // Only native-endian, interleaved 16-bit integer samples are compressed.
+    
+    if( ( kAudioFormatLinearPCM != format->mFormatID ) || ( 16 != format->mBitsPerChannel ) || ( 0 == format->mChannelsPerFrame ) ||
+        ( 0 == ( format->mFormatFlags & kAudioFormatFlagIsSignedInteger ) ) ||
+        ( ( format->mFormatFlags & kAudioFormatFlagIsBigEndian ) != kAudioFormatFlagsNativeEndian ) ||
+        ( format->mFormatFlags & kAudioFormatFlagIsNonInterleaved ) ||
+        ( format->mBytesPerFrame != ( format->mChannelsPerFrame * sizeof( SInt16 ) ) ) )
+        return 0;
+    
+    const UInt64 numberOfFrames = ( audioData->numberOfAudioDataBytes / format->mBytesPerFrame );
+    
+    SUCompressedAudio compressedAudio = createCompressedAudio( audioData->audioData, format->mChannelsPerFrame, numberOfFrames );
+    
+    if( NULL == compressedAudio )
+        return 0;
+    
+    // Swap it in for the audio bytes. Any trailing partial frame is dropped.
+    
+    const UInt64 previousSize = audioDataResidentSize( audioData );
+    
+    free( audioData->audioData );
+    
+    audioData->audioData              = NULL;
+    audioData->numberOfAudioDataBytes = ( numberOfFrames * format->mBytesPerFrame );
+    audioData->compressedAudio        = compressedAudio;
+    
+    return ( previousSize - audioDataResidentSize( audioData ) );
+}
+
+/** Copies audio bytes from CBR audio data in to a buffer, decoding them if the audio data is compressed.
+ *  Compressed audio data is decoded in whole frames, so the offset and length should be multiples of its frame size. */
+
+SU_INLINE void copyAudioDataBytes( SUSoundEffectData audioData, SInt64 byteOffset, UInt32 byteLength, void * destination ) {
+    
+    if( NULL != audioData->compressedAudio )
+    {
+        const UInt32 bytesPerFrame = audioData->dataFormat.mBytesPerFrame;
+        decodeCompressedAudio( audioData->compressedAudio, (UInt64)byteOffset / bytesPerFrame, byteLength / bytesPerFrame, destination );
+    }
+    else
+    {
+        memcpy( destination, audioData->audioData + byteOffset, byteLength );
+    }
+}
+
+#pragma mark -
+#pragma mark Measuring and Trimming Audio Data
+
+/** Returns whether audio data is CBR linear PCM with one frame per packet, which has been read in full. */
+
+static bool audioDataCanBeScanned( SUSoundEffectData audioData ) {
+    
+    const AudioStreamBasicDescription * format = &( audioData->dataFormat );
+    
+    if( ( kAudioFormatLinearPCM != format->mFormatID ) || ( 0 == format->mBytesPerFrame ) || ( 1 != format->mFramesPerPacket ) || ( NULL != audioData->packetDescriptions ) )
+        return false;
+    
+    return ( ( ( NULL != audioData->audioData ) || ( NULL != audioData->compressedAudio ) ) && ( noErr == audioDataLoadingStatus( audioData ) ) );
+}
+
+/** Stores the levels of `numberOfFrames` frames whose samples' squares sum to `sumOfSquares`. */
+
+static void setAudioDataLevels( SUSoundEffectData audioData, float peak, double sumOfSquares, UInt64 numberOfFrames ) {
+    
+    const double numberOfSamples = ( (double)numberOfFrames * audioData->dataFormat.mChannelsPerFrame );
+    
+    audioData->levels.peak     = peak;
+    audioData->levels.rms      = ( numberOfSamples > 0 ) ? (float)sqrt( ( ( sumOfSquares > 0 ) ? sumOfSquares : 0 ) / numberOfSamples ) : 0;
+    audioData->levels.measured = true;
+}
+
+bool measureAudioDataLevels( SUSoundEffectData audioData ) {
+    
+    // Reads are only shared with reads which measured the same levels, so shared audio data can't gain levels.
+    
+    if( ( false == audioDataCanBeScanned( audioData ) ) || ( false == beginModifyingAudioData( audioData ) ) )
+        return false;
+    
+    const UInt64 numberOfFrames = ( audioData->numberOfAudioDataBytes / audioData->dataFormat.mBytesPerFrame );
+    SUSoundLevelScan scan;
+    
+    if( false == scanAudioDataLevels( audioData, 0, numberOfFrames, kSUAudioDataSilenceThreshold, &scan ) )
+        return false;
+    
+    setAudioDataLevels( audioData, scan.peak, scan.sumOfSquares, numberOfFrames );
+    
+    return true;
+}
+
+UInt64 trimAudioDataSilence( SUSoundEffectData audioData, float silenceThreshold ) {
+    
+    // Compressed blocks can't be trimmed without re-encoding them, arena buffers can't be shrunk individually, and shared
+    // buffers may be in use.
+    
+    if( ( false == audioDataCanBeScanned( audioData ) ) || ( NULL == audioData->audioData ) || ( NULL != audioData->arena ) ||
+        ( false == beginModifyingAudioData( audioData ) ) )
+        return 0;
+    
+    const UInt32 bytesPerFrame  = audioData->dataFormat.mBytesPerFrame;
+    const UInt64 numberOfFrames = ( audioData->numberOfAudioDataBytes / bytesPerFrame );
+    SUSoundLevelScan scan, leadingScan, trailingScan;
+    
+    
+    // ===================
+    //
+    // 1. Find the audible frames, and the levels of every frame
+    //
+    // ===================
+    
+    
+    if( false == scanAudioDataLevels( audioData, 0, numberOfFrames, silenceThreshold, &scan ) )
+        return 0;
+    
+    if( scan.endAudibleFrame <= scan.firstAudibleFrame )
+    {
+        setAudioDataLevels( audioData, scan.peak, scan.sumOfSquares, numberOfFrames );
+        return 0;
+    }
+    
+    const UInt64 numberOfLeadingFrames  = scan.firstAudibleFrame;
+    const UInt64 numberOfTrailingFrames = ( numberOfFrames - scan.endAudibleFrame );
+    const UInt64 numberOfAudibleFrames  = ( scan.endAudibleFrame - scan.firstAudibleFrame );
+    
+    // The silent frames' samples are quiet but not necessarily zero, so they are scanned again to remove them from the RMS level.
+    // They are no louder than the threshold, so the peak is unaffected.
+    
+    if( ( false == scanAudioDataLevels( audioData, 0, numberOfLeadingFrames, silenceThreshold, &leadingScan ) ) ||
+        ( false == scanAudioDataLevels( audioData, scan.endAudibleFrame, numberOfTrailingFrames, silenceThreshold, &trailingScan ) ) )
+        return 0;
+    
+    setAudioDataLevels( audioData, scan.peak, scan.sumOfSquares - leadingScan.sumOfSquares - trailingScan.sumOfSquares, numberOfAudibleFrames );
+    
+    if( ( 0 == numberOfLeadingFrames ) && ( 0 == numberOfTrailingFrames ) )
+        return 0;
+    
+    
+    // ===================
+    //
+    // 2. Move the audible frames to the start of the audio bytes
+    //
+    // ===================
+    
+    
+    const size_t numberOfAudibleBytes = (size_t)( numberOfAudibleFrames * bytesPerFrame );
+    
+    if( NULL != audioData->mappedRegion )
+    {
+        // The mapping is removed using mappedRegion, so the audio bytes can start part-way through it.
+        
+        audioData->audioData = ( (UInt8 *)audioData->audioData + ( numberOfLeadingFrames * bytesPerFrame ) );
+    }
+    else
+    {
+        memmove( audioData->audioData, (UInt8 *)audioData->audioData + ( numberOfLeadingFrames * bytesPerFrame ), numberOfAudibleBytes );
+        
+        void * shrunkAudioData = SU_REALLOC( audioData->audioData, numberOfAudibleBytes );
+        
+        if( NULL != shrunkAudioData )
+            audioData->audioData = shrunkAudioData;
+    }
+    
+    audioData->numberOfAudioDataBytes               = numberOfAudibleBytes;
+    audioData->numberOfPackets                      = numberOfAudibleFrames;
+    audioData->numberOfFrames                       = numberOfAudibleFrames;
+    audioData->levels.numberOfLeadingFramesTrimmed  += numberOfLeadingFrames;
+    audioData->levels.numberOfTrailingFramesTrimmed += numberOfTrailingFrames;
+    
+    if( NULL != audioData->waveform )
+    {
+        freeSoundWaveform( audioData->waveform );
+        audioData->waveform = createSoundWaveform( audioData );
+    }
+    
+    return ( numberOfLeadingFrames + numberOfTrailingFrames );
+}
+
+float audioDataNormalizingGain( SUSoundEffectData audioData, float targetPeak ) {
+    
+    if( ( false == audioData->levels.measured ) || ( audioData->levels.peak <= 0 ) )
+        return 1;
+    
+    return ( targetPeak / audioData->levels.peak );
+}
+
+#pragma mark -
+#pragma mark Progressive Loading
+
+UInt64 audioDataPacketsAvailable( SUSoundEffectData audioData ) {
+    
+    if( NULL == audioData->progressiveLoad )
+        return audioData->numberOfPackets;
+    
+    return __atomic_load_n( &audioData->progressiveLoad->numberOfPacketsAvailable, __ATOMIC_ACQUIRE );
+}
+
+OSStatus audioDataLoadingStatus( SUSoundEffectData audioData ) {
+    
+    if( NULL == audioData->progressiveLoad )
+        return noErr;
+    
+    return __atomic_load_n( &audioData->progressiveLoad->status, __ATOMIC_ACQUIRE );
+}
+
+/** Returns the playback position at which the audio data which has been read ends: a packet index for VBR data, and a byte
+ *  offset for CBR data. `oEndStatus` is set to the result code for a fill which reaches it. */
+
+SU_INLINE SInt64 audioDataAvailableEnd( SUSoundEffectData audioData, OSStatus * oEndStatus ) {
+    
+    if( NULL == audioData->progressiveLoad )
+    {
+        *oEndStatus = kAudioFileEndOfFileError;
+        return audioDataHasPacketDescriptions( audioData ) ? (SInt64)audioData->numberOfPackets : (SInt64)audioData->numberOfAudioDataBytes;
+    }
+    
+    // The status is loaded first: once it is final, so is the watermark which was stored before it.
+    
+    const OSStatus status                 = audioDataLoadingStatus( audioData );
+    const UInt64 numberOfPacketsAvailable = audioDataPacketsAvailable( audioData );
+    
+    *oEndStatus = ( noErr == status ) ? kAudioFileEndOfFileError : status;
+    
+    if( audioDataHasPacketDescriptions( audioData ) )
+        return (SInt64)numberOfPacketsAvailable;
+    
+    const UInt64 numberOfBytesAvailable = ( numberOfPacketsAvailable * audioData->dataFormat.mBytesPerPacket );
+    
+    return (SInt64)( ( numberOfBytesAvailable < audioData->numberOfAudioDataBytes ) ? numberOfBytesAvailable : audioData->numberOfAudioDataBytes );
+}
+
+#pragma mark -
+#pragma mark Seeking within Audio Data
+
+SInt64 packetIndexForFrame( SUSoundEffectData audioData, SInt64 frame ) {
+    
+    if( ( frame < 0 ) || ( (UInt64)frame >= audioData->numberOfFrames ) )
+        return -1;
+    
+    const SUPacketTable table = audioData->packetTable;
+    
+    if( ( NULL != table ) && ( NULL != table->packetFrames ) )
+    {
+        // Find the last checkpoint at or before the frame, then scan forward from it.
+        
+        UInt64 low  = 0;
+        UInt64 high = ( ( audioData->numberOfPackets - 1 ) / kSUPacketTableCheckpointInterval ) + 1;
+        
+        while( ( high - low ) > 1 )
+        {
+            const UInt64 mid = low + ( ( high - low ) / 2 );
+            
+            if( table->frameCheckpoints[ mid ] <= (UInt64)frame )
+                low  = mid;
+            else
+                high = mid;
+        }
+        
+        UInt64 packetIndex = ( low * kSUPacketTableCheckpointInterval );
+        UInt64 startFrame  = table->frameCheckpoints[ low ];
+        
+        while( ( ( packetIndex + 1 ) < audioData->numberOfPackets ) && ( ( startFrame + table->packetFrames[ packetIndex ] ) <= (UInt64)frame ) )
+        {
+            startFrame += table->packetFrames[ packetIndex ];
+            packetIndex++;
+        }
+        
+        return (SInt64)packetIndex;
+    }
+    
+    if( NULL == audioData->packetStartFrames )
+    {
+        const UInt32 framesPerPacket = ( ( 0 == audioData->dataFormat.mFramesPerPacket ) && ( NULL != table ) ) ? table->constantVariableFrames :
+                                                                                                                   audioData->dataFormat.mFramesPerPacket;
+        return ( frame / framesPerPacket );
+    }
+    
+    // Find the last packet which starts at or before the frame.
+    
+    UInt64 low  = 0;
+    UInt64 high = audioData->numberOfPackets;
+    
+    while( ( high - low ) > 1 )
+    {
+        const UInt64 mid = low + ( ( high - low ) / 2 );
+        
+        if( audioData->packetStartFrames[ mid ] <= (UInt64)frame )
+            low  = mid;
+        else
+            high = mid;
+    }
+    
+    return (SInt64)low;
+}
+
+SInt64 packetIndexForByteOffset( SUSoundEffectData audioData, SInt64 byteOffset ) {
+    
+    if( ( byteOffset < 0 ) || ( (UInt64)byteOffset >= audioData->numberOfAudioDataBytes ) )
+        return -1;
+    
+    const SUPacketTable table = audioData->packetTable;
+    
+    if( NULL != table )
+    {
+        // Find the last checkpoint at or before the byte, then scan forward from it.
+        
+        UInt64 low  = 0;
+        UInt64 high = ( ( audioData->numberOfPackets - 1 ) / kSUPacketTableCheckpointInterval ) + 1;
+        
+        while( ( high - low ) > 1 )
+        {
+            const UInt64 mid = low + ( ( high - low ) / 2 );
+            
+            if( table->offsetCheckpoints[ mid ] <= byteOffset )
+                low  = mid;
+            else
+                high = mid;
+        }
+        
+        UInt64 packetIndex = ( low * kSUPacketTableCheckpointInterval );
+        SInt64 offset      = table->offsetCheckpoints[ low ];
+        
+        while( ( ( packetIndex + 1 ) < audioData->numberOfPackets ) && ( ( offset + table->packetSizes[ packetIndex ] ) <= byteOffset ) )
+        {
+            offset += table->packetSizes[ packetIndex ];
+            packetIndex++;
+        }
+        
+        return (SInt64)packetIndex;
+    }
+    
+    // Only packets which have been read can be found.
+    
+    const UInt64 numberOfPacketsAvailable = audioDataPacketsAvailable( audioData );
+    
+    if( NULL == audioData->packetDescriptions )
+    {
+        const UInt64 packetIndex = ( (UInt64)byteOffset / audioData->dataFormat.mBytesPerPacket );
+        
+        return ( packetIndex < numberOfPacketsAvailable ) ? (SInt64)packetIndex : -1;
+    }
+    
+    if( numberOfPacketsAvailable < audioData->numberOfPackets )
+    {
+        const AudioStreamPacketDescription * lastPacket = ( numberOfPacketsAvailable > 0 ) ? &( audioData->packetDescriptions[ numberOfPacketsAvailable - 1 ] ) : NULL;
+        
+        if( ( NULL == lastPacket ) || ( byteOffset >= ( lastPacket->mStartOffset + lastPacket->mDataByteSize ) ) )
+            return -1;
+    }
+    
+    // Find the last packet which starts at or before the byte.
+    
+    UInt64 low  = 0;
+    UInt64 high = numberOfPacketsAvailable;
+    
+    while( ( high - low ) > 1 )
+    {
+        const UInt64 mid = low + ( ( high - low ) / 2 );
+        
+        if( audioData->packetDescriptions[ mid ].mStartOffset <= byteOffset )
+            low  = mid;
+        else
+            high = mid;
+    }
+    
+    return (SInt64)low;
+}
+
+OSStatus seekAudioDataToTime( SUSoundEffectData audioData, Float64 time, SInt64 * oPlaybackPosition ) {
+    
+    const SInt64 frame       = (SInt64)( time * audioData->dataFormat.mSampleRate );
+    const SInt64 packetIndex = ( time >= 0 ) ? packetIndexForFrame( audioData, frame ) : -1;
+    
+    if( packetIndex < 0 )
+        return kAudioFilePositionError;
+    
+    if( audioDataHasPacketDescriptions( audioData ) )
+    {
+        *oPlaybackPosition = packetIndex;
+    }
+    else
+    {
+        *oPlaybackPosition = ( packetIndex * audioData->dataFormat.mBytesPerPacket );
+    }
+    
+    return noErr;
+}
+
+#pragma mark -
+#pragma mark Filling Buffers
+
+/** A run of packets which fills one buffer. */
+
+typedef struct _SUSoundBufferSlice {
+    
+    SInt64 byteOffset;          /**< The start offset of the slice's first packet. */
+    UInt32 byteLength;          /**< The number of audio bytes in the slice. */
+    UInt32 numberOfPackets;     /**< The number of packets in the slice. */
+    UInt64 firstPacket;         /**< The index of the slice's first packet. */
+    
+} SUSoundBufferSlice;
+
+/** Walks the packets from `firstPacket` up to `endPacket` which fit in to the buffer, writing their descriptions (rebased to the start
+ *  of the buffer) in to it and measuring the slice of audio data they occupy. Returns the number of packets consumed, which includes
+ *  a packet too large to fit in an empty buffer; such a packet can never be played from the buffer, so it is skipped. */
+
+static UInt32 measureSoundBufferSlice( SUSoundBuffer * buffer, SUSoundEffectData audioData, UInt64 firstPacket, UInt64 endPacket, SUSoundBufferSlice * oSlice ) {
+    
+    oSlice->firstPacket     = firstPacket;
+    oSlice->byteOffset      = 0;
+    oSlice->byteLength      = 0;
+    oSlice->numberOfPackets = 0;
+    
+    // Compact packet tables are decoded as we go: the first packet's offset is found from the preceding checkpoint,
+    // and each subsequent packet starts where the previous one ended.
+    
+    const SUPacketTable table = audioData->packetTable;
+    AudioStreamPacketDescription decodedPacket = { 0 };
+    
+    if( ( NULL != table ) && ( firstPacket < audioData->numberOfPackets ) )
+    {
+        decodedPacket.mStartOffset = packetTableStartOffset( table, firstPacket );
+    }
+    
+    while( oSlice->numberOfPackets < buffer->packetDescriptionCapacity )
+    {
+        const UInt64 packetIndex = ( firstPacket + oSlice->numberOfPackets );
+        
+        // Stop buffering if we've already buffered all packets in the audio data (or the requested range)
+        
+        if( ( packetIndex >= audioData->numberOfPackets ) || ( packetIndex >= endPacket ) )
+            break;
+        
+        const AudioStreamPacketDescription * sourcePacket;
+        
+        if( NULL != table )
+        {
+            decodedPacket.mStartOffset           += decodedPacket.mDataByteSize;
+            decodedPacket.mDataByteSize           = table->packetSizes[ packetIndex ];
+            decodedPacket.mVariableFramesInPacket = packetTableFrames( table, packetIndex );
+            
+            sourcePacket = &decodedPacket;
+        }
+        else
+        {
+            sourcePacket = &( audioData->packetDescriptions[ packetIndex ] );
+        }
+        
+        // Stop buffering once the buffer has no space for the data in this packet.
+        
+        if( ( oSlice->byteLength + sourcePacket->mDataByteSize ) > buffer->audioDataBytesCapacity )
+        {
+            return ( 0 == oSlice->numberOfPackets ) ? 1 : oSlice->numberOfPackets;
+        }
+        
+        // If reading in the first packet, set the slice's start location to the start offset of the source packet.
+        
+        if( 0 == oSlice->numberOfPackets )
+        {
+            oSlice->byteOffset = sourcePacket->mStartOffset;
+        }
+        
+        // Copy the packet description in (rebasing the start offset to this buffer rather than the file as a whole).
+        
+        AudioStreamPacketDescription * destinationPacket = &( buffer->packetDescriptions[ oSlice->numberOfPackets ] );
+        
+        destinationPacket->mStartOffset             = oSlice->byteLength;
+        destinationPacket->mDataByteSize            = sourcePacket->mDataByteSize;
+        destinationPacket->mVariableFramesInPacket  = sourcePacket->mVariableFramesInPacket;
+        
+        // Expand the amount of data to copy to include this packet, and increment number of packets read.
+        
+        oSlice->byteLength += sourcePacket->mDataByteSize;
+        oSlice->numberOfPackets++;
+    }
+    
+    return oSlice->numberOfPackets;
+}
+
+OSStatus fillSoundBufferFromAudioData( SUSoundBuffer * buffer,
+                                       SUSoundEffectData audioData,
+                                       SInt64 * ioPlaybackPosition ) {
+    
+    SU_SOUND_INSTRUMENTATION_BEGIN( instrumentation );
+    
+    // 1. Reset the buffer
+    
+    buffer->audioDataByteSize      = 0;
+    buffer->packetDescriptionCount = 0;
+    
+    // 2. Calculate the byte range to fill the buffer with, up to the end of the audio data which has been read
+    
+    OSStatus endStatus;
+    const SInt64 availableEnd = audioDataAvailableEnd( audioData, &endStatus );
+    
+    SInt64 audioDataBufferLocation = 0;
+    UInt32 audioDataBufferLength   = 0;
+    UInt32 numberOfPacketsConsumed = 0;
+    
+    if( audioDataHasPacketDescriptions( audioData ) )
+    {
+        // Read the packet-data in to the buffer,
+        // and use it to calculate the buffer's byte range.
+        
+        SUSoundBufferSlice slice;
+        
+        numberOfPacketsConsumed = measureSoundBufferSlice( buffer, audioData, (UInt64)*ioPlaybackPosition, (UInt64)availableEnd, &slice );
+        
+        audioDataBufferLocation        = slice.byteOffset;
+        audioDataBufferLength          = slice.byteLength;
+        buffer->packetDescriptionCount = slice.numberOfPackets;
+    }
+    else
+    {
+        // Calculate this buffer's byte range
+        
+        const SInt64 remainingBytes = ( availableEnd > *ioPlaybackPosition ) ? ( availableEnd - *ioPlaybackPosition ) : 0;
+        UInt32 bytesToRead          = ( buffer->audioDataBytesCapacity < remainingBytes ) ? buffer->audioDataBytesCapacity : (UInt32)remainingBytes;
+        
+        // Compressed audio data is decoded in whole frames.
+        
+        if( NULL != audioData->compressedAudio )
+        {
+            bytesToRead -= ( bytesToRead % audioData->dataFormat.mBytesPerFrame );
+        }
+
+        audioDataBufferLocation = *ioPlaybackPosition;
+        audioDataBufferLength   = bytesToRead;
+    }
+    
+    // 3. Copy the audio data in to the buffer
+
+    if( audioDataHasPacketDescriptions( audioData ) )
+        memcpy( buffer->audioData, audioData->audioData + audioDataBufferLocation, audioDataBufferLength );
+    else
+        copyAudioDataBytes( audioData, audioDataBufferLocation, audioDataBufferLength, buffer->audioData );
+    buffer->audioDataByteSize = (UInt32)audioDataBufferLength;
+    
+    // 4. Advance the playback cursor,
+    //    Set the error to kAudioFileEndOfFileError if the playback cursor has reached the end of the data
+    //    (or kSUAudioDataNotReadyError if it has reached the end of the data read so far)
+    
+    OSStatus err = noErr;
+    
+    if( audioDataHasPacketDescriptions( audioData ) )
+    {
+        *ioPlaybackPosition += numberOfPacketsConsumed;
+    }
+    else
+    {
+        *ioPlaybackPosition += buffer->audioDataByteSize;
+    }
+    
+    if( *ioPlaybackPosition >= availableEnd )
+    {
+        err = endStatus;
+    }
+    
+    SU_SOUND_INSTRUMENTATION_END( instrumentation, buffer->audioDataByteSize, buffer->packetDescriptionCount,
+                                  soundBufferPlaybackDuration( buffer, &audioData->dataFormat ) );
+    
+    return err;
+}
+
+#pragma mark -
+#pragma mark Scheduled and Looping Fills
+
+/** Fills the start of the buffer with the silence which precedes scheduled playback. Only linear PCM silence can be generated. */
+
+static OSStatus fillSoundBufferWithSilence( SUSoundBuffer * buffer, SUSoundEffectData audioData, SUSoundPlaybackSchedule * ioSchedule ) {
+    
+    const AudioStreamBasicDescription * format = &audioData->dataFormat;
+    
+    if( ( kAudioFormatLinearPCM != format->mFormatID ) || ( 0 == format->mBytesPerFrame ) || audioDataHasPacketDescriptions( audioData ) )
+        return kAudioFileOperationNotSupportedError;
+    
+    // 8-bit integer samples are unsigned unless flagged otherwise, so their silence is the midpoint of their range.
+    
+    const bool unsignedSamples = ( 8 == format->mBitsPerChannel ) && ( 0 == ( format->mFormatFlags & ( kAudioFormatFlagIsSignedInteger | kAudioFormatFlagIsFloat ) ) );
+    
+    const UInt64 framesAvailable = ( buffer->audioDataBytesCapacity - buffer->audioDataByteSize ) / format->mBytesPerFrame;
+    const UInt64 framesOfSilence = ( ioSchedule->startDelay < framesAvailable ) ? ioSchedule->startDelay : framesAvailable;
+    
+    memset( (UInt8 *)buffer->audioData + buffer->audioDataByteSize, unsignedSamples ? 0x80 : 0, (size_t)( framesOfSilence * format->mBytesPerFrame ) );
+    
+    buffer->audioDataByteSize += (UInt32)( framesOfSilence * format->mBytesPerFrame );
+    ioSchedule->startDelay    -= framesOfSilence;
+    
+    return noErr;
+}
+
+/** Fills the rest of the buffer from CBR audio data, returning to the start of the loop whenever the cursor reaches its end. */
+
+static OSStatus fillSoundBufferWithLoopedBytes( SUSoundBuffer * buffer, SUSoundEffectData audioData, const SUSoundPlaybackSchedule * schedule, SInt64 * ioPlaybackPosition ) {
+    
+    const UInt32 bytesPerPacket  = audioData->dataFormat.mBytesPerPacket;
+    const UInt32 framesPerPacket = ( audioData->dataFormat.mFramesPerPacket > 0 ) ? audioData->dataFormat.mFramesPerPacket : 1;
+    const SInt64 dataEnd         = audioData->numberOfAudioDataBytes;
+    
+    OSStatus endStatus;
+    const SInt64 availableEnd = audioDataAvailableEnd( audioData, &endStatus );
+    
+    // Loop points are rounded down to the start of their packets. For linear PCM, a packet is one frame.
+    
+    const SInt64 loopStart = (SInt64)( schedule->loopStartFrame / framesPerPacket ) * bytesPerPacket;
+    SInt64 loopEnd         = (SInt64)( schedule->loopEndFrame   / framesPerPacket ) * bytesPerPacket;
+    
+    if( loopEnd > dataEnd )
+        loopEnd = dataEnd;
+    
+    const bool looping = ( loopEnd > loopStart );
+    
+    // Only whole packets are copied, so that the seam falls between them.
+    
+    const UInt32 capacity = ( bytesPerPacket > 0 ) ? ( ( buffer->audioDataBytesCapacity / bytesPerPacket ) * bytesPerPacket ) : buffer->audioDataBytesCapacity;
+    SInt64 position       = *ioPlaybackPosition;
+    
+    if( looping && ( position == loopEnd ) )
+        position = loopStart;
+    
+    while( buffer->audioDataByteSize < capacity )
+    {
+        SInt64 segmentEnd = ( looping && ( position < loopEnd ) ) ? loopEnd : dataEnd;
+        
+        if( segmentEnd > availableEnd )
+            segmentEnd = availableEnd;
+        
+        if( ( position < 0 ) || ( position >= segmentEnd ) )
+            break;
+        
+        const UInt32 spaceRemaining = ( capacity - buffer->audioDataByteSize );
+        const UInt32 length         = ( ( segmentEnd - position ) < spaceRemaining ) ? (UInt32)( segmentEnd - position ) : spaceRemaining;
+        
+        copyAudioDataBytes( audioData, position, length, (UInt8 *)buffer->audioData + buffer->audioDataByteSize );
+        
+        buffer->audioDataByteSize += length;
+        position                  += length;
+        
+        if( looping && ( position == loopEnd ) )
+            position = loopStart;
+    }
+    
+    *ioPlaybackPosition = position;
+    
+    return ( position >= availableEnd ) ? endStatus : noErr;
+}
+
+/** Fills the rest of the buffer from VBR audio data, stitching the packets at the end of the loop to those at its start. */
+
+static OSStatus fillSoundBufferWithLoopedPackets( SUSoundBuffer * buffer, SUSoundEffectData audioData, const SUSoundPlaybackSchedule * schedule, SInt64 * ioPlaybackPosition ) {
+    
+    const UInt64 numberOfPackets = audioData->numberOfPackets;
+    
+    OSStatus endStatus;
+    const SInt64 availableEnd = audioDataAvailableEnd( audioData, &endStatus );
+    
+    // Loop points are rounded down to the start of the packets containing them.
+    
+    SInt64 loopStart = -1;
+    SInt64 loopEnd   = -1;
+    
+    if( schedule->loopEndFrame > schedule->loopStartFrame )
+    {
+        loopStart = packetIndexForFrame( audioData, (SInt64)schedule->loopStartFrame );
+        loopEnd   = ( schedule->loopEndFrame >= audioData->numberOfFrames ) ? (SInt64)numberOfPackets : packetIndexForFrame( audioData, (SInt64)schedule->loopEndFrame );
+    }
+    
+    const bool looping = ( loopStart >= 0 ) && ( loopEnd > loopStart );
+    SInt64 position    = *ioPlaybackPosition;
+    
+    if( looping && ( position == loopEnd ) )
+        position = loopStart;
+    
+    while( buffer->packetDescriptionCount < buffer->packetDescriptionCapacity )
+    {
+        SInt64 segmentEnd = ( looping && ( position < loopEnd ) ) ? loopEnd : (SInt64)numberOfPackets;
+        
+        if( segmentEnd > availableEnd )
+            segmentEnd = availableEnd;
+        
+        if( ( position < 0 ) || ( position >= segmentEnd ) )
+            break;
+        
+        // Measure the packets which fit in to the rest of the buffer, then rebase them to follow the packets already in it.
+        
+        SUSoundBuffer remainder = {
+            .audioData                  = (UInt8 *)buffer->audioData + buffer->audioDataByteSize,
+            .audioDataBytesCapacity     = buffer->audioDataBytesCapacity - buffer->audioDataByteSize,
+            .packetDescriptions         = buffer->packetDescriptions + buffer->packetDescriptionCount,
+            .packetDescriptionCapacity  = buffer->packetDescriptionCapacity - buffer->packetDescriptionCount,
+        };
+        
+        SUSoundBufferSlice slice;
+        const UInt32 numberOfPacketsConsumed = measureSoundBufferSlice( &remainder, audioData, (UInt64)position, (UInt64)segmentEnd, &slice );
+        
+        if( 0 == slice.numberOfPackets )
+        {
+            // The next packet doesn't fit. If the buffer is empty it never will, so it is skipped.
+            
+            if( 0 == buffer->packetDescriptionCount )
+                position += numberOfPacketsConsumed;
+            
+            break;
+        }
+        
+        memcpy( remainder.audioData, audioData->audioData + slice.byteOffset, slice.byteLength );
+        
+        for( UInt32 i = 0; i < slice.numberOfPackets; i++ )
+        {
+            remainder.packetDescriptions[ i ].mStartOffset += buffer->audioDataByteSize;
+        }
+        
+        buffer->audioDataByteSize      += slice.byteLength;
+        buffer->packetDescriptionCount += slice.numberOfPackets;
+        position                       += numberOfPacketsConsumed;
+        
+        if( looping && ( position == loopEnd ) )
+            position = loopStart;
+    }
+    
+    *ioPlaybackPosition = position;
+    
+    return ( position >= availableEnd ) ? endStatus : noErr;
+}
+
+OSStatus fillSoundBufferFromAudioDataWithSchedule( SUSoundBuffer * buffer,
+                                                   SUSoundEffectData audioData,
+                                                   SUSoundPlaybackSchedule * ioSchedule,
+                                                   SInt64 * ioPlaybackPosition ) {
+    
+    SU_SOUND_INSTRUMENTATION_BEGIN( instrumentation );
+    
+    // 1. Reset the buffer
+    
+    buffer->audioDataByteSize      = 0;
+    buffer->packetDescriptionCount = 0;
+    
+    // 2. Fill any remaining start delay with silence
+    
+    OSStatus err = noErr;
+    
+    if( ioSchedule->startDelay > 0 )
+    {
+        err = fillSoundBufferWithSilence( buffer, audioData, ioSchedule );
+    }
+    
+    // 3. Fill the rest of the buffer with audio data, wrapping around the loop
+    
+    if( ( noErr == err ) && ( 0 == ioSchedule->startDelay ) )
+    {
+        if( audioDataHasPacketDescriptions( audioData ) )
+            err = fillSoundBufferWithLoopedPackets( buffer, audioData, ioSchedule, ioPlaybackPosition );
+        else
+            err = fillSoundBufferWithLoopedBytes( buffer, audioData, ioSchedule, ioPlaybackPosition );
+    }
+    
+    SU_SOUND_INSTRUMENTATION_END( instrumentation, buffer->audioDataByteSize, buffer->packetDescriptionCount,
+                                  soundBufferPlaybackDuration( buffer, &audioData->dataFormat ) );
+    
+    return err;
+}
+
+#pragma mark -
+#pragma mark Planning Buffer Fills
+
+/** The number of packets covered by each entry of a plan's slice index. */
+
+#define SU_SOUND_BUFFER_PLAN_INDEX_STRIDE 16
+
+struct _SUSoundBufferPlan {
+    
+    SUSoundEffectData audioData;
+    
+    UInt32 audioDataBytesCapacity;
+    UInt32 packetDescriptionCapacity;
+    
+    SUSoundBufferSlice * slices;
+    UInt64 numberOfSlices;
+    
+    AudioStreamPacketDescription * rebasedPacketDescriptions;   /**< Each packet's description, rebased to the start of its slice. */
+    
+    UInt64 * sliceIndex;        /**< The slice containing every SU_SOUND_BUFFER_PLAN_INDEX_STRIDE'th packet. Read-only once created,
+                                     so voices sharing the plan find their slices from their own playback positions. */
+};
+
+SUSoundBufferPlan createSoundBufferPlan( SUSoundEffectData audioData, UInt32 audioDataBytesCapacity, UInt32 packetDescriptionCapacity ) {
+    
+    if( ( false == audioDataHasPacketDescriptions( audioData ) ) || ( 0 == audioData->numberOfPackets ) || ( 0 == packetDescriptionCapacity ) )
+        return NULL;
+    
+    if( noErr != audioDataLoadingStatus( audioData ) )
+        return NULL;
+    
+    if( audioData->numberOfPackets > ( SIZE_T_MAX / sizeof( AudioStreamPacketDescription ) ) )
+        return NULL;
+    
+    SUSoundBufferPlan plan = SU_CALLOC( 1, sizeof( struct _SUSoundBufferPlan ) );
+    
+    if( NULL == plan )
+        return NULL;
+    
+    plan->audioDataBytesCapacity    = audioDataBytesCapacity;
+    plan->packetDescriptionCapacity = packetDescriptionCapacity;
+    plan->rebasedPacketDescriptions = SU_MALLOC( (size_t)audioData->numberOfPackets * sizeof( AudioStreamPacketDescription ) );
+    
+    // Every slice holds at least one packet; the array is shrunk once the number of slices is known.
+    
+    plan->slices = SU_MALLOC( (size_t)audioData->numberOfPackets * sizeof( SUSoundBufferSlice ) );
+    
+    if( ( NULL == plan->rebasedPacketDescriptions ) || ( NULL == plan->slices ) )
+    {
+        freeSoundBufferPlan( plan );
+        return NULL;
+    }
+    
+    // Fill buffers from the start of the audio data, recording the slices they contain.
+    
+    SUSoundBuffer buffer = {
+        .audioDataBytesCapacity     = audioDataBytesCapacity,
+        .packetDescriptionCapacity  = packetDescriptionCapacity,
+    };
+    
+    SInt64 playbackPosition = 0;
+    
+    while( (UInt64)playbackPosition < audioData->numberOfPackets )
+    {
+        // Measuring a slice writes its rebased packet descriptions, but does not copy any audio bytes.
+        
+        SUSoundBufferSlice * slice = &plan->slices[ plan->numberOfSlices ];
+        
+        buffer.packetDescriptions = ( plan->rebasedPacketDescriptions + playbackPosition );
+        measureSoundBufferSlice( &buffer, audioData, (UInt64)playbackPosition, audioData->numberOfPackets, slice );
+        
+        if( 0 == slice->numberOfPackets )
+        {
+            // A packet is too large for the buffer.
+            freeSoundBufferPlan( plan );
+            return NULL;
+        }
+        
+        playbackPosition += slice->numberOfPackets;
+        plan->numberOfSlices++;
+    }
+    
+    SUSoundBufferSlice * slices = SU_REALLOC( plan->slices, (size_t)plan->numberOfSlices * sizeof( SUSoundBufferSlice ) );
+    
+    if( NULL != slices )
+        plan->slices = slices;
+    
+    // Index the slices by packet, so any slice can be found by stepping over at most a stride's worth of slices.
+    
+    const UInt64 numberOfIndexEntries = ( ( audioData->numberOfPackets + SU_SOUND_BUFFER_PLAN_INDEX_STRIDE - 1 ) / SU_SOUND_BUFFER_PLAN_INDEX_STRIDE );
+    plan->sliceIndex = SU_MALLOC( (size_t)numberOfIndexEntries * sizeof( UInt64 ) );
+    
+    if( NULL == plan->sliceIndex )
+    {
+        freeSoundBufferPlan( plan );
+        return NULL;
+    }
+    
+    UInt64 sliceIndex = 0;
+    
+    for( UInt64 entry = 0; entry < numberOfIndexEntries; entry++ )
+    {
+        const UInt64 packet = ( entry * SU_SOUND_BUFFER_PLAN_INDEX_STRIDE );
+        
+        while( ( plan->slices[ sliceIndex ].firstPacket + plan->slices[ sliceIndex ].numberOfPackets ) <= packet )
+        {
+            sliceIndex++;
+        }
+        
+        plan->sliceIndex[ entry ] = sliceIndex;
+    }
+    
+    plan->audioData = retainAudioData( audioData );
+    
+    return plan;
+}
+
+void freeSoundBufferPlan( SUSoundBufferPlan plan ) {
+    
+    if( NULL != plan )
+    {
+        freeAudioData( plan->audioData );
+        free( plan->slices );
+        free( plan->rebasedPacketDescriptions );
+        free( plan->sliceIndex );
+        free( plan );
+    }
+}
+
+static OSStatus fillSoundBufferFromPlanSlice( SUSoundBuffer * buffer, SUSoundBufferPlan plan, SInt64 * ioPlaybackPosition ) {
+    
+    if( ( buffer->audioDataBytesCapacity < plan->audioDataBytesCapacity ) || ( buffer->packetDescriptionCapacity < plan->packetDescriptionCapacity ) )
+        return fillSoundBufferFromAudioData( buffer, plan->audioData, ioPlaybackPosition );
+    
+    // 1. Find the slice which starts at the playback position.
+    //    The index gives the slice containing a nearby earlier packet; step forward from there.
+    
+    const SInt64 position = *ioPlaybackPosition;
+    
+    if( ( position < 0 ) || ( (UInt64)position >= plan->audioData->numberOfPackets ) )
+        return fillSoundBufferFromAudioData( buffer, plan->audioData, ioPlaybackPosition );
+    
+    UInt64 sliceIndex = plan->sliceIndex[ (UInt64)position / SU_SOUND_BUFFER_PLAN_INDEX_STRIDE ];
+    
+    while( ( ( sliceIndex + 1 ) < plan->numberOfSlices ) && ( plan->slices[ sliceIndex + 1 ].firstPacket <= (UInt64)position ) )
+    {
+        sliceIndex++;
+    }
+    
+    if( plan->slices[ sliceIndex ].firstPacket != (UInt64)position )
+        return fillSoundBufferFromAudioData( buffer, plan->audioData, ioPlaybackPosition );
+    
+    // 2. Copy the slice's audio bytes and rebased packet descriptions.
+    
+    const SUSoundBufferSlice * slice = &plan->slices[ sliceIndex ];
+    
+    memcpy( buffer->audioData, plan->audioData->audioData + slice->byteOffset, slice->byteLength );
+    memcpy( buffer->packetDescriptions, plan->rebasedPacketDescriptions + slice->firstPacket, slice->numberOfPackets * sizeof( AudioStreamPacketDescription ) );
+    
+    buffer->audioDataByteSize      = slice->byteLength;
+    buffer->packetDescriptionCount = slice->numberOfPackets;
+    
+    // 3. Advance the playback cursor.
+    
+    *ioPlaybackPosition = (SInt64)( slice->firstPacket + slice->numberOfPackets );
+    
+    return ( ( sliceIndex + 1 ) < plan->numberOfSlices ) ? noErr : kAudioFileEndOfFileError;
+}
+
+OSStatus fillSoundBufferFromPlan( SUSoundBuffer * buffer, SUSoundBufferPlan plan, SInt64 * ioPlaybackPosition ) {
+    
+    SU_SOUND_INSTRUMENTATION_BEGIN( instrumentation );
+    
+    OSStatus err = fillSoundBufferFromPlanSlice( buffer, plan, ioPlaybackPosition );
+    
+    SU_SOUND_INSTRUMENTATION_END( instrumentation, buffer->audioDataByteSize, buffer->packetDescriptionCount,
+                                  soundBufferPlaybackDuration( buffer, &plan->audioData->dataFormat ) );
+    
+    return err;
+}
@@ -0,0 +1,593 @@
+//
+//  SUSoundCore.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUSoundCore_h
+#define SpringUtils_SUSoundCore_h
+
+// The platform-neutral core of SUSoundTools: the in-memory audio data type, a WAV file reader, seeking and buffer filling.
+// None of it depends on AudioToolbox, so it can be built, tested and profiled on any POSIX system. On other systems,
+// the Core Audio types and result codes it uses are declared here with their Core Audio values.
+
+#if defined( __APPLE__ )
+
+    #import <AudioToolbox/AudioToolbox.h>
+
+#else
+
+    #import <stdint.h>
+    #import <stddef.h>
+    #import <stdbool.h>
+
+    typedef int8_t      SInt8;
+    typedef uint8_t     UInt8;
+    typedef int16_t     SInt16;
+    typedef uint16_t    UInt16;
+    typedef int32_t     SInt32;
+    typedef uint32_t    UInt32;
+    typedef int64_t     SInt64;
+    typedef uint64_t    UInt64;
+    typedef double      Float64;
+    typedef SInt32      OSStatus;
+
+    typedef UInt32      AudioFormatID;
+    typedef UInt32      AudioFormatFlags;
+
+    typedef struct AudioStreamBasicDescription {
+        Float64             mSampleRate;
+        AudioFormatID       mFormatID;
+        AudioFormatFlags    mFormatFlags;
+        UInt32              mBytesPerPacket;
+        UInt32              mFramesPerPacket;
+        UInt32              mBytesPerFrame;
+        UInt32              mChannelsPerFrame;
+        UInt32              mBitsPerChannel;
+        UInt32              mReserved;
+    } AudioStreamBasicDescription;
+
+    typedef struct AudioStreamPacketDescription {
+        SInt64              mStartOffset;
+        UInt32              mVariableFramesInPacket;
+        UInt32              mDataByteSize;
+    } AudioStreamPacketDescription;
+
+    enum {
+        noErr                                   = 0,
+        
+        kAudioFormatLinearPCM                   = 'lpcm',
+        
+        kAudioFormatFlagIsFloat                 = ( 1U << 0 ),
+        kAudioFormatFlagIsBigEndian             = ( 1U << 1 ),
+        kAudioFormatFlagIsSignedInteger         = ( 1U << 2 ),
+        kAudioFormatFlagIsPacked                = ( 1U << 3 ),
+        kAudioFormatFlagIsAlignedHigh           = ( 1U << 4 ),
+        kAudioFormatFlagIsNonInterleaved        = ( 1U << 5 ),
+    #if defined( __BYTE_ORDER__ ) && ( __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__ )
+        kAudioFormatFlagsNativeEndian           = kAudioFormatFlagIsBigEndian,
+    #else
+        kAudioFormatFlagsNativeEndian           = 0,
+    #endif
+        
+        kAudioFileUnspecifiedError              = 'wht?',
+        kAudioFileUnsupportedDataFormatError    = 'fmt?',
+        kAudioFileInvalidFileError              = 'dta?',
+        kAudioFileOperationNotSupportedError    = 0x6F703F3F, // 'op??'
+        kAudioFileEndOfFileError                = -39,
+        kAudioFilePositionError                 = -40,
+    };
+
+    #ifndef SIZE_T_MAX
+        #define SIZE_T_MAX SIZE_MAX
+    #endif
+
+#endif
+
+#import "SUBase.h"
+
+/** Returned when the requested audio data has not been read in to memory yet. Try again later. */
+
+enum { kSUAudioDataNotReadyError = 'nrdy' };
+
+/** The number of packets between the absolute offsets (and frames) stored in an SUPacketTable. */
+
+enum { kSUPacketTableCheckpointInterval = 64 };
+
+/** A compact, struct-of-arrays replacement for an array of AudioStreamPacketDescriptions.
+ *
+ *  Packets must be stored contiguously, so each packet's size is also the delta from its start offset to the next packet's.
+ *  Absolute offsets are kept only for every kSUPacketTableCheckpointInterval'th packet; the rest are decoded by summing sizes.
+ *  This takes a little over 2 bytes per packet, rather than 16.
+ */
+
+typedef struct _SUPacketTable {
+    
+    UInt16 * packetSizes;                               /**< The size (in bytes) of each packet. */
+    UInt16 * packetFrames;                              /**< The number of frames in each packet. NULL if every packet has constantVariableFrames frames. */
+    UInt32 constantVariableFrames;                      /**< The mVariableFramesInPacket value of every packet, if packetFrames is NULL. */
+    
+    SInt64 * offsetCheckpoints;                         /**< The start offset of every kSUPacketTableCheckpointInterval'th packet. */
+    UInt64 * frameCheckpoints;                          /**< The first frame of every kSUPacketTableCheckpointInterval'th packet. NULL if packetFrames is NULL. */
+    
+} *SUPacketTable;
+
+/** The number of sample frames in each block of SUCompressedAudio. */
+
+enum { kSUCompressedAudioFramesPerBlock = 256 };
+
+/** 16-bit linear PCM samples, encoded as IMA ADPCM in 4 bits per sample. See SUSoundCompression.h.
+ *
+ *  Samples are encoded in blocks of kSUCompressedAudioFramesPerBlock frames. Each block begins with its first samples and
+ *  the decoder's step sizes, so any block can be decoded without the blocks before it.
+ */
+
+typedef struct _SUCompressedAudio {
+    
+    UInt8 * blocks;                                     /**< The encoded blocks. */
+    UInt32 bytesPerBlock;                               /**< The size (in bytes) of each block. */
+    UInt32 numberOfChannels;                            /**< The number of channels in each frame. */
+    UInt64 numberOfFrames;                              /**< The number of sample frames encoded. */
+    UInt64 numberOfBlocks;                              /**< The number of blocks. */
+    
+} *SUCompressedAudio;
+
+/** A pyramid of min/max/RMS peaks for drawing the waveform of linear PCM audio data at any zoom level. See SUSoundWaveform.h. */
+
+typedef struct _SUSoundWaveform *SUSoundWaveform;
+
+/** The largest sample magnitude which trimAudioDataSilence() treats as silent when trimming during a read (about -72 dBFS). */
+
+#define kSUAudioDataSilenceThreshold    ( 1.0f / 4096 )
+
+/** The levels of linear PCM audio data, measured once when it was read so that they needn't be measured again when it is played
+ *  (e.g. to normalise its gain). Sample values are normalized to [-1, 1]. See measureAudioDataLevels() and trimAudioDataSilence(). */
+
+typedef struct _SUAudioDataLevels {
+    
+    UInt64 numberOfLeadingFramesTrimmed;                /**< The number of silent frames which were removed from the start of the audio data. */
+    UInt64 numberOfTrailingFramesTrimmed;               /**< The number of silent frames which were removed from the end of the audio data. */
+    float peak;                                         /**< The largest sample magnitude, over all channels. */
+    float rms;                                          /**< The root mean square of every sample, over all channels. */
+    bool measured;                                      /**< Whether the levels have been measured. If false, the other fields are 0. */
+    
+} SUAudioDataLevels;
+
+typedef struct _SUSoundEffectData {
+    
+    AudioStreamBasicDescription dataFormat;             /**< Audio data format description. */
+
+    void * audioData;                                   /**< Audio data bytes. */
+    UInt64 numberOfAudioDataBytes;                      /**< The length of audio data. */
+
+    AudioStreamPacketDescription * packetDescriptions;  /**< Audio packet descriptions. NULL if the data format is CBR. */
+    UInt64 numberOfPackets;                             /**< The number of audio packet descriptions. */
+    UInt32 maximumPacketSize;                           /**< The maximum size (in bytes) of data represented by a single packet description. */
+
+    UInt64 * packetStartFrames;                         /**< The index of the first frame in each packet. NULL unless the data format has a variable number of frames per packet. */
+    UInt64 numberOfFrames;                              /**< The total number of sample frames in the audio data. */
+
+    void * mappedRegion;                                /**< The memory-mapped region of the file containing audioData. NULL if audioData was allocated on the heap. */
+    size_t mappedRegionLength;                          /**< The length of the memory-mapped region. */
+
+    UInt32 retainCount;                                 /**< The number of references to this instance. Use retainAudioData() and freeAudioData() to modify. */
+
+    SUPacketTable packetTable;                          /**< A compact packet table, which replaces packetDescriptions and packetStartFrames. See compactAudioDataPacketTable(). */
+
+    struct _SUAudioDataArena * arena;                   /**< The arena containing this instance and its buffers, if it was loaded as part of a sound bank. NULL otherwise. */
+
+    SUCompressedAudio compressedAudio;                  /**< The audio data in a compressed form, which replaces audioData. See compressAudioData(). */
+
+    struct _SUProgressiveLoad * progressiveLoad;        /**< The progress of reading the audio data on a background thread, if it is read progressively. NULL otherwise. See audioDataPacketsAvailable(). */
+
+    SUSoundWaveform waveform;                           /**< The audio data's waveform peaks, if they were built when it was read (see SUAudioDataReadingWaveform). NULL otherwise. */
+
+    struct _SUAudioDataDeduplicationEntry * deduplicationEntry;   /**< The entry through which later reads share this audio data, if it was read with SUAudioDataReadingShared. NULL otherwise. */
+
+    SUAudioDataLevels levels;                           /**< The audio data's levels, if they were measured when it was read (see SUAudioDataReadingLevels). */
+
+    struct _SUSoundEffectData * nextRetired;            /**< The next audio data waiting to be freed, once the last reference has been released on a real-time thread. For internal use. */
+    
+} *SUSoundEffectData;
+
+/** Options which control how audio data is read in to memory. */
+
+typedef enum _SUAudioDataReadingOptions {
+
+    SUAudioDataReadingOptionsNone   = 0,
+
+    /** Memory-maps the audio data region of the file rather than copying it in to the heap.
+     *  Mapped pages are read-only and clean, so they are only paged in as they are played and may be evicted under memory pressure.
+     *  Only CBR audio data (e.g. linear PCM) is mapped, as its packets are known to be stored contiguously. VBR audio data, and
+     *  audio data which cannot be mapped, is read in to the heap instead. */
+
+    SUAudioDataReadingMapped        = 1UL << 0,
+
+    /** Converts linear PCM audio data to native-endian, interleaved 32-bit float samples once it has been read, so that it
+     *  needs no further conversion when it is played. See copyAudioDataInCanonicalFormat().
+     *  Audio data in other formats is returned unconverted. Converted data is always stored in the heap. */
+
+    SUAudioDataReadingCanonicalFormat = 1UL << 1,
+
+    /** Stores VBR packet descriptions in a compact packet table once they have been read. See compactAudioDataPacketTable(). */
+
+    SUAudioDataReadingCompactPacketTable = 1UL << 2,
+
+    /** Compresses 16-bit linear PCM audio data to a quarter of its size once it has been read. See compressAudioData().
+     *  Has no effect on audio data which is mapped, or converted to the canonical format. */
+
+    SUAudioDataReadingCompressed = 1UL << 3,
+
+    /** Builds the waveform peak pyramid of linear PCM audio data once it has been read (after any conversion), and stores it
+     *  in the audio data's waveform field. See createSoundWaveform(). */
+
+    SUAudioDataReadingWaveform = 1UL << 4,
+
+    /** Returns identical audio data which is already resident instead of a copy.
+     *
+     *  Once audio data has been read (and the other options applied), its format, audio bytes and packet layout are hashed.
+     *  If they match audio data which an earlier shared read returned and which has not yet been freed, that audio data is
+     *  retained and returned instead, and the new copy is freed. See audioDataDeduplicationStatistics().
+     *  Memory-mapped audio data is never shared this way, since its pages are already shared by the file system cache.
+     *
+     *  Shared audio data must be treated as read-only: compactAudioDataPacketTable(), compressAudioData(), measureAudioDataLevels()
+     *  and trimAudioDataSilence() leave it unchanged while anything else holds a reference to it. */
+
+    SUAudioDataReadingShared = 1UL << 5,
+
+    /** Measures the peak and RMS levels of linear PCM audio data once it has been read (after any conversion), and stores them
+     *  in the audio data's levels field. See measureAudioDataLevels(). */
+
+    SUAudioDataReadingLevels = 1UL << 6,
+
+    /** Removes leading and trailing silence (samples no louder than kSUAudioDataSilenceThreshold) from linear PCM audio data once
+     *  it has been read (after any conversion, and before compression), and measures its levels. See trimAudioDataSilence(). */
+
+    SUAudioDataReadingTrimSilence = 1UL << 7,
+
+} SUAudioDataReadingOptions;
+
+/** Counts the reads which returned audio data that was already resident, rather than a copy. See SUAudioDataReadingShared. */
+
+typedef struct _SUAudioDataDeduplicationStatistics {
+    
+    UInt64 numberOfSharedReads;         /**< The number of reads which returned audio data that was already resident. */
+    UInt64 numberOfBytesSaved;          /**< The total resident size of the copies which those reads freed. */
+    UInt64 numberOfResidentBytesSaved;  /**< The part of numberOfBytesSaved which is still saved, because the shared audio data has not been freed. */
+    
+} SUAudioDataDeduplicationStatistics;
+
+/** A precomputed plan for filling buffers of a given capacity from VBR audio data. See createSoundBufferPlan(). */
+
+typedef struct _SUSoundBufferPlan *SUSoundBufferPlan;
+
+/** A buffer to be filled with audio data. Its fields mirror those of an AudioQueueBuffer. */
+
+typedef struct _SUSoundBuffer {
+    
+    void * audioData;                                   /**< The buffer's audio data bytes. */
+    UInt32 audioDataBytesCapacity;                      /**< The size (in bytes) of audioData. */
+    UInt32 audioDataByteSize;                           /**< The number of valid bytes in audioData. */
+    
+    AudioStreamPacketDescription * packetDescriptions;  /**< The buffer's packet descriptions. NULL if packetDescriptionCapacity is 0. */
+    UInt32 packetDescriptionCapacity;                   /**< The number of packet descriptions the buffer can hold. 0 for CBR data. */
+    UInt32 packetDescriptionCount;                      /**< The number of valid packet descriptions. */
+    
+} SUSoundBuffer;
+
+/** Describes when audio data starts playing in to a sequence of buffers, and which part of it loops.
+ *  See fillSoundBufferFromAudioDataWithSchedule(). */
+
+typedef struct _SUSoundPlaybackSchedule {
+    
+    UInt64 startDelay;          /**< The number of frames of silence to fill before playback starts. Decremented as silence is filled. */
+    UInt64 loopStartFrame;      /**< The frame playback returns to when it reaches loopEndFrame. */
+    UInt64 loopEndFrame;        /**< The frame after the last frame of the loop. If not greater than loopStartFrame, the audio data does not loop. */
+    
+} SUSoundPlaybackSchedule;
+
+
+//-----------------------------------------/
+/** @name Reading and Freeing Audio Data */
+//-----------------------------------------/
+
+
+/** Reads the audio data from a WAV file in to memory.
+ *
+ *  Supports RIFF/WAVE files containing integer PCM or IEEE float samples, including WAVE_FORMAT_EXTENSIBLE files.
+ *
+ *  @param  path        The path of the WAV file to read.
+ *  @param  options     Options which control how the audio data is read. See SUAudioDataReadingOptions.
+ *
+ *  @returns            An SUSoundEffectData containing the audio data, or NULL if the file couldn't be read.
+ *                      You must release this value by calling freeAudioData().
+ */
+
+SU_EXTERN SUSoundEffectData readAudioDataFromWAVFile( const char * path, SUAudioDataReadingOptions options );
+
+/** Adds a reference to an SUSoundEffectData instance.
+ *
+ *  This function is thread-safe.
+ *
+ *  @param  audioData   The SUSoundEffectData instance to retain.
+ *
+ *  @returns            The given instance. Each call must be balanced by a call to freeAudioData().
+ */
+
+SU_EXTERN SUSoundEffectData retainAudioData( SUSoundEffectData audioData );
+
+/** Releases a reference to an SUSoundEffectData instance.
+ *
+ *  When the last reference is released, the instance and its associated memory buffers are freed.
+ *  If the audio data was memory-mapped, the mapping is removed. This function is thread-safe.
+ *
+ *  @param  audioData   The SUSoundEffectData instance to release. After calling this function,
+ *                      you should no longer use the SUSoundEffect instance.
+ */
+
+SU_EXTERN void freeAudioData( SUSoundEffectData audioData );
+
+/** Returns the number of bytes of heap memory used by an SUSoundEffectData instance.
+ *
+ *  Memory-mapped audio data is not included, since it may be paged out at any time.
+ *
+ *  @param  audioData   The SUSoundEffectData instance.
+ */
+
+SU_EXTERN UInt64 audioDataResidentSize( SUSoundEffectData audioData );
+
+/** Returns the number of packets of audio data which have been read in to memory, and so can be played.
+ *
+ *  This is the audio data's numberOfPackets, unless it is being read progressively (see readAudioDataFromURLProgressively()),
+ *  in which case it rises as packets are read. This function is thread-safe, and does not block.
+ *
+ *  @param  audioData   The audio data.
+ */
+
+SU_EXTERN UInt64 audioDataPacketsAvailable( SUSoundEffectData audioData );
+
+/** Returns whether all of the audio data has been read in to memory.
+ *
+ *  This function is thread-safe, and does not block.
+ *
+ *  @param  audioData   The audio data.
+ *
+ *  @returns            noErr once every packet has been read, or kSUAudioDataNotReadyError while the audio data is being read progressively.
+ *                      If reading failed part-way through, the error is returned, and only the packets read before it are available.
+ */
+
+SU_EXTERN OSStatus audioDataLoadingStatus( SUSoundEffectData audioData );
+
+/** Returns a snapshot of the statistics on reads which shared resident audio data. This function is thread-safe. */
+
+SU_EXTERN SUAudioDataDeduplicationStatistics audioDataDeduplicationStatistics( void );
+
+/** Replaces the packet descriptions of VBR audio data with a compact packet table (see SUPacketTable).
+ *
+ *  The table is decoded on the fly when seeking and filling buffers. Audio data which is CBR, whose packets are not
+ *  contiguous, or whose packets are larger than 65535 bytes or frames is left unchanged, as is audio data in a sound bank's arena
+ *  and audio data which has not been read in full (see audioDataLoadingStatus()).
+ *
+ *  This function is not thread-safe; it must not be called while the audio data is in use. Audio data with more than one
+ *  reference (e.g. from a shared read; see SUAudioDataReadingShared) is left unchanged, since another owner may be playing it.
+ *  Once compacted, the audio data is no longer shared with later reads.
+ *
+ *  @param  audioData   The audio data.
+ *
+ *  @returns            The number of bytes of memory saved, or 0 if the audio data was left unchanged.
+ */
+
+SU_EXTERN UInt64 compactAudioDataPacketTable( SUSoundEffectData audioData );
+
+/** Replaces the audio bytes of 16-bit linear PCM audio data with IMA ADPCM compressed audio (see SUCompressedAudio).
+ *
+ *  Compression is lossy, but uses a quarter of the memory. The audio data's format, length and playback positions are unchanged,
+ *  and it is decoded as it fills buffers; decoding is allocation-free and hundreds of times faster than real time. Its audioData field
+ *  becomes NULL, so audio data which is read directly (e.g. by SUSoundMixer or copyAudioDataInCanonicalFormat()) cannot be compressed.
+ *
+ *  Audio data in other formats, memory-mapped audio data, audio data in a sound bank's arena and audio data which has not been
+ *  read in full (see audioDataLoadingStatus()) are left unchanged.
+ *  This function is not thread-safe; it must not be called while the audio data is in use. Audio data with more than one
+ *  reference (e.g. from a shared read; see SUAudioDataReadingShared) is left unchanged, since another owner may be playing it.
+ *  Once compressed, the audio data is no longer shared with later reads.
+ *
+ *  @param  audioData   The audio data.
+ *
+ *  @returns            The number of bytes of memory saved, or 0 if the audio data was left unchanged.
+ */
+
+SU_EXTERN UInt64 compressAudioData( SUSoundEffectData audioData );
+
+/** Measures the peak and RMS levels of linear PCM audio data, and stores them in its levels field.
+ *
+ *  The samples are scanned once, with SSE2 or NEON (see scanAudioDataLevels()). Audio data which is VBR or not linear PCM, and audio
+ *  data which has not been read in full (see audioDataLoadingStatus()), is left unchanged.
+ *  This function is not thread-safe; it must not be called while the audio data is in use. Audio data with more than one
+ *  reference (e.g. from a shared read; see SUAudioDataReadingShared) is left unchanged. Once measured, the audio data is no
+ *  longer shared with later reads.
+ *
+ *  @param  audioData   The audio data.
+ *
+ *  @returns            true if the levels were measured.
+ */
+
+SU_EXTERN bool measureAudioDataLevels( SUSoundEffectData audioData );
+
+/** Removes the silent frames from the start and end of linear PCM audio data, and measures the levels of the frames which remain.
+ *
+ *  A frame is silent if none of its samples is louder than the threshold. Heap-allocated audio bytes are moved down and shrunk,
+ *  and memory-mapped audio data is trimmed without copying. The numbers of frames removed are added to the audio data's levels,
+ *  so that callers which need the original timing can delay playback (e.g. with SUSoundPlaybackSchedule's startDelay).
+ *  If the audio data has a waveform, it is rebuilt.
+ *
+ *  Audio data which is entirely silent is not trimmed. Audio data which is VBR, compressed, in a sound bank's arena or not linear
+ *  PCM, and audio data which has not been read in full (see audioDataLoadingStatus()), is left unchanged.
+ *  This function is not thread-safe; it must not be called while the audio data is in use. Audio data with more than one
+ *  reference (e.g. from a shared read; see SUAudioDataReadingShared) is left unchanged, since another owner may be playing it.
+ *  Once trimmed, the audio data is no longer shared with later reads.
+ *
+ *  @param  audioData           The audio data.
+ *  @param  silenceThreshold    The largest sample magnitude which is considered silent, normalized to [0, 1].
+ *
+ *  @returns                    The number of frames removed.
+ */
+
+SU_EXTERN UInt64 trimAudioDataSilence( SUSoundEffectData audioData, float silenceThreshold );
+
+/** Returns the gain which brings the peak level of audio data to a target level (e.g. for startSoundMixerVoice()), using its
+ *  measured levels rather than scanning its samples.
+ *
+ *  @param  audioData   The audio data.
+ *  @param  targetPeak  The peak sample magnitude to normalise to.
+ *
+ *  @returns            The gain, or 1 if the audio data's levels have not been measured or it is silent.
+ */
+
+SU_EXTERN float audioDataNormalizingGain( SUSoundEffectData audioData, float targetPeak );
+
+
+//----------------------------------/
+/** @name Seeking within Audio Data */
+//----------------------------------/
+
+
+/** Returns the index of the packet containing the given sample frame.
+ *
+ *  For formats with a constant number of frames per packet this is a division; otherwise it is a binary search
+ *  of the audio data's packetStartFrames index.
+ *
+ *  @param  audioData   The audio data.
+ *  @param  frame       The index of the sample frame.
+ *
+ *  @returns            The index of the packet containing `frame`, or -1 if the frame is outside of the audio data.
+ */
+
+SU_EXTERN SInt64 packetIndexForFrame( SUSoundEffectData audioData, SInt64 frame );
+
+/** Returns the index of the packet containing the given byte of audio data.
+ *
+ *  While the audio data is being read progressively, only the bytes of packets which have been read can be found.
+ *
+ *  @param  audioData   The audio data.
+ *  @param  byteOffset  The offset of the byte, relative to the start of the audio data.
+ *
+ *  @returns            The index of the packet containing `byteOffset`, or -1 if the byte is outside of the audio data.
+ */
+
+SU_EXTERN SInt64 packetIndexForByteOffset( SUSoundEffectData audioData, SInt64 byteOffset );
+
+/** Calculates the playback position of the packet containing the given time.
+ *
+ *  The result may be passed as the playback position to fillBufferFromAudioData(). For VBR data it is a packet index,
+ *  and for CBR data it is the byte offset of the packet.
+ *
+ *  @param  audioData           The audio data.
+ *  @param  time                The time (in seconds) from the start of the audio data.
+ *  @param  oPlaybackPosition   On output, the playback position of the packet containing `time`.
+ *
+ *  @returns                    noErr, or kAudioFilePositionError if the time is outside of the audio data.
+ */
+
+SU_EXTERN OSStatus seekAudioDataToTime( SUSoundEffectData audioData, Float64 time, SInt64 * oPlaybackPosition );
+
+
+//-------------------------/
+/** @name Filling Buffers */
+//-------------------------/
+
+
+/** Fills a buffer with sound data. fillBufferFromAudioData() is a wrapper around this function for AudioQueue buffers.
+ *
+ *  If the audio data is being read progressively, only the packets which have been read (see audioDataPacketsAvailable())
+ *  are filled from, so the buffer may be only partly filled, or empty.
+ *
+ *  @param  buffer              The buffer to fill with audio data.
+ *  @param  audioData           The audio data to fill the buffer from.
+ *  @param  ioPlaybackPosition  On input, the cursor position to fill from. On output, the new cursor position.
+ *
+ *  @returns                    A result code, which is equal to kAudioFileEndOfFileError once the playback position has
+ *                              reached the end of the given data, or kSUAudioDataNotReadyError once it has reached the packets
+ *                              which have been read so far. Any audio data in the buffer is valid; fill again later for the rest.
+ */
+
+SU_EXTERN OSStatus fillSoundBufferFromAudioData( SUSoundBuffer * buffer, SUSoundEffectData audioData, SInt64 * ioPlaybackPosition );
+
+/** Fills a buffer with sound data, starting after a delay and looping over a region of the audio data.
+ *
+ *  While the schedule's start delay is non-zero, the buffer is filled with silence, and the playback position is not used.
+ *  Audio data follows the silence in the same buffer, so playback starts at a sample-accurate time. Once the playback
+ *  position reaches the end of the loop, it returns to the start of the loop within the same buffer, so the loop plays
+ *  without a gap and the buffer is always full.
+ *
+ *  Loop points are sample-accurate for linear PCM. For other formats, they are rounded down to the start of the packets
+ *  containing them. A start delay requires linear PCM audio data. As with fillSoundBufferFromAudioData(), audio data which is
+ *  being read progressively is only filled from up to the packets which have been read.
+ *
+ *  @param  buffer              The buffer to fill with audio data.
+ *  @param  audioData           The audio data to fill the buffer from.
+ *  @param  ioSchedule          The start delay and loop region. On output, the start delay is reduced by the frames of silence filled.
+ *  @param  ioPlaybackPosition  On input, the cursor position to fill from. On output, the new cursor position.
+ *
+ *  @returns                    A result code, which is equal to kAudioFileEndOfFileError once the playback position has
+ *                              reached the end of the given data (which never happens while looping), kSUAudioDataNotReadyError once it
+ *                              has reached the packets which have been read so far, or kAudioFileOperationNotSupportedError if a start delay
+ *                              was requested for audio data which is not linear PCM.
+ */
+
+SU_EXTERN OSStatus fillSoundBufferFromAudioDataWithSchedule( SUSoundBuffer * buffer, SUSoundEffectData audioData, SUSoundPlaybackSchedule * ioSchedule, SInt64 * ioPlaybackPosition );
+
+
+//----------------------------------/
+/** @name Planning Buffer Fills */
+//----------------------------------/
+
+
+/** Precomputes how VBR audio data is split in to buffers of the given capacity.
+ *
+ *  Playing from the start of the audio data always fills buffers with the same slices of packets. A plan records each
+ *  slice's byte range and packet range, along with a copy of the packet descriptions rebased to the start of their slice,
+ *  so that filling a buffer is a single copy of audio bytes and a single copy of packet descriptions.
+ *
+ *  A plan keeps a reference to the audio data, and uses a little over 16 bytes per packet for its rebased descriptions and an index of its slices.
+ *
+ *  @param  audioData                   The VBR audio data to plan buffer fills for.
+ *  @param  audioDataBytesCapacity      The capacity (in bytes) of the buffers to be filled.
+ *  @param  packetDescriptionCapacity   The number of packet descriptions the buffers to be filled can hold.
+ *
+ *  @returns                            A new plan, or NULL if the audio data is CBR, has not been read in full, or has packets larger than `audioDataBytesCapacity`.
+ *                                      You must release this value by calling freeSoundBufferPlan().
+ */
+
+SU_EXTERN SUSoundBufferPlan createSoundBufferPlan( SUSoundEffectData audioData, UInt32 audioDataBytesCapacity, UInt32 packetDescriptionCapacity );
+
+/** Releases a buffer plan and its reference to its audio data.
+ *
+ *  @param  plan    The plan to release. After calling this function, you should no longer use the plan.
+ */
+
+SU_EXTERN void freeSoundBufferPlan( SUSoundBufferPlan plan );
+
+/** Fills a buffer with sound data, using a precomputed plan.
+ *
+ *  Fills take constant time, and keep no state in the plan, so voices playing the same plan do not slow each other down.
+ *  Filling from a playback position which does not start one of the plan's slices
+ *  (e.g. after seeking), or in to a buffer smaller than the plan's capacity, falls back to fillSoundBufferFromAudioData(),
+ *  after which the buffers it fills will not line up with the plan until playback restarts from a slice boundary.
+ *
+ *  This function is thread-safe; one plan can be used to fill buffers for several voices.
+ *
+ *  @param  buffer              The buffer to fill with audio data.
+ *  @param  plan                The plan to fill the buffer with.
+ *  @param  ioPlaybackPosition  On input, the cursor position to fill from. On output, the new cursor position.
+ *
+ *  @returns                    A result code, which is equal to kAudioFileEndOfFileError once the playback position has
+ *                              reached the end of the plan's audio data.
+ */
+
+SU_EXTERN OSStatus fillSoundBufferFromPlan( SUSoundBuffer * buffer, SUSoundBufferPlan plan, SInt64 * ioPlaybackPosition );
+
+#endif
@@ -0,0 +1,64 @@
+//
+//  SUSoundCore_Private.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundCore.h"
+
+// Loading steps shared by the WAV reader and the AudioToolbox readers in SUSoundTools.
+
+#define CHECK_OSSTATUS_FREE_AND_RETURN( err, freeCmd, retVal ) if( __builtin_expect( noErr != err, 0 ) ) { freeCmd; return retVal; }
+
+/** Maps the `numberOfAudioDataBytes` of audio data at `dataOffset` in the file at `path`, setting the data's audioData
+ *  and mappedRegion. The audio data must be a single contiguous region of the file. */
+
+SU_EXTERN OSStatus mapAudioDataRegion( const char * path, SInt64 dataOffset, SUSoundEffectData data );
+
+/** Counts the audio data's frames and, if the number of frames per packet varies, builds the packetStartFrames index.
+ *  If packetStartFrames has already been allocated, the index is built in place. */
+
+SU_EXTERN OSStatus buildFrameIndex( SUSoundEffectData data );
+
+/** Applies the options which take effect once audio data has been read (e.g. SUAudioDataReadingCanonicalFormat).
+ *  Returns the audio data to hand to the caller, which may be a replacement for `data`. */
+
+SU_EXTERN SUSoundEffectData finishReadingAudioData( SUSoundEffectData data, SUAudioDataReadingOptions options );
+
+/** A single allocation holding several SUSoundEffectData instances and their buffers. It is freed once all of them have been freed. */
+
+struct _SUAudioDataArena {
+    
+    UInt32 retainCount;     /**< The number of instances in the arena which have not been freed. */
+    size_t size;            /**< The size of the arena's memory, which immediately follows this header. */
+    
+};
+
+/** Releases a reference to an arena, freeing it when the last reference is released. */
+
+SU_EXTERN void releaseAudioDataArena( struct _SUAudioDataArena * arena );
+
+/** Releases a reference to audio data, like freeAudioData(), but without freeing it on the calling thread. Audio data whose
+ *  last reference is released is handed to a background thread (see startAudioDataRetireThread()), so that real-time threads
+ *  never block on the deduplication table's lock or wait for memory to be freed or unmapped. This function is lock-free. */
+
+SU_EXTERN void retireAudioData( SUSoundEffectData audioData );
+
+/** Starts the background thread which frees the audio data passed to retireAudioData(), if it is not already running.
+ *  Until it is started, retireAudioData() frees audio data on the calling thread. This function is thread-safe. */
+
+SU_EXTERN void startAudioDataRetireThread( void );
+
+/** The progress of audio data which is being read on a background thread. The reader writes each packet's bytes and description
+ *  in place, then publishes it by storing the watermark; fills only read packets below the watermark they load. */
+
+struct _SUProgressiveLoad {
+    
+    UInt64 numberOfPacketsAvailable;    /**< The number of packets read so far. Stored with release semantics. */
+    OSStatus status;                    /**< kSUAudioDataNotReadyError while reading, then the result of reading. Stored with release semantics, after the final watermark. */
+    
+};
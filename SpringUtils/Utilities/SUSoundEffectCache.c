@@ -0,0 +1,408 @@
+//
+//  SUSoundEffectCache.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundEffectCache.h"
+
+#import <pthread.h>
+#import <sys/stat.h>
+
+#define SU_SOUND_EFFECT_CACHE_NUMBER_OF_BUCKETS 64
+#define SU_SHARED_SOUND_EFFECT_CACHE_BYTE_BUDGET ( 16 * 1024 * 1024 )
+
+typedef struct _SUSoundEffectCacheEntry {
+    
+    // File identity
+    
+    dev_t  device;
+    ino_t  inode;
+    off_t  fileSize;
+    time_t modificationTime;
+    
+    // Contents. While the file is being read, `loading` is true and `data` is NULL.
+    // Entries for different files may share deduplicated audio data; only one of them is charged its cost.
+    
+    SUSoundEffectData data;
+    UInt64 cost;
+    bool   loading;
+    
+    // Bucket chains, and the LRU list (most-recently-used first). Entries are only in the audio data buckets and the LRU list once loaded.
+    
+    struct _SUSoundEffectCacheEntry * nextInBucket;
+    struct _SUSoundEffectCacheEntry * nextInDataBucket;
+    struct _SUSoundEffectCacheEntry * moreRecentlyUsed;
+    struct _SUSoundEffectCacheEntry * lessRecentlyUsed;
+    
+} SUSoundEffectCacheEntry;
+
+struct _SUSoundEffectCache {
+    
+    pthread_mutex_t lock;
+    pthread_cond_t  loadCompleted;
+    pthread_cond_t  readsCompleted;
+    
+    SUAudioDataReadingOptions options;
+    UInt32 activeReads;     // The number of calls to readAudioDataFromCache() which may still use the cache.
+    
+    SUSoundEffectCacheEntry * buckets[ SU_SOUND_EFFECT_CACHE_NUMBER_OF_BUCKETS ];       // Keyed by file identity.
+    SUSoundEffectCacheEntry * dataBuckets[ SU_SOUND_EFFECT_CACHE_NUMBER_OF_BUCKETS ];   // Keyed by audio data.
+    SUSoundEffectCacheEntry * mostRecentlyUsed;
+    SUSoundEffectCacheEntry * leastRecentlyUsed;
+    
+    SUSoundEffectCacheStatistics statistics;
+};
+
+#pragma mark -
+#pragma mark Entries
+
+static inline size_t bucketIndex( dev_t device, ino_t inode ) {
+    
+    const UInt64 hash = ( (UInt64)inode * 0x9E3779B97F4A7C15ULL ) ^ (UInt64)device;
+    return (size_t)( hash >> 58 ) % SU_SOUND_EFFECT_CACHE_NUMBER_OF_BUCKETS;
+}
+
+static inline size_t dataBucketIndex( SUSoundEffectData data ) {
+    
+    const UInt64 hash = (UInt64)(uintptr_t)data * 0x9E3779B97F4A7C15ULL;
+    return (size_t)( hash >> 58 ) % SU_SOUND_EFFECT_CACHE_NUMBER_OF_BUCKETS;
+}
+
+static SUSoundEffectCacheEntry * findEntry( SUSoundEffectCache cache, dev_t device, ino_t inode ) {
+    
+    SUSoundEffectCacheEntry * entry = cache->buckets[ bucketIndex( device, inode ) ];
+    
+    while( ( NULL != entry ) && ( ( entry->device != device ) || ( entry->inode != inode ) ) )
+    {
+        entry = entry->nextInBucket;
+    }
+    
+    return entry;
+}
+
+static void unlinkFromRecentlyUsedList( SUSoundEffectCache cache, SUSoundEffectCacheEntry * entry ) {
+    
+    if( NULL != entry->moreRecentlyUsed )
+        entry->moreRecentlyUsed->lessRecentlyUsed = entry->lessRecentlyUsed;
+    else
+        cache->mostRecentlyUsed = entry->lessRecentlyUsed;
+    
+    if( NULL != entry->lessRecentlyUsed )
+        entry->lessRecentlyUsed->moreRecentlyUsed = entry->moreRecentlyUsed;
+    else
+        cache->leastRecentlyUsed = entry->moreRecentlyUsed;
+    
+    entry->moreRecentlyUsed = NULL;
+    entry->lessRecentlyUsed = NULL;
+}
+
+static void markMostRecentlyUsed( SUSoundEffectCache cache, SUSoundEffectCacheEntry * entry ) {
+    
+    if( cache->mostRecentlyUsed == entry )
+        return;
+    
+    if( ( NULL != entry->moreRecentlyUsed ) || ( cache->leastRecentlyUsed == entry ) )
+    {
+        unlinkFromRecentlyUsedList( cache, entry );
+    }
+    
+    entry->lessRecentlyUsed = cache->mostRecentlyUsed;
+    
+    if( NULL != cache->mostRecentlyUsed )
+        cache->mostRecentlyUsed->moreRecentlyUsed = entry;
+    else
+        cache->leastRecentlyUsed = entry;
+    
+    cache->mostRecentlyUsed = entry;
+}
+
+/** Returns a loaded entry which holds the given audio data, or NULL. The cache must be locked. */
+
+static SUSoundEffectCacheEntry * findEntryWithData( SUSoundEffectCache cache, SUSoundEffectData data ) {
+    
+    SUSoundEffectCacheEntry * entry = cache->dataBuckets[ dataBucketIndex( data ) ];
+    
+    while( ( NULL != entry ) && ( entry->data != data ) )
+    {
+        entry = entry->nextInDataBucket;
+    }
+    
+    return entry;
+}
+
+static void unlinkFromDataBucket( SUSoundEffectCache cache, SUSoundEffectCacheEntry * entry ) {
+    
+    SUSoundEffectCacheEntry ** link = &( cache->dataBuckets[ dataBucketIndex( entry->data ) ] );
+    
+    while( *link != entry )
+    {
+        link = &( (*link)->nextInDataBucket );
+    }
+    *link = entry->nextInDataBucket;
+}
+
+/** Removes an entry from the cache and releases its audio data. The cache must be locked. */
+
+static void removeEntry( SUSoundEffectCache cache, SUSoundEffectCacheEntry * entry ) {
+    
+    SUSoundEffectCacheEntry ** link = &( cache->buckets[ bucketIndex( entry->device, entry->inode ) ] );
+    
+    while( *link != entry )
+    {
+        link = &( (*link)->nextInBucket );
+    }
+    *link = entry->nextInBucket;
+    
+    if( false == entry->loading )
+    {
+        unlinkFromRecentlyUsedList( cache, entry );
+        unlinkFromDataBucket( cache, entry );
+        
+        // If another entry shares the audio data, it stays resident and that entry takes over its cost.
+        
+        SUSoundEffectCacheEntry * sharingEntry = findEntryWithData( cache, entry->data );
+        
+        if( NULL != sharingEntry )
+            sharingEntry->cost += entry->cost;
+        else
+            cache->statistics.residentBytes -= entry->cost;
+    }
+    
+    cache->statistics.numberOfEntries--;
+    
+    freeAudioData( entry->data );
+    free( entry );
+}
+
+/** Evicts least-recently-used entries until the cache is within its budget. The cache must be locked. */
+
+static void evictEntriesToFitBudget( SUSoundEffectCache cache ) {
+    
+    while( ( cache->statistics.residentBytes > cache->statistics.byteBudget ) && ( NULL != cache->leastRecentlyUsed ) )
+    {
+        removeEntry( cache, cache->leastRecentlyUsed );
+        cache->statistics.evictions++;
+    }
+}
+
+#pragma mark -
+#pragma mark Creating and Freeing Caches
+
+SUSoundEffectCache createSoundEffectCache( UInt64 byteBudget, SUAudioDataReadingOptions options ) {
+    
+    SUSoundEffectCache cache = calloc( 1, sizeof( struct _SUSoundEffectCache ) );
+    
+    if( NULL == cache )
+        return NULL;
+    
+    pthread_mutex_init( &cache->lock, NULL );
+    pthread_cond_init( &cache->loadCompleted, NULL );
+    pthread_cond_init( &cache->readsCompleted, NULL );
+    
+    cache->options               = options;
+    cache->statistics.byteBudget = byteBudget;
+    
+    return cache;
+}
+
+void freeSoundEffectCache( SUSoundEffectCache cache ) {
+    
+    if( NULL != cache )
+    {
+        // Wait for in-flight reads, which store their results in the cache when their loads complete.
+        
+        pthread_mutex_lock( &cache->lock );
+        
+        while( cache->activeReads > 0 )
+        {
+            pthread_cond_wait( &cache->readsCompleted, &cache->lock );
+        }
+        
+        pthread_mutex_unlock( &cache->lock );
+        
+        removeAllAudioDataFromCache( cache );
+        
+        pthread_cond_destroy( &cache->readsCompleted );
+        pthread_cond_destroy( &cache->loadCompleted );
+        pthread_mutex_destroy( &cache->lock );
+        
+        free( cache );
+    }
+}
+
+static SUSoundEffectCache _sharedSoundEffectCache;
+
+static void createSharedSoundEffectCache( void ) {
+    
+    _sharedSoundEffectCache = createSoundEffectCache( SU_SHARED_SOUND_EFFECT_CACHE_BYTE_BUDGET, SUAudioDataReadingOptionsNone );
+}
+
+SUSoundEffectCache sharedSoundEffectCache( void ) {
+    
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once( &once, createSharedSoundEffectCache );
+    
+    return _sharedSoundEffectCache;
+}
+
+#pragma mark -
+#pragma mark Reading Audio Data
+
+/** Ends a read which began by locking the cache, and unlocks it. */
+
+static void endRead( SUSoundEffectCache cache ) {
+    
+    if( 0 == --cache->activeReads )
+        pthread_cond_broadcast( &cache->readsCompleted );
+    
+    pthread_mutex_unlock( &cache->lock );
+}
+
+SUSoundEffectData readAudioDataFromCache( SUSoundEffectCache cache, CFURLRef fileURL ) {
+    
+    if( ( NULL == cache ) || ( NULL == fileURL ) )
+        return NULL;
+    
+    // Identify the file
+    
+    UInt8 path[ PATH_MAX ];
+    struct stat fileInfo;
+    
+    if( false == CFURLGetFileSystemRepresentation( fileURL, true, path, sizeof( path ) ) )
+        return NULL;
+    
+    if( 0 != stat( (const char *)path, &fileInfo ) )
+        return NULL;
+    
+    pthread_mutex_lock( &cache->lock );
+    cache->activeReads++;
+    
+    SUSoundEffectCacheEntry * entry;
+    
+    while( NULL != ( entry = findEntry( cache, fileInfo.st_dev, fileInfo.st_ino ) ) )
+    {
+        // Wait for another thread's load of this file to complete.
+        
+        if( entry->loading )
+        {
+            pthread_cond_wait( &cache->loadCompleted, &cache->lock );
+            continue;
+        }
+        
+        // The file has been replaced since it was cached.
+        
+        if( ( entry->fileSize != fileInfo.st_size ) || ( entry->modificationTime != fileInfo.st_mtime ) )
+        {
+            removeEntry( cache, entry );
+            continue;
+        }
+        
+        // Cache hit
+        
+        cache->statistics.hits++;
+        markMostRecentlyUsed( cache, entry );
+        
+        SUSoundEffectData data = retainAudioData( entry->data );
+        
+        endRead( cache );
+        
+        return data;
+    }
+    
+    // Cache miss. Insert a placeholder so concurrent requests for this file wait for this load.
+    
+    cache->statistics.misses++;
+    
+    entry = calloc( 1, sizeof( SUSoundEffectCacheEntry ) );
+    
+    if( NULL == entry )
+    {
+        endRead( cache );
+        return NULL;
+    }
+    
+    entry->device           = fileInfo.st_dev;
+    entry->inode            = fileInfo.st_ino;
+    entry->fileSize         = fileInfo.st_size;
+    entry->modificationTime = fileInfo.st_mtime;
+    entry->loading          = true;
+    
+    const size_t bucket            = bucketIndex( entry->device, entry->inode );
+    entry->nextInBucket            = cache->buckets[ bucket ];
+    cache->buckets[ bucket ]       = entry;
+    cache->statistics.numberOfEntries++;
+    
+    pthread_mutex_unlock( &cache->lock );
+    
+    SUSoundEffectData data = readAudioDataFromURL( fileURL, cache->options );
+    
+    pthread_mutex_lock( &cache->lock );
+    
+    if( NULL != data )
+    {
+        entry->data    = retainAudioData( data );
+        entry->cost    = ( NULL != findEntryWithData( cache, data ) ) ? 0 : audioDataResidentSize( data );
+        entry->loading = false;
+        
+        const size_t dataBucket          = dataBucketIndex( data );
+        entry->nextInDataBucket          = cache->dataBuckets[ dataBucket ];
+        cache->dataBuckets[ dataBucket ] = entry;
+        
+        cache->statistics.residentBytes += entry->cost;
+        markMostRecentlyUsed( cache, entry );
+        
+        evictEntriesToFitBudget( cache );
+    }
+    else
+    {
+        removeEntry( cache, entry );
+    }
+    
+    pthread_cond_broadcast( &cache->loadCompleted );
+    endRead( cache );
+    
+    return data;
+}
+
+void removeAllAudioDataFromCache( SUSoundEffectCache cache ) {
+    
+    pthread_mutex_lock( &cache->lock );
+    
+    // Entries which are still loading are left for their loading thread to complete.
+    
+    while( NULL != cache->leastRecentlyUsed )
+    {
+        removeEntry( cache, cache->leastRecentlyUsed );
+    }
+    
+    pthread_mutex_unlock( &cache->lock );
+}
+
+#pragma mark -
+#pragma mark Sizing the Cache
+
+void setSoundEffectCacheByteBudget( SUSoundEffectCache cache, UInt64 byteBudget ) {
+    
+    pthread_mutex_lock( &cache->lock );
+    
+    cache->statistics.byteBudget = byteBudget;
+    evictEntriesToFitBudget( cache );
+    
+    pthread_mutex_unlock( &cache->lock );
+}
+
+SUSoundEffectCacheStatistics soundEffectCacheStatistics( SUSoundEffectCache cache ) {
+    
+    pthread_mutex_lock( &cache->lock );
+    
+    const SUSoundEffectCacheStatistics statistics = cache->statistics;
+    
+    pthread_mutex_unlock( &cache->lock );
+    
+    return statistics;
+}
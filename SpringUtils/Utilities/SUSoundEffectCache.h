@@ -0,0 +1,102 @@
+//
+//  SUSoundEffectCache.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUSoundEffectCache_h
+#define SpringUtils_SUSoundEffectCache_h
+
+#import "SUSoundTools.h"
+
+/** A thread-safe cache of loaded audio data, keyed by file identity (device and inode).
+ *
+ *  The cache keeps its entries resident within a byte budget, evicting the least-recently-used entries when the budget is exceeded.
+ *  Evicting an entry only releases the cache's reference; audio data which is still in use stays alive until its last reference is released.
+ *  Concurrent requests for the same file are coalesced, so each file is only read once.
+ */
+
+typedef struct _SUSoundEffectCache *SUSoundEffectCache;
+
+/** Counters describing the effectiveness of a cache. */
+
+typedef struct _SUSoundEffectCacheStatistics {
+    
+    UInt64 hits;                /**< The number of requests which were served from the cache, or by another thread's in-flight load. */
+    UInt64 misses;              /**< The number of requests which read the file. */
+    UInt64 evictions;           /**< The number of entries evicted to stay within the byte budget. */
+    
+    UInt64 numberOfEntries;     /**< The number of entries currently in the cache. */
+    UInt64 residentBytes;       /**< The number of bytes used by the cache's entries. See audioDataResidentSize(). Audio data shared by several entries is counted once. */
+    UInt64 byteBudget;          /**< The maximum number of bytes the cache keeps resident. */
+    
+} SUSoundEffectCacheStatistics;
+
+
+//----------------------------------/
+/** @name Creating and Freeing Caches */
+//----------------------------------/
+
+
+/** Creates a new sound effect cache.
+ *
+ *  @param  byteBudget  The maximum number of bytes the cache keeps resident.
+ *  @param  options     The options used to read audio data in to the cache.
+ *
+ *  @returns            A new cache, or NULL if it could not be created. You must release this value by calling freeSoundEffectCache().
+ */
+
+SU_EXTERN SUSoundEffectCache createSoundEffectCache( UInt64 byteBudget, SUAudioDataReadingOptions options );
+
+/** Releases a sound effect cache and its references to its entries. If other threads are reading audio data from the cache,
+ *  this function waits for them to return.
+ *
+ *  @param  cache   The cache to release. After calling this function, you should no longer use the cache.
+ */
+
+SU_EXTERN void freeSoundEffectCache( SUSoundEffectCache cache );
+
+/** Returns the shared sound effect cache, which has a byte budget of 16MB and reads audio data with no options. */
+
+SU_EXTERN SUSoundEffectCache sharedSoundEffectCache( void );
+
+
+//-----------------------------/
+/** @name Reading Audio Data */
+//-----------------------------/
+
+
+/** Returns the audio data of the file at the given URL, reading the file if it isn't already cached.
+ *
+ *  @param  cache       The cache.
+ *  @param  fileURL     The file URL of the audio file to read.
+ *
+ *  @returns            The file's audio data, or NULL if the file couldn't be read.
+ *                      You must release this value by calling freeAudioData().
+ */
+
+SU_EXTERN SUSoundEffectData readAudioDataFromCache( SUSoundEffectCache cache, CFURLRef fileURL );
+
+/** Releases the cache's references to all of its entries. */
+
+SU_EXTERN void removeAllAudioDataFromCache( SUSoundEffectCache cache );
+
+
+//----------------------------/
+/** @name Sizing the Cache */
+//----------------------------/
+
+
+/** Changes the maximum number of bytes the cache keeps resident, evicting entries if necessary. */
+
+SU_EXTERN void setSoundEffectCacheByteBudget( SUSoundEffectCache cache, UInt64 byteBudget );
+
+/** Returns the cache's counters. */
+
+SU_EXTERN SUSoundEffectCacheStatistics soundEffectCacheStatistics( SUSoundEffectCache cache );
+
+#endif
@@ -0,0 +1,430 @@
+//
+//  SUSoundInstrumentation.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundInstrumentation.h"
+#import "SUSoundInstrumentation_Private.h"
+
+#import <string.h>
+
+#if defined( SUSOUNDTOOLS_INSTRUMENTATION )
+
+#import <stdlib.h>
+#import <pthread.h>
+
+#if defined( __APPLE__ )
+    #import <mach/mach_time.h>
+#else
+    #import <time.h>
+#endif
+
+static SUSoundInstrumentationStatistics gStatistics;
+
+static pthread_key_t gScopeKey;
+static bool          gScopeKeyCreated;
+
+#if defined( __APPLE__ )
+static mach_timebase_info_data_t gTimebase;
+#endif
+
+__attribute__((constructor)) static void initializeSoundInstrumentation( void ) {
+
+#if defined( __APPLE__ )
+    mach_timebase_info( &gTimebase );
+#endif
+
+    // Interposed functions check for a scope, so they must not read the key until it exists.
+
+    if( 0 == pthread_key_create( &gScopeKey, NULL ) )
+        __atomic_store_n( &gScopeKeyCreated, true, __ATOMIC_RELEASE );
+}
+
+#pragma mark -
+#pragma mark Timing
+
+static inline UInt64 currentTime( void ) {
+
+#if defined( __APPLE__ )
+    return mach_absolute_time();
+#else
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( (UInt64)now.tv_sec * 1000000000ull ) + (UInt64)now.tv_nsec;
+#endif
+}
+
+static inline UInt64 nanosecondsFromTime( UInt64 time ) {
+
+#if defined( __APPLE__ )
+    return ( time * gTimebase.numer ) / gTimebase.denom;
+#else
+    return time;
+#endif
+}
+
+static inline UInt32 durationBucket( UInt64 nanoseconds ) {
+
+    const UInt64 microseconds = nanoseconds / 1000;
+
+    if( 0 == microseconds )
+        return 0;
+
+    const UInt32 bucket = (UInt32)( 64 - __builtin_clzll( microseconds ) );
+    return ( bucket < kSUSoundInstrumentationDurationBuckets ) ? bucket : ( kSUSoundInstrumentationDurationBuckets - 1 );
+}
+
+#pragma mark -
+#pragma mark Recording Fills
+
+void beginSoundInstrumentationScope( SUSoundInstrumentationScope * scope ) {
+
+    scope->numberOfViolations = 0;
+    scope->outermost          = false;
+
+    if( false == __atomic_load_n( &gScopeKeyCreated, __ATOMIC_ACQUIRE ) )
+        return;
+
+    if( NULL != pthread_getspecific( gScopeKey ) )
+        return;
+
+    pthread_setspecific( gScopeKey, scope );
+
+    scope->outermost = true;
+    scope->startTime = currentTime();
+}
+
+void endSoundInstrumentationScope( SUSoundInstrumentationScope * scope, UInt32 numberOfBytes, UInt32 numberOfPackets, Float64 audioDuration ) {
+
+    if( false == scope->outermost )
+        return;
+
+    const UInt64 duration = nanosecondsFromTime( currentTime() - scope->startTime );
+
+    pthread_setspecific( gScopeKey, NULL );
+
+    // ===================
+    //
+    // 1. Totals
+    //
+    // ===================
+
+    __atomic_fetch_add( &gStatistics.numberOfFills,   1,               __ATOMIC_RELAXED );
+    __atomic_fetch_add( &gStatistics.numberOfBytes,   numberOfBytes,   __ATOMIC_RELAXED );
+    __atomic_fetch_add( &gStatistics.numberOfPackets, numberOfPackets, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &gStatistics.totalDuration,   duration,        __ATOMIC_RELAXED );
+
+    UInt64 maximumDuration = __atomic_load_n( &gStatistics.maximumDuration, __ATOMIC_RELAXED );
+
+    while( duration > maximumDuration )
+    {
+        if( __atomic_compare_exchange_n( &gStatistics.maximumDuration, &maximumDuration, duration, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+            break;
+    }
+
+    // ===================
+    //
+    // 2. Histograms
+    //
+    // ===================
+
+    __atomic_fetch_add( &gStatistics.durationHistogram[ durationBucket( duration ) ], 1, __ATOMIC_RELAXED );
+
+    if( audioDuration > 0 )
+    {
+        const Float64 deadlineFraction = ( (Float64)duration / 1e9 ) / audioDuration;
+        const UInt32  bucket           = ( deadlineFraction < 1 ) ? (UInt32)( deadlineFraction * 10 ) : ( kSUSoundInstrumentationDeadlineBuckets - 1 );
+
+        __atomic_fetch_add( &gStatistics.deadlineHistogram[ bucket ], 1, __ATOMIC_RELAXED );
+    }
+
+    // ===================
+    //
+    // 3. Violations
+    //
+    // ===================
+
+    if( scope->numberOfViolations > 0 )
+        __atomic_fetch_add( &gStatistics.numberOfViolatingFills, 1, __ATOMIC_RELAXED );
+}
+
+Float64 soundBufferPlaybackDuration( const SUSoundBuffer * buffer, const AudioStreamBasicDescription * format ) {
+
+    if( format->mSampleRate <= 0 )
+        return 0;
+
+    UInt64 numberOfFrames = 0;
+
+    if( format->mBytesPerPacket > 0 )
+    {
+        numberOfFrames = (UInt64)( buffer->audioDataByteSize / format->mBytesPerPacket ) * format->mFramesPerPacket;
+    }
+    else if( format->mFramesPerPacket > 0 )
+    {
+        numberOfFrames = (UInt64)buffer->packetDescriptionCount * format->mFramesPerPacket;
+    }
+    else
+    {
+        for( UInt32 i = 0; i < buffer->packetDescriptionCount; i++ )
+            numberOfFrames += buffer->packetDescriptions[ i ].mVariableFramesInPacket;
+    }
+
+    return ( numberOfFrames / format->mSampleRate );
+}
+
+#pragma mark -
+#pragma mark Recording Violations
+
+void noteSoundInstrumentationViolation( SUSoundInstrumentationViolation violation ) {
+
+    if( false == __atomic_load_n( &gScopeKeyCreated, __ATOMIC_ACQUIRE ) )
+        return;
+
+    SUSoundInstrumentationScope * scope = pthread_getspecific( gScopeKey );
+
+    if( NULL == scope )
+        return;
+
+    scope->numberOfViolations++;
+
+    if( SUSoundInstrumentationViolationAllocation == violation )
+        __atomic_fetch_add( &gStatistics.numberOfAllocations, 1, __ATOMIC_RELAXED );
+    else
+        __atomic_fetch_add( &gStatistics.numberOfLocks, 1, __ATOMIC_RELAXED );
+}
+
+// Interposed allocation and locking functions. Each records a violation, then calls the original function.
+// These functions must not allocate or lock, or they will recurse.
+
+#if defined( __APPLE__ )
+
+    // dyld replaces calls to `replacee` in every other image with calls to `replacement`.
+    // Calls from within this image still reach the original functions, so SpringUtils' own sources use SU_MALLOC() and SU_LOCK().
+
+    #define SU_INTERPOSE( replacement, replacee )                                                                   \
+        __attribute__((used)) static const struct { const void * replacement; const void * replacee; }             \
+        interpose_##replacee __attribute__(( section( "__DATA,__interpose" ) )) = {                                 \
+            (const void *)(uintptr_t)&replacement, (const void *)(uintptr_t)&replacee                               \
+        };
+
+    static void * instrumentedMalloc( size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return malloc( size );
+    }
+
+    static void * instrumentedCalloc( size_t count, size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return calloc( count, size );
+    }
+
+    static void * instrumentedRealloc( void * ptr, size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return realloc( ptr, size );
+    }
+
+    static void instrumentedFree( void * ptr ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        free( ptr );
+    }
+
+    static int instrumentedPosixMemalign( void ** memptr, size_t alignment, size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return posix_memalign( memptr, alignment, size );
+    }
+
+    static void * instrumentedValloc( size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return valloc( size );
+    }
+
+    static int instrumentedMutexLock( pthread_mutex_t * mutex ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationLock );
+        return pthread_mutex_lock( mutex );
+    }
+
+    static int instrumentedReadLock( pthread_rwlock_t * lock ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationLock );
+        return pthread_rwlock_rdlock( lock );
+    }
+
+    static int instrumentedWriteLock( pthread_rwlock_t * lock ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationLock );
+        return pthread_rwlock_wrlock( lock );
+    }
+
+    SU_INTERPOSE( instrumentedMalloc,    malloc )
+    SU_INTERPOSE( instrumentedCalloc,    calloc )
+    SU_INTERPOSE( instrumentedRealloc,          realloc )
+    SU_INTERPOSE( instrumentedFree,             free )
+    SU_INTERPOSE( instrumentedPosixMemalign,    posix_memalign )
+    SU_INTERPOSE( instrumentedValloc,           valloc )
+    SU_INTERPOSE( instrumentedMutexLock,        pthread_mutex_lock )
+    SU_INTERPOSE( instrumentedReadLock,         pthread_rwlock_rdlock )
+    SU_INTERPOSE( instrumentedWriteLock,        pthread_rwlock_wrlock )
+
+#elif defined( __GLIBC__ )
+
+    // Definitions in the executable take precedence over glibc's. The allocation functions remain available under their
+    // internal names; the lock functions are looked up with dlsym(), which does not take any of the locks it interposes.
+
+    #import <dlfcn.h>
+    #import <errno.h>
+
+    extern void * __libc_malloc( size_t size );
+    extern void * __libc_calloc( size_t count, size_t size );
+    extern void * __libc_realloc( void * ptr, size_t size );
+    extern void   __libc_free( void * ptr );
+    extern void * __libc_memalign( size_t alignment, size_t size );
+    extern void * __libc_valloc( size_t size );
+    extern void * __libc_pvalloc( size_t size );
+
+    typedef int (*SUMutexLockFunction)( pthread_mutex_t * mutex );
+    typedef int (*SURWLockFunction)( pthread_rwlock_t * lock );
+
+    static void * gMutexLock;
+    static void * gReadLock;
+    static void * gWriteLock;
+
+    static void * originalFunction( void ** function, const char * name ) {
+        if( NULL == *function )
+            *function = dlsym( RTLD_NEXT, name );
+        return *function;
+    }
+
+    void * malloc( size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return __libc_malloc( size );
+    }
+
+    void * calloc( size_t count, size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return __libc_calloc( count, size );
+    }
+
+    void * realloc( void * ptr, size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return __libc_realloc( ptr, size );
+    }
+
+    void free( void * ptr ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        __libc_free( ptr );
+    }
+
+    // glibc implements each of the aligned allocation functions with memalign.
+
+    void * memalign( size_t alignment, size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return __libc_memalign( alignment, size );
+    }
+
+    void * aligned_alloc( size_t alignment, size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return __libc_memalign( alignment, size );
+    }
+
+    int posix_memalign( void ** memptr, size_t alignment, size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+
+        if( ( 0 != ( alignment % sizeof( void * ) ) ) || ( 0 != ( alignment & ( alignment - 1 ) ) ) || ( 0 == alignment ) )
+            return EINVAL;
+
+        void * memory = __libc_memalign( alignment, size );
+
+        if( NULL == memory )
+            return ENOMEM;
+
+        *memptr = memory;
+        return 0;
+    }
+
+    void * valloc( size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return __libc_valloc( size );
+    }
+
+    void * pvalloc( size_t size ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation );
+        return __libc_pvalloc( size );
+    }
+
+    int pthread_mutex_lock( pthread_mutex_t * mutex ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationLock );
+        return ( (SUMutexLockFunction)originalFunction( &gMutexLock, "pthread_mutex_lock" ) )( mutex );
+    }
+
+    int pthread_rwlock_rdlock( pthread_rwlock_t * lock ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationLock );
+        return ( (SURWLockFunction)originalFunction( &gReadLock, "pthread_rwlock_rdlock" ) )( lock );
+    }
+
+    int pthread_rwlock_wrlock( pthread_rwlock_t * lock ) {
+        noteSoundInstrumentationViolation( SUSoundInstrumentationViolationLock );
+        return ( (SURWLockFunction)originalFunction( &gWriteLock, "pthread_rwlock_wrlock" ) )( lock );
+    }
+
+#endif
+
+#pragma mark -
+#pragma mark Reading Statistics
+
+bool soundInstrumentationIsEnabled( void ) {
+
+    return true;
+}
+
+SUSoundInstrumentationStatistics soundInstrumentationStatistics( void ) {
+
+    SUSoundInstrumentationStatistics snapshot;
+
+    // The statistics are all UInt64 counters; read each one atomically.
+
+    const UInt64 * counters = (const UInt64 *)&gStatistics;
+    UInt64 * snapshotCounters = (UInt64 *)&snapshot;
+
+    for( size_t i = 0; i < ( sizeof( SUSoundInstrumentationStatistics ) / sizeof( UInt64 ) ); i++ )
+        snapshotCounters[ i ] = __atomic_load_n( &counters[ i ], __ATOMIC_RELAXED );
+
+    return snapshot;
+}
+
+void resetSoundInstrumentationStatistics( void ) {
+
+    UInt64 * counters = (UInt64 *)&gStatistics;
+
+    for( size_t i = 0; i < ( sizeof( SUSoundInstrumentationStatistics ) / sizeof( UInt64 ) ); i++ )
+        __atomic_store_n( &counters[ i ], 0, __ATOMIC_RELAXED );
+}
+
+#else
+
+#pragma mark -
+#pragma mark Reading Statistics
+
+bool soundInstrumentationIsEnabled( void ) {
+
+    return false;
+}
+
+SUSoundInstrumentationStatistics soundInstrumentationStatistics( void ) {
+
+    SUSoundInstrumentationStatistics snapshot;
+    memset( &snapshot, 0, sizeof( snapshot ) );
+
+    return snapshot;
+}
+
+void resetSoundInstrumentationStatistics( void ) {
+}
+
+void noteSoundInstrumentationViolation( SUSoundInstrumentationViolation violation ) {
+
+    (void)violation;
+}
+
+#endif
@@ -0,0 +1,115 @@
+//
+//  SUSoundInstrumentation.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUSoundInstrumentation_h
+#define SpringUtils_SUSoundInstrumentation_h
+
+#import "SUSoundCore.h"
+
+/** Real-time instrumentation of the buffer-filling functions.
+ *
+ *  When SpringUtils is built with SUSOUNDTOOLS_INSTRUMENTATION defined, every call to fillBufferFromAudioFile(),
+ *  fillSoundBufferFromAudioData() and fillSoundBufferFromPlan() (and their AudioQueue adapters) is timed, and the time it took,
+ *  the bytes and packets it delivered, and how much of its deadline it used are recorded in a set of lock-free histograms.
+ *  A fill's deadline is the playback duration of the audio it delivered, which is the longest it may take before the audio
+ *  device runs dry.
+ *
+ *  While a fill is in progress, its thread is treated as a real-time thread: calls to the allocator and lock functions made on
+ *  that thread are counted, and the fill is flagged as a violation. These functions are replaced only in instrumented builds:
+ *
+ *  - On Apple platforms, malloc(), calloc(), realloc(), free(), posix_memalign(), valloc(), pthread_mutex_lock(),
+ *    pthread_rwlock_rdlock() and pthread_rwlock_wrlock() are interposed with dyld. Interposing does not reach calls made from
+ *    within SpringUtils itself, so SpringUtils notes its own calls to malloc(), calloc(), realloc() and pthread_mutex_lock().
+ *  - With glibc, the same functions, and also memalign(), aligned_alloc() and pvalloc(), are overridden, which counts calls
+ *    made from anywhere in the process, including SpringUtils.
+ *  - Other platforms count only the violations reported with noteSoundInstrumentationViolation().
+ *
+ *  Recording is wait-free and does not allocate, so it is safe to use from an audio callback. Statistics can be read at
+ *  any time from another thread.
+ *
+ *  In ordinary builds the fill functions are not instrumented, and the statistics are always zero.
+ */
+
+/** The number of buckets in the fill duration histogram. */
+
+#define kSUSoundInstrumentationDurationBuckets   16
+
+/** The number of buckets in the deadline histogram. */
+
+#define kSUSoundInstrumentationDeadlineBuckets   11
+
+/** The kinds of real-time violation which can be recorded. */
+
+typedef enum SUSoundInstrumentationViolation {
+    SUSoundInstrumentationViolationAllocation,      /**< Memory was allocated, reallocated or freed. */
+    SUSoundInstrumentationViolationLock,            /**< A lock was taken, or waited for. */
+} SUSoundInstrumentationViolation;
+
+/** A snapshot of the fill statistics. */
+
+typedef struct _SUSoundInstrumentationStatistics {
+
+    UInt64 numberOfFills;               /**< The number of buffers filled. */
+    UInt64 numberOfBytes;               /**< The number of audio bytes delivered. */
+    UInt64 numberOfPackets;             /**< The number of packet descriptions delivered. */
+
+    UInt64 totalDuration;               /**< The total time (in nanoseconds) spent filling buffers. */
+    UInt64 maximumDuration;             /**< The time (in nanoseconds) taken by the slowest fill. */
+
+    /** Fill durations. Bucket 0 counts fills which took less than 1 microsecond, bucket `i` counts fills which took
+     *  between 2^(i-1) and 2^i microseconds, and the last bucket counts every slower fill. */
+
+    UInt64 durationHistogram[ kSUSoundInstrumentationDurationBuckets ];
+
+    /** The fraction of its deadline each fill used, in steps of 10%. The last bucket counts fills which missed their
+     *  deadline. Fills whose deadline is unknown (file fills, and fills which delivered no audio) are not counted. */
+
+    UInt64 deadlineHistogram[ kSUSoundInstrumentationDeadlineBuckets ];
+
+    UInt64 numberOfAllocations;         /**< The number of calls to the allocator (including frees) made during fills. */
+    UInt64 numberOfLocks;               /**< The number of locks taken during fills. */
+    UInt64 numberOfViolatingFills;      /**< The number of fills which called the allocator or took a lock. */
+
+} SUSoundInstrumentationStatistics;
+
+
+//-----------------------------/
+/** @name Reading Statistics */
+//-----------------------------/
+
+
+/** Returns true if SpringUtils was built with SUSOUNDTOOLS_INSTRUMENTATION defined. */
+
+SU_EXTERN bool soundInstrumentationIsEnabled( void );
+
+/** Returns a snapshot of the fill statistics. Call this function from a thread which is not filling buffers.
+ *
+ *  Each counter is read atomically, but fills which complete while the snapshot is being taken may be partly included.
+ */
+
+SU_EXTERN SUSoundInstrumentationStatistics soundInstrumentationStatistics( void );
+
+/** Resets the fill statistics to zero. Fills which are in progress may be partly recorded in the new statistics. */
+
+SU_EXTERN void resetSoundInstrumentationStatistics( void );
+
+
+//-------------------------------/
+/** @name Recording Violations */
+//-------------------------------/
+
+
+/** Records a real-time violation if the calling thread is filling a buffer. Use this to report allocations or locks which
+ *  are not made through the interposed functions (e.g. a custom allocator). Does nothing in ordinary builds.
+ */
+
+SU_EXTERN void noteSoundInstrumentationViolation( SUSoundInstrumentationViolation violation );
+
+#endif
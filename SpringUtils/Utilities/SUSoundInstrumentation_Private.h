@@ -0,0 +1,70 @@
+//
+//  SUSoundInstrumentation_Private.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundInstrumentation.h"
+
+// Hooks for the instrumented fill functions. In ordinary builds, the hooks (and their arguments) compile to nothing.
+
+#if defined( SUSOUNDTOOLS_INSTRUMENTATION )
+
+/** An instrumented fill in progress. Fills may be nested (e.g. a plan fill which falls back to a data fill); only the outermost is recorded. */
+
+typedef struct _SUSoundInstrumentationScope {
+
+    UInt64 startTime;               /**< The time at which the fill began, in clock ticks. */
+    UInt32 numberOfViolations;      /**< The number of allocations and locks made during the fill. */
+    bool   outermost;               /**< Whether this is the outermost fill on its thread. */
+
+} SUSoundInstrumentationScope;
+
+/** Marks the calling thread as a real-time thread and starts timing the fill. */
+
+SU_EXTERN void beginSoundInstrumentationScope( SUSoundInstrumentationScope * scope );
+
+/** Stops timing the fill and records it. An `audioDuration` of 0 means that the fill's deadline is unknown. */
+
+SU_EXTERN void endSoundInstrumentationScope( SUSoundInstrumentationScope * scope, UInt32 numberOfBytes, UInt32 numberOfPackets, Float64 audioDuration );
+
+/** Returns the playback duration (in seconds) of a filled buffer of audio in the given format, or 0 if it cannot be determined. */
+
+SU_EXTERN Float64 soundBufferPlaybackDuration( const SUSoundBuffer * buffer, const AudioStreamBasicDescription * format );
+
+    #define SU_SOUND_INSTRUMENTATION_BEGIN( scope )                                 \
+        SUSoundInstrumentationScope scope;                                          \
+        beginSoundInstrumentationScope( &scope )
+
+    #define SU_SOUND_INSTRUMENTATION_END( scope, bytes, packets, audioDuration )   \
+        endSoundInstrumentationScope( &scope, bytes, packets, audioDuration )
+
+#else
+
+    #define SU_SOUND_INSTRUMENTATION_BEGIN( scope )
+    #define SU_SOUND_INSTRUMENTATION_END( scope, bytes, packets, audioDuration )
+
+#endif
+
+// Allocation and locking in SpringUtils' own sources. dyld interposing does not reach calls made from within the image which
+// interposes them, so on Apple platforms these calls note their own violations. Elsewhere the overridden functions count them.
+
+#if defined( SUSOUNDTOOLS_INSTRUMENTATION ) && defined( __APPLE__ )
+
+    #define SU_MALLOC( size )           ( noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation ), malloc( size ) )
+    #define SU_CALLOC( count, size )    ( noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation ), calloc( count, size ) )
+    #define SU_REALLOC( ptr, size )     ( noteSoundInstrumentationViolation( SUSoundInstrumentationViolationAllocation ), realloc( ptr, size ) )
+    #define SU_LOCK( mutex )            ( noteSoundInstrumentationViolation( SUSoundInstrumentationViolationLock ), pthread_mutex_lock( mutex ) )
+
+#else
+
+    #define SU_MALLOC( size )           malloc( size )
+    #define SU_CALLOC( count, size )    calloc( count, size )
+    #define SU_REALLOC( ptr, size )     realloc( ptr, size )
+    #define SU_LOCK( mutex )            pthread_mutex_lock( mutex )
+
+#endif
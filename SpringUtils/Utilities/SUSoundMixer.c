@@ -0,0 +1,775 @@
+//
+//  SUSoundMixer.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundMixer.h"
+#import "SUSoundMixer_Private.h"
+#import "SUPCMConversion_Private.h"
+#import "SUSoundCore_Private.h"
+
+#import <math.h>
+
+#if defined( __SSE2__ )
+    #import <emmintrin.h>
+    #define SU_MIXER_SSE2 1
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+    #import <arm_neon.h>
+    #define SU_MIXER_NEON 1
+#endif
+
+// The vector and scalar kernels must produce bit-identical results, so both perform exactly the same sequence of
+// single-precision multiplies and adds, and floating-point contraction (e.g. in to FMAs) is disabled.
+
+#pragma STDC FP_CONTRACT OFF
+
+/** The smallest number of triggers the trigger queue can hold. */
+
+#define kSUSoundMixerMinimumTriggerQueueCapacity    64
+
+/** The largest number of triggers the trigger queue can hold. */
+
+#define kSUSoundMixerMaximumTriggerQueueCapacity    ( 1U << 20 )
+
+typedef enum _SUSoundMixerSourceFormat {
+    
+    SUSoundMixerSourceFormatUnsupported = 0,
+    SUSoundMixerSourceFormatInt16,
+    SUSoundMixerSourceFormatFloat32,
+    
+} SUSoundMixerSourceFormat;
+
+typedef struct _SUSoundMixerVoice {
+    
+    SUSoundEffectData audioData;
+    SUSoundMixerSourceFormat sourceFormat;
+    UInt32 numberOfChannels;
+    
+    UInt64 frameCursor;
+    UInt64 numberOfFrames;
+    UInt64 startDelay;              /**< The number of frames to mix before the voice starts, if it was triggered. */
+    
+    float gain;
+    float pan;
+    
+    bool  playing;
+    
+} SUSoundMixerVoice;
+
+/** A request to start a voice at a sample time, made by triggerSoundMixerVoice(). */
+
+typedef struct _SUSoundMixerTrigger {
+    
+    SUSoundEffectData audioData;    /**< Retained by the producer; the reference passes to the voice. */
+    SUSoundMixerSourceFormat sourceFormat;
+    UInt64 sampleTime;
+    float gain;
+    float pan;
+    
+} SUSoundMixerTrigger;
+
+/** A slot in the trigger queue. A slot at position `p` may be written when its sequence is `p`, and read when it is `p` + 1. */
+
+typedef struct _SUSoundMixerTriggerSlot {
+    
+    UInt64 sequence;
+    SUSoundMixerTrigger trigger;
+    
+} SUSoundMixerTriggerSlot;
+
+struct _SUSoundMixer {
+    
+    Float64 sampleRate;
+    SUSoundMixerSampleFormat outputFormat;
+    
+    SUSoundMixerVoice * voices;
+    UInt32 maximumNumberOfVoices;
+    
+    float * accumulator;            /**< Interleaved stereo float samples. */
+    UInt32  maximumFramesPerBuffer;
+    
+    UInt64 sampleTime;              /**< The number of frames rendered. Written by the render thread, and read atomically by producers. */
+    
+    SUSoundMixerTriggerSlot * triggerSlots;
+    UInt32 triggerQueueCapacity;    /**< A power of two. */
+    UInt64 enqueuePosition;         /**< The next position producers will claim. Modified atomically. */
+    UInt64 dequeuePosition;         /**< The next position the render thread will read. */
+    
+    SUSoundMixerTrigger * pendingTriggers;  /**< Triggers taken from the queue whose sample time has not yet been rendered. */
+    UInt32 numberOfPendingTriggers;
+    
+    bool usesVectorKernels;
+};
+
+#pragma mark -
+#pragma mark Kernels
+
+static void mixInt16Mono( float * accumulator, const SInt16 * source, UInt32 numberOfFrames, float leftGain, float rightGain, bool vector ) {
+    
+    UInt32 i = 0;
+    
+#if SU_MIXER_SSE2
+    if( vector )
+    {
+        const __m128 left  = _mm_set1_ps( leftGain );
+        const __m128 right = _mm_set1_ps( rightGain );
+        
+        for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+        {
+            const __m128i packed  = _mm_loadl_epi64( (const __m128i *)( source + i ) );
+            const __m128  samples = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( packed, packed ), 16 ) );
+            const __m128  l       = _mm_mul_ps( samples, left );
+            const __m128  r       = _mm_mul_ps( samples, right );
+            
+            float * out = accumulator + ( 2 * i );
+            _mm_storeu_ps( out,     _mm_add_ps( _mm_loadu_ps( out ),     _mm_unpacklo_ps( l, r ) ) );
+            _mm_storeu_ps( out + 4, _mm_add_ps( _mm_loadu_ps( out + 4 ), _mm_unpackhi_ps( l, r ) ) );
+        }
+    }
+#elif SU_MIXER_NEON
+    if( vector )
+    {
+        for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+        {
+            const float32x4_t samples = vcvtq_f32_s32( vmovl_s16( vld1_s16( source + i ) ) );
+            float32x4x2_t     lr;
+            lr.val[ 0 ] = vmulq_n_f32( samples, leftGain );
+            lr.val[ 1 ] = vmulq_n_f32( samples, rightGain );
+            
+            float * out = accumulator + ( 2 * i );
+            float32x4x2_t acc = vld2q_f32( out );
+            acc.val[ 0 ] = vaddq_f32( acc.val[ 0 ], lr.val[ 0 ] );
+            acc.val[ 1 ] = vaddq_f32( acc.val[ 1 ], lr.val[ 1 ] );
+            vst2q_f32( out, acc );
+        }
+    }
+#endif
+    
+    for( ; i < numberOfFrames; i++ )
+    {
+        const float sample = (float)source[ i ];
+        const float l      = sample * leftGain;
+        const float r      = sample * rightGain;
+        
+        accumulator[ ( 2 * i ) + 0 ] += l;
+        accumulator[ ( 2 * i ) + 1 ] += r;
+    }
+}
+
+static void mixInt16Stereo( float * accumulator, const SInt16 * source, UInt32 numberOfFrames, float leftGain, float rightGain, bool vector ) {
+    
+    UInt32 i = 0;
+    
+#if SU_MIXER_SSE2
+    if( vector )
+    {
+        const __m128 gains = _mm_setr_ps( leftGain, rightGain, leftGain, rightGain );
+        
+        for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+        {
+            const __m128i packed = _mm_loadu_si128( (const __m128i *)( source + ( 2 * i ) ) );
+            const __m128  lo     = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( packed, packed ), 16 ) );
+            const __m128  hi     = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( packed, packed ), 16 ) );
+            
+            float * out = accumulator + ( 2 * i );
+            _mm_storeu_ps( out,     _mm_add_ps( _mm_loadu_ps( out ),     _mm_mul_ps( lo, gains ) ) );
+            _mm_storeu_ps( out + 4, _mm_add_ps( _mm_loadu_ps( out + 4 ), _mm_mul_ps( hi, gains ) ) );
+        }
+    }
+#elif SU_MIXER_NEON
+    if( vector )
+    {
+        const float gainValues[ 4 ] = { leftGain, rightGain, leftGain, rightGain };
+        const float32x4_t gains     = vld1q_f32( gainValues );
+        
+        for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+        {
+            const int16x8_t   packed = vld1q_s16( source + ( 2 * i ) );
+            const float32x4_t lo     = vcvtq_f32_s32( vmovl_s16( vget_low_s16( packed ) ) );
+            const float32x4_t hi     = vcvtq_f32_s32( vmovl_s16( vget_high_s16( packed ) ) );
+            
+            float * out = accumulator + ( 2 * i );
+            vst1q_f32( out,     vaddq_f32( vld1q_f32( out ),     vmulq_f32( lo, gains ) ) );
+            vst1q_f32( out + 4, vaddq_f32( vld1q_f32( out + 4 ), vmulq_f32( hi, gains ) ) );
+        }
+    }
+#endif
+    
+    for( ; i < numberOfFrames; i++ )
+    {
+        const float l = (float)source[ ( 2 * i ) + 0 ] * leftGain;
+        const float r = (float)source[ ( 2 * i ) + 1 ] * rightGain;
+        
+        accumulator[ ( 2 * i ) + 0 ] += l;
+        accumulator[ ( 2 * i ) + 1 ] += r;
+    }
+}
+
+static void mixFloat32Mono( float * accumulator, const float * source, UInt32 numberOfFrames, float leftGain, float rightGain, bool vector ) {
+    
+    UInt32 i = 0;
+    
+#if SU_MIXER_SSE2
+    if( vector )
+    {
+        const __m128 left  = _mm_set1_ps( leftGain );
+        const __m128 right = _mm_set1_ps( rightGain );
+        
+        for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+        {
+            const __m128 samples = _mm_loadu_ps( source + i );
+            const __m128 l       = _mm_mul_ps( samples, left );
+            const __m128 r       = _mm_mul_ps( samples, right );
+            
+            float * out = accumulator + ( 2 * i );
+            _mm_storeu_ps( out,     _mm_add_ps( _mm_loadu_ps( out ),     _mm_unpacklo_ps( l, r ) ) );
+            _mm_storeu_ps( out + 4, _mm_add_ps( _mm_loadu_ps( out + 4 ), _mm_unpackhi_ps( l, r ) ) );
+        }
+    }
+#elif SU_MIXER_NEON
+    if( vector )
+    {
+        for( ; ( i + 4 ) <= numberOfFrames; i += 4 )
+        {
+            const float32x4_t samples = vld1q_f32( source + i );
+            
+            float * out = accumulator + ( 2 * i );
+            float32x4x2_t acc = vld2q_f32( out );
+            acc.val[ 0 ] = vaddq_f32( acc.val[ 0 ], vmulq_n_f32( samples, leftGain ) );
+            acc.val[ 1 ] = vaddq_f32( acc.val[ 1 ], vmulq_n_f32( samples, rightGain ) );
+            vst2q_f32( out, acc );
+        }
+    }
+#endif
+    
+    for( ; i < numberOfFrames; i++ )
+    {
+        const float l = source[ i ] * leftGain;
+        const float r = source[ i ] * rightGain;
+        
+        accumulator[ ( 2 * i ) + 0 ] += l;
+        accumulator[ ( 2 * i ) + 1 ] += r;
+    }
+}
+
+static void mixFloat32Stereo( float * accumulator, const float * source, UInt32 numberOfFrames, float leftGain, float rightGain, bool vector ) {
+    
+    UInt32 i = 0;
+    
+#if SU_MIXER_SSE2
+    if( vector )
+    {
+        const __m128 gains = _mm_setr_ps( leftGain, rightGain, leftGain, rightGain );
+        
+        for( ; ( i + 2 ) <= numberOfFrames; i += 2 )
+        {
+            float * out = accumulator + ( 2 * i );
+            _mm_storeu_ps( out, _mm_add_ps( _mm_loadu_ps( out ), _mm_mul_ps( _mm_loadu_ps( source + ( 2 * i ) ), gains ) ) );
+        }
+    }
+#elif SU_MIXER_NEON
+    if( vector )
+    {
+        const float gainValues[ 4 ] = { leftGain, rightGain, leftGain, rightGain };
+        const float32x4_t gains     = vld1q_f32( gainValues );
+        
+        for( ; ( i + 2 ) <= numberOfFrames; i += 2 )
+        {
+            float * out = accumulator + ( 2 * i );
+            vst1q_f32( out, vaddq_f32( vld1q_f32( out ), vmulq_f32( vld1q_f32( source + ( 2 * i ) ), gains ) ) );
+        }
+    }
+#endif
+    
+    for( ; i < numberOfFrames; i++ )
+    {
+        const float l = source[ ( 2 * i ) + 0 ] * leftGain;
+        const float r = source[ ( 2 * i ) + 1 ] * rightGain;
+        
+        accumulator[ ( 2 * i ) + 0 ] += l;
+        accumulator[ ( 2 * i ) + 1 ] += r;
+    }
+}
+
+#pragma mark -
+#pragma mark Trigger Queue
+
+// A bounded multi-producer, single-consumer queue. Producers claim a position with a compare-and-swap, write the trigger
+// in to its slot, then publish it by storing the slot's sequence with release semantics. The render thread is the only
+// consumer, so it reads slots in order without any atomic read-modify-write, and never waits for a producer.
+
+static bool enqueueSoundMixerTrigger( SUSoundMixer mixer, const SUSoundMixerTrigger * trigger ) {
+    
+    const UInt64 mask = ( mixer->triggerQueueCapacity - 1 );
+    UInt64 position   = __atomic_load_n( &mixer->enqueuePosition, __ATOMIC_RELAXED );
+    SUSoundMixerTriggerSlot * slot;
+    
+    for( ;; )
+    {
+        slot = &( mixer->triggerSlots[ position & mask ] );
+        
+        const SInt64 difference = (SInt64)( __atomic_load_n( &slot->sequence, __ATOMIC_ACQUIRE ) - position );
+        
+        if( 0 == difference )
+        {
+            if( __atomic_compare_exchange_n( &mixer->enqueuePosition, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+                break;
+        }
+        else if( difference < 0 )
+        {
+            // The slot still holds a trigger from the previous lap, so the queue is full.
+            return false;
+        }
+        else
+        {
+            position = __atomic_load_n( &mixer->enqueuePosition, __ATOMIC_RELAXED );
+        }
+    }
+    
+    slot->trigger = *trigger;
+    __atomic_store_n( &slot->sequence, position + 1, __ATOMIC_RELEASE );
+    
+    return true;
+}
+
+/** Takes the oldest published trigger from the queue. Called only by the render thread (or when freeing the mixer). */
+
+static bool dequeueSoundMixerTrigger( SUSoundMixer mixer, SUSoundMixerTrigger * oTrigger ) {
+    
+    const UInt64 position          = mixer->dequeuePosition;
+    SUSoundMixerTriggerSlot * slot = &( mixer->triggerSlots[ position & ( mixer->triggerQueueCapacity - 1 ) ] );
+    
+    if( __atomic_load_n( &slot->sequence, __ATOMIC_ACQUIRE ) != ( position + 1 ) )
+        return false;
+    
+    *oTrigger = slot->trigger;
+    __atomic_store_n( &slot->sequence, position + mixer->triggerQueueCapacity, __ATOMIC_RELEASE );
+    
+    mixer->dequeuePosition = ( position + 1 );
+    
+    return true;
+}
+
+#pragma mark -
+#pragma mark Creating and Freeing Mixers
+
+SUSoundMixer createSoundMixer( Float64 sampleRate, SUSoundMixerSampleFormat outputFormat, UInt32 maximumNumberOfVoices, UInt32 maximumFramesPerBuffer ) {
+    
+    if( ( 0 == maximumNumberOfVoices ) || ( 0 == maximumFramesPerBuffer ) )
+        return NULL;
+    
+    SUSoundMixer mixer = calloc( 1, sizeof( struct _SUSoundMixer ) );
+    
+    if( NULL == mixer )
+        return NULL;
+    
+    mixer->sampleRate               = sampleRate;
+    mixer->outputFormat             = outputFormat;
+    mixer->maximumNumberOfVoices    = maximumNumberOfVoices;
+    mixer->maximumFramesPerBuffer   = maximumFramesPerBuffer;
+    mixer->usesVectorKernels        = true;
+    
+    // The trigger queue holds at least four triggers per voice.
+    
+    mixer->triggerQueueCapacity = kSUSoundMixerMinimumTriggerQueueCapacity;
+    
+    while( ( mixer->triggerQueueCapacity < ( (UInt64)maximumNumberOfVoices * 4 ) ) && ( mixer->triggerQueueCapacity < kSUSoundMixerMaximumTriggerQueueCapacity ) )
+    {
+        mixer->triggerQueueCapacity *= 2;
+    }
+    
+    mixer->voices          = calloc( maximumNumberOfVoices, sizeof( SUSoundMixerVoice ) );
+    mixer->accumulator     = malloc( (size_t)maximumFramesPerBuffer * 2 * sizeof( float ) );
+    mixer->triggerSlots    = calloc( mixer->triggerQueueCapacity, sizeof( SUSoundMixerTriggerSlot ) );
+    mixer->pendingTriggers = calloc( mixer->triggerQueueCapacity, sizeof( SUSoundMixerTrigger ) );
+    
+    if( ( NULL == mixer->voices ) || ( NULL == mixer->accumulator ) || ( NULL == mixer->triggerSlots ) || ( NULL == mixer->pendingTriggers ) )
+    {
+        freeSoundMixer( mixer );
+        return NULL;
+    }
+    
+    for( UInt32 i = 0; i < mixer->triggerQueueCapacity; i++ )
+    {
+        mixer->triggerSlots[ i ].sequence = i;
+    }
+    
+    // Voices release their audio data on the render thread, which must not free it.
+    
+    startAudioDataRetireThread();
+    
+    return mixer;
+}
+
+void freeSoundMixer( SUSoundMixer mixer ) {
+    
+    if( NULL != mixer )
+    {
+        if( NULL != mixer->voices )
+        {
+            for( UInt32 i = 0; i < mixer->maximumNumberOfVoices; i++ )
+            {
+                stopSoundMixerVoice( mixer, (SInt32)i );
+            }
+            
+            free( mixer->voices );
+        }
+        
+        if( NULL != mixer->triggerSlots )
+        {
+            SUSoundMixerTrigger trigger;
+            
+            while( dequeueSoundMixerTrigger( mixer, &trigger ) )
+            {
+                retireAudioData( trigger.audioData );
+            }
+        }
+        
+        for( UInt32 i = 0; i < mixer->numberOfPendingTriggers; i++ )
+        {
+            retireAudioData( mixer->pendingTriggers[ i ].audioData );
+        }
+        
+        free( mixer->triggerSlots );
+        free( mixer->pendingTriggers );
+        free( mixer->accumulator );
+        free( mixer );
+    }
+}
+
+AudioStreamBasicDescription soundMixerOutputFormat( SUSoundMixer mixer ) {
+    
+    const UInt32 bytesPerSample = ( SUSoundMixerSampleFormatInt16 == mixer->outputFormat ) ? sizeof( SInt16 ) : sizeof( float );
+    
+    AudioStreamBasicDescription format = { 0 };
+    
+    format.mSampleRate       = mixer->sampleRate;
+    format.mFormatID         = kAudioFormatLinearPCM;
+    format.mFormatFlags      = kAudioFormatFlagsNativeEndian | kAudioFormatFlagIsPacked |
+                               ( ( SUSoundMixerSampleFormatInt16 == mixer->outputFormat ) ? kAudioFormatFlagIsSignedInteger : kAudioFormatFlagIsFloat );
+    format.mFramesPerPacket  = 1;
+    format.mChannelsPerFrame = 2;
+    format.mBitsPerChannel   = ( bytesPerSample * 8 );
+    format.mBytesPerFrame    = ( bytesPerSample * 2 );
+    format.mBytesPerPacket   = format.mBytesPerFrame;
+    
+    return format;
+}
+
+void setSoundMixerUsesVectorKernels( SUSoundMixer mixer, bool usesVectorKernels ) {
+    
+    mixer->usesVectorKernels = usesVectorKernels;
+}
+
+#pragma mark -
+#pragma mark Managing Voices
+
+static SUSoundMixerSourceFormat sourceFormatOfAudioData( SUSoundEffectData audioData ) {
+    
+    const AudioStreamBasicDescription * format = &( audioData->dataFormat );
+    
+    if( kAudioFormatLinearPCM != format->mFormatID )
+        return SUSoundMixerSourceFormatUnsupported;
+    
+    if( ( ( format->mFormatFlags & kAudioFormatFlagIsBigEndian ) != kAudioFormatFlagsNativeEndian ) ||
+        ( format->mFormatFlags & kAudioFormatFlagIsNonInterleaved ) ||
+        ( ( 1 != format->mChannelsPerFrame ) && ( 2 != format->mChannelsPerFrame ) ) )
+    {
+        return SUSoundMixerSourceFormatUnsupported;
+    }
+    
+    if( ( format->mFormatFlags & kAudioFormatFlagIsFloat ) && ( 32 == format->mBitsPerChannel ) &&
+        ( format->mBytesPerFrame == ( sizeof( float ) * format->mChannelsPerFrame ) ) )
+    {
+        return SUSoundMixerSourceFormatFloat32;
+    }
+    
+    if( ( format->mFormatFlags & kAudioFormatFlagIsSignedInteger ) && ( 16 == format->mBitsPerChannel ) &&
+        ( format->mBytesPerFrame == ( sizeof( SInt16 ) * format->mChannelsPerFrame ) ) )
+    {
+        return SUSoundMixerSourceFormatInt16;
+    }
+    
+    return SUSoundMixerSourceFormatUnsupported;
+}
+
+/** Returns the format the mixer would play audio data in, or SUSoundMixerSourceFormatUnsupported if it can't be played. */
+
+static SUSoundMixerSourceFormat playableFormatOfAudioData( SUSoundMixer mixer, SUSoundEffectData audioData ) {
+    
+    // The mixer reads samples directly, so it can't play compressed audio data, or audio data which is still being read.
+    
+    if( ( NULL == audioData ) || ( NULL == audioData->audioData ) || ( noErr != audioDataLoadingStatus( audioData ) ) )
+        return SUSoundMixerSourceFormatUnsupported;
+    
+    if( audioData->dataFormat.mSampleRate != mixer->sampleRate )
+        return SUSoundMixerSourceFormatUnsupported;
+    
+    return sourceFormatOfAudioData( audioData );
+}
+
+/** Starts a free voice, which takes over a reference to the audio data. Returns -1 if there is no free voice. */
+
+static SInt32 startVoiceWithRetainedAudioData( SUSoundMixer mixer, SUSoundEffectData audioData, SUSoundMixerSourceFormat sourceFormat,
+                                               float gain, float pan, UInt64 startDelay ) {
+    
+    for( UInt32 i = 0; i < mixer->maximumNumberOfVoices; i++ )
+    {
+        SUSoundMixerVoice * voice = &( mixer->voices[ i ] );
+        
+        if( false == voice->playing )
+        {
+            voice->audioData        = audioData;
+            voice->sourceFormat     = sourceFormat;
+            voice->numberOfChannels = audioData->dataFormat.mChannelsPerFrame;
+            voice->frameCursor      = 0;
+            voice->numberOfFrames   = ( audioData->numberOfAudioDataBytes / audioData->dataFormat.mBytesPerFrame );
+            voice->startDelay       = startDelay;
+            voice->gain             = gain;
+            voice->pan              = pan;
+            voice->playing          = true;
+            
+            return (SInt32)i;
+        }
+    }
+    
+    return -1;
+}
+
+SInt32 startSoundMixerVoice( SUSoundMixer mixer, SUSoundEffectData audioData, float gain, float pan ) {
+    
+    const SUSoundMixerSourceFormat sourceFormat = playableFormatOfAudioData( mixer, audioData );
+    
+    if( SUSoundMixerSourceFormatUnsupported == sourceFormat )
+        return -1;
+    
+    const SInt32 voice = startVoiceWithRetainedAudioData( mixer, retainAudioData( audioData ), sourceFormat, gain, pan, 0 );
+    
+    if( voice < 0 )
+        retireAudioData( audioData );
+    
+    return voice;
+}
+
+void stopSoundMixerVoice( SUSoundMixer mixer, SInt32 voice ) {
+    
+    if( ( voice < 0 ) || ( (UInt32)voice >= mixer->maximumNumberOfVoices ) )
+        return;
+    
+    SUSoundMixerVoice * v = &( mixer->voices[ voice ] );
+    
+    if( v->playing )
+    {
+        retireAudioData( v->audioData );
+        
+        v->audioData = NULL;
+        v->playing   = false;
+    }
+}
+
+bool soundMixerVoiceIsPlaying( SUSoundMixer mixer, SInt32 voice ) {
+    
+    if( ( voice < 0 ) || ( (UInt32)voice >= mixer->maximumNumberOfVoices ) )
+        return false;
+    
+    return mixer->voices[ voice ].playing;
+}
+
+void setSoundMixerVoiceGain( SUSoundMixer mixer, SInt32 voice, float gain ) {
+    
+    if( soundMixerVoiceIsPlaying( mixer, voice ) )
+    {
+        mixer->voices[ voice ].gain = gain;
+    }
+}
+
+void setSoundMixerVoicePan( SUSoundMixer mixer, SInt32 voice, float pan ) {
+    
+    if( soundMixerVoiceIsPlaying( mixer, voice ) )
+    {
+        mixer->voices[ voice ].pan = pan;
+    }
+}
+
+#pragma mark -
+#pragma mark Triggering Voices
+
+bool triggerSoundMixerVoice( SUSoundMixer mixer, SUSoundEffectData audioData, UInt64 sampleTime, float gain, float pan ) {
+    
+    const SUSoundMixerSourceFormat sourceFormat = playableFormatOfAudioData( mixer, audioData );
+    
+    if( SUSoundMixerSourceFormatUnsupported == sourceFormat )
+        return false;
+    
+    const SUSoundMixerTrigger trigger = {
+        .audioData      = retainAudioData( audioData ),
+        .sourceFormat   = sourceFormat,
+        .sampleTime     = sampleTime,
+        .gain           = gain,
+        .pan            = pan,
+    };
+    
+    if( enqueueSoundMixerTrigger( mixer, &trigger ) )
+        return true;
+    
+    retireAudioData( audioData );
+    return false;
+}
+
+UInt64 soundMixerSampleTime( SUSoundMixer mixer ) {
+    
+    return __atomic_load_n( &mixer->sampleTime, __ATOMIC_RELAXED );
+}
+
+/** Moves triggers from the queue to the pending list, then starts the pending triggers whose sample time falls before the
+ *  end of the next `numberOfFrames` frames, delayed to their exact frame. Triggers whose time has passed start immediately. */
+
+static void startTriggeredVoices( SUSoundMixer mixer, UInt32 numberOfFrames ) {
+    
+    while( ( mixer->numberOfPendingTriggers < mixer->triggerQueueCapacity ) &&
+           dequeueSoundMixerTrigger( mixer, &( mixer->pendingTriggers[ mixer->numberOfPendingTriggers ] ) ) )
+    {
+        mixer->numberOfPendingTriggers++;
+    }
+    
+    const UInt64 bufferStartTime    = mixer->sampleTime;
+    const UInt64 bufferEndTime      = ( bufferStartTime + numberOfFrames );
+    UInt32 numberOfPendingTriggers  = 0;
+    
+    for( UInt32 i = 0; i < mixer->numberOfPendingTriggers; i++ )
+    {
+        const SUSoundMixerTrigger * trigger = &( mixer->pendingTriggers[ i ] );
+        
+        if( trigger->sampleTime >= bufferEndTime )
+        {
+            mixer->pendingTriggers[ numberOfPendingTriggers++ ] = *trigger;
+            continue;
+        }
+        
+        const UInt64 startDelay = ( trigger->sampleTime > bufferStartTime ) ? ( trigger->sampleTime - bufferStartTime ) : 0;
+        
+        // Triggers are dropped if every voice is busy.
+        
+        if( startVoiceWithRetainedAudioData( mixer, trigger->audioData, trigger->sourceFormat, trigger->gain, trigger->pan, startDelay ) < 0 )
+        {
+            retireAudioData( trigger->audioData );
+        }
+    }
+    
+    mixer->numberOfPendingTriggers = numberOfPendingTriggers;
+}
+
+#pragma mark -
+#pragma mark Rendering Output
+
+/** Mixes up to maximumFramesPerBuffer frames of every playing voice in to the accumulator. */
+
+static void mixVoicesInToAccumulator( SUSoundMixer mixer, UInt32 numberOfFrames ) {
+    
+    memset( mixer->accumulator, 0, (size_t)numberOfFrames * 2 * sizeof( float ) );
+    
+    for( UInt32 v = 0; v < mixer->maximumNumberOfVoices; v++ )
+    {
+        SUSoundMixerVoice * voice = &( mixer->voices[ v ] );
+        
+        if( false == voice->playing )
+            continue;
+        
+        // Triggered voices start part-way through a buffer.
+        
+        UInt32 startFrame = 0;
+        
+        if( voice->startDelay > 0 )
+        {
+            if( voice->startDelay >= numberOfFrames )
+            {
+                voice->startDelay -= numberOfFrames;
+                continue;
+            }
+            
+            startFrame        = (UInt32)voice->startDelay;
+            voice->startDelay = 0;
+        }
+        
+        const UInt64 remainingFrames = ( voice->numberOfFrames - voice->frameCursor );
+        const UInt32 framesToMix     = ( remainingFrames < ( numberOfFrames - startFrame ) ) ? (UInt32)remainingFrames : ( numberOfFrames - startFrame );
+        float * accumulator          = ( mixer->accumulator + ( 2 * startFrame ) );
+        
+        // Constant-power pan. Integer samples are also scaled in to [-1, 1) by their gains.
+        
+        const float pan       = fmaxf( fminf( voice->pan, 1.0f ), -1.0f );
+        const float angle     = ( pan + 1.0f ) * (float)( M_PI / 4.0 );
+        const float scale     = ( SUSoundMixerSourceFormatInt16 == voice->sourceFormat ) ? ( 1.0f / 32768.0f ) : 1.0f;
+        const float leftGain  = voice->gain * scale * cosf( angle );
+        const float rightGain = voice->gain * scale * sinf( angle );
+        
+        const void * source = (const UInt8 *)voice->audioData->audioData + ( voice->frameCursor * voice->audioData->dataFormat.mBytesPerFrame );
+        
+        if( SUSoundMixerSourceFormatInt16 == voice->sourceFormat )
+        {
+            if( 1 == voice->numberOfChannels )
+                mixInt16Mono( accumulator, source, framesToMix, leftGain, rightGain, mixer->usesVectorKernels );
+            else
+                mixInt16Stereo( accumulator, source, framesToMix, leftGain, rightGain, mixer->usesVectorKernels );
+        }
+        else
+        {
+            if( 1 == voice->numberOfChannels )
+                mixFloat32Mono( accumulator, source, framesToMix, leftGain, rightGain, mixer->usesVectorKernels );
+            else
+                mixFloat32Stereo( accumulator, source, framesToMix, leftGain, rightGain, mixer->usesVectorKernels );
+        }
+        
+        voice->frameCursor += framesToMix;
+        
+        if( voice->frameCursor >= voice->numberOfFrames )
+        {
+            stopSoundMixerVoice( mixer, (SInt32)v );
+        }
+    }
+}
+
+void mixSoundMixerVoices( SUSoundMixer mixer, void * outBuffer, UInt32 numberOfFrames ) {
+    
+    startTriggeredVoices( mixer, numberOfFrames );
+    
+    __atomic_store_n( &mixer->sampleTime, mixer->sampleTime + numberOfFrames, __ATOMIC_RELAXED );
+    
+    while( numberOfFrames > 0 )
+    {
+        const UInt32 framesToMix = ( numberOfFrames < mixer->maximumFramesPerBuffer ) ? numberOfFrames : mixer->maximumFramesPerBuffer;
+        
+        mixVoicesInToAccumulator( mixer, framesToMix );
+        
+        if( SUSoundMixerSampleFormatInt16 == mixer->outputFormat )
+        {
+            convertFloat32ToInt16Kernel( mixer->accumulator, outBuffer, ( framesToMix * 2 ), mixer->usesVectorKernels );
+            outBuffer = ( (UInt8 *)outBuffer + ( (size_t)framesToMix * 2 * sizeof( SInt16 ) ) );
+        }
+        else
+        {
+            memcpy( outBuffer, mixer->accumulator, (size_t)framesToMix * 2 * sizeof( float ) );
+            outBuffer = ( (UInt8 *)outBuffer + ( (size_t)framesToMix * 2 * sizeof( float ) ) );
+        }
+        
+        numberOfFrames -= framesToMix;
+    }
+}
+
+OSStatus fillBufferFromSoundMixer( AudioQueueBufferRef inBuffer, SUSoundMixer mixer ) {
+    
+    const UInt32 bytesPerFrame  = soundMixerOutputFormat( mixer ).mBytesPerFrame;
+    const UInt32 numberOfFrames = ( inBuffer->mAudioDataBytesCapacity / bytesPerFrame );
+    
+    mixSoundMixerVoices( mixer, inBuffer->mAudioData, numberOfFrames );
+    
+    inBuffer->mAudioDataByteSize      = ( numberOfFrames * bytesPerFrame );
+    inBuffer->mPacketDescriptionCount = 0;
+    
+    return noErr;
+}
@@ -0,0 +1,175 @@
+//
+//  SUSoundMixer.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUSoundMixer_h
+#define SpringUtils_SUSoundMixer_h
+
+#import "SUSoundTools.h"
+
+/** Mixes any number of playing sound effects in to a single stereo output, so one AudioQueue can serve all of them.
+ *
+ *  Voices are summed in to a 32-bit float accumulator using SIMD kernels (SSE2 or NEON, where available), then written out
+ *  as interleaved stereo float or saturated 16-bit integer samples.
+ *
+ *  Voices play native-endian, interleaved linear PCM with 16-bit integer or 32-bit float samples, in mono or stereo,
+ *  at the mixer's sample rate. Other formats can be converted once, at load time, with copyAudioDataInCanonicalFormat().
+ *
+ *  A mixer is not thread-safe: its voices must be started, stopped and modified on the same thread as it is rendered,
+ *  or with external synchronisation. The exception is triggering voices (see triggerSoundMixerVoice()), which may be done
+ *  from any thread without locks: triggers are queued, and the render thread starts their voices at the start of the next
+ *  buffer, at the exact frame they were scheduled for.
+ *
+ *  If the mixer releases the last reference to audio data (e.g. when a voice stops), the audio data is freed on a background
+ *  thread, so that rendering never waits to free memory.
+ */
+
+typedef struct _SUSoundMixer *SUSoundMixer;
+
+/** The sample formats a mixer can output. Output is always interleaved stereo. */
+
+typedef enum _SUSoundMixerSampleFormat {
+    
+    SUSoundMixerSampleFormatFloat32 = 0,    /**< Native-endian 32-bit float samples. */
+    SUSoundMixerSampleFormatInt16   = 1,    /**< Native-endian 16-bit signed integer samples, saturated to the integer range. */
+    
+} SUSoundMixerSampleFormat;
+
+
+//----------------------------------/
+/** @name Creating and Freeing Mixers */
+//----------------------------------/
+
+
+/** Creates a new sound mixer.
+ *
+ *  @param  sampleRate              The sample rate of the mixer's voices and output.
+ *  @param  outputFormat            The sample format of the mixer's output.
+ *  @param  maximumNumberOfVoices   The maximum number of voices which may play at once.
+ *  @param  maximumFramesPerBuffer  The number of frames mixed at a time. Larger outputs are mixed in several passes.
+ *
+ *  @returns                        A new mixer, or NULL if it could not be created. You must release this value by calling freeSoundMixer().
+ */
+
+SU_EXTERN SUSoundMixer createSoundMixer( Float64 sampleRate, SUSoundMixerSampleFormat outputFormat, UInt32 maximumNumberOfVoices, UInt32 maximumFramesPerBuffer );
+
+/** Releases a sound mixer and its references to the audio data of its voices.
+ *
+ *  @param  mixer   The mixer to release. After calling this function, you should no longer use the mixer.
+ */
+
+SU_EXTERN void freeSoundMixer( SUSoundMixer mixer );
+
+/** Returns the format of the mixer's output, for creating an AudioQueue.
+ *
+ *  @param  mixer   The mixer.
+ */
+
+SU_EXTERN AudioStreamBasicDescription soundMixerOutputFormat( SUSoundMixer mixer );
+
+
+//-------------------------/
+/** @name Managing Voices */
+//-------------------------/
+
+
+/** Starts playing audio data on a free voice.
+ *
+ *  @param  mixer       The mixer.
+ *  @param  audioData   The audio data to play. The mixer retains the audio data until the voice stops.
+ *  @param  gain        The linear gain to apply to the audio data.
+ *  @param  pan         The stereo position, from -1 (left) to 1 (right). Panning is constant-power.
+ *
+ *  @returns            The index of the voice playing the audio data, or -1 if there is no free voice or the audio data's format is unsupported
+ *                      (including compressed audio data, and audio data which has not been read in full; see compressAudioData()
+ *                      and audioDataLoadingStatus()).
+ */
+
+SU_EXTERN SInt32 startSoundMixerVoice( SUSoundMixer mixer, SUSoundEffectData audioData, float gain, float pan );
+
+/** Stops a voice, releasing its audio data. Voices stop automatically when they reach the end of their audio data.
+ *
+ *  @param  mixer   The mixer.
+ *  @param  voice   The index of the voice to stop.
+ */
+
+SU_EXTERN void stopSoundMixerVoice( SUSoundMixer mixer, SInt32 voice );
+
+/** Returns true if the voice is playing. */
+
+SU_EXTERN bool soundMixerVoiceIsPlaying( SUSoundMixer mixer, SInt32 voice );
+
+/** Changes the gain of a playing voice. */
+
+SU_EXTERN void setSoundMixerVoiceGain( SUSoundMixer mixer, SInt32 voice, float gain );
+
+/** Changes the stereo position of a playing voice, from -1 (left) to 1 (right). */
+
+SU_EXTERN void setSoundMixerVoicePan( SUSoundMixer mixer, SInt32 voice, float pan );
+
+
+//---------------------------/
+/** @name Triggering Voices */
+//---------------------------/
+
+
+/** Schedules audio data to start playing on a free voice at a sample time. This function may be called from any thread.
+ *
+ *  The trigger is pushed on to a lock-free queue, which the render thread drains at the start of each call to
+ *  mixSoundMixerVoices(). The voice starts at the frame of the output whose sample time was given, so triggers are
+ *  sample-accurate as long as they are scheduled at least one buffer ahead (see soundMixerSampleTime()). Triggers whose sample
+ *  time has already been rendered start at the beginning of the next buffer. Triggers which find every voice busy are dropped.
+ *  The queue holds at least four triggers per voice. This function does not allocate memory or take locks.
+ *
+ *  @param  mixer       The mixer.
+ *  @param  audioData   The audio data to play. It is retained until the voice stops (or the trigger is dropped).
+ *  @param  sampleTime  The sample time (in output frames since the mixer was created) at which to start playing.
+ *  @param  gain        The linear gain to apply to the audio data.
+ *  @param  pan         The stereo position, from -1 (left) to 1 (right).
+ *
+ *  @returns            true if the trigger was queued, or false if the queue is full or the audio data cannot be played
+ *                      by the mixer (see startSoundMixerVoice()).
+ */
+
+SU_EXTERN bool triggerSoundMixerVoice( SUSoundMixer mixer, SUSoundEffectData audioData, UInt64 sampleTime, float gain, float pan );
+
+/** Returns the sample time of the first frame which has not yet been rendered. Triggers scheduled before this time will
+ *  start late. This function may be called from any thread.
+ *
+ *  @param  mixer   The mixer.
+ */
+
+SU_EXTERN UInt64 soundMixerSampleTime( SUSoundMixer mixer );
+
+
+//---------------------------/
+/** @name Rendering Output */
+//---------------------------/
+
+
+/** Starts the voices triggered for this buffer, then mixes the mixer's playing voices in to a buffer, and advances them.
+ *
+ *  @param  mixer           The mixer.
+ *  @param  outBuffer       The buffer to write interleaved stereo samples in to, in the mixer's output format.
+ *  @param  numberOfFrames  The number of frames to write.
+ */
+
+SU_EXTERN void mixSoundMixerVoices( SUSoundMixer mixer, void * outBuffer, UInt32 numberOfFrames );
+
+/** Fills an AudioQueue buffer with the output of the mixer.
+ *
+ *  @param  inBuffer    The buffer to fill. The AudioQueue must have been created with the format returned by soundMixerOutputFormat().
+ *  @param  mixer       The mixer.
+ *
+ *  @returns            noErr.
+ */
+
+SU_EXTERN OSStatus fillBufferFromSoundMixer( AudioQueueBufferRef inBuffer, SUSoundMixer mixer );
+
+#endif
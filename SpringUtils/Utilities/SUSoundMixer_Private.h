@@ -0,0 +1,16 @@
+//
+//  SUSoundMixer_Private.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundMixer.h"
+
+/** Selects between the SIMD kernels (the default, where available) and the scalar reference kernels.
+ *  Both produce bit-identical output. */
+
+SU_EXTERN void setSoundMixerUsesVectorKernels( SUSoundMixer mixer, bool usesVectorKernels );
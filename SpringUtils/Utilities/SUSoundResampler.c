@@ -0,0 +1,592 @@
+//
+//  SUSoundResampler.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundResampler.h"
+#import "SUSoundResampler_Private.h"
+#import "SUPCMConversion.h"
+#import "SUPCMConversion_Private.h"
+
+#import <math.h>
+#import <stdlib.h>
+#import <string.h>
+
+#if defined( __SSE2__ )
+    #import <emmintrin.h>
+    #define SU_RESAMPLER_SSE2 1
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+    #import <arm_neon.h>
+    #define SU_RESAMPLER_NEON 1
+#endif
+
+// The vector dot product and its scalar equivalent add the same products in the same order, so results are bit-identical.
+
+#pragma STDC FP_CONTRACT OFF
+
+/** The Kaiser window's shape parameter. 8.6 gives about 90 dB of stopband attenuation. */
+
+#define kSUSoundResamplerKaiserBeta     8.6
+
+/** The number of input frames a resampler can accept between producing output. */
+
+#define kSUSoundResamplerFramesPerRun   1024
+
+/** The largest number of bytes per sample in a linear PCM format supported by convertSamplesToFloat32(). */
+
+#define kSUSoundResamplerMaximumBytesPerSample  4
+
+/** Input frames are kept deinterleaved, one row per channel, so that each channel's dot products read contiguous samples.
+ *  Row index `i` holds input frame `i` - ( kSUSoundResamplerNumberOfTaps / 2 - 1 ), counted from the start of the row. */
+
+struct _SUSoundResampler {
+    
+    UInt64 sourceRate;              /**< The source sample rate, in whole hertz. */
+    UInt64 interpolation;           /**< L, the number of output frames per M input frames. */
+    UInt64 decimation;              /**< M. */
+    UInt64 integerStep;             /**< M / L, the whole number of input frames between output frames. */
+    UInt64 fractionalStep;          /**< M % L, the remainder, in phases. */
+    
+    UInt32 numberOfChannels;
+    UInt32 numberOfPhases;          /**< The number of precomputed phases: L, or kSUSoundResamplerMaximumNumberOfPhases. */
+    float * coefficients;           /**< kSUSoundResamplerNumberOfTaps coefficients per phase. */
+    
+    float * history;                /**< numberOfChannels rows of rowCapacity input frames. */
+    float ** rows;                  /**< Pointers to the first frame of each row. */
+    size_t rowCapacity;
+    size_t numberOfRowFrames;       /**< The number of input frames in each row. */
+    size_t position;                /**< The row index of the first input frame used by the next output frame. May exceed numberOfRowFrames. */
+    UInt64 phase;                   /**< The next output frame's position between input frames, from 0 to L - 1. */
+    size_t numberOfFinishingFrames; /**< The number of frames of silence added after the input by finishResamplingFloat32(). */
+    
+    void * sourceBytes;             /**< Scratch space for fillSoundBufferFromAudioDataResampled(). */
+    float * sourceSamples;
+    bool sourceEnded;
+    
+};
+
+#pragma mark -
+#pragma mark Creating Resamplers
+
+static UInt64 greatestCommonDivisor( UInt64 a, UInt64 b ) {
+    
+    while( 0 != b )
+    {
+        const UInt64 remainder = ( a % b );
+        a = b;
+        b = remainder;
+    }
+    
+    return a;
+}
+
+/** The zeroth-order modified Bessel function of the first kind, which shapes the Kaiser window. */
+
+static double besselI0( double x ) {
+    
+    double sum  = 1;
+    double term = 1;
+    
+    for( int k = 1; k < 64; k++ )
+    {
+        term *= ( ( x / ( 2 * k ) ) * ( x / ( 2 * k ) ) );
+        sum  += term;
+        
+        if( term < ( sum * 1e-17 ) )
+            break;
+    }
+    
+    return sum;
+}
+
+/** Computes the coefficients of one phase, for output frames `fraction` of an input frame after the filter's centre tap.
+ *  `cutoff` is in cycles per input frame. Each phase is normalised to unity gain at 0 Hz. */
+
+static void computeResamplerPhase( float * coefficients, double fraction, double cutoff ) {
+    
+    const double halfLength = ( kSUSoundResamplerNumberOfTaps / 2 );
+    const double windowNorm = besselI0( kSUSoundResamplerKaiserBeta );
+    double values[ kSUSoundResamplerNumberOfTaps ];
+    double sum = 0;
+    
+    for( int tap = 0; tap < kSUSoundResamplerNumberOfTaps; tap++ )
+    {
+        const double x      = ( tap - ( halfLength - 1 ) - fraction );
+        const double r      = ( x / halfLength );
+        const double window = ( fabs( r ) < 1 ) ? ( besselI0( kSUSoundResamplerKaiserBeta * sqrt( 1 - ( r * r ) ) ) / windowNorm ) : 0;
+        const double sinc   = ( 0 == x ) ? 1 : ( sin( M_PI * 2 * cutoff * x ) / ( M_PI * 2 * cutoff * x ) );
+        
+        values[ tap ] = ( sinc * window );
+        sum          += values[ tap ];
+    }
+    
+    for( int tap = 0; tap < kSUSoundResamplerNumberOfTaps; tap++ )
+    {
+        coefficients[ tap ] = (float)( values[ tap ] / sum );
+    }
+}
+
+SUSoundResampler createSoundResampler( Float64 sourceSampleRate, Float64 destinationSampleRate, UInt32 numberOfChannels ) {
+    
+    if( ( 0 == numberOfChannels ) || !( sourceSampleRate >= 1 ) || !( destinationSampleRate >= 1 ) || ( sourceSampleRate > 1e6 ) || ( destinationSampleRate > 1e6 ) )
+        return NULL;
+    
+    SUSoundResampler resampler = calloc( 1, sizeof( struct _SUSoundResampler ) );
+    
+    if( NULL == resampler )
+        return NULL;
+    
+    // ===================
+    //
+    // 1. Reduce the ratio of the sample rates
+    //
+    // ===================
+    
+    const UInt64 sourceRate      = (UInt64)llround( sourceSampleRate );
+    const UInt64 destinationRate = (UInt64)llround( destinationSampleRate );
+    const UInt64 divisor         = greatestCommonDivisor( sourceRate, destinationRate );
+    
+    resampler->sourceRate       = sourceRate;
+    resampler->interpolation    = ( destinationRate / divisor );
+    resampler->decimation       = ( sourceRate / divisor );
+    resampler->integerStep      = ( resampler->decimation / resampler->interpolation );
+    resampler->fractionalStep   = ( resampler->decimation % resampler->interpolation );
+    resampler->numberOfChannels = numberOfChannels;
+    resampler->numberOfPhases   = (UInt32)( ( resampler->interpolation < kSUSoundResamplerMaximumNumberOfPhases ) ? resampler->interpolation : kSUSoundResamplerMaximumNumberOfPhases );
+    
+    // ===================
+    //
+    // 2. Precompute the filter's phases. The cutoff is the lower of the two Nyquist frequencies
+    //
+    // ===================
+    
+    const double cutoff = ( 0.5 * ( ( destinationRate < sourceRate ) ? ( (double)destinationRate / sourceRate ) : 1 ) );
+    
+    resampler->coefficients = malloc( (size_t)resampler->numberOfPhases * kSUSoundResamplerNumberOfTaps * sizeof( float ) );
+    
+    if( NULL == resampler->coefficients )
+    {
+        freeSoundResampler( resampler );
+        return NULL;
+    }
+    
+    for( UInt32 phase = 0; phase < resampler->numberOfPhases; phase++ )
+    {
+        computeResamplerPhase( &resampler->coefficients[ phase * kSUSoundResamplerNumberOfTaps ], ( (double)phase / resampler->numberOfPhases ), cutoff );
+    }
+    
+    // ===================
+    //
+    // 3. Allocate the history and scratch space. Each row has room for the filter, a run of input, and one output's step
+    //
+    // ===================
+    
+    resampler->rowCapacity   = (size_t)( kSUSoundResamplerNumberOfTaps + kSUSoundResamplerFramesPerRun + resampler->integerStep + 1 );
+    resampler->history       = malloc( resampler->rowCapacity * numberOfChannels * sizeof( float ) );
+    resampler->rows          = malloc( numberOfChannels * sizeof( float * ) );
+    resampler->sourceBytes   = malloc( (size_t)kSUSoundResamplerFramesPerRun * numberOfChannels * kSUSoundResamplerMaximumBytesPerSample );
+    resampler->sourceSamples = malloc( (size_t)kSUSoundResamplerFramesPerRun * numberOfChannels * sizeof( float ) );
+    
+    if( ( NULL == resampler->history ) || ( NULL == resampler->rows ) || ( NULL == resampler->sourceBytes ) || ( NULL == resampler->sourceSamples ) )
+    {
+        freeSoundResampler( resampler );
+        return NULL;
+    }
+    
+    for( UInt32 channel = 0; channel < numberOfChannels; channel++ )
+    {
+        resampler->rows[ channel ] = &resampler->history[ channel * resampler->rowCapacity ];
+    }
+    
+    resetSoundResampler( resampler );
+    
+    return resampler;
+}
+
+void freeSoundResampler( SUSoundResampler resampler ) {
+    
+    if( NULL == resampler )
+        return;
+    
+    free( resampler->coefficients );
+    free( resampler->history );
+    free( resampler->rows );
+    free( resampler->sourceBytes );
+    free( resampler->sourceSamples );
+    free( resampler );
+}
+
+void resetSoundResampler( SUSoundResampler resampler ) {
+    
+    // The first output frame is centred on the first input frame, so it is preceded by half a filter of silence.
+    
+    resampler->numberOfRowFrames       = ( kSUSoundResamplerNumberOfTaps / 2 - 1 );
+    resampler->position                = 0;
+    resampler->phase                   = 0;
+    resampler->numberOfFinishingFrames = 0;
+    resampler->sourceEnded             = false;
+    
+    for( UInt32 channel = 0; channel < resampler->numberOfChannels; channel++ )
+    {
+        memset( resampler->rows[ channel ], 0, resampler->numberOfRowFrames * sizeof( float ) );
+    }
+}
+
+#pragma mark -
+#pragma mark Resampling Float Samples
+
+/** Returns the dot product of kSUSoundResamplerNumberOfTaps coefficients and samples.
+ *  The products are summed in 8 lanes, which are then added pairwise. */
+
+SU_INLINE float resamplerDotProduct( const float * coefficients, const float * samples, bool vector ) {
+    
+    float lanes[ 8 ];
+
+#if SU_RESAMPLER_SSE2
+    if( vector )
+    {
+        __m128 lo = _mm_setzero_ps();
+        __m128 hi = _mm_setzero_ps();
+        
+        for( int tap = 0; tap < kSUSoundResamplerNumberOfTaps; tap += 8 )
+        {
+            lo = _mm_add_ps( lo, _mm_mul_ps( _mm_loadu_ps( coefficients + tap ),     _mm_loadu_ps( samples + tap ) ) );
+            hi = _mm_add_ps( hi, _mm_mul_ps( _mm_loadu_ps( coefficients + tap + 4 ), _mm_loadu_ps( samples + tap + 4 ) ) );
+        }
+        
+        _mm_storeu_ps( lanes,     lo );
+        _mm_storeu_ps( lanes + 4, hi );
+    }
+    else
+#elif SU_RESAMPLER_NEON
+    if( vector )
+    {
+        float32x4_t lo = vdupq_n_f32( 0 );
+        float32x4_t hi = vdupq_n_f32( 0 );
+        
+        for( int tap = 0; tap < kSUSoundResamplerNumberOfTaps; tap += 8 )
+        {
+            lo = vaddq_f32( lo, vmulq_f32( vld1q_f32( coefficients + tap ),     vld1q_f32( samples + tap ) ) );
+            hi = vaddq_f32( hi, vmulq_f32( vld1q_f32( coefficients + tap + 4 ), vld1q_f32( samples + tap + 4 ) ) );
+        }
+        
+        vst1q_f32( lanes,     lo );
+        vst1q_f32( lanes + 4, hi );
+    }
+    else
+#endif
+    {
+        for( int lane = 0; lane < 8; lane++ )
+        {
+            lanes[ lane ] = 0;
+        }
+        
+        for( int tap = 0; tap < kSUSoundResamplerNumberOfTaps; tap += 8 )
+        {
+            for( int lane = 0; lane < 8; lane++ )
+            {
+                lanes[ lane ] += ( coefficients[ tap + lane ] * samples[ tap + lane ] );
+            }
+        }
+    }
+    
+    const float a = ( lanes[ 0 ] + lanes[ 4 ] ), b = ( lanes[ 1 ] + lanes[ 5 ] );
+    const float c = ( lanes[ 2 ] + lanes[ 6 ] ), d = ( lanes[ 3 ] + lanes[ 7 ] );
+    
+    return ( ( a + b ) + ( c + d ) );
+}
+
+/** Writes output frames until the output is full or the input in the rows runs out. While finishing, output stops after the
+ *  frame for the last input frame. */
+
+static size_t produceResampledFrames( SUSoundResampler resampler, float * destination, size_t numberOfDestinationFrames, bool vector ) {
+    
+    const UInt32 numberOfChannels = resampler->numberOfChannels;
+    const size_t inputEnd         = ( resampler->numberOfRowFrames - resampler->numberOfFinishingFrames );
+    size_t numberOfFrames         = 0;
+    
+    while( numberOfFrames < numberOfDestinationFrames )
+    {
+        if( ( resampler->position + kSUSoundResamplerNumberOfTaps ) > resampler->numberOfRowFrames )
+            break;
+        
+        if( ( resampler->numberOfFinishingFrames > 0 ) && ( ( resampler->position + kSUSoundResamplerNumberOfTaps / 2 - 1 ) >= inputEnd ) )
+            break;
+        
+        const UInt64 phaseIndex     = ( resampler->numberOfPhases == resampler->interpolation ) ? resampler->phase
+                                                                                                : ( ( resampler->phase * resampler->numberOfPhases ) / resampler->interpolation );
+        const float * coefficients  = &resampler->coefficients[ phaseIndex * kSUSoundResamplerNumberOfTaps ];
+        float * frame               = &destination[ numberOfFrames * numberOfChannels ];
+        
+        for( UInt32 channel = 0; channel < numberOfChannels; channel++ )
+        {
+            frame[ channel ] = resamplerDotProduct( coefficients, resampler->rows[ channel ] + resampler->position, vector );
+        }
+        
+        numberOfFrames++;
+        
+        resampler->position += (size_t)resampler->integerStep;
+        resampler->phase    += resampler->fractionalStep;
+        
+        if( resampler->phase >= resampler->interpolation )
+        {
+            resampler->phase -= resampler->interpolation;
+            resampler->position++;
+        }
+    }
+    
+    return numberOfFrames;
+}
+
+/** Discards the input frames before the next output frame's first tap, and returns the number of frames the rows have room for. */
+
+static size_t compactResamplerRows( SUSoundResampler resampler ) {
+    
+    const size_t discard = ( resampler->position < resampler->numberOfRowFrames ) ? resampler->position : resampler->numberOfRowFrames;
+    
+    if( discard > 0 )
+    {
+        for( UInt32 channel = 0; channel < resampler->numberOfChannels; channel++ )
+        {
+            memmove( resampler->rows[ channel ], resampler->rows[ channel ] + discard, ( resampler->numberOfRowFrames - discard ) * sizeof( float ) );
+        }
+        
+        resampler->numberOfRowFrames -= discard;
+        resampler->position          -= discard;
+    }
+    
+    return ( resampler->rowCapacity - resampler->numberOfRowFrames );
+}
+
+/** Deinterleaves input frames on to the end of the rows. */
+
+static void appendResamplerInput( SUSoundResampler resampler, const float * source, size_t numberOfFrames ) {
+    
+    float * destinations[ resampler->numberOfChannels ];
+    
+    for( UInt32 channel = 0; channel < resampler->numberOfChannels; channel++ )
+    {
+        destinations[ channel ] = ( resampler->rows[ channel ] + resampler->numberOfRowFrames );
+    }
+    
+    deinterleaveFloat32( source, resampler->numberOfChannels, destinations, numberOfFrames );
+    resampler->numberOfRowFrames += numberOfFrames;
+}
+
+size_t resampleFloat32Kernel( SUSoundResampler resampler,
+                              const float * source, size_t numberOfSourceFrames, size_t * oNumberOfSourceFramesUsed,
+                              float * destination, size_t numberOfDestinationFrames,
+                              bool vector ) {
+    
+    size_t numberOfFramesUsed    = 0;
+    size_t numberOfFramesWritten = 0;
+    
+    for( ;; )
+    {
+        numberOfFramesWritten += produceResampledFrames( resampler, destination + ( numberOfFramesWritten * resampler->numberOfChannels ),
+                                                         ( numberOfDestinationFrames - numberOfFramesWritten ), vector );
+        
+        if( ( numberOfFramesWritten == numberOfDestinationFrames ) || ( numberOfFramesUsed == numberOfSourceFrames ) )
+            break;
+        
+        size_t numberOfFrames = compactResamplerRows( resampler );
+        
+        if( numberOfFrames > ( numberOfSourceFrames - numberOfFramesUsed ) )
+            numberOfFrames = ( numberOfSourceFrames - numberOfFramesUsed );
+        
+        appendResamplerInput( resampler, source + ( numberOfFramesUsed * resampler->numberOfChannels ), numberOfFrames );
+        numberOfFramesUsed += numberOfFrames;
+    }
+    
+    if( oNumberOfSourceFramesUsed )
+        *oNumberOfSourceFramesUsed = numberOfFramesUsed;
+    
+    return numberOfFramesWritten;
+}
+
+size_t resampleFloat32( SUSoundResampler resampler,
+                        const float * source, size_t numberOfSourceFrames, size_t * oNumberOfSourceFramesUsed,
+                        float * destination, size_t numberOfDestinationFrames ) {
+    
+    return resampleFloat32Kernel( resampler, source, numberOfSourceFrames, oNumberOfSourceFramesUsed, destination, numberOfDestinationFrames, true );
+}
+
+size_t finishResamplingFloat32( SUSoundResampler resampler, float * destination, size_t numberOfDestinationFrames ) {
+    
+    // The last output frame reads half a filter past the last input frame.
+    
+    const size_t numberOfFinishingFrames = ( kSUSoundResamplerNumberOfTaps / 2 );
+    size_t numberOfFramesWritten         = 0;
+    
+    for( ;; )
+    {
+        if( resampler->numberOfFinishingFrames > 0 )
+        {
+            numberOfFramesWritten += produceResampledFrames( resampler, destination + ( numberOfFramesWritten * resampler->numberOfChannels ),
+                                                             ( numberOfDestinationFrames - numberOfFramesWritten ), true );
+        }
+        
+        if( ( numberOfFramesWritten == numberOfDestinationFrames ) || ( resampler->numberOfFinishingFrames == numberOfFinishingFrames ) )
+            break;
+        
+        size_t numberOfFrames = compactResamplerRows( resampler );
+        
+        if( numberOfFrames > ( numberOfFinishingFrames - resampler->numberOfFinishingFrames ) )
+            numberOfFrames = ( numberOfFinishingFrames - resampler->numberOfFinishingFrames );
+        
+        for( UInt32 channel = 0; channel < resampler->numberOfChannels; channel++ )
+        {
+            memset( resampler->rows[ channel ] + resampler->numberOfRowFrames, 0, numberOfFrames * sizeof( float ) );
+        }
+        
+        resampler->numberOfRowFrames       += numberOfFrames;
+        resampler->numberOfFinishingFrames += numberOfFrames;
+    }
+    
+    return numberOfFramesWritten;
+}
+
+#pragma mark -
+#pragma mark Resampling Audio Data
+
+SUSoundEffectData copyAudioDataWithSampleRate( SUSoundEffectData audioData, Float64 sampleRate ) {
+    
+    SUSoundEffectData data = copyAudioDataInCanonicalFormat( audioData, audioData->dataFormat.mChannelsPerFrame );
+    
+    if( NULL == data )
+        return NULL;
+    
+    const UInt32 numberOfChannels = data->dataFormat.mChannelsPerFrame;
+    SUSoundResampler resampler    = createSoundResampler( data->dataFormat.mSampleRate, sampleRate, numberOfChannels );
+    
+    if( NULL == resampler )
+    {
+        freeAudioData( data );
+        return NULL;
+    }
+    
+    // Output frame `n` is produced for every `n` * M/L which falls before the end of the input.
+    
+    const UInt64 numberOfSourceFrames = data->numberOfFrames;
+    const UInt64 numberOfFrames       = ( ( numberOfSourceFrames * resampler->interpolation ) + resampler->decimation - 1 ) / resampler->decimation;
+    float * samples                   = NULL;
+    
+    if( ( numberOfFrames * numberOfChannels * sizeof( float ) ) <= SIZE_T_MAX )
+        samples = malloc( (size_t)( numberOfFrames * numberOfChannels * sizeof( float ) ) );
+    
+    if( NULL == samples )
+    {
+        freeSoundResampler( resampler );
+        freeAudioData( data );
+        return NULL;
+    }
+    
+    size_t numberOfFramesWritten = resampleFloat32( resampler, data->audioData, (size_t)numberOfSourceFrames, NULL, samples, (size_t)numberOfFrames );
+    numberOfFramesWritten       += finishResamplingFloat32( resampler, samples + ( numberOfFramesWritten * numberOfChannels ), (size_t)( numberOfFrames - numberOfFramesWritten ) );
+    
+    freeSoundResampler( resampler );
+    free( data->audioData );
+    
+    data->audioData              = samples;
+    data->dataFormat.mSampleRate = sampleRate;
+    data->numberOfFrames         = numberOfFramesWritten;
+    data->numberOfPackets        = numberOfFramesWritten;
+    data->numberOfAudioDataBytes = ( numberOfFramesWritten * data->dataFormat.mBytesPerFrame );
+    
+    return data;
+}
+
+OSStatus fillSoundBufferFromAudioDataResampled( SUSoundBuffer * buffer,
+                                                SUSoundEffectData audioData,
+                                                SUSoundResampler resampler,
+                                                SInt64 * ioPlaybackPosition ) {
+    
+    const AudioStreamBasicDescription * format = &( audioData->dataFormat );
+    const UInt32 numberOfChannels              = resampler->numberOfChannels;
+    
+    buffer->audioDataByteSize      = 0;
+    buffer->packetDescriptionCount = 0;
+    
+    // Converting no samples checks that the format is supported.
+    
+    if( ( 0 == format->mBytesPerFrame ) || ( NULL != audioData->packetDescriptions ) || ( numberOfChannels != format->mChannelsPerFrame ) ||
+        ( (UInt64)llround( format->mSampleRate ) != resampler->sourceRate ) ||
+        ( false == convertSamplesToFloat32( format, resampler->sourceBytes, resampler->sourceSamples, 0 ) ) )
+        return kAudioFileUnsupportedDataFormatError;
+    
+    float * destination                    = buffer->audioData;
+    const size_t numberOfDestinationFrames = ( buffer->audioDataBytesCapacity / ( numberOfChannels * sizeof( float ) ) );
+    size_t numberOfFramesWritten           = 0;
+    OSStatus err                           = noErr;
+    
+    for( ;; )
+    {
+        // ===================
+        //
+        // 1. Write output from the input already in the resampler, or finish once the audio data has ended
+        //
+        // ===================
+        
+        if( resampler->sourceEnded )
+        {
+            const size_t numberOfFrames = finishResamplingFloat32( resampler, destination + ( numberOfFramesWritten * numberOfChannels ),
+                                                                   ( numberOfDestinationFrames - numberOfFramesWritten ) );
+            numberOfFramesWritten      += numberOfFrames;
+            
+            if( numberOfFramesWritten < numberOfDestinationFrames )
+                err = kAudioFileEndOfFileError;
+            
+            break;
+        }
+        
+        numberOfFramesWritten += produceResampledFrames( resampler, destination + ( numberOfFramesWritten * numberOfChannels ),
+                                                         ( numberOfDestinationFrames - numberOfFramesWritten ), true );
+        
+        if( numberOfFramesWritten == numberOfDestinationFrames )
+            break;
+        
+        // ===================
+        //
+        // 2. Read as many source frames as the resampler has room for, and convert them to floats
+        //
+        // ===================
+        
+        size_t numberOfFrames = compactResamplerRows( resampler );
+        
+        if( numberOfFrames > kSUSoundResamplerFramesPerRun )
+            numberOfFrames = kSUSoundResamplerFramesPerRun;
+        
+        SUSoundBuffer sourceBuffer = {
+            .audioData              = resampler->sourceBytes,
+            .audioDataBytesCapacity = (UInt32)( numberOfFrames * format->mBytesPerFrame ),
+        };
+        
+        err            = fillSoundBufferFromAudioData( &sourceBuffer, audioData, ioPlaybackPosition );
+        numberOfFrames = ( sourceBuffer.audioDataByteSize / format->mBytesPerFrame );
+        
+        if( numberOfFrames > 0 )
+        {
+            convertSamplesToFloat32( format, resampler->sourceBytes, resampler->sourceSamples, numberOfFrames * numberOfChannels );
+            appendResamplerInput( resampler, resampler->sourceSamples, numberOfFrames );
+        }
+        
+        if( kAudioFileEndOfFileError == err )
+        {
+            resampler->sourceEnded = true;
+            err = noErr;
+        }
+        else if( ( noErr != err ) || ( 0 == numberOfFrames ) )
+        {
+            break;
+        }
+    }
+    
+    buffer->audioDataByteSize = (UInt32)( numberOfFramesWritten * numberOfChannels * sizeof( float ) );
+    
+    return err;
+}
@@ -0,0 +1,141 @@
+//
+//  SUSoundResampler.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUSoundResampler_h
+#define SpringUtils_SUSoundResampler_h
+
+#import "SUSoundCore.h"
+
+/** Band-limited polyphase sample rate conversion.
+ *
+ *  A resampler converts between two sample rates whose ratio, after rounding each rate to a whole number of hertz, is
+ *  L/M in lowest terms (e.g. 147/160 from 48 kHz to 44.1 kHz). Each output frame is the dot product of
+ *  kSUSoundResamplerNumberOfTaps input frames with one of L phases of a Kaiser-windowed sinc filter, whose cutoff is the
+ *  Nyquist frequency of the lower of the two rates. The phases are computed once, when the resampler is created; when L is
+ *  larger than kSUSoundResamplerMaximumNumberOfPhases, the nearest earlier phase is used, although output frames are still
+ *  positioned exactly.
+ *
+ *  Output frame `n` is sampled at exactly `n` * M/L input frames, so the filter adds no delay and converting a whole buffer
+ *  produces ceil( `frames` * L/M ) frames. Dot products use SSE2 or NEON.
+ *
+ *  A resampler may be used offline (see copyAudioDataWithSampleRate()), or to fill buffers at the destination rate from audio
+ *  data at the source rate (see fillSoundBufferFromAudioDataResampled()). It keeps the filter's history between calls, so
+ *  each stream of audio needs its own resampler. Resampling does not allocate memory.
+ */
+
+typedef struct _SUSoundResampler *SUSoundResampler;
+
+/** The number of input frames contributing to each output frame. */
+
+#define kSUSoundResamplerNumberOfTaps           64
+
+/** The largest number of filter phases a resampler precomputes. */
+
+#define kSUSoundResamplerMaximumNumberOfPhases  1024
+
+
+//-----------------------------/
+/** @name Creating Resamplers */
+//-----------------------------/
+
+
+/** Creates a resampler.
+ *
+ *  @param  sourceSampleRate        The sample rate of the input. It is rounded to a whole number of hertz.
+ *  @param  destinationSampleRate   The sample rate of the output. It is rounded to a whole number of hertz.
+ *  @param  numberOfChannels        The number of interleaved channels in the input and output.
+ *
+ *  @returns                        A new resampler, or NULL if either sample rate is less than 1 Hz or greater than 1 MHz, or
+ *                                  the number of channels is 0. You must release this value by calling freeSoundResampler().
+ */
+
+SU_EXTERN SUSoundResampler createSoundResampler( Float64 sourceSampleRate, Float64 destinationSampleRate, UInt32 numberOfChannels );
+
+/** Frees a resampler. */
+
+SU_EXTERN void freeSoundResampler( SUSoundResampler resampler );
+
+/** Discards a resampler's history, so that it can start converting a new stream (e.g. after seeking). */
+
+SU_EXTERN void resetSoundResampler( SUSoundResampler resampler );
+
+
+//----------------------------------/
+/** @name Resampling Float Samples */
+//----------------------------------/
+
+
+/** Resamples interleaved float frames.
+ *
+ *  Input frames are used until either the input is exhausted or the output is full. Frames which have been used but do not yet
+ *  have enough following frames to produce output are kept in the resampler for the next call.
+ *
+ *  @param  resampler                   The resampler.
+ *  @param  source                      The input frames.
+ *  @param  numberOfSourceFrames        The number of input frames.
+ *  @param  oNumberOfSourceFramesUsed   On output, the number of input frames which were used. Pass the rest in the next call.
+ *  @param  destination                 The buffer to write output frames in to.
+ *  @param  numberOfDestinationFrames   The number of frames the output buffer can hold.
+ *
+ *  @returns                            The number of frames written to the output buffer.
+ */
+
+SU_EXTERN size_t resampleFloat32( SUSoundResampler resampler, const float * source, size_t numberOfSourceFrames, size_t * oNumberOfSourceFramesUsed, float * destination, size_t numberOfDestinationFrames );
+
+/** Writes the output frames which are still waiting on input, as if the input were followed by silence, up to the output frame
+ *  for the last input frame.
+ *
+ *  Call this function until it returns fewer frames than the output buffer can hold. The resampler must then be reset before
+ *  it is given more input.
+ *
+ *  @returns    The number of frames written to the output buffer.
+ */
+
+SU_EXTERN size_t finishResamplingFloat32( SUSoundResampler resampler, float * destination, size_t numberOfDestinationFrames );
+
+
+//-------------------------------/
+/** @name Resampling Audio Data */
+//-------------------------------/
+
+
+/** Creates a copy of linear PCM audio data at a different sample rate, in the canonical format (see canonicalAudioDataFormat()).
+ *
+ *  @param  audioData   The audio data to convert. It must be in a format supported by copyAudioDataInCanonicalFormat().
+ *  @param  sampleRate  The sample rate of the copy.
+ *
+ *  @returns            The converted audio data, or NULL if the audio data could not be converted.
+ *                      You must release this value by calling freeAudioData().
+ */
+
+SU_EXTERN SUSoundEffectData copyAudioDataWithSampleRate( SUSoundEffectData audioData, Float64 sampleRate );
+
+/** Fills a buffer with sound data converted to a different sample rate.
+ *
+ *  The buffer is filled with frames in the canonical format at the resampler's destination rate. Source frames are read from
+ *  the audio data as they are needed with fillSoundBufferFromAudioData(), so the playback position is in the same units, and
+ *  frames which have been read but not yet used are kept in the resampler. Reset the resampler whenever the playback
+ *  position is moved. Once the end of the audio data has been reached, the last output frames are written.
+ *
+ *  @param  buffer              The buffer to fill with float audio data. Packet descriptions are not used.
+ *  @param  audioData           The audio data to fill the buffer from. It must be CBR linear PCM with 8, 16, 24 or 32-bit samples,
+ *                              at the resampler's source rate and with the resampler's number of channels.
+ *  @param  resampler           The resampler.
+ *  @param  ioPlaybackPosition  On input, the cursor position to read source frames from. On output, the new cursor position.
+ *
+ *  @returns                    A result code, which is equal to kAudioFileEndOfFileError once the last output frame has been
+ *                              written, kSUAudioDataNotReadyError if the buffer could not be filled because the audio data
+ *                              is still being read, or kAudioFileUnsupportedDataFormatError if the audio data does not match
+ *                              the resampler.
+ */
+
+SU_EXTERN OSStatus fillSoundBufferFromAudioDataResampled( SUSoundBuffer * buffer, SUSoundEffectData audioData, SUSoundResampler resampler, SInt64 * ioPlaybackPosition );
+
+#endif
@@ -0,0 +1,15 @@
+//
+//  SUSoundResampler_Private.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundResampler.h"
+
+// A variant of resampleFloat32() which can be forced to use its scalar dot product, for comparison against the SIMD kernel.
+
+SU_EXTERN size_t resampleFloat32Kernel( SUSoundResampler resampler, const float * source, size_t numberOfSourceFrames, size_t * oNumberOfSourceFramesUsed, float * destination, size_t numberOfDestinationFrames, bool vector );
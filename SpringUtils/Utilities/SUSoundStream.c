@@ -0,0 +1,350 @@
+//
+//  SUSoundStream.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundStream.h"
+
+#import <pthread.h>
+#import <dispatch/dispatch.h>
+
+typedef struct _SUSoundStreamChunk {
+    
+    void * audioData;                                   /**< Audio data bytes. */
+    UInt32 audioDataByteSize;                           /**< The length of audio data. */
+    
+    AudioStreamPacketDescription * packetDescriptions;  /**< Packet descriptions, relative to audioData. NULL if the data format is CBR. */
+    UInt32 packetDescriptionCount;                      /**< The number of packet descriptions. */
+    
+    SInt64   playbackPosition;                          /**< The cursor position the chunk was read from. */
+    UInt32   generation;                                /**< The seek generation the chunk was read in. */
+    OSStatus status;                                    /**< The result of reading the chunk. */
+    
+} SUSoundStreamChunk;
+
+struct _SUSoundStream {
+    
+    AudioFileID audioFile;
+    
+    UInt32 bytesCapacity;
+    UInt32 packetDescriptionCapacity;
+    
+    // Ring of chunks. writeIndex is only written by the producer, readIndex only by the consumer.
+    
+    SUSoundStreamChunk * chunks;
+    UInt32 numberOfChunks;
+    UInt64 writeIndex;
+    UInt64 readIndex;
+    
+    // Seek requests, written by the consumer. The position is published by incrementing the generation.
+    
+    SInt64 seekPosition;
+    UInt32 generation;
+    
+    // Consumer state. finalStatus is kAudioFileEndOfFileError or the read error which stopped the stream, until the next seek.
+    
+    OSStatus finalStatus;
+    UInt64   underrunCount;
+    
+    // Producer thread. It parks on wakeup while the ring is full or it has stopped reading, and the consumer signals it
+    // whenever it frees a chunk or seeks.
+    
+    bool                 running;
+    pthread_t            producerThread;
+    dispatch_semaphore_t wakeup;
+};
+
+#pragma mark -
+#pragma mark Producer
+
+static void readChunk( SUSoundStream stream, SUSoundStreamChunk * chunk, SInt64 playbackPosition ) {
+    
+    chunk->playbackPosition       = playbackPosition;
+    chunk->audioDataByteSize      = stream->bytesCapacity;
+    chunk->packetDescriptionCount = stream->packetDescriptionCapacity;
+    
+    if( stream->packetDescriptionCapacity > 0 )
+    {
+        chunk->status = AudioFileReadPacketData( stream->audioFile,
+                                                 true,
+                                                 &( chunk->audioDataByteSize ),
+                                                 chunk->packetDescriptions,
+                                                 playbackPosition,
+                                                 &( chunk->packetDescriptionCount ),
+                                                 chunk->audioData );
+    }
+    else
+    {
+        chunk->packetDescriptionCount = 0;
+        chunk->status = AudioFileReadBytes( stream->audioFile,
+                                            true,
+                                            playbackPosition,
+                                            &( chunk->audioDataByteSize ),
+                                            chunk->audioData );
+    }
+}
+
+static void * soundStreamProducer( void * context ) {
+    
+    SUSoundStream stream = context;
+    
+    UInt32 generation       = __atomic_load_n( &stream->generation, __ATOMIC_ACQUIRE );
+    SInt64 playbackPosition = __atomic_load_n( &stream->seekPosition, __ATOMIC_RELAXED );
+    bool   stoppedReading   = false;
+    
+    while( __atomic_load_n( &stream->running, __ATOMIC_ACQUIRE ) )
+    {
+        // Restart from the requested position if the consumer has seeked.
+        
+        const UInt32 currentGeneration = __atomic_load_n( &stream->generation, __ATOMIC_ACQUIRE );
+        
+        if( currentGeneration != generation )
+        {
+            generation       = currentGeneration;
+            playbackPosition = __atomic_load_n( &stream->seekPosition, __ATOMIC_RELAXED );
+            stoppedReading   = false;
+        }
+        
+        // Park while the ring is full, or the file has been read to the end or failed to read.
+        
+        const UInt64 writeIndex = __atomic_load_n( &stream->writeIndex, __ATOMIC_RELAXED );
+        const UInt64 readIndex  = __atomic_load_n( &stream->readIndex,  __ATOMIC_ACQUIRE );
+        
+        if( stoppedReading || ( ( writeIndex - readIndex ) >= stream->numberOfChunks ) )
+        {
+            dispatch_semaphore_wait( stream->wakeup, DISPATCH_TIME_FOREVER );
+            continue;
+        }
+        
+        // Read the next chunk and publish it to the consumer.
+        
+        SUSoundStreamChunk * chunk = &( stream->chunks[ writeIndex % stream->numberOfChunks ] );
+        
+        readChunk( stream, chunk, playbackPosition );
+        chunk->generation = generation;
+        
+        if( stream->packetDescriptionCapacity > 0 )
+        {
+            playbackPosition += chunk->packetDescriptionCount;
+        }
+        else
+        {
+            playbackPosition += chunk->audioDataByteSize;
+        }
+        
+        stoppedReading = ( noErr != chunk->status );
+        
+        __atomic_store_n( &stream->writeIndex, writeIndex + 1, __ATOMIC_RELEASE );
+    }
+    
+    return NULL;
+}
+
+#pragma mark -
+#pragma mark Creating and Freeing Streams
+
+SUSoundStream createSoundStream( AudioFileID audioFile,
+                                 UInt32 bytesCapacity,
+                                 UInt32 packetDescriptionCapacity,
+                                 UInt32 numberOfChunks,
+                                 SInt64 playbackPosition ) {
+    
+    if( ( NULL == audioFile ) || ( 0 == bytesCapacity ) || ( 0 == numberOfChunks ) )
+        return NULL;
+    
+    SUSoundStream stream = calloc( 1, sizeof( struct _SUSoundStream ) );
+    
+    if( NULL == stream )
+        return NULL;
+    
+    stream->audioFile                   = audioFile;
+    stream->bytesCapacity               = bytesCapacity;
+    stream->packetDescriptionCapacity   = packetDescriptionCapacity;
+    stream->numberOfChunks              = numberOfChunks;
+    stream->seekPosition                = playbackPosition;
+    stream->running                     = true;
+    stream->wakeup                      = dispatch_semaphore_create( 0 );
+    
+    if( NULL == stream->wakeup )
+    {
+        free( stream );
+        return NULL;
+    }
+    
+    // Allocate all chunk buffers up-front, so nothing is allocated while streaming.
+    
+    stream->chunks = calloc( numberOfChunks, sizeof( SUSoundStreamChunk ) );
+    
+    if( NULL == stream->chunks )
+    {
+        stream->running = false;
+        freeSoundStream( stream );
+        return NULL;
+    }
+    
+    for( UInt32 i = 0; i < numberOfChunks; i++ )
+    {
+        stream->chunks[ i ].audioData = malloc( bytesCapacity );
+        
+        if( packetDescriptionCapacity > 0 )
+        {
+            stream->chunks[ i ].packetDescriptions = malloc( packetDescriptionCapacity * sizeof( AudioStreamPacketDescription ) );
+        }
+        
+        if( ( NULL == stream->chunks[ i ].audioData ) || ( ( packetDescriptionCapacity > 0 ) && ( NULL == stream->chunks[ i ].packetDescriptions ) ) )
+        {
+            stream->running = false;
+            freeSoundStream( stream );
+            return NULL;
+        }
+    }
+    
+    if( 0 != pthread_create( &stream->producerThread, NULL, soundStreamProducer, stream ) )
+    {
+        stream->running = false;
+        freeSoundStream( stream );
+        return NULL;
+    }
+    
+    return stream;
+}
+
+void freeSoundStream( SUSoundStream stream ) {
+    
+    if( NULL != stream )
+    {
+        if( __atomic_exchange_n( &stream->running, false, __ATOMIC_ACQ_REL ) )
+        {
+            dispatch_semaphore_signal( stream->wakeup );
+            pthread_join( stream->producerThread, NULL );
+        }
+        
+        if( NULL != stream->wakeup )
+        {
+            dispatch_release( stream->wakeup );
+        }
+        
+        if( NULL != stream->chunks )
+        {
+            for( UInt32 i = 0; i < stream->numberOfChunks; i++ )
+            {
+                free( stream->chunks[ i ].audioData );
+                free( stream->chunks[ i ].packetDescriptions );
+            }
+            
+            free( stream->chunks );
+        }
+        
+        free( stream );
+    }
+}
+
+#pragma mark -
+#pragma mark Reading from the Stream
+
+OSStatus fillBufferFromSoundStream( AudioQueueBufferRef inBuffer,
+                                    SUSoundStream stream,
+                                    SInt64 * ioPlaybackPosition ) {
+    
+    // 1. Reset the buffer
+    
+    inBuffer->mAudioDataByteSize      = 0;
+    inBuffer->mPacketDescriptionCount = 0;
+    
+    if( ( inBuffer->mAudioDataBytesCapacity < stream->bytesCapacity ) ||
+        ( inBuffer->mPacketDescriptionCapacity < stream->packetDescriptionCapacity ) )
+    {
+        return kAudioFileOperationNotSupportedError;
+    }
+    
+    if( noErr != stream->finalStatus )
+    {
+        return stream->finalStatus;
+    }
+    
+    // 2. Pop the next chunk, discarding any which were read before the last seek
+    
+    const UInt32 generation = stream->generation;
+    
+    UInt64 readIndex = stream->readIndex;
+    SUSoundStreamChunk * chunk;
+    
+    while( true )
+    {
+        if( readIndex == __atomic_load_n( &stream->writeIndex, __ATOMIC_ACQUIRE ) )
+        {
+            __atomic_fetch_add( &stream->underrunCount, 1, __ATOMIC_RELAXED );
+            return kSUAudioDataNotReadyError;
+        }
+        
+        chunk = &( stream->chunks[ readIndex % stream->numberOfChunks ] );
+        
+        if( chunk->generation == generation )
+            break;
+        
+        __atomic_store_n( &stream->readIndex, ++readIndex, __ATOMIC_RELEASE );
+        dispatch_semaphore_signal( stream->wakeup );
+    }
+    
+    // If the caller moved the playback cursor, restart reading from its new position.
+    
+    if( chunk->playbackPosition != *ioPlaybackPosition )
+    {
+        seekSoundStream( stream, *ioPlaybackPosition );
+        __atomic_fetch_add( &stream->underrunCount, 1, __ATOMIC_RELAXED );
+        return kSUAudioDataNotReadyError;
+    }
+    
+    // 3. Copy the chunk in to the buffer
+    
+    memcpy( inBuffer->mAudioData, chunk->audioData, chunk->audioDataByteSize );
+    inBuffer->mAudioDataByteSize = chunk->audioDataByteSize;
+    
+    if( chunk->packetDescriptionCount > 0 )
+    {
+        memcpy( inBuffer->mPacketDescriptions, chunk->packetDescriptions, chunk->packetDescriptionCount * sizeof( AudioStreamPacketDescription ) );
+    }
+    inBuffer->mPacketDescriptionCount = chunk->packetDescriptionCount;
+    
+    const OSStatus err = chunk->status;
+    
+    __atomic_store_n( &stream->readIndex, readIndex + 1, __ATOMIC_RELEASE );
+    dispatch_semaphore_signal( stream->wakeup );
+    
+    // 4. Advance the playback cursor
+    
+    if( stream->packetDescriptionCapacity > 0 )
+    {
+        *ioPlaybackPosition += inBuffer->mPacketDescriptionCount;
+    }
+    else
+    {
+        *ioPlaybackPosition += inBuffer->mAudioDataByteSize;
+    }
+    
+    // The producer stops at the end of the file or the first read error. Keep returning that result until the next seek, rather
+    // than reporting underruns for chunks which will never arrive.
+    
+    stream->finalStatus = err;
+    
+    return err;
+}
+
+void seekSoundStream( SUSoundStream stream, SInt64 playbackPosition ) {
+    
+    stream->finalStatus = noErr;
+    
+    __atomic_store_n( &stream->seekPosition, playbackPosition, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &stream->generation, 1, __ATOMIC_RELEASE );
+    dispatch_semaphore_signal( stream->wakeup );
+}
+
+UInt64 soundStreamUnderrunCount( SUSoundStream stream ) {
+    
+    return __atomic_load_n( &stream->underrunCount, __ATOMIC_RELAXED );
+}
@@ -0,0 +1,93 @@
+//
+//  SUSoundStream.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUSoundStream_h
+#define SpringUtils_SUSoundStream_h
+
+#import "SUSoundTools.h"
+
+/** Streams audio data from a file on a background thread.
+ *
+ *  A sound stream owns a producer thread which reads chunks of the file ahead of playback in to a single-producer/single-consumer
+ *  ring. fillBufferFromSoundStream() only copies a chunk which is already in memory, so it never performs file I/O and is safe
+ *  to call from an AudioQueue callback.
+ */
+
+typedef struct _SUSoundStream *SUSoundStream;
+
+
+//------------------------------------/
+/** @name Creating and Freeing Streams */
+//------------------------------------/
+
+
+/** Creates a sound stream and starts reading from the given audio file.
+ *
+ *  The stream reads chunks which are the same size as the AudioQueue buffers it will fill, so `bytesCapacity` and
+ *  `packetDescriptionCapacity` should be the capacities of those buffers.
+ *
+ *  @param  audioFile                   The audio file to read. It must remain open, and must not be read from elsewhere, until the stream is freed.
+ *  @param  bytesCapacity               The maximum number of audio bytes in each chunk.
+ *  @param  packetDescriptionCapacity   The maximum number of packets in each chunk, or 0 if the audio data format is CBR.
+ *  @param  numberOfChunks              The number of chunks to read ahead of playback.
+ *  @param  playbackPosition            The cursor position to begin reading from.
+ *
+ *  @returns                            A new sound stream, or NULL if it could not be created. You must release this value by calling freeSoundStream().
+ */
+
+SU_EXTERN SUSoundStream createSoundStream( AudioFileID audioFile, UInt32 bytesCapacity, UInt32 packetDescriptionCapacity, UInt32 numberOfChunks, SInt64 playbackPosition );
+
+/** Stops a sound stream's producer thread and releases its memory buffers.
+ *
+ *  @param  stream  The stream to release. After calling this function, you should no longer use the stream.
+ */
+
+SU_EXTERN void freeSoundStream( SUSoundStream stream );
+
+
+//----------------------------------/
+/** @name Reading from the Stream */
+//----------------------------------/
+
+
+/** Fills an AudioQueue buffer with the next chunk read by the stream.
+ *
+ *  This function does not block, allocate memory or take locks.
+ *
+ *  @param  inBuffer            The buffer to fill with audio data. Its capacities must be at least those the stream was created with.
+ *  @param  stream              The stream to fill the buffer from.
+ *  @param  ioPlaybackPosition  On input, the cursor position to fill from. On output, the new cursor position.
+ *
+ *  @returns                    A result code, as for fillBufferFromAudioFile(). If the next chunk hasn't been read yet, the buffer is
+ *                              left empty, the stream's underrun count is incremented and kSUAudioDataNotReadyError is returned.
+ *                              Once the stream has returned kAudioFileEndOfFileError or a read error, it keeps returning it until
+ *                              seekSoundStream() is called.
+ */
+
+SU_EXTERN OSStatus fillBufferFromSoundStream( AudioQueueBufferRef inBuffer, SUSoundStream stream, SInt64 * ioPlaybackPosition );
+
+/** Discards any chunks which have been read ahead and restarts reading from the given position.
+ *
+ *  This function must be called from the same thread as fillBufferFromSoundStream().
+ *
+ *  @param  stream              The stream.
+ *  @param  playbackPosition    The cursor position to continue reading from.
+ */
+
+SU_EXTERN void seekSoundStream( SUSoundStream stream, SInt64 playbackPosition );
+
+/** Returns the number of times fillBufferFromSoundStream() was called before the next chunk had been read.
+ *
+ *  @param  stream  The stream.
+ */
+
+SU_EXTERN UInt64 soundStreamUnderrunCount( SUSoundStream stream );
+
+#endif
@@ -9,45 +9,32 @@
 //
 
 #import "SUSoundTools.h"
+#import "SUSoundTools_Private.h"
+#import "SUSoundCore_Private.h"
+#import "SUSoundInstrumentation_Private.h"
 
-#define CHECK_OSSTATUS_FREE_AND_RETURN( err, freeCmd, retVal ) if( __builtin_expect( noErr != err, 0 ) ) { freeCmd; return retVal; }
+#import <pthread.h>
 
 #pragma mark -
 #pragma mark Reading Audio Date from a file
 
-SUSoundEffectData readAudioDataFromFile ( AudioFileID audioFile ) {
-    
-    // Verify the audio file
-    
-    if( NULL == audioFile )
-        return NULL;
-    
-    SUSoundEffectData data = calloc( 1, sizeof( struct _SUSoundEffectData ) );
+OSStatus readAudioDataProperties( AudioFileID audioFile, SUSoundEffectData data ) {
     
     OSStatus err;
-
-
-    // ===================
-    //
-    // 1. Read decoding information
-    //
-    // ===================
-
-
     UInt32 propertySz;
     
     // Audio Data Format
     
     propertySz  = sizeof( data->dataFormat );
     err         = AudioFileGetProperty( audioFile, kAudioFilePropertyDataFormat, &propertySz, &data->dataFormat );
-    CHECK_OSSTATUS_FREE_AND_RETURN( err, freeAudioData( data ), NULL )
+    if( noErr != err ) return err;
     
     // Number of audio bytes
     
     UInt64 byte = 0;
     propertySz  = sizeof( byte );
     err         = AudioFileGetProperty( audioFile, kAudioFilePropertyAudioDataByteCount, &propertySz, &byte );
-    CHECK_OSSTATUS_FREE_AND_RETURN( err, freeAudioData( data ), NULL )
+    if( noErr != err ) return err;
 
     data->numberOfAudioDataBytes = byte;
     
@@ -55,21 +42,159 @@ SUSoundEffectData readAudioDataFromFile ( AudioFileID audioFile ) {
     
     propertySz  = sizeof( data->maximumPacketSize );
     err         = AudioFileGetProperty( audioFile, kAudioFilePropertyPacketSizeUpperBound, &propertySz, &data->maximumPacketSize );
-    CHECK_OSSTATUS_FREE_AND_RETURN( err, freeAudioData( data ), NULL )
+    if( noErr != err ) return err;
 
     // Number of audio packets
     
     UInt64 pkts = 0;
     propertySz  = sizeof( pkts );
     err         = AudioFileGetProperty( audioFile, kAudioFilePropertyAudioDataPacketCount, &propertySz, &pkts );
-    CHECK_OSSTATUS_FREE_AND_RETURN( err, freeAudioData( data ), NULL )
+    if( noErr != err ) return err;
 
     data->numberOfPackets = pkts;
+    
+    return noErr;
+}
+
+/** Returns the number of packets to read at a time when they are read in runs, which is about 64KB of audio data. */
+
+static UInt32 packetsPerReadRun( SUSoundEffectData data ) {
+    
+    const UInt32 runSize    = ( 64 * 1024 );
+    const UInt32 packetSize = ( data->maximumPacketSize > 0 ) ? data->maximumPacketSize : 1;
+    
+    return ( packetSize < runSize ) ? ( runSize / packetSize ) : 1;
+}
+
+/** Reads the next run of at most `maximumNumberOfPackets` packets, advancing the totals read. The packets are read in to `buffer`
+ *  after the bytes already read. Packet start offsets are rebased to the start of the file's audio data. If the file has no more
+ *  packets, nothing is read and the totals are unchanged. */
+
+static OSStatus readPacketRun( AudioFileID audioFile, SUSoundEffectData data, void * buffer, UInt32 maximumNumberOfPackets,
+                               UInt64 * ioTotalPacketsRead, UInt64 * ioTotalBytesRead ) {
+    
+    const UInt64 totalBytesRead   = *ioTotalBytesRead;
+    const UInt64 totalPacketsRead = *ioTotalPacketsRead;
+    
+    UInt64 numberOfBytesToGo    = ( data->numberOfAudioDataBytes - totalBytesRead );
+    UInt32 numberOfBytesToRead  = ( numberOfBytesToGo > UINT32_MAX ) ? UINT32_MAX : (UInt32)numberOfBytesToGo;
+
+    UInt64 numberOfPacketsToGo   = ( data->numberOfPackets - totalPacketsRead );
+    UInt32 numberOfPacketsToRead = ( numberOfPacketsToGo > maximumNumberOfPackets ) ? maximumNumberOfPackets : (UInt32)numberOfPacketsToGo;
+    
+    AudioStreamPacketDescription * packetDescriptions = ( NULL != data->packetDescriptions ) ? ( data->packetDescriptions + totalPacketsRead ) : NULL;
+
+    OSStatus err = AudioFileReadPacketData( audioFile,
+                                            false,
+                                            &numberOfBytesToRead,
+                                            packetDescriptions,
+                                            totalPacketsRead,
+                                            &numberOfPacketsToRead,
+                                            ( buffer + totalBytesRead ) );
+
+    if( ( noErr != err ) || ( 0 == numberOfPacketsToRead ) )
+        return err;
+    
+    // Packet start offsets are relative to the buffer passed in to this read;
+    // rebase them so they are relative to the start of the audio data.
+    
+    if( ( NULL != packetDescriptions ) && ( totalBytesRead > 0 ) )
+    {
+        for( UInt32 i = 0; i < numberOfPacketsToRead; i++ )
+        {
+            packetDescriptions[ i ].mStartOffset += totalBytesRead;
+        }
+    }
+
+    *ioTotalBytesRead   += numberOfBytesToRead;
+    *ioTotalPacketsRead += numberOfPacketsToRead;
+    
+    return noErr;
+}
+
+/** Reads packets from the file in to `buffer`, which is advanced as data is read, so it must be large enough to hold all of the file's audio bytes.
+ *  Packet start offsets are always relative to the start of the file's audio data. */
+
+OSStatus readPacketData( AudioFileID audioFile, SUSoundEffectData data, void * buffer ) {
+    
+    OSStatus err = noErr;
+
+    UInt64 totalBytesRead   = 0;
+    UInt64 totalPacketsRead = 0;
+
+    while( ( totalPacketsRead < data->numberOfPackets ) || ( totalBytesRead < data->numberOfAudioDataBytes ) )
+    {
+        const UInt64 previousPacketsRead = totalPacketsRead;
+        
+        err = readPacketRun( audioFile, data, buffer, UINT32_MAX, &totalPacketsRead, &totalBytesRead );
+
+        if( ( noErr != err ) || ( previousPacketsRead == totalPacketsRead ) )
+        {
+            // Reading failed, or the file is shorter than it claims to be.
+            break;
+        }
+    }
+    
+    if( ( noErr == err ) && ( totalBytesRead != data->numberOfAudioDataBytes ) )
+    {
+        err = kAudioFileInvalidFileError;
+    }
+    
+    return err;
+}
+
+/** Maps the audio data region of the file at `path` without copying the audio bytes. */
+
+static OSStatus mapAudioData( AudioFileID audioFile, const char * path, SUSoundEffectData data ) {
+    
+    OSStatus err;
+    
+    // The audio data must be a single contiguous region of the file. Only CBR packets are known to be: VBR packets' offsets
+    // are relative to the data they were read in to, so they can't reveal chunks or gaps between packets in the file
+    // (e.g. interleaved chunks in an MPEG-4 file).
+    
+    if( 0 == data->dataFormat.mBytesPerPacket )
+        return kAudioFileOperationNotSupportedError;
+    
+    SInt64 dataOffset = 0;
+    UInt32 propertySz = sizeof( dataOffset );
+    err               = AudioFileGetProperty( audioFile, kAudioFilePropertyDataOffset, &propertySz, &dataOffset );
+    if( noErr != err ) return err;
+    
+    return mapAudioDataRegion( path, dataOffset, data );
+}
+
+static SUSoundEffectData readAudioDataFromFileWithOptions( AudioFileID audioFile, const char * path, SUAudioDataReadingOptions options ) {
+    
+    // Verify the audio file
+    
+    if( NULL == audioFile )
+        return NULL;
+    
+    SUSoundEffectData data = SU_CALLOC( 1, sizeof( struct _SUSoundEffectData ) );
+    
+    if( NULL == data )
+        return NULL;
+    
+    data->retainCount = 1;
+    
+    OSStatus err;
+
+
+    // ===================
+    //
+    // 1. Read decoding information
+    //
+    // ===================
+
+    
+    err = readAudioDataProperties( audioFile, data );
+    CHECK_OSSTATUS_FREE_AND_RETURN( err, freeAudioData( data ), NULL )
 
 
     // ===================
     //
-    // 2. Allocate memory for audio data
+    // 2. Allocate memory for packet descriptions
     //
     // ===================
 
@@ -79,81 +204,324 @@ SUSoundEffectData readAudioDataFromFile ( AudioFileID audioFile ) {
         free( data );
         return NULL;
     }
-
-    data->audioData = malloc( (size_t)data->numberOfAudioDataBytes );
     
     // If the audio format is variable bit-rate, we will need packet information,
     // so also allocate packet data
     
     if( 0 == data->dataFormat.mBytesPerPacket )
     {
-        data->packetDescriptions = malloc( (size_t)data->numberOfPackets * sizeof( AudioStreamPacketDescription ) );
+        data->packetDescriptions = SU_MALLOC( (size_t)data->numberOfPackets * sizeof( AudioStreamPacketDescription ) );
+        
+        if( NULL == data->packetDescriptions )
+        {
+            freeAudioData( data );
+            return NULL;
+        }
     }
 
 
     // ===================
     //
-    // 3. Read audio/packet data
+    // 3. Read (or map) audio/packet data
     //
     // ===================
 
-
-    UInt64 totalBytesRead   = 0;
-    UInt64 totalPacketsRead = 0;
-
-    while( ( totalPacketsRead < data->numberOfPackets ) || ( totalBytesRead < data->numberOfAudioDataBytes ) )
+    
+    err = kAudioFileOperationNotSupportedError;
+    
+    // Data which will be converted afterwards is only read once, so there is nothing to gain from mapping it.
+    
+    if( ( options & SUAudioDataReadingMapped ) && ( 0 == ( options & SUAudioDataReadingCanonicalFormat ) ) && ( NULL != path ) )
     {
-        UInt64 numberOfBytesToGo    = ( data->numberOfAudioDataBytes - totalBytesRead );
-        UInt32 numberOfBytesToRead  = ( numberOfBytesToGo > UINT32_MAX ) ? UINT32_MAX : (UInt32)numberOfBytesToGo;
-
-        UInt64 numberOfPacketsToGo   = ( data->numberOfPackets - totalPacketsRead );
-        UInt32 numberOfPacketsToRead = ( numberOfPacketsToGo > UINT32_MAX ) ? UINT32_MAX : (UInt32)numberOfPacketsToGo;
-
-        err = AudioFileReadPacketData( audioFile,
-                                       false,
-                                       &numberOfBytesToRead,
-                                       data->packetDescriptions,
-                                       totalPacketsRead,
-                                       &numberOfPacketsToRead,
-                                       data->audioData );
-
-        if( noErr != err )
-        {
-            // Reading failed.
-            break;
-        }
-        else
-        {
-            totalBytesRead   += numberOfBytesToRead;
-            totalPacketsRead += numberOfPacketsToRead;
-        }
+        err = mapAudioData( audioFile, path, data );
+    }
+    
+    // Audio data which could not be mapped is read in to the heap.
+    
+    if( noErr != err )
+    {
+        data->audioData = SU_MALLOC( (size_t)data->numberOfAudioDataBytes );
+        err             = ( NULL != data->audioData ) ? readPacketData( audioFile, data, data->audioData ) : kAudioFileUnspecifiedError;
     }
 
     // If reading failed, free resources and return NULL.
     
     CHECK_OSSTATUS_FREE_AND_RETURN( err, freeAudioData( data ), NULL )
+    
+    
+    // ===================
+    //
+    // 4. Index packet frames for seeking
+    //
+    // ===================
+    
+    
+    err = buildFrameIndex( data );
+    CHECK_OSSTATUS_FREE_AND_RETURN( err, freeAudioData( data ), NULL )
 
     // Return the read audio data.
 
     return data;
 }
 
-void freeAudioData ( SUSoundEffectData audioData ) {
+SUSoundEffectData readAudioDataFromFile ( AudioFileID audioFile ) {
+    
+    return finishReadingAudioData( readAudioDataFromFileWithOptions( audioFile, NULL, SUAudioDataReadingOptionsNone ), SUAudioDataReadingOptionsNone );
+}
+
+SUSoundEffectData readAudioDataFromURL( CFURLRef fileURL, SUAudioDataReadingOptions options ) {
+    
+    if( NULL == fileURL )
+        return NULL;
+    
+    UInt8 path[ PATH_MAX ];
+    
+    if( false == CFURLGetFileSystemRepresentation( fileURL, true, path, sizeof( path ) ) )
+        return NULL;
+    
+    AudioFileID audioFile = NULL;
+    
+    if( noErr != AudioFileOpenURL( fileURL, kAudioFileReadPermission, 0, &audioFile ) )
+        return NULL;
+    
+    SUSoundEffectData data = readAudioDataFromFileWithOptions( audioFile, (const char *)path, options );
+    
+    AudioFileClose( audioFile );
+    
+    return finishReadingAudioData( data, options );
+}
+
+#pragma mark -
+#pragma mark Reading Audio Data Progressively
+
+/** A file which is being read progressively, and how much of it has been read. */
+
+typedef struct _SUProgressiveReader {
+    
+    AudioFileID audioFile;
+    SUSoundEffectData data;     /**< The audio data being read. Once reading moves to a background thread, the reader holds a reference to it. */
+    
+    UInt32 packetsPerRun;
+    UInt64 totalPacketsRead;
+    UInt64 totalBytesRead;
+    
+} SUProgressiveReader;
+
+/** Reads the next run of packets in to place, then publishes them to fills by raising the watermark. */
+
+static OSStatus readNextProgressiveRun( SUProgressiveReader * reader ) {
+    
+    SUSoundEffectData data           = reader->data;
+    const UInt64 previousPacketsRead = reader->totalPacketsRead;
+    
+    OSStatus err = readPacketRun( reader->audioFile, data, data->audioData, reader->packetsPerRun, &reader->totalPacketsRead, &reader->totalBytesRead );
     
-    if( NULL != audioData )
+    if( noErr != err )
+        return err;
+    
+    if( previousPacketsRead == reader->totalPacketsRead )
+        return kAudioFileInvalidFileError;
+    
+    // CBR packets are only published once all of their bytes have been read.
+    
+    UInt64 numberOfPacketsAvailable = reader->totalPacketsRead;
+    
+    if( ( NULL == data->packetDescriptions ) && ( ( reader->totalBytesRead / data->dataFormat.mBytesPerPacket ) < numberOfPacketsAvailable ) )
+    {
+        numberOfPacketsAvailable = ( reader->totalBytesRead / data->dataFormat.mBytesPerPacket );
+    }
+    
+    __atomic_store_n( &data->progressiveLoad->numberOfPacketsAvailable, numberOfPacketsAvailable, __ATOMIC_RELEASE );
+    
+    return noErr;
+}
+
+/** Closes the file, publishes the result of reading it, and frees the reader. */
+
+static void finishReadingProgressively( SUProgressiveReader * reader, OSStatus err ) {
+    
+    SUSoundEffectData data = reader->data;
+    
+    if( ( noErr == err ) && ( reader->totalBytesRead != data->numberOfAudioDataBytes ) )
+    {
+        err = kAudioFileInvalidFileError;
+    }
+    
+    AudioFileClose( reader->audioFile );
+    free( reader );
+    
+    __atomic_store_n( &data->progressiveLoad->status, err, __ATOMIC_RELEASE );
+}
+
+/** Closes the file and frees the reader, along with audio data which could not be read. */
+
+static void abandonProgressiveReading( SUProgressiveReader * reader ) {
+    
+    AudioFileClose( reader->audioFile );
+    freeAudioData( reader->data );
+    free( reader );
+}
+
+static void * readRemainingPacketsProgressively( void * context ) {
+    
+    SUProgressiveReader * reader = context;
+    SUSoundEffectData data       = reader->data;
+    OSStatus err                 = noErr;
+    
+    while( ( noErr == err ) && ( reader->totalPacketsRead < data->numberOfPackets ) )
     {
-        if( NULL != audioData->audioData )
+        // If the reader holds the only reference, nobody will ever play the rest of the audio data.
+        
+        if( 1 == __atomic_load_n( &data->retainCount, __ATOMIC_ACQUIRE ) )
         {
-            free( audioData->audioData );
+            err = kAudioFileUnspecifiedError;
+            break;
         }
         
-        if( NULL != audioData->packetDescriptions )
+        err = readNextProgressiveRun( reader );
+    }
+    
+    finishReadingProgressively( reader, err );
+    freeAudioData( data );
+    
+    return NULL;
+}
+
+SUSoundEffectData readAudioDataFromURLProgressively( CFURLRef fileURL, UInt64 numberOfInitialPackets ) {
+    
+    if( NULL == fileURL )
+        return NULL;
+    
+    SUProgressiveReader * reader = SU_CALLOC( 1, sizeof( SUProgressiveReader ) );
+    SUSoundEffectData data       = SU_CALLOC( 1, sizeof( struct _SUSoundEffectData ) );
+    
+    if( ( NULL == reader ) || ( NULL == data ) || ( noErr != AudioFileOpenURL( fileURL, kAudioFileReadPermission, 0, &reader->audioFile ) ) )
+    {
+        free( reader );
+        free( data );
+        return NULL;
+    }
+    
+    reader->data      = data;
+    data->retainCount = 1;
+    
+    OSStatus err;
+
+
+    // ===================
+    //
+    // 1. Read decoding information
+    //
+    // ===================
+
+    
+    err = readAudioDataProperties( reader->audioFile, data );
+    
+    if( ( noErr == err ) && ( ( data->numberOfAudioDataBytes > SIZE_T_MAX ) || ( data->numberOfPackets > SIZE_T_MAX ) ) )
+    {
+        // Cannot read file - not enough memory.
+        err = kAudioFileUnspecifiedError;
+    }
+    
+    CHECK_OSSTATUS_FREE_AND_RETURN( err, abandonProgressiveReading( reader ), NULL )
+
+
+    // ===================
+    //
+    // 2. Allocate memory for audio and packet data, which is read in to place
+    //
+    // ===================
+
+    
+    data->audioData       = SU_MALLOC( (size_t)data->numberOfAudioDataBytes );
+    data->progressiveLoad = SU_CALLOC( 1, sizeof( struct _SUProgressiveLoad ) );
+    
+    if( 0 == data->dataFormat.mBytesPerPacket )
+    {
+        data->packetDescriptions = SU_MALLOC( (size_t)data->numberOfPackets * sizeof( AudioStreamPacketDescription ) );
+    }
+    
+    if( ( NULL == data->audioData ) || ( NULL == data->progressiveLoad ) || ( ( 0 == data->dataFormat.mBytesPerPacket ) && ( NULL == data->packetDescriptions ) ) )
+    {
+        err = kAudioFileUnspecifiedError;
+    }
+    
+    CHECK_OSSTATUS_FREE_AND_RETURN( err, abandonProgressiveReading( reader ), NULL )
+    
+    data->progressiveLoad->status = kSUAudioDataNotReadyError;
+    reader->packetsPerRun         = packetsPerReadRun( data );
+
+
+    // ===================
+    //
+    // 3. Read the initial packets on this thread
+    //
+    // ===================
+
+    
+    // Seeking by time needs a frame index, which can only be built for formats with a variable number of frames per packet
+    // once every packet has been read. Those formats are read in full before returning.
+    
+    if( 0 == data->dataFormat.mFramesPerPacket )
+    {
+        numberOfInitialPackets = data->numberOfPackets;
+    }
+    
+    if( numberOfInitialPackets > data->numberOfPackets )
+    {
+        numberOfInitialPackets = data->numberOfPackets;
+    }
+    
+    while( ( noErr == err ) && ( reader->totalPacketsRead < numberOfInitialPackets ) )
+    {
+        err = readNextProgressiveRun( reader );
+    }
+    
+    if( noErr == err )
+    {
+        err = buildFrameIndex( data );
+    }
+    
+    CHECK_OSSTATUS_FREE_AND_RETURN( err, abandonProgressiveReading( reader ), NULL )
+
+
+    // ===================
+    //
+    // 4. Read the remaining packets on a background thread
+    //
+    // ===================
+
+    
+    if( reader->totalPacketsRead == data->numberOfPackets )
+    {
+        finishReadingProgressively( reader, noErr );
+        
+        // The file may have been shorter than it claimed.
+        
+        err = audioDataLoadingStatus( data );
+        CHECK_OSSTATUS_FREE_AND_RETURN( err, freeAudioData( data ), NULL )
+    }
+    else
+    {
+        pthread_attr_t attributes;
+        pthread_t thread;
+        
+        pthread_attr_init( &attributes );
+        pthread_attr_setdetachstate( &attributes, PTHREAD_CREATE_DETACHED );
+        
+        retainAudioData( data );
+        
+        if( 0 != pthread_create( &thread, &attributes, readRemainingPacketsProgressively, reader ) )
         {
-            free( audioData->packetDescriptions );
+            // Without a thread, the rest of the file is read now.
+            
+            readRemainingPacketsProgressively( reader );
         }
         
-        free( audioData );
+        pthread_attr_destroy( &attributes );
     }
+    
+    return data;
 }
 
 #pragma mark -
@@ -163,6 +531,8 @@ OSStatus fillBufferFromAudioFile( AudioQueueBufferRef inBuffer,
                                   AudioFileID audioFile,
                                   SInt64 * ioPlaybackPosition ) {
     
+    SU_SOUND_INSTRUMENTATION_BEGIN( instrumentation );
+    
     OSStatus err;
     
     // 1. Read the audio data
@@ -200,6 +570,10 @@ OSStatus fillBufferFromAudioFile( AudioQueueBufferRef inBuffer,
         *ioPlaybackPosition += inBuffer->mAudioDataByteSize;
     }
     
+    // The file's format isn't known here, so its deadline isn't recorded.
+    
+    SU_SOUND_INSTRUMENTATION_END( instrumentation, inBuffer->mAudioDataByteSize, inBuffer->mPacketDescriptionCount, 0 );
+    
     return err;
 }
 
@@ -207,103 +581,56 @@ OSStatus fillBufferFromAudioData( AudioQueueBufferRef inBuffer,
                                   SUSoundEffectData audioData,
                                   SInt64 * ioPlaybackPosition ) {
     
-    // 1. Reset the buffer
+    SUSoundBuffer buffer = {
+        .audioData                  = inBuffer->mAudioData,
+        .audioDataBytesCapacity     = inBuffer->mAudioDataBytesCapacity,
+        .packetDescriptions         = inBuffer->mPacketDescriptions,
+        .packetDescriptionCapacity  = inBuffer->mPacketDescriptionCapacity,
+    };
     
-    inBuffer->mAudioDataByteSize      = 0;
-    inBuffer->mPacketDescriptionCount = 0;
+    OSStatus err = fillSoundBufferFromAudioData( &buffer, audioData, ioPlaybackPosition );
     
-    // 2. Calculate the byte range to fill the buffer with
+    inBuffer->mAudioDataByteSize      = buffer.audioDataByteSize;
+    inBuffer->mPacketDescriptionCount = buffer.packetDescriptionCount;
     
-    SInt64 audioDataBufferLocation = 0;
-    UInt32 audioDataBufferLength   = 0;
-    
-    if( NULL != audioData->packetDescriptions )
-    {
-        // Read the packet-data in to the buffer,
-        // and use it to calculate the buffer's byte range.
-        
-        UInt32 numberOfPacketsRead = 0;
-        
-        while( numberOfPacketsRead < inBuffer->mPacketDescriptionCapacity )
-        {
-            const UInt64 packetIndex = ( *ioPlaybackPosition + numberOfPacketsRead );
-
-            // Stop buffering if we've already buffered all packets in the audio data
-            
-            if( packetIndex > audioData->numberOfPackets )
-                break;
-            
-            AudioStreamPacketDescription * sourcePacket      = &( audioData->packetDescriptions[ packetIndex ] );
-            AudioStreamPacketDescription * destinationPacket = &( inBuffer->mPacketDescriptions[ numberOfPacketsRead ] );
-            
-            if( ( audioDataBufferLength + sourcePacket->mDataByteSize ) <= inBuffer->mAudioDataBytesCapacity )
-            {
-                // The buffer has space for the data in this packet,
-                // so copy the packet description in (rebasing the start offset to this buffer rather than the file as a whole).
-                
-                destinationPacket->mStartOffset             = audioDataBufferLength;
-                destinationPacket->mDataByteSize            = sourcePacket->mDataByteSize;
-                destinationPacket->mVariableFramesInPacket  = sourcePacket->mVariableFramesInPacket;
-                
-                // Expand the amount of data to copy to include this packet
-                
-                audioDataBufferLength += sourcePacket->mDataByteSize;
-            }
-
-            // If reading in the first packet, set the buffer's audio data start location to the start offset of the source packet.
-
-            if( 0 == numberOfPacketsRead )
-            {
-                audioDataBufferLocation = sourcePacket->mStartOffset;
-            }
-
-            // Increment number of packets read.
-
-            numberOfPacketsRead++;
-        }
-        
-        inBuffer->mPacketDescriptionCount = numberOfPacketsRead;
-    }
-    else
-    {
-        // Calculate this buffer's byte range
-        
-        const SInt64 remainingBytes = audioData->numberOfAudioDataBytes - *ioPlaybackPosition;
-        const UInt32 bytesToRead    = ( inBuffer->mAudioDataBytesCapacity < remainingBytes ) ? inBuffer->mAudioDataBytesCapacity : (UInt32)remainingBytes;
+    return err;
+}
 
-        audioDataBufferLocation = *ioPlaybackPosition;
-        audioDataBufferLength   = bytesToRead;
-    }
+OSStatus fillBufferFromSoundBufferPlan( AudioQueueBufferRef inBuffer,
+                                        SUSoundBufferPlan plan,
+                                        SInt64 * ioPlaybackPosition ) {
+    
+    SUSoundBuffer buffer = {
+        .audioData                  = inBuffer->mAudioData,
+        .audioDataBytesCapacity     = inBuffer->mAudioDataBytesCapacity,
+        .packetDescriptions         = inBuffer->mPacketDescriptions,
+        .packetDescriptionCapacity  = inBuffer->mPacketDescriptionCapacity,
+    };
+    
+    OSStatus err = fillSoundBufferFromPlan( &buffer, plan, ioPlaybackPosition );
     
-    // 3. Copy the audio data in to the buffer
+    inBuffer->mAudioDataByteSize      = buffer.audioDataByteSize;
+    inBuffer->mPacketDescriptionCount = buffer.packetDescriptionCount;
+    
+    return err;
+}
 
-    memcpy( inBuffer->mAudioData, audioData->audioData + audioDataBufferLocation, audioDataBufferLength );
-    inBuffer->mAudioDataByteSize = (UInt32)audioDataBufferLength;
+OSStatus fillBufferFromAudioDataWithSchedule( AudioQueueBufferRef inBuffer,
+                                              SUSoundEffectData audioData,
+                                              SUSoundPlaybackSchedule * ioSchedule,
+                                              SInt64 * ioPlaybackPosition ) {
     
-    // 4. Advance the playback cursor,
-    //    Set the error to kAudioFileEndOfFileError if the playback cursor has reached the end of the data
+    SUSoundBuffer buffer = {
+        .audioData                  = inBuffer->mAudioData,
+        .audioDataBytesCapacity     = inBuffer->mAudioDataBytesCapacity,
+        .packetDescriptions         = inBuffer->mPacketDescriptions,
+        .packetDescriptionCapacity  = inBuffer->mPacketDescriptionCapacity,
+    };
     
-    OSStatus err = noErr;
+    OSStatus err = fillSoundBufferFromAudioDataWithSchedule( &buffer, audioData, ioSchedule, ioPlaybackPosition );
     
-    if( inBuffer->mPacketDescriptionCapacity > 0 )
-    {
-        *ioPlaybackPosition += inBuffer->mPacketDescriptionCount;
-        
-        if( *ioPlaybackPosition >= audioData->numberOfPackets )
-        {
-            err = kAudioFileEndOfFileError;
-        }
-    }
-    else
-    {
-        *ioPlaybackPosition += inBuffer->mAudioDataByteSize;
-        
-        if( *ioPlaybackPosition >= audioData->numberOfAudioDataBytes )
-        {
-            err = kAudioFileEndOfFileError;
-        }
-    }
+    inBuffer->mAudioDataByteSize      = buffer.audioDataByteSize;
+    inBuffer->mPacketDescriptionCount = buffer.packetDescriptionCount;
     
     return err;
 }
-
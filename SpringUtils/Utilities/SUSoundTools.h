@@ -12,21 +12,7 @@
 #define SpringUtils_SUSoundTools_h
 
 #import <AudioToolbox/AudioToolbox.h>
-#import "SUBase.h"
-
-typedef struct _SUSoundEffectData {
-    
-    AudioStreamBasicDescription dataFormat;             /**< Audio data format description. */
-
-    void * audioData;                                   /**< Audio data bytes. */
-    UInt64 numberOfAudioDataBytes;                      /**< The length of audio data. */
-
-    AudioStreamPacketDescription * packetDescriptions;  /**< Audio packet descriptions. NULL if the data format is CBR. */
-    UInt64 numberOfPackets;                             /**< The number of audio packet descriptions. */
-    UInt32 maximumPacketSize;                           /**< The maximum size (in bytes) of data represented by a single packet description. */
-    
-} *SUSoundEffectData;
-
+#import "SUSoundCore.h"
 
 //-----------------------------------------/
 /** @name Reading audio data from a file. */
@@ -34,6 +20,9 @@ typedef struct _SUSoundEffectData {
 
 
 /** Reads the audio bytes and packet descriptions of the given file in to memory.
+ *
+ *  This function takes no reading options; to trim silence or measure levels, call trimAudioDataSilence() or
+ *  measureAudioDataLevels() on the result, or read the file with readAudioDataFromURL().
  *
  *  @param  audioFile   The file to read.
  *
@@ -43,13 +32,36 @@ typedef struct _SUSoundEffectData {
 
 SU_EXTERN SUSoundEffectData readAudioDataFromFile( AudioFileID audioFile );
 
-/** Releases an SUSoundEffectData instance and its associated memory buffers.
+/** Reads the audio bytes and packet descriptions of the file at the given URL in to memory.
  *
- *  @param  audioData   The SUSoundEffectData instance to release. After calling this function,
- *                      you should no longer use the SUSoundEffect instance.
+ *  @param  fileURL     The file URL of the audio file to read.
+ *  @param  options     Options which control how the audio data is read. See SUAudioDataReadingOptions.
+ *
+ *  @returns            An SUSoundEffectData containing the audio data, or NULL if the file couldn't be read.
+ *                      You must release this value by calling freeAudioData().
  */
 
-SU_EXTERN void freeAudioData( SUSoundEffectData audioData );
+SU_EXTERN SUSoundEffectData readAudioDataFromURL( CFURLRef fileURL, SUAudioDataReadingOptions options );
+
+/** Reads the audio bytes and packet descriptions of the file at the given URL in to memory, returning as soon as the first
+ *  packets have been read. The rest are read on a background thread.
+ *
+ *  Filling buffers from the audio data only uses the packets which have been read (see audioDataPacketsAvailable()); a fill which
+ *  reaches them returns kSUAudioDataNotReadyError instead of waiting. Audio data which has not been read in full can't be
+ *  compacted, compressed, converted, planned or played by an SUSoundMixer; use audioDataLoadingStatus() to find out when it has been.
+ *  If every other reference to the audio data is released before reading finishes, the rest of the file is not read.
+ *
+ *  Formats with a variable number of frames per packet need every packet to build their frame index, so they are read in full
+ *  before this function returns.
+ *
+ *  @param  fileURL                 The file URL of the audio file to read.
+ *  @param  numberOfInitialPackets  The number of packets to read before returning. More may be read, since packets are read in runs of about 64KB.
+ *
+ *  @returns                        An SUSoundEffectData containing the audio data, or NULL if the file or its initial packets couldn't be read.
+ *                                  You must release this value by calling freeAudioData().
+ */
+
+SU_EXTERN SUSoundEffectData readAudioDataFromURLProgressively( CFURLRef fileURL, UInt64 numberOfInitialPackets );
 
 
 //------------------------------------/
@@ -69,7 +81,7 @@ SU_EXTERN void freeAudioData( SUSoundEffectData audioData );
 
 SU_EXTERN OSStatus fillBufferFromAudioFile( AudioQueueBufferRef inBuffer, AudioFileID audioFile, SInt64 * ioPlaybackPosition );
 
-/** Fills an AudioQueue buffer with sound data.
+/** Fills an AudioQueue buffer with sound data. See fillSoundBufferFromAudioData().
  *
  *  @param  inBuffer            The buffer to fill with audio data.
  *  @param  audioData           The audio data to fill the buffer from.
@@ -81,4 +93,30 @@ SU_EXTERN OSStatus fillBufferFromAudioFile( AudioQueueBufferRef inBuffer, AudioF
 
 SU_EXTERN OSStatus fillBufferFromAudioData( AudioQueueBufferRef inBuffer, SUSoundEffectData audioData, SInt64 * ioPlaybackPosition );
 
+/** Fills an AudioQueue buffer with sound data, starting after a delay and looping over a region of the audio data.
+ *  See fillSoundBufferFromAudioDataWithSchedule().
+ *
+ *  @param  inBuffer            The buffer to fill with audio data.
+ *  @param  audioData           The audio data to fill the buffer from.
+ *  @param  ioSchedule          The start delay and loop region. On output, the start delay is reduced by the frames of silence filled.
+ *  @param  ioPlaybackPosition  On input, the cursor position to fill from. On output, the new cursor position.
+ *
+ *  @returns                    A result code, which is equal to kAudioFileEndOfFileError once the playback position has
+ *                              reached the end of the given data.
+ */
+
+SU_EXTERN OSStatus fillBufferFromAudioDataWithSchedule( AudioQueueBufferRef inBuffer, SUSoundEffectData audioData, SUSoundPlaybackSchedule * ioSchedule, SInt64 * ioPlaybackPosition );
+
+/** Fills an AudioQueue buffer with sound data, using a precomputed plan. See fillSoundBufferFromPlan().
+ *
+ *  @param  inBuffer            The buffer to fill with audio data.
+ *  @param  plan                The plan to fill the buffer with.
+ *  @param  ioPlaybackPosition  On input, the cursor position to fill from. On output, the new cursor position.
+ *
+ *  @returns                    A result code, which is equal to kAudioFileEndOfFileError once the playback position has
+ *                              reached the end of the plan's audio data.
+ */
+
+SU_EXTERN OSStatus fillBufferFromSoundBufferPlan( AudioQueueBufferRef inBuffer, SUSoundBufferPlan plan, SInt64 * ioPlaybackPosition );
+
 #endif
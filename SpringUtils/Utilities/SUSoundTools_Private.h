@@ -0,0 +1,21 @@
+//
+//  SUSoundTools_Private.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundTools.h"
+
+// Loading steps used by readAudioDataFromFile(), which are shared with the sound bank loader.
+
+/** Reads the data format, audio byte count, packet count and maximum packet size of a file. */
+
+SU_EXTERN OSStatus readAudioDataProperties( AudioFileID audioFile, SUSoundEffectData data );
+
+/** Reads packets from the file in to `buffer`, which must be large enough to hold all of the file's audio bytes. */
+
+SU_EXTERN OSStatus readPacketData( AudioFileID audioFile, SUSoundEffectData data, void * buffer );
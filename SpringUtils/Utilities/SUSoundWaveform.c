@@ -0,0 +1,565 @@
+//
+//  SUSoundWaveform.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUSoundWaveform.h"
+#import "SUSoundCompression.h"
+#import "SUPCMConversion_Private.h"
+
+#import <fcntl.h>
+#import <limits.h>
+#import <math.h>
+#import <stdio.h>
+#import <stdlib.h>
+#import <string.h>
+#import <unistd.h>
+#import <sys/stat.h>
+
+#if defined( __SSE2__ )
+    #import <emmintrin.h>
+    #define SU_WAVEFORM_SSE2 1
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+    #import <arm_neon.h>
+    #define SU_WAVEFORM_NEON 1
+#endif
+
+/** The maximum number of levels in a pyramid. Each level halves the number of blocks, so 64 levels covers any length. */
+
+#define kSUSoundWaveformMaximumLevels   64
+
+/** The number of frames converted to floats at a time while building a pyramid. */
+
+#define kSUSoundWaveformFramesPerRun    ( kSUSoundWaveformFramesPerBlock * 64 )
+
+/** The peaks of one channel over one block. Sums of squares, rather than RMS values, are stored so that blocks can be merged. */
+
+typedef struct _SUSoundWaveformBlock {
+    
+    float minimum;
+    float maximum;
+    float sumOfSquares;
+    
+} SUSoundWaveformBlock;
+
+/** Blocks are stored level by level, from the bottom, with the channels of each block interleaved. */
+
+struct _SUSoundWaveform {
+    
+    UInt32 numberOfChannels;
+    UInt32 numberOfLevels;
+    UInt64 numberOfFrames;
+    
+    UInt64 levelOffsets[ kSUSoundWaveformMaximumLevels ];    /**< The index of the first block of each level. */
+    UInt64 levelLengths[ kSUSoundWaveformMaximumLevels ];    /**< The number of blocks in each level. */
+    
+    SUSoundWaveformBlock * blocks;
+    UInt64 numberOfBlocks;
+    
+};
+
+/** The header of a peak file, which is followed by the pyramid's blocks. */
+
+typedef struct _SUSoundWaveformFileHeader {
+    
+    UInt32 magic;
+    UInt32 framesPerBlock;
+    UInt32 numberOfChannels;
+    UInt32 reserved;
+    UInt64 numberOfFrames;
+    UInt64 numberOfBlocks;
+    
+} SUSoundWaveformFileHeader;
+
+/** Identifies a peak file. Written in the byte order of the machine which wrote it, so files from other machines are rejected. */
+
+#define kSUSoundWaveformFileMagic   0x53555731  // 'SUW1'
+
+/** Allocates an empty pyramid, laying out its levels. */
+
+static SUSoundWaveform allocateSoundWaveform( UInt32 numberOfChannels, UInt64 numberOfFrames ) {
+    
+    if( ( 0 == numberOfChannels ) || ( 0 == numberOfFrames ) )
+        return NULL;
+    
+    SUSoundWaveform waveform = calloc( 1, sizeof( struct _SUSoundWaveform ) );
+    
+    if( NULL == waveform )
+        return NULL;
+    
+    waveform->numberOfChannels = numberOfChannels;
+    waveform->numberOfFrames   = numberOfFrames;
+    
+    UInt64 levelLength = ( ( numberOfFrames - 1 ) / kSUSoundWaveformFramesPerBlock ) + 1;
+    
+    for( ;; )
+    {
+        waveform->levelOffsets[ waveform->numberOfLevels ] = waveform->numberOfBlocks;
+        waveform->levelLengths[ waveform->numberOfLevels ] = levelLength;
+        waveform->numberOfBlocks                          += levelLength;
+        waveform->numberOfLevels++;
+        
+        if( 1 == levelLength )
+            break;
+        
+        levelLength = ( levelLength + 1 ) / 2;
+    }
+    
+    if( waveform->numberOfBlocks > ( SIZE_T_MAX / ( numberOfChannels * sizeof( SUSoundWaveformBlock ) ) ) )
+    {
+        free( waveform );
+        return NULL;
+    }
+    
+    waveform->blocks = malloc( (size_t)waveform->numberOfBlocks * numberOfChannels * sizeof( SUSoundWaveformBlock ) );
+    
+    if( NULL == waveform->blocks )
+    {
+        free( waveform );
+        return NULL;
+    }
+    
+    return waveform;
+}
+
+SU_INLINE SUSoundWaveformBlock * soundWaveformBlock( SUSoundWaveform waveform, UInt32 level, UInt64 index ) {
+    
+    return &( waveform->blocks[ ( waveform->levelOffsets[ level ] + index ) * waveform->numberOfChannels ] );
+}
+
+/** Returns the number of frames summarised by a block, which is smaller for the last block of each level. */
+
+SU_INLINE UInt64 soundWaveformBlockFrames( SUSoundWaveform waveform, UInt32 level, UInt64 index ) {
+    
+    const UInt64 framesPerBlock = ( (UInt64)kSUSoundWaveformFramesPerBlock << level );
+    const UInt64 firstFrame     = ( index * framesPerBlock );
+    
+    return ( ( firstFrame + framesPerBlock ) <= waveform->numberOfFrames ) ? framesPerBlock : ( waveform->numberOfFrames - firstFrame );
+}
+
+SU_INLINE void mergeSoundWaveformBlock( SUSoundWaveformBlock * block, const SUSoundWaveformBlock * other ) {
+    
+    block->minimum       = ( other->minimum < block->minimum ) ? other->minimum : block->minimum;
+    block->maximum       = ( other->maximum > block->maximum ) ? other->maximum : block->maximum;
+    block->sumOfSquares += other->sumOfSquares;
+}
+
+#pragma mark -
+#pragma mark Building Waveform Pyramids
+
+/** Reduces the interleaved float samples of one block to the peaks of each of its channels. */
+
+static void reduceSoundWaveformBlock( const float * samples, UInt32 numberOfChannels, size_t numberOfFrames, SUSoundWaveformBlock * blocks ) {
+    
+    const size_t numberOfSamples = ( numberOfFrames * numberOfChannels );
+    size_t i = 0;
+    
+    for( UInt32 channel = 0; channel < numberOfChannels; channel++ )
+    {
+        blocks[ channel ] = (SUSoundWaveformBlock){ INFINITY, -INFINITY, 0 };
+    }
+
+#if SU_WAVEFORM_SSE2 || SU_WAVEFORM_NEON
+    
+    // With 1, 2 or 4 channels, each vector lane always holds the same channel.
+    
+    if( ( 0 == ( 4 % numberOfChannels ) ) && ( numberOfSamples >= 4 ) )
+    {
+        SUSoundWaveformBlock lanes[ 4 ];
+        float minimums[ 4 ], maximums[ 4 ], sumsOfSquares[ 4 ];
+    
+    #if SU_WAVEFORM_SSE2
+        
+        __m128 minimum      = _mm_set1_ps( INFINITY );
+        __m128 maximum      = _mm_set1_ps( -INFINITY );
+        __m128 sumOfSquares = _mm_setzero_ps();
+        
+        for( ; ( i + 4 ) <= numberOfSamples; i += 4 )
+        {
+            const __m128 x = _mm_loadu_ps( samples + i );
+            
+            minimum      = _mm_min_ps( minimum, x );
+            maximum      = _mm_max_ps( maximum, x );
+            sumOfSquares = _mm_add_ps( sumOfSquares, _mm_mul_ps( x, x ) );
+        }
+        
+        _mm_storeu_ps( minimums, minimum );
+        _mm_storeu_ps( maximums, maximum );
+        _mm_storeu_ps( sumsOfSquares, sumOfSquares );
+    
+    #else
+        
+        float32x4_t minimum      = vdupq_n_f32( INFINITY );
+        float32x4_t maximum      = vdupq_n_f32( -INFINITY );
+        float32x4_t sumOfSquares = vdupq_n_f32( 0 );
+        
+        for( ; ( i + 4 ) <= numberOfSamples; i += 4 )
+        {
+            const float32x4_t x = vld1q_f32( samples + i );
+            
+            minimum      = vminq_f32( minimum, x );
+            maximum      = vmaxq_f32( maximum, x );
+            sumOfSquares = vaddq_f32( sumOfSquares, vmulq_f32( x, x ) );
+        }
+        
+        vst1q_f32( minimums, minimum );
+        vst1q_f32( maximums, maximum );
+        vst1q_f32( sumsOfSquares, sumOfSquares );
+    
+    #endif
+        
+        for( UInt32 lane = 0; lane < 4; lane++ )
+        {
+            lanes[ lane ] = (SUSoundWaveformBlock){ minimums[ lane ], maximums[ lane ], sumsOfSquares[ lane ] };
+            mergeSoundWaveformBlock( &blocks[ lane % numberOfChannels ], &lanes[ lane ] );
+        }
+    }
+
+#endif
+    
+    // The vector loop stops at a multiple of 4 samples, which is a whole number of frames, so the tail starts at channel 0.
+    
+    for( ; i < numberOfSamples; i++ )
+    {
+        const float x                = samples[ i ];
+        SUSoundWaveformBlock * block = &blocks[ i % numberOfChannels ];
+        
+        block->minimum       = ( x < block->minimum ) ? x : block->minimum;
+        block->maximum       = ( x > block->maximum ) ? x : block->maximum;
+        block->sumOfSquares += ( x * x );
+    }
+}
+
+SUSoundWaveform createSoundWaveform( SUSoundEffectData audioData ) {
+    
+    const AudioStreamBasicDescription * format = &( audioData->dataFormat );
+    
+    if( ( kAudioFormatLinearPCM != format->mFormatID ) || ( 0 == format->mBytesPerFrame ) || ( NULL != audioData->packetDescriptions ) )
+        return NULL;
+    
+    if( ( ( NULL == audioData->audioData ) && ( NULL == audioData->compressedAudio ) ) || ( noErr != audioDataLoadingStatus( audioData ) ) )
+        return NULL;
+    
+    const UInt32 numberOfChannels = format->mChannelsPerFrame;
+    const UInt64 numberOfFrames   = ( audioData->numberOfAudioDataBytes / format->mBytesPerFrame );
+    
+    SUSoundWaveform waveform = allocateSoundWaveform( numberOfChannels, numberOfFrames );
+    
+    if( NULL == waveform )
+        return NULL;
+    
+    float * samples         = malloc( (size_t)kSUSoundWaveformFramesPerRun * numberOfChannels * sizeof( float ) );
+    SInt16 * decodedSamples = ( NULL != audioData->compressedAudio ) ? malloc( (size_t)kSUSoundWaveformFramesPerRun * numberOfChannels * sizeof( SInt16 ) ) : NULL;
+    bool converted          = ( NULL != samples ) && ( ( NULL == audioData->compressedAudio ) || ( NULL != decodedSamples ) );
+    
+    
+    // ===================
+    //
+    // 1. Reduce the samples to the bottom level, a run of blocks at a time
+    //
+    // ===================
+    
+    
+    for( UInt64 frame = 0; converted && ( frame < numberOfFrames ); frame += kSUSoundWaveformFramesPerRun )
+    {
+        const UInt64 numberOfRunFrames = ( ( numberOfFrames - frame ) < kSUSoundWaveformFramesPerRun ) ? ( numberOfFrames - frame ) : kSUSoundWaveformFramesPerRun;
+        const void * source;
+        
+        if( NULL != decodedSamples )
+        {
+            decodeCompressedAudio( audioData->compressedAudio, frame, numberOfRunFrames, decodedSamples );
+            source = decodedSamples;
+        }
+        else
+        {
+            source = ( (const UInt8 *)audioData->audioData + ( frame * format->mBytesPerFrame ) );
+        }
+        
+        converted = convertSamplesToFloat32( format, source, samples, (size_t)( numberOfRunFrames * numberOfChannels ) );
+        
+        for( UInt64 runFrame = 0; converted && ( runFrame < numberOfRunFrames ); runFrame += kSUSoundWaveformFramesPerBlock )
+        {
+            const UInt64 blockIndex = ( ( frame + runFrame ) / kSUSoundWaveformFramesPerBlock );
+            
+            reduceSoundWaveformBlock( samples + ( runFrame * numberOfChannels ), numberOfChannels,
+                                      (size_t)soundWaveformBlockFrames( waveform, 0, blockIndex ), soundWaveformBlock( waveform, 0, blockIndex ) );
+        }
+    }
+    
+    free( samples );
+    free( decodedSamples );
+    
+    if( false == converted )
+    {
+        freeSoundWaveform( waveform );
+        return NULL;
+    }
+    
+    
+    // ===================
+    //
+    // 2. Merge pairs of blocks in to each level above
+    //
+    // ===================
+    
+    
+    for( UInt32 level = 1; level < waveform->numberOfLevels; level++ )
+    {
+        for( UInt64 index = 0; index < waveform->levelLengths[ level ]; index++ )
+        {
+            SUSoundWaveformBlock * block       = soundWaveformBlock( waveform, level, index );
+            const SUSoundWaveformBlock * first = soundWaveformBlock( waveform, level - 1, index * 2 );
+            const bool hasSecond               = ( ( ( index * 2 ) + 1 ) < waveform->levelLengths[ level - 1 ] );
+            
+            for( UInt32 channel = 0; channel < numberOfChannels; channel++ )
+            {
+                block[ channel ] = first[ channel ];
+                
+                if( hasSecond )
+                    mergeSoundWaveformBlock( &block[ channel ], &first[ numberOfChannels + channel ] );
+            }
+        }
+    }
+    
+    return waveform;
+}
+
+void freeSoundWaveform( SUSoundWaveform waveform ) {
+    
+    if( NULL != waveform )
+    {
+        free( waveform->blocks );
+        free( waveform );
+    }
+}
+
+UInt64 soundWaveformSize( SUSoundWaveform waveform ) {
+    
+    return ( sizeof( struct _SUSoundWaveform ) + ( waveform->numberOfBlocks * waveform->numberOfChannels * sizeof( SUSoundWaveformBlock ) ) );
+}
+
+UInt32 soundWaveformNumberOfChannels( SUSoundWaveform waveform ) {
+    
+    return waveform->numberOfChannels;
+}
+
+UInt64 soundWaveformNumberOfFrames( SUSoundWaveform waveform ) {
+    
+    return waveform->numberOfFrames;
+}
+
+#pragma mark -
+#pragma mark Querying Peaks
+
+void getSoundWaveformPeaks( SUSoundWaveform waveform, UInt32 channel, UInt64 firstFrame, UInt64 numberOfFrames, SUSoundWaveformPeak * peaks, UInt32 numberOfPeaks ) {
+    
+    if( 0 == numberOfPeaks )
+        return;
+    
+    if( channel >= waveform->numberOfChannels )
+    {
+        memset( peaks, 0, numberOfPeaks * sizeof( SUSoundWaveformPeak ) );
+        return;
+    }
+    
+    // Use the coarsest level whose blocks are no larger than a peak, so each peak spans at most three blocks.
+    
+    const UInt64 framesPerPeak = ( numberOfFrames / numberOfPeaks );
+    UInt32 level = 0;
+    
+    while( ( ( level + 1 ) < waveform->numberOfLevels ) && ( ( (UInt64)kSUSoundWaveformFramesPerBlock << ( level + 1 ) ) <= framesPerPeak ) )
+    {
+        level++;
+    }
+    
+    const UInt64 framesPerBlock = ( (UInt64)kSUSoundWaveformFramesPerBlock << level );
+    
+    for( UInt32 i = 0; i < numberOfPeaks; i++ )
+    {
+        const UInt64 start = firstFrame + ( ( numberOfFrames * i ) / numberOfPeaks );
+        UInt64 end         = firstFrame + ( ( numberOfFrames * ( i + 1 ) ) / numberOfPeaks );
+        
+        if( end <= start )
+            end = ( start + 1 );
+        
+        if( end > waveform->numberOfFrames )
+            end = waveform->numberOfFrames;
+        
+        if( start >= end )
+        {
+            peaks[ i ] = (SUSoundWaveformPeak){ 0, 0, 0 };
+            continue;
+        }
+        
+        const UInt64 firstBlock = ( start / framesPerBlock );
+        const UInt64 lastBlock  = ( ( end - 1 ) / framesPerBlock );
+        
+        SUSoundWaveformBlock peak = *( soundWaveformBlock( waveform, level, firstBlock ) + channel );
+        UInt64 numberOfPeakFrames = soundWaveformBlockFrames( waveform, level, firstBlock );
+        
+        for( UInt64 index = ( firstBlock + 1 ); index <= lastBlock; index++ )
+        {
+            mergeSoundWaveformBlock( &peak, soundWaveformBlock( waveform, level, index ) + channel );
+            numberOfPeakFrames += soundWaveformBlockFrames( waveform, level, index );
+        }
+        
+        peaks[ i ] = (SUSoundWaveformPeak){ peak.minimum, peak.maximum, sqrtf( peak.sumOfSquares / numberOfPeakFrames ) };
+    }
+}
+
+#pragma mark -
+#pragma mark Persisting Pyramids
+
+OSStatus writeSoundWaveformToFile( SUSoundWaveform waveform, const char * path ) {
+    
+    const SUSoundWaveformFileHeader header = {
+        .magic            = kSUSoundWaveformFileMagic,
+        .framesPerBlock   = kSUSoundWaveformFramesPerBlock,
+        .numberOfChannels = waveform->numberOfChannels,
+        .numberOfFrames   = waveform->numberOfFrames,
+        .numberOfBlocks   = waveform->numberOfBlocks,
+    };
+    
+    const size_t blocksSize = (size_t)waveform->numberOfBlocks * waveform->numberOfChannels * sizeof( SUSoundWaveformBlock );
+    
+    // Write to a temporary file and move it in to place, so readers never see a partly-written file.
+    
+    char temporaryPath[ PATH_MAX ];
+    
+    if( snprintf( temporaryPath, sizeof( temporaryPath ), "%s.%d.tmp", path, (int)getpid() ) >= (int)sizeof( temporaryPath ) )
+        return kAudioFileUnspecifiedError;
+    
+    const int fd = open( temporaryPath, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    
+    if( fd < 0 )
+        return kAudioFileUnspecifiedError;
+    
+    bool written = ( sizeof( header ) == write( fd, &header, sizeof( header ) ) );
+    
+    for( size_t offset = 0; written && ( offset < blocksSize ); )
+    {
+        const ssize_t bytesWritten = write( fd, (const UInt8 *)waveform->blocks + offset, blocksSize - offset );
+        
+        written = ( bytesWritten > 0 );
+        offset += written ? (size_t)bytesWritten : 0;
+    }
+    
+    written = ( 0 == close( fd ) ) && written;
+    written = written && ( 0 == rename( temporaryPath, path ) );
+    
+    if( false == written )
+    {
+        unlink( temporaryPath );
+        return kAudioFileUnspecifiedError;
+    }
+    
+    return noErr;
+}
+
+/** Returns true if a peak file of the given size can hold the pyramid its header describes. Checked before allocating the
+ *  pyramid, so a corrupt header cannot cause a large allocation. */
+
+static bool soundWaveformFileHeaderIsValid( const SUSoundWaveformFileHeader * header, off_t fileSize ) {
+    
+    if( ( kSUSoundWaveformFileMagic != header->magic ) || ( kSUSoundWaveformFramesPerBlock != header->framesPerBlock ) )
+        return false;
+    
+    if( ( 0 == header->numberOfChannels ) || ( 0 == header->numberOfFrames ) || ( fileSize < (off_t)sizeof( SUSoundWaveformFileHeader ) ) )
+        return false;
+    
+    // The file holds exactly the header's number of blocks, and the bottom level alone has a block for every run of frames.
+    
+    const UInt64 blocksSize   = (UInt64)fileSize - sizeof( SUSoundWaveformFileHeader );
+    const UInt64 blockSetSize  = (UInt64)header->numberOfChannels * sizeof( SUSoundWaveformBlock );
+    
+    if( ( 0 != ( blocksSize % blockSetSize ) ) || ( header->numberOfBlocks != ( blocksSize / blockSetSize ) ) )
+        return false;
+    
+    return ( ( ( header->numberOfFrames - 1 ) / kSUSoundWaveformFramesPerBlock ) < header->numberOfBlocks );
+}
+
+SUSoundWaveform readSoundWaveformFromFile( const char * path ) {
+    
+    const int fd = open( path, O_RDONLY );
+    
+    if( fd < 0 )
+        return NULL;
+    
+    SUSoundWaveformFileHeader header;
+    SUSoundWaveform waveform = NULL;
+    struct stat fileStatus;
+    
+    if( ( 0 == fstat( fd, &fileStatus ) ) && ( sizeof( header ) == pread( fd, &header, sizeof( header ), 0 ) ) &&
+        soundWaveformFileHeaderIsValid( &header, fileStatus.st_size ) )
+    {
+        waveform = allocateSoundWaveform( header.numberOfChannels, header.numberOfFrames );
+    }
+    
+    // The file must hold exactly the blocks of the pyramid its header describes.
+    
+    if( NULL != waveform )
+    {
+        const size_t blocksSize = (size_t)waveform->numberOfBlocks * waveform->numberOfChannels * sizeof( SUSoundWaveformBlock );
+        bool valid              = ( header.numberOfBlocks == waveform->numberOfBlocks ) && ( (UInt64)fileStatus.st_size == ( sizeof( header ) + blocksSize ) );
+        
+        for( size_t offset = 0; valid && ( offset < blocksSize ); )
+        {
+            const ssize_t bytesRead = pread( fd, (UInt8 *)waveform->blocks + offset, blocksSize - offset, (off_t)( sizeof( header ) + offset ) );
+            
+            valid   = ( bytesRead > 0 );
+            offset += valid ? (size_t)bytesRead : 0;
+        }
+        
+        if( false == valid )
+        {
+            freeSoundWaveform( waveform );
+            waveform = NULL;
+        }
+    }
+    
+    close( fd );
+    
+    return waveform;
+}
+
+SUSoundWaveform loadSoundWaveformForAudioFile( SUSoundEffectData audioData, const char * path ) {
+    
+    char peakPath[ PATH_MAX ];
+    
+    if( snprintf( peakPath, sizeof( peakPath ), "%s.%s", path, kSUSoundWaveformFileExtension ) >= (int)sizeof( peakPath ) )
+        return createSoundWaveform( audioData );
+    
+    // Use the peak file if it is up to date.
+    
+    struct stat audioFileStatus, peakFileStatus;
+    
+    if( ( 0 == stat( path, &audioFileStatus ) ) && ( 0 == stat( peakPath, &peakFileStatus ) ) && ( peakFileStatus.st_mtime >= audioFileStatus.st_mtime ) )
+    {
+        SUSoundWaveform waveform = readSoundWaveformFromFile( peakPath );
+        
+        if( ( NULL != waveform ) && ( audioData->dataFormat.mBytesPerFrame > 0 ) &&
+            ( waveform->numberOfChannels == audioData->dataFormat.mChannelsPerFrame ) &&
+            ( waveform->numberOfFrames == ( audioData->numberOfAudioDataBytes / audioData->dataFormat.mBytesPerFrame ) ) )
+        {
+            return waveform;
+        }
+        
+        freeSoundWaveform( waveform );
+    }
+    
+    // Otherwise, build the pyramid and save it for next time.
+    
+    SUSoundWaveform waveform = createSoundWaveform( audioData );
+    
+    if( NULL != waveform )
+    {
+        writeSoundWaveformToFile( waveform, peakPath );
+    }
+    
+    return waveform;
+}
@@ -0,0 +1,137 @@
+//
+//  SUSoundWaveform.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUSoundWaveform_h
+#define SpringUtils_SUSoundWaveform_h
+
+#import "SUSoundCore.h"
+
+/** Min/max/RMS peak pyramids for drawing waveforms.
+ *
+ *  The bottom level of the pyramid summarises each channel in blocks of kSUSoundWaveformFramesPerBlock frames, and each
+ *  level above it summarises pairs of blocks from the level below, up to a single block covering all of the audio data.
+ *  A pyramid takes 24 bytes per block per channel (just under a fifth of the size of 16-bit samples), and is built in a single
+ *  pass over the samples.
+ *
+ *  Querying peaks reads, for each peak, the two or three blocks from the coarsest level whose blocks are no larger than the
+ *  peak's range of frames, so drawing a waveform costs O(pixels) at any zoom level.
+ */
+
+/** The number of sample frames summarised by each block at the bottom level of a pyramid. */
+
+#define kSUSoundWaveformFramesPerBlock  64
+
+/** The extension appended to the path of an audio file to name its peak file. See loadSoundWaveformForAudioFile(). */
+
+#define kSUSoundWaveformFileExtension   "peaks"
+
+/** The peaks of one channel over a range of frames. Sample values are normalized to [-1, 1]. */
+
+typedef struct _SUSoundWaveformPeak {
+    
+    float minimum;      /**< The lowest sample in the range. */
+    float maximum;      /**< The highest sample in the range. */
+    float rms;          /**< The root mean square of the samples in the range. */
+    
+} SUSoundWaveformPeak;
+
+
+//-----------------------------------/
+/** @name Building Waveform Pyramids */
+//-----------------------------------/
+
+
+/** Builds the peak pyramid of linear PCM audio data.
+ *
+ *  Samples are converted to floats a run at a time and reduced to blocks with SSE2 or NEON when the number of channels is 1, 2 or 4.
+ *  Compressed audio data is decoded as it is read.
+ *
+ *  @param  audioData   The audio data. It must be linear PCM, and must have been read in full (see audioDataLoadingStatus()).
+ *
+ *  @returns            A new pyramid, or NULL if the audio data is empty or its format is unsupported.
+ *                      You must release this value by calling freeSoundWaveform().
+ */
+
+SU_EXTERN SUSoundWaveform createSoundWaveform( SUSoundEffectData audioData );
+
+/** Frees a peak pyramid. */
+
+SU_EXTERN void freeSoundWaveform( SUSoundWaveform waveform );
+
+/** Returns the number of bytes of heap memory used by a peak pyramid. */
+
+SU_EXTERN UInt64 soundWaveformSize( SUSoundWaveform waveform );
+
+/** Returns the number of channels summarised by a peak pyramid. */
+
+SU_EXTERN UInt32 soundWaveformNumberOfChannels( SUSoundWaveform waveform );
+
+/** Returns the number of sample frames summarised by a peak pyramid. */
+
+SU_EXTERN UInt64 soundWaveformNumberOfFrames( SUSoundWaveform waveform );
+
+
+//-------------------------/
+/** @name Querying Peaks */
+//-------------------------/
+
+
+/** Divides a range of frames in to equal parts (e.g. one per pixel), and returns the peaks of one channel over each part.
+ *
+ *  Each peak is gathered from whole blocks, so its range is widened to the boundaries of the blocks it overlaps. When a part is
+ *  smaller than kSUSoundWaveformFramesPerBlock frames, neighbouring peaks may therefore be equal; draw individual samples instead.
+ *  Parts beyond the end of the audio data have zero peaks. This function does not allocate memory.
+ *
+ *  @param  waveform        The peak pyramid.
+ *  @param  channel         The channel to return peaks for.
+ *  @param  firstFrame      The first frame of the range.
+ *  @param  numberOfFrames  The number of frames in the range.
+ *  @param  peaks           On output, the peaks of each part of the range.
+ *  @param  numberOfPeaks   The number of parts to divide the range in to.
+ */
+
+SU_EXTERN void getSoundWaveformPeaks( SUSoundWaveform waveform, UInt32 channel, UInt64 firstFrame, UInt64 numberOfFrames, SUSoundWaveformPeak * peaks, UInt32 numberOfPeaks );
+
+
+//------------------------------/
+/** @name Persisting Pyramids */
+//------------------------------/
+
+
+/** Writes a peak pyramid to a file, in the byte order of the current machine.
+ *
+ *  @returns    noErr, or kAudioFileUnspecifiedError if the file could not be written.
+ */
+
+SU_EXTERN OSStatus writeSoundWaveformToFile( SUSoundWaveform waveform, const char * path );
+
+/** Reads a peak pyramid written by writeSoundWaveformToFile().
+ *
+ *  @returns    The pyramid, or NULL if the file could not be read, is damaged, or was written on a machine with a different byte order.
+ *              You must release this value by calling freeSoundWaveform().
+ */
+
+SU_EXTERN SUSoundWaveform readSoundWaveformFromFile( const char * path );
+
+/** Returns the peak pyramid of audio data read from the file at the given path, using a peak file stored next to it.
+ *
+ *  If the peak file (the audio file's path with kSUSoundWaveformFileExtension appended) is at least as new as the audio file and
+ *  matches the audio data's length and number of channels, the pyramid is read from it. Otherwise the pyramid is built from the
+ *  audio data, and written to the peak file for next time; failing to write it is not an error.
+ *
+ *  @param  audioData   The audio data read from the file.
+ *  @param  path        The path of the audio file.
+ *
+ *  @returns            The pyramid, or NULL if it could not be read or built. You must release this value by calling freeSoundWaveform().
+ */
+
+SU_EXTERN SUSoundWaveform loadSoundWaveformForAudioFile( SUSoundEffectData audioData, const char * path );
+
+#endif
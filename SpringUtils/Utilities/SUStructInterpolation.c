@@ -0,0 +1,575 @@
+//
+//  SUStructInterpolation.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUStructInterpolation.h"
+
+#import <math.h>
+#import <pthread.h>
+#import <stdlib.h>
+#import <string.h>
+
+/** The kinds of scalar in a plan. */
+
+typedef enum _SUStructScalarKind {
+    
+    SUStructScalarKindInt8,
+    SUStructScalarKindUInt8,
+    SUStructScalarKindInt16,
+    SUStructScalarKindUInt16,
+    SUStructScalarKindInt32,
+    SUStructScalarKindUInt32,
+    SUStructScalarKindInt64,
+    SUStructScalarKindUInt64,
+    SUStructScalarKindFloat32,
+    SUStructScalarKindFloat64,
+    SUStructScalarKindBool,
+    SUStructScalarKindSnap,     /**< Bytes which snap from the start to the end value. */
+    
+} SUStructScalarKind;
+
+/** A run of identically-typed scalars, which are contiguous in the structure. */
+
+typedef struct _SUStructInterpolationRun {
+    
+    UInt32 offset;
+    UInt32 count;       /**< The number of scalars, or for SUStructScalarKindSnap, the number of bytes. */
+    UInt32 kind;
+    
+} SUStructInterpolationRun;
+
+struct _SUStructInterpolationPlan {
+    
+    size_t size;
+    UInt32 numberOfRuns;
+    SUStructInterpolationRun runs[];
+    
+};
+
+/** The size and alignment of each kind of scalar, as a field of a structure. */
+
+#define SU_FIELD_ALIGNMENT( type )  offsetof( struct { char c; type field; }, field )
+
+static const size_t scalarKindSizes[] = { 1, 1, 2, 2, 4, 4, 8, 8, 4, 8, 1, 1 };
+
+#pragma mark -
+#pragma mark Compiling Plans
+
+/** Collects the runs of a plan as a type is parsed. */
+
+typedef struct _SUStructPlanBuilder {
+    
+    SUStructInterpolationRun * runs;
+    UInt32 numberOfRuns;
+    UInt32 capacity;
+    UInt32 firstMergeableRun;   /**< Runs before this one are not extended, as they are being repeated for an array. */
+    bool failed;
+    
+} SUStructPlanBuilder;
+
+/** Appends a run to a plan, extending the last run instead if the new one continues it. */
+
+static void appendStructRun( SUStructPlanBuilder * builder, SUStructInterpolationRun run ) {
+    
+    if( builder->numberOfRuns > builder->firstMergeableRun )
+    {
+        SUStructInterpolationRun * last = &( builder->runs[ builder->numberOfRuns - 1 ] );
+        
+        if( ( last->kind == run.kind ) && ( ( last->offset + ( last->count * scalarKindSizes[ last->kind ] ) ) == run.offset ) )
+        {
+            last->count += run.count;
+            return;
+        }
+    }
+    
+    if( builder->numberOfRuns == builder->capacity )
+    {
+        const UInt32 capacity = ( builder->capacity > 0 ) ? ( builder->capacity * 2 ) : 8;
+        SUStructInterpolationRun * runs = realloc( builder->runs, capacity * sizeof( SUStructInterpolationRun ) );
+        
+        if( NULL == runs )
+        {
+            builder->failed = true;
+            return;
+        }
+        
+        builder->runs     = runs;
+        builder->capacity = capacity;
+    }
+    
+    builder->runs[ builder->numberOfRuns++ ] = run;
+}
+
+/** Skips a quoted name (e.g. the field names in an ivar's type encoding), if there is one. */
+
+static const char * skipQuotedName( const char * type ) {
+    
+    if( '"' != *type )
+        return type;
+    
+    const char * end = strchr( type + 1, '"' );
+    
+    return ( NULL != end ) ? ( end + 1 ) : ( type + strlen( type ) );
+}
+
+/** Skips a single type without parsing it, e.g. the type a pointer points to. */
+
+static const char * skipType( const char * type ) {
+    
+    while( ( '\0' != *type ) && ( NULL != strchr( "rnNoORVA", *type ) ) )
+        type++;
+    
+    switch( *type )
+    {
+        case '\0':
+            return type;
+        
+        case '^':
+        case 'j':
+            return skipType( type + 1 );
+        
+        case '@':
+            type++;
+            if( '?' == *type )
+                type++;
+            return skipQuotedName( type );
+        
+        case 'b':
+            type++;
+            while( ( *type >= '0' ) && ( *type <= '9' ) )
+                type++;
+            return type;
+        
+        case '{':
+        case '(':
+        case '[':
+        {
+            UInt32 depth = 0;
+            
+            do
+            {
+                if( '"' == *type )
+                {
+                    type = skipQuotedName( type );
+                    continue;
+                }
+                
+                if( ( '{' == *type ) || ( '(' == *type ) || ( '[' == *type ) )
+                    depth++;
+                else if( ( '}' == *type ) || ( ')' == *type ) || ( ']' == *type ) )
+                    depth--;
+                
+                type++;
+            
+            } while( ( depth > 0 ) && ( '\0' != *type ) );
+            
+            return type;
+        }
+        
+        default:
+            return ( type + 1 );
+    }
+}
+
+static const char * parseStructType( const char * type, size_t offset, SUStructPlanBuilder * builder, size_t * oSize, size_t * oAlignment );
+
+/** Parses the fields of a structure or union, up to and including its closing bracket. Returns NULL if they can't be parsed. */
+
+static const char * parseStructFields( const char * type, size_t offset, bool isUnion, SUStructPlanBuilder * builder, size_t * oSize, size_t * oAlignment ) {
+    
+    const char closingBracket = isUnion ? ')' : '}';
+    
+    size_t size      = 0;
+    size_t alignment = 1;
+    
+    while( closingBracket != *type )
+    {
+        size_t fieldSize, fieldAlignment;
+        
+        // A field's offset depends on its alignment, so it is measured before its runs are added at that offset.
+        
+        const char * field = skipQuotedName( type );
+        
+        type = parseStructType( field, 0, NULL, &fieldSize, &fieldAlignment );
+        
+        if( NULL == type )
+            return NULL;
+        
+        const size_t fieldOffset = isUnion ? 0 : ( ( ( size + fieldAlignment - 1 ) / fieldAlignment ) * fieldAlignment );
+        
+        if( NULL != builder )
+            parseStructType( field, offset + fieldOffset, builder, &fieldSize, &fieldAlignment );
+        
+        // Structure fields follow one another; union fields all start at the beginning.
+        
+        alignment = ( fieldAlignment > alignment ) ? fieldAlignment : alignment;
+        size      = isUnion ? ( ( fieldSize > size ) ? fieldSize : size ) : ( fieldOffset + fieldSize );
+    }
+    
+    *oSize      = ( ( size + alignment - 1 ) / alignment ) * alignment;
+    *oAlignment = alignment;
+    
+    return ( type + 1 );
+}
+
+/** Parses one type, appending its runs to a plan (if there is one) at a given offset. Returns the type after the one parsed,
+ *  or NULL if it can't be interpolated. */
+
+static const char * parseStructType( const char * type, size_t offset, SUStructPlanBuilder * builder, size_t * oSize, size_t * oAlignment ) {
+    
+    // Qualifiers (const, in, out, bycopy, etc.) don't affect layout.
+    
+    while( ( '\0' != *type ) && ( NULL != strchr( "rnNoORVA", *type ) ) )
+        type++;
+    
+    SUStructScalarKind kind;
+    size_t alignment;
+    
+    switch( *type++ )
+    {
+        case 'c':   kind = SUStructScalarKindInt8;    alignment = SU_FIELD_ALIGNMENT( SInt8 );   break;
+        case 'C':   kind = SUStructScalarKindUInt8;   alignment = SU_FIELD_ALIGNMENT( UInt8 );   break;
+        case 's':   kind = SUStructScalarKindInt16;   alignment = SU_FIELD_ALIGNMENT( SInt16 );  break;
+        case 'S':   kind = SUStructScalarKindUInt16;  alignment = SU_FIELD_ALIGNMENT( UInt16 );  break;
+        case 'i':
+        case 'l':   kind = SUStructScalarKindInt32;   alignment = SU_FIELD_ALIGNMENT( SInt32 );  break;
+        case 'I':
+        case 'L':   kind = SUStructScalarKindUInt32;  alignment = SU_FIELD_ALIGNMENT( UInt32 );  break;
+        case 'q':   kind = SUStructScalarKindInt64;   alignment = SU_FIELD_ALIGNMENT( SInt64 );  break;
+        case 'Q':   kind = SUStructScalarKindUInt64;  alignment = SU_FIELD_ALIGNMENT( UInt64 );  break;
+        case 'f':   kind = SUStructScalarKindFloat32; alignment = SU_FIELD_ALIGNMENT( float );   break;
+        case 'd':   kind = SUStructScalarKindFloat64; alignment = SU_FIELD_ALIGNMENT( double );  break;
+        case 'B':   kind = SUStructScalarKindBool;    alignment = SU_FIELD_ALIGNMENT( bool );    break;
+        
+        // Pointer-sized values which can't be interpolated.
+        
+        case '@':
+        case '#':
+        case ':':
+        case '*':
+        case '^':
+        {
+            type = ( '^' == type[ -1 ] ) ? skipType( type ) : ( ( '@' == type[ -1 ] ) ? skipType( type - 1 ) : type );
+            
+            *oSize      = sizeof( void * );
+            *oAlignment = SU_FIELD_ALIGNMENT( void * );
+            
+            if( NULL != builder )
+                appendStructRun( builder, (SUStructInterpolationRun){ (UInt32)offset, (UInt32)*oSize, SUStructScalarKindSnap } );
+            
+            return type;
+        }
+        
+        case 'D':
+        {
+            *oSize      = sizeof( long double );
+            *oAlignment = SU_FIELD_ALIGNMENT( long double );
+            
+            if( NULL != builder )
+                appendStructRun( builder, (SUStructInterpolationRun){ (UInt32)offset, (UInt32)*oSize, SUStructScalarKindSnap } );
+            
+            return type;
+        }
+        
+        // Complex numbers are interpolated as pairs of their component type.
+        
+        case 'j':
+        {
+            size_t componentSize;
+            
+            type = parseStructType( type, offset, builder, &componentSize, oAlignment );
+            
+            if( NULL != type )
+                type = parseStructType( type - 1, offset + componentSize, builder, &componentSize, oAlignment );
+            
+            *oSize = ( componentSize * 2 );
+            return type;
+        }
+        
+        case '[':
+        {
+            char * end;
+            const unsigned long count = strtoul( type, &end, 10 );
+            size_t elementSize;
+            
+            const UInt32 firstRun               = ( NULL != builder ) ? builder->numberOfRuns : 0;
+            const UInt32 outerFirstMergeableRun = ( NULL != builder ) ? builder->firstMergeableRun : 0;
+            
+            // Parse the first element, then repeat its runs for the others.
+            
+            if( NULL != builder )
+                builder->firstMergeableRun = firstRun;
+            
+            type = parseStructType( end, offset, builder, &elementSize, oAlignment );
+            
+            if( ( NULL == type ) || ( ']' != *type ) || ( 0 == count ) || ( count > UINT32_MAX ) )
+                return NULL;
+            
+            if( NULL != builder )
+            {
+                // The element's runs are copied, as the last of them is extended as the first repeats are appended.
+                
+                const UInt32 numberOfElementRuns        = ( builder->numberOfRuns - firstRun );
+                SUStructInterpolationRun * elementRuns  = malloc( numberOfElementRuns * sizeof( SUStructInterpolationRun ) );
+                
+                builder->failed            = builder->failed || ( NULL == elementRuns );
+                builder->firstMergeableRun = outerFirstMergeableRun;
+                
+                if( NULL != elementRuns )
+                    memcpy( elementRuns, builder->runs + firstRun, numberOfElementRuns * sizeof( SUStructInterpolationRun ) );
+                
+                for( unsigned long element = 1; ( element < count ) && ( false == builder->failed ); element++ )
+                {
+                    for( UInt32 run = 0; run < numberOfElementRuns; run++ )
+                    {
+                        SUStructInterpolationRun repeated = elementRuns[ run ];
+                        repeated.offset += (UInt32)( element * elementSize );
+                        
+                        appendStructRun( builder, repeated );
+                    }
+                }
+                
+                free( elementRuns );
+            }
+            
+            *oSize = ( count * elementSize );
+            return ( type + 1 );
+        }
+        
+        case '{':
+        case '(':
+        {
+            const bool isUnion = ( '(' == type[ -1 ] );
+            
+            // Structures without their fields (e.g. the pointee of a pointer) can't be laid out.
+            
+            while( ( '=' != *type ) && ( '}' != *type ) && ( ')' != *type ) && ( '\0' != *type ) )
+                type++;
+            
+            if( '=' != *type )
+                return NULL;
+            
+            // Union members overlap, so the whole union snaps.
+            
+            type = parseStructFields( type + 1, offset, isUnion, isUnion ? NULL : builder, oSize, oAlignment );
+            
+            if( ( NULL != type ) && isUnion && ( NULL != builder ) )
+                appendStructRun( builder, (SUStructInterpolationRun){ (UInt32)offset, (UInt32)*oSize, SUStructScalarKindSnap } );
+            
+            return type;
+        }
+        
+        // Bitfields, void, unknown types and function pointers.
+        
+        default:
+            return NULL;
+    }
+    
+    *oSize      = scalarKindSizes[ kind ];
+    *oAlignment = alignment;
+    
+    if( NULL != builder )
+        appendStructRun( builder, (SUStructInterpolationRun){ (UInt32)offset, 1, kind } );
+    
+    return type;
+}
+
+/** Compiles a type's plan. Returns NULL if it can't be interpolated. */
+
+static SUStructInterpolationPlan compileStructInterpolationPlan( const char * objCType ) {
+    
+    SUStructPlanBuilder builder = { NULL, 0, 0, 0, false };
+    size_t size, alignment;
+    
+    const char * end = parseStructType( objCType, 0, &builder, &size, &alignment );
+    
+    struct _SUStructInterpolationPlan * plan = NULL;
+    
+    if( ( NULL != end ) && ( '\0' == *end ) && ( false == builder.failed ) && ( size > 0 ) && ( size <= UINT32_MAX ) )
+    {
+        plan = malloc( sizeof( struct _SUStructInterpolationPlan ) + ( builder.numberOfRuns * sizeof( SUStructInterpolationRun ) ) );
+        
+        if( NULL != plan )
+        {
+            plan->size         = size;
+            plan->numberOfRuns = builder.numberOfRuns;
+            memcpy( plan->runs, builder.runs, builder.numberOfRuns * sizeof( SUStructInterpolationRun ) );
+        }
+    }
+    
+    free( builder.runs );
+    return plan;
+}
+
+/** A type in the plan cache. Entries are immutable once they are published, and are never removed. */
+
+typedef struct _SUStructPlanCacheEntry {
+    
+    struct _SUStructPlanCacheEntry * next;
+    UInt64 hash;
+    SUStructInterpolationPlan plan;     /**< NULL if the type can't be interpolated, so that it isn't parsed again. */
+    char objCType[];
+    
+} SUStructPlanCacheEntry;
+
+#define kSUStructPlanCacheBuckets   64
+
+static SUStructPlanCacheEntry * planCache[ kSUStructPlanCacheBuckets ];
+static pthread_mutex_t          planCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Finds a type in a bucket of the plan cache. */
+
+static SUStructPlanCacheEntry * findStructPlanCacheEntry( SUStructPlanCacheEntry * entry, UInt64 hash, const char * objCType ) {
+    
+    for( ; NULL != entry; entry = entry->next )
+    {
+        if( ( hash == entry->hash ) && ( 0 == strcmp( objCType, entry->objCType ) ) )
+            return entry;
+    }
+    
+    return NULL;
+}
+
+SUStructInterpolationPlan structInterpolationPlanForType( const char * objCType ) {
+    
+    // FNV-1a. Type encodings are short, so this costs about as much as comparing them.
+    
+    UInt64 hash = 0xcbf29ce484222325ULL;
+    
+    for( const char * character = objCType; '\0' != *character; character++ )
+    {
+        hash = ( hash ^ (UInt8)*character ) * 0x100000001b3ULL;
+    }
+    
+    SUStructPlanCacheEntry ** bucket = &( planCache[ hash % kSUStructPlanCacheBuckets ] );
+    
+    
+    // ===================
+    //
+    // 1. Look for a cached plan. Entries are published with release semantics, so they can be read without locking
+    //
+    // ===================
+    
+    
+    SUStructPlanCacheEntry * entry = findStructPlanCacheEntry( __atomic_load_n( bucket, __ATOMIC_ACQUIRE ), hash, objCType );
+    
+    if( NULL != entry )
+        return entry->plan;
+    
+    
+    // ===================
+    //
+    // 2. Compile and publish the plan. The lock stops two threads compiling the same type
+    //
+    // ===================
+    
+    
+    pthread_mutex_lock( &planCacheLock );
+    
+    entry = findStructPlanCacheEntry( *bucket, hash, objCType );
+    
+    if( NULL == entry )
+    {
+        const size_t typeLength = strlen( objCType );
+        
+        entry = malloc( sizeof( SUStructPlanCacheEntry ) + typeLength + 1 );
+        
+        if( NULL != entry )
+        {
+            entry->next = *bucket;
+            entry->hash = hash;
+            entry->plan = compileStructInterpolationPlan( objCType );
+            memcpy( entry->objCType, objCType, typeLength + 1 );
+            
+            __atomic_store_n( bucket, entry, __ATOMIC_RELEASE );
+        }
+    }
+    
+    pthread_mutex_unlock( &planCacheLock );
+    
+    return ( NULL != entry ) ? entry->plan : NULL;
+}
+
+size_t structInterpolationPlanSize( SUStructInterpolationPlan plan ) {
+    
+    return plan->size;
+}
+
+#pragma mark -
+#pragma mark Interpolating C Structures
+
+/** Interpolates a run of integers, rounding to the nearest integer and clamping to the type's range. Unchanged values are
+ *  copied exactly, even where they can't be represented as doubles. */
+
+#define SU_INTERPOLATE_INTEGER_RUN( type, minimum, maximum )                                                \
+{                                                                                                           \
+    for( UInt32 i = 0; i < run->count; i++ )                                                                \
+    {                                                                                                       \
+        type startValue, endValue;                                                                          \
+        memcpy( &startValue, (const UInt8 *)start + run->offset + ( i * sizeof( type ) ), sizeof( type ) ); \
+        memcpy( &endValue, (const UInt8 *)end + run->offset + ( i * sizeof( type ) ), sizeof( type ) );     \
+                                                                                                            \
+        if( startValue != endValue )                                                                        \
+        {                                                                                                   \
+            const double value = floor( (double)startValue + ( ( (double)endValue - (double)startValue ) * offset ) + 0.5 ); \
+                                                                                                            \
+            if( value <= (double)minimum )                                                                  \
+                startValue = minimum;                                                                       \
+            else if( value >= (double)maximum )                                                             \
+                startValue = maximum;                                                                       \
+            else                                                                                            \
+                startValue = (type)value;                                                                   \
+        }                                                                                                   \
+                                                                                                            \
+        memcpy( (UInt8 *)result + run->offset + ( i * sizeof( type ) ), &startValue, sizeof( type ) );      \
+    }                                                                                                       \
+    break;                                                                                                  \
+}
+
+void interpolateStructWithPlan( SUStructInterpolationPlan plan, const void * start, const void * end, SUInterpolationOffset offset, void * result ) {
+    
+    const void * snapValue = ( offset < 0.5f ) ? start : end;
+    
+    for( UInt32 runIndex = 0; runIndex < plan->numberOfRuns; runIndex++ )
+    {
+        const SUStructInterpolationRun * run = &( plan->runs[ runIndex ] );
+        
+        switch( (SUStructScalarKind)run->kind )
+        {
+            // Floating-point runs (e.g. a matrix, or an array of points) use the vectorized array functions.
+            
+            case SUStructScalarKindFloat32:
+                getFloatsWithOffsetBetweenFloats( (const float *)( (const UInt8 *)start + run->offset ), (const float *)( (const UInt8 *)end + run->offset ),
+                                                  offset, (float *)( (UInt8 *)result + run->offset ), run->count );
+                break;
+            
+            case SUStructScalarKindFloat64:
+                getDoublesWithOffsetBetweenDoubles( (const double *)( (const UInt8 *)start + run->offset ), (const double *)( (const UInt8 *)end + run->offset ),
+                                                    offset, (double *)( (UInt8 *)result + run->offset ), run->count );
+                break;
+            
+            case SUStructScalarKindInt8:    SU_INTERPOLATE_INTEGER_RUN( SInt8,  INT8_MIN,  INT8_MAX )
+            case SUStructScalarKindUInt8:   SU_INTERPOLATE_INTEGER_RUN( UInt8,  0,         UINT8_MAX )
+            case SUStructScalarKindInt16:   SU_INTERPOLATE_INTEGER_RUN( SInt16, INT16_MIN, INT16_MAX )
+            case SUStructScalarKindUInt16:  SU_INTERPOLATE_INTEGER_RUN( UInt16, 0,         UINT16_MAX )
+            case SUStructScalarKindInt32:   SU_INTERPOLATE_INTEGER_RUN( SInt32, INT32_MIN, INT32_MAX )
+            case SUStructScalarKindUInt32:  SU_INTERPOLATE_INTEGER_RUN( UInt32, 0,         UINT32_MAX )
+            case SUStructScalarKindInt64:   SU_INTERPOLATE_INTEGER_RUN( SInt64, INT64_MIN, INT64_MAX )
+            case SUStructScalarKindUInt64:  SU_INTERPOLATE_INTEGER_RUN( UInt64, 0,         UINT64_MAX )
+            
+            // Values which can't be interpolated snap at the middle of the interpolation.
+            
+            case SUStructScalarKindBool:
+            case SUStructScalarKindSnap:
+                if( result != snapValue )
+                    memcpy( (UInt8 *)result + run->offset, (const UInt8 *)snapValue + run->offset, run->count * scalarKindSizes[ run->kind ] );
+                break;
+        }
+    }
+}
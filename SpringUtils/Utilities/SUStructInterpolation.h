@@ -0,0 +1,73 @@
+//
+//  SUStructInterpolation.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUStructInterpolation_h
+#define SpringUtils_SUStructInterpolation_h
+
+#import "SUValueInterpolation.h"
+
+/** Interpolation of arbitrary C structures, described by Objective-C type encodings (as returned by `@encode()` or
+ *  `-[NSValue objCType]`).
+ *
+ *  A type encoding is compiled once into an interpolation plan: a flat list of runs of identically-typed scalars, with their
+ *  offsets in the structure, covering every field of any nested structures and arrays. Interpolating a structure executes
+ *  its plan directly on the structure's bytes, and does not allocate memory.
+ *
+ *  - Floats and doubles are interpolated linearly, a run at a time.
+ *  - Integers are interpolated linearly, rounded to the nearest integer and clamped to the range of their type.
+ *  - bools, and fields which can't be interpolated (pointers, objects, selectors, classes, unions and long doubles), snap
+ *    from the start value to the end value at an offset of 0.5.
+ *
+ *  Bitfields, and types of unknown size, can't be interpolated.
+ */
+
+typedef const struct _SUStructInterpolationPlan *SUStructInterpolationPlan;
+
+
+//---------------------------------------/
+/** @name Compiling Interpolation Plans */
+//---------------------------------------/
+
+
+/** Returns the interpolation plan for a type.
+ *
+ *  Plans are compiled the first time they are requested and cached for the lifetime of the process, so the cost of parsing a
+ *  type encoding is only paid once. Looking up a cached plan does not lock or allocate memory, and may be done on any thread.
+ *
+ *  @param  objCType    An Objective-C type encoding.
+ *
+ *  @returns            The type's interpolation plan, or NULL if the type can't be interpolated. Plans are never freed.
+ */
+
+SU_EXTERN SUStructInterpolationPlan structInterpolationPlanForType( const char * objCType );
+
+/** Returns the size, in bytes, of the type a plan interpolates. */
+
+SU_EXTERN size_t structInterpolationPlanSize( SUStructInterpolationPlan plan );
+
+
+//------------------------------------/
+/** @name Interpolating C Structures */
+//------------------------------------/
+
+
+/** Interpolates between two structures.
+ *
+ *  @param  plan    The interpolation plan for the structures' type.
+ *  @param  start   The start structure. This is the structure returned when the offset is 0.
+ *  @param  end     The final structure. This is the structure returned when the offset is 1.
+ *  @param  offset  The offset.
+ *  @param  result  On output, the structure at distance `offset` in to an interpolation between `start` and `end`. This may
+ *                  be the same as `start` or `end`, but must not otherwise overlap them. All three must be aligned for the type.
+ */
+
+SU_EXTERN void interpolateStructWithPlan( SUStructInterpolationPlan plan, const void * start, const void * end, SUInterpolationOffset offset, void * result );
+
+#endif
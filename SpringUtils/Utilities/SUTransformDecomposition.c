@@ -0,0 +1,603 @@
+//
+//  SUTransformDecomposition.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#include "SUTransformDecomposition_Private.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined( __AVX__ )
+    #include <immintrin.h>
+    #define SU_TRANSFORM_AVX 1
+#elif defined( __SSE2__ )
+    #include <emmintrin.h>
+    #define SU_TRANSFORM_SSE2 1
+#elif ( defined( __ARM_NEON__ ) || defined( __ARM_NEON ) ) && defined( __aarch64__ )
+    #include <arm_neon.h>
+    #define SU_TRANSFORM_NEON 1
+#endif
+
+// The vector and scalar kernels must round identically, so the compiler may not fuse multiplies and adds.
+
+#pragma STDC FP_CONTRACT OFF
+
+#ifndef M_PI
+    #define M_PI 3.14159265358979323846
+#endif
+
+/** Returns the number at a given offset between two numbers. */
+
+SU_INLINE double interpolateDouble( double start, double end, double offset ) {
+    
+    return start + ( ( end - start ) * offset );
+}
+
+/** Returns the rotation from one angle to another which takes the shortest path, in [-π, π]. */
+
+SU_INLINE double shortestRotationBetweenAngles( double start, double end ) {
+    
+    double rotation = fmod( end - start, 2 * M_PI );
+    
+    if( rotation > M_PI )
+        rotation -= ( 2 * M_PI );
+    else if( rotation < -M_PI )
+        rotation += ( 2 * M_PI );
+    
+    return rotation;
+}
+
+#pragma mark -
+#pragma mark Affine Transforms
+
+void decomposeAffineMatrix( const double * matrix, SUAffineTransformDecomposition * oDecomposition ) {
+    
+    // The rows of the transform's matrix are the images of the x and y axes. They are made orthonormal (Gram-Schmidt), and
+    // the lengths and overlap removed along the way are the scale and shear. The shear isn't divided by the y scale, so that
+    // transforms which scale y to zero keep it.
+    
+    double row0[ 2 ] = { matrix[ 0 ], matrix[ 1 ] };
+    double row1[ 2 ] = { matrix[ 2 ], matrix[ 3 ] };
+    
+    double scaleX = hypot( row0[ 0 ], row0[ 1 ] );
+    
+    if( scaleX > 0 )
+    {
+        row0[ 0 ] /= scaleX;
+        row0[ 1 ] /= scaleX;
+    }
+    else
+    {
+        row0[ 0 ] = 1;
+        row0[ 1 ] = 0;
+    }
+    
+    double shear = ( row0[ 0 ] * row1[ 0 ] ) + ( row0[ 1 ] * row1[ 1 ] );
+    
+    row1[ 0 ] -= ( shear * row0[ 0 ] );
+    row1[ 1 ] -= ( shear * row0[ 1 ] );
+    
+    double scaleY = hypot( row1[ 0 ], row1[ 1 ] );
+    
+    if( scaleY > 0 )
+    {
+        row1[ 0 ] /= scaleY;
+        row1[ 1 ] /= scaleY;
+    }
+    else
+    {
+        row1[ 0 ] = -row0[ 1 ];
+        row1[ 1 ] = row0[ 0 ];
+    }
+    
+    // A reflection is folded in to the x scale, leaving a rotation.
+    
+    if( ( ( row0[ 0 ] * row1[ 1 ] ) - ( row0[ 1 ] * row1[ 0 ] ) ) < 0 )
+    {
+        scaleX    = -scaleX;
+        shear     = -shear;
+        row0[ 0 ] = -row0[ 0 ];
+        row0[ 1 ] = -row0[ 1 ];
+    }
+    
+    oDecomposition->scale[ 0 ]       = scaleX;
+    oDecomposition->scale[ 1 ]       = scaleY;
+    oDecomposition->shear            = shear;
+    oDecomposition->rotation         = atan2( row0[ 1 ], row0[ 0 ] );
+    oDecomposition->translation[ 0 ] = matrix[ 4 ];
+    oDecomposition->translation[ 1 ] = matrix[ 5 ];
+}
+
+void recomposeAffineMatrix( const SUAffineTransformDecomposition * decomposition, double * matrix ) {
+    
+    const double cosine = cos( decomposition->rotation );
+    const double sine   = sin( decomposition->rotation );
+    const double scaleX = decomposition->scale[ 0 ];
+    const double scaleY = decomposition->scale[ 1 ];
+    const double shear  = decomposition->shear;
+    
+    matrix[ 0 ] = ( scaleX * cosine );
+    matrix[ 1 ] = ( scaleX * sine );
+    matrix[ 2 ] = ( ( shear * cosine ) - ( scaleY * sine ) );
+    matrix[ 3 ] = ( ( shear * sine ) + ( scaleY * cosine ) );
+    matrix[ 4 ] = decomposition->translation[ 0 ];
+    matrix[ 5 ] = decomposition->translation[ 1 ];
+}
+
+void interpolateAffineTransformDecompositions( const SUAffineTransformDecomposition * start, const SUAffineTransformDecomposition * end,
+                                               double offset, SUAffineTransformDecomposition * result ) {
+    
+    const double rotation = ( start->rotation + ( shortestRotationBetweenAngles( start->rotation, end->rotation ) * offset ) );
+    
+    result->scale[ 0 ]       = interpolateDouble( start->scale[ 0 ], end->scale[ 0 ], offset );
+    result->scale[ 1 ]       = interpolateDouble( start->scale[ 1 ], end->scale[ 1 ], offset );
+    result->shear            = interpolateDouble( start->shear, end->shear, offset );
+    result->rotation         = rotation;
+    result->translation[ 0 ] = interpolateDouble( start->translation[ 0 ], end->translation[ 0 ], offset );
+    result->translation[ 1 ] = interpolateDouble( start->translation[ 1 ], end->translation[ 1 ], offset );
+}
+
+#pragma mark -
+#pragma mark 4x4 Matrix Kernels
+
+// Each row of a product is a sum of the rows of `b`, weighted by the elements of the same row of `a`. Both kernels add the
+// weighted rows in the same order, so that they produce bit-identical results.
+
+void multiplyTransform3DKernel( const double * a, const double * b, double * result, bool vector ) {
+    
+    double product[ 16 ];
+    
+    if( vector )
+    {
+#if SU_TRANSFORM_AVX
+        
+        const __m256d rows[ 4 ] = { _mm256_loadu_pd( b ), _mm256_loadu_pd( b + 4 ), _mm256_loadu_pd( b + 8 ), _mm256_loadu_pd( b + 12 ) };
+        
+        for( uint32_t i = 0; i < 4; i++ )
+        {
+            __m256d row = _mm256_mul_pd( _mm256_set1_pd( a[ ( i * 4 ) ] ), rows[ 0 ] );
+            
+            row = _mm256_add_pd( row, _mm256_mul_pd( _mm256_set1_pd( a[ ( i * 4 ) + 1 ] ), rows[ 1 ] ) );
+            row = _mm256_add_pd( row, _mm256_mul_pd( _mm256_set1_pd( a[ ( i * 4 ) + 2 ] ), rows[ 2 ] ) );
+            row = _mm256_add_pd( row, _mm256_mul_pd( _mm256_set1_pd( a[ ( i * 4 ) + 3 ] ), rows[ 3 ] ) );
+            
+            _mm256_storeu_pd( product + ( i * 4 ), row );
+        }
+        
+        memcpy( result, product, sizeof( product ) );
+        return;
+
+#elif SU_TRANSFORM_SSE2
+        
+        // Each row is two vectors: its first and last pairs of elements.
+        
+        for( uint32_t half = 0; half < 4; half += 2 )
+        {
+            const __m128d rows[ 4 ] = { _mm_loadu_pd( b + half ), _mm_loadu_pd( b + 4 + half ), _mm_loadu_pd( b + 8 + half ), _mm_loadu_pd( b + 12 + half ) };
+            
+            for( uint32_t i = 0; i < 4; i++ )
+            {
+                __m128d row = _mm_mul_pd( _mm_set1_pd( a[ ( i * 4 ) ] ), rows[ 0 ] );
+                
+                row = _mm_add_pd( row, _mm_mul_pd( _mm_set1_pd( a[ ( i * 4 ) + 1 ] ), rows[ 1 ] ) );
+                row = _mm_add_pd( row, _mm_mul_pd( _mm_set1_pd( a[ ( i * 4 ) + 2 ] ), rows[ 2 ] ) );
+                row = _mm_add_pd( row, _mm_mul_pd( _mm_set1_pd( a[ ( i * 4 ) + 3 ] ), rows[ 3 ] ) );
+                
+                _mm_storeu_pd( product + ( i * 4 ) + half, row );
+            }
+        }
+        
+        memcpy( result, product, sizeof( product ) );
+        return;
+
+#elif SU_TRANSFORM_NEON
+        
+        for( uint32_t half = 0; half < 4; half += 2 )
+        {
+            const float64x2_t rows[ 4 ] = { vld1q_f64( b + half ), vld1q_f64( b + 4 + half ), vld1q_f64( b + 8 + half ), vld1q_f64( b + 12 + half ) };
+            
+            for( uint32_t i = 0; i < 4; i++ )
+            {
+                float64x2_t row = vmulq_n_f64( rows[ 0 ], a[ ( i * 4 ) ] );
+                
+                row = vaddq_f64( row, vmulq_n_f64( rows[ 1 ], a[ ( i * 4 ) + 1 ] ) );
+                row = vaddq_f64( row, vmulq_n_f64( rows[ 2 ], a[ ( i * 4 ) + 2 ] ) );
+                row = vaddq_f64( row, vmulq_n_f64( rows[ 3 ], a[ ( i * 4 ) + 3 ] ) );
+                
+                vst1q_f64( product + ( i * 4 ) + half, row );
+            }
+        }
+        
+        memcpy( result, product, sizeof( product ) );
+        return;
+
+#endif
+    }
+    
+    for( uint32_t i = 0; i < 4; i++ )
+    {
+        for( uint32_t j = 0; j < 4; j++ )
+        {
+            double element = ( a[ ( i * 4 ) ] * b[ j ] );
+            
+            element += ( a[ ( i * 4 ) + 1 ] * b[ 4 + j ] );
+            element += ( a[ ( i * 4 ) + 2 ] * b[ 8 + j ] );
+            element += ( a[ ( i * 4 ) + 3 ] * b[ 12 + j ] );
+            
+            product[ ( i * 4 ) + j ] = element;
+        }
+    }
+    
+    memcpy( result, product, sizeof( product ) );
+}
+
+void recomposeTransform3DKernel( const SUTransform3DDecomposition * decomposition, double * matrix, bool vector ) {
+    
+    const double x = decomposition->quaternion[ 0 ];
+    const double y = decomposition->quaternion[ 1 ];
+    const double z = decomposition->quaternion[ 2 ];
+    const double w = decomposition->quaternion[ 3 ];
+    
+    
+    // ===================
+    //
+    // 1. Scale and skew
+    //
+    // ===================
+    
+    
+    // Scaling and skewing only affect the upper 3x3 block, and compose to a lower triangular matrix, with the scales on its
+    // diagonal and the skews below it.
+    
+    const double * scale = decomposition->scale;
+    const double * skew  = decomposition->skew;
+    
+    double transform[ 16 ] = {
+        scale[ 0 ], 0, 0, 0,
+        skew[ 0 ], scale[ 1 ], 0, 0,
+        skew[ 1 ], skew[ 2 ], scale[ 2 ], 0,
+        0, 0, 0, 1
+    };
+    
+    
+    // ===================
+    //
+    // 2. Rotate
+    //
+    // ===================
+    
+    
+    const double rotation[ 16 ] = {
+        1 - ( 2 * ( ( y * y ) + ( z * z ) ) ),  2 * ( ( x * y ) + ( z * w ) ),          2 * ( ( x * z ) - ( y * w ) ),          0,
+        2 * ( ( x * y ) - ( z * w ) ),          1 - ( 2 * ( ( x * x ) + ( z * z ) ) ),  2 * ( ( y * z ) + ( x * w ) ),          0,
+        2 * ( ( x * z ) + ( y * w ) ),          2 * ( ( y * z ) - ( x * w ) ),          1 - ( 2 * ( ( x * x ) + ( y * y ) ) ),  0,
+        0,                                      0,                                      0,                                      1
+    };
+    
+    multiplyTransform3DKernel( transform, rotation, transform, vector );
+    
+    
+    // ===================
+    //
+    // 3. Translate, then apply perspective
+    //
+    // ===================
+    
+    
+    const double * translation = decomposition->translation;
+    const double * perspective = decomposition->perspective;
+    
+    const double projection[ 16 ] = {
+        1, 0, 0, perspective[ 0 ],
+        0, 1, 0, perspective[ 1 ],
+        0, 0, 1, perspective[ 2 ],
+        translation[ 0 ], translation[ 1 ], translation[ 2 ], perspective[ 3 ]
+    };
+    
+    multiplyTransform3DKernel( transform, projection, matrix, vector );
+}
+
+#pragma mark -
+#pragma mark 3D Transforms
+
+/** Returns the determinant of a 3x3 matrix, given as its rows. */
+
+SU_INLINE double determinant3x3( const double * row0, const double * row1, const double * row2 ) {
+    
+    return ( row0[ 0 ] * ( ( row1[ 1 ] * row2[ 2 ] ) - ( row1[ 2 ] * row2[ 1 ] ) ) ) -
+           ( row0[ 1 ] * ( ( row1[ 0 ] * row2[ 2 ] ) - ( row1[ 2 ] * row2[ 0 ] ) ) ) +
+           ( row0[ 2 ] * ( ( row1[ 0 ] * row2[ 1 ] ) - ( row1[ 1 ] * row2[ 0 ] ) ) );
+}
+
+/** Returns the dot product of two 3-vectors. */
+
+SU_INLINE double dotProduct3( const double * a, const double * b ) {
+    
+    return ( a[ 0 ] * b[ 0 ] ) + ( a[ 1 ] * b[ 1 ] ) + ( a[ 2 ] * b[ 2 ] );
+}
+
+/** Subtracts a multiple of one 3-vector from another. */
+
+SU_INLINE void subtractMultiple3( double * a, const double * b, double multiple ) {
+    
+    a[ 0 ] -= ( b[ 0 ] * multiple );
+    a[ 1 ] -= ( b[ 1 ] * multiple );
+    a[ 2 ] -= ( b[ 2 ] * multiple );
+}
+
+/** Normalizes a 3-vector and returns its length. A zero vector is replaced by a unit vector perpendicular to two others. */
+
+static double normalize3( double * a, const double * perpendicular0, const double * perpendicular1 ) {
+    
+    const double length = sqrt( dotProduct3( a, a ) );
+    
+    if( length > 0 )
+    {
+        a[ 0 ] /= length;
+        a[ 1 ] /= length;
+        a[ 2 ] /= length;
+    }
+    else
+    {
+        a[ 0 ] = ( perpendicular0[ 1 ] * perpendicular1[ 2 ] ) - ( perpendicular0[ 2 ] * perpendicular1[ 1 ] );
+        a[ 1 ] = ( perpendicular0[ 2 ] * perpendicular1[ 0 ] ) - ( perpendicular0[ 0 ] * perpendicular1[ 2 ] );
+        a[ 2 ] = ( perpendicular0[ 0 ] * perpendicular1[ 1 ] ) - ( perpendicular0[ 1 ] * perpendicular1[ 0 ] );
+    }
+    
+    return length;
+}
+
+bool decomposeTransform3D( const double * matrix, SUTransform3DDecomposition * oDecomposition ) {
+    
+    if( 0 == matrix[ 15 ] )
+        return false;
+    
+    
+    // ===================
+    //
+    // 1. Normalize the matrix, and separate its perspective
+    //
+    // ===================
+    
+    
+    double m[ 16 ];
+    
+    for( uint32_t i = 0; i < 16; i++ )
+    {
+        m[ i ] = ( matrix[ i ] / matrix[ 15 ] );
+    }
+    
+    // The matrix is recomposed as its upper 3x3 block, followed by a translation and perspective, so the perspective is the
+    // matrix's last column transformed by the inverse of that block. The CSS Transforms specification requires the block to be
+    // invertible; here, that is only required when there is a perspective, so that transforms which scale to zero can still be
+    // interpolated.
+    
+    double * perspective = oDecomposition->perspective;
+    
+    if( ( 0 != m[ 3 ] ) || ( 0 != m[ 7 ] ) || ( 0 != m[ 11 ] ) )
+    {
+        const double determinant = determinant3x3( m, m + 4, m + 8 );
+        
+        if( 0 == determinant )
+            return false;
+        
+        double inverse[ 9 ];
+        
+        inverse[ 0 ] = ( ( m[ 5 ] * m[ 10 ] ) - ( m[ 6 ] * m[ 9 ] ) ) / determinant;
+        inverse[ 1 ] = ( ( m[ 2 ] * m[ 9 ] ) - ( m[ 1 ] * m[ 10 ] ) ) / determinant;
+        inverse[ 2 ] = ( ( m[ 1 ] * m[ 6 ] ) - ( m[ 2 ] * m[ 5 ] ) ) / determinant;
+        inverse[ 3 ] = ( ( m[ 6 ] * m[ 8 ] ) - ( m[ 4 ] * m[ 10 ] ) ) / determinant;
+        inverse[ 4 ] = ( ( m[ 0 ] * m[ 10 ] ) - ( m[ 2 ] * m[ 8 ] ) ) / determinant;
+        inverse[ 5 ] = ( ( m[ 2 ] * m[ 4 ] ) - ( m[ 0 ] * m[ 6 ] ) ) / determinant;
+        inverse[ 6 ] = ( ( m[ 4 ] * m[ 9 ] ) - ( m[ 5 ] * m[ 8 ] ) ) / determinant;
+        inverse[ 7 ] = ( ( m[ 1 ] * m[ 8 ] ) - ( m[ 0 ] * m[ 9 ] ) ) / determinant;
+        inverse[ 8 ] = ( ( m[ 0 ] * m[ 5 ] ) - ( m[ 1 ] * m[ 4 ] ) ) / determinant;
+        
+        const double column[ 3 ] = { m[ 3 ], m[ 7 ], m[ 11 ] };
+        
+        for( uint32_t i = 0; i < 3; i++ )
+        {
+            perspective[ i ] = ( inverse[ i * 3 ] * column[ 0 ] ) + ( inverse[ ( i * 3 ) + 1 ] * column[ 1 ] ) + ( inverse[ ( i * 3 ) + 2 ] * column[ 2 ] );
+        }
+        
+        perspective[ 3 ] = 1;
+    }
+    else
+    {
+        perspective[ 0 ] = 0;
+        perspective[ 1 ] = 0;
+        perspective[ 2 ] = 0;
+        perspective[ 3 ] = 1;
+    }
+    
+    
+    // ===================
+    //
+    // 2. Separate the translation, scale and skew, leaving the rotation
+    //
+    // ===================
+    
+    
+    double * scale = oDecomposition->scale;
+    double * skew  = oDecomposition->skew;
+    
+    static const double yAxis[ 3 ] = { 0, 1, 0 }, zAxis[ 3 ] = { 0, 0, 1 };
+    
+    double row0[ 3 ] = { m[ 0 ], m[ 1 ], m[ 2 ] };
+    double row1[ 3 ] = { m[ 4 ], m[ 5 ], m[ 6 ] };
+    double row2[ 3 ] = { m[ 8 ], m[ 9 ], m[ 10 ] };
+    
+    oDecomposition->translation[ 0 ] = m[ 12 ];
+    oDecomposition->translation[ 1 ] = m[ 13 ];
+    oDecomposition->translation[ 2 ] = m[ 14 ];
+    
+    scale[ 0 ] = normalize3( row0, yAxis, zAxis );
+    
+    skew[ 0 ] = dotProduct3( row0, row1 );
+    subtractMultiple3( row1, row0, skew[ 0 ] );
+    
+    scale[ 1 ] = normalize3( row1, zAxis, row0 );
+    
+    skew[ 1 ] = dotProduct3( row0, row2 );
+    subtractMultiple3( row2, row0, skew[ 1 ] );
+    skew[ 2 ] = dotProduct3( row1, row2 );
+    subtractMultiple3( row2, row1, skew[ 2 ] );
+    
+    scale[ 2 ] = normalize3( row2, row0, row1 );
+    
+    // A reflection is folded in to the scales and skews, leaving a rotation.
+    
+    if( determinant3x3( row0, row1, row2 ) < 0 )
+    {
+        for( uint32_t i = 0; i < 3; i++ )
+        {
+            scale[ i ] = -scale[ i ];
+            skew[ i ]  = -skew[ i ];
+            row0[ i ]  = -row0[ i ];
+            row1[ i ]  = -row1[ i ];
+            row2[ i ]  = -row2[ i ];
+        }
+    }
+    
+    
+    // ===================
+    //
+    // 3. Convert the rotation to a quaternion
+    //
+    // ===================
+    
+    
+    double * quaternion = oDecomposition->quaternion;
+    
+    // The rows are the images of the axes, so the matrix is the transpose of the rotation's usual (column vector) matrix. The
+    // largest of the quaternion's components is found from the diagonal, and the others from the off-diagonal elements, which
+    // avoids dividing by a small number.
+    
+    const double trace = row0[ 0 ] + row1[ 1 ] + row2[ 2 ];
+    
+    if( trace > 0 )
+    {
+        const double factor = 0.5 / sqrt( trace + 1 );
+        
+        quaternion[ 0 ] = ( row1[ 2 ] - row2[ 1 ] ) * factor;
+        quaternion[ 1 ] = ( row2[ 0 ] - row0[ 2 ] ) * factor;
+        quaternion[ 2 ] = ( row0[ 1 ] - row1[ 0 ] ) * factor;
+        quaternion[ 3 ] = 0.25 / factor;
+    }
+    else if( ( row0[ 0 ] > row1[ 1 ] ) && ( row0[ 0 ] > row2[ 2 ] ) )
+    {
+        const double factor = 2 * sqrt( 1 + row0[ 0 ] - row1[ 1 ] - row2[ 2 ] );
+        
+        quaternion[ 0 ] = 0.25 * factor;
+        quaternion[ 1 ] = ( row1[ 0 ] + row0[ 1 ] ) / factor;
+        quaternion[ 2 ] = ( row2[ 0 ] + row0[ 2 ] ) / factor;
+        quaternion[ 3 ] = ( row1[ 2 ] - row2[ 1 ] ) / factor;
+    }
+    else if( row1[ 1 ] > row2[ 2 ] )
+    {
+        const double factor = 2 * sqrt( 1 + row1[ 1 ] - row0[ 0 ] - row2[ 2 ] );
+        
+        quaternion[ 0 ] = ( row1[ 0 ] + row0[ 1 ] ) / factor;
+        quaternion[ 1 ] = 0.25 * factor;
+        quaternion[ 2 ] = ( row2[ 1 ] + row1[ 2 ] ) / factor;
+        quaternion[ 3 ] = ( row2[ 0 ] - row0[ 2 ] ) / factor;
+    }
+    else
+    {
+        const double factor = 2 * sqrt( 1 + row2[ 2 ] - row0[ 0 ] - row1[ 1 ] );
+        
+        quaternion[ 0 ] = ( row2[ 0 ] + row0[ 2 ] ) / factor;
+        quaternion[ 1 ] = ( row2[ 1 ] + row1[ 2 ] ) / factor;
+        quaternion[ 2 ] = 0.25 * factor;
+        quaternion[ 3 ] = ( row0[ 1 ] - row1[ 0 ] ) / factor;
+    }
+    
+    return true;
+}
+
+void recomposeTransform3D( const SUTransform3DDecomposition * decomposition, double * matrix ) {
+    
+    recomposeTransform3DKernel( decomposition, matrix, true );
+}
+
+void interpolateTransform3DDecompositions( const SUTransform3DDecomposition * start, const SUTransform3DDecomposition * end,
+                                           double offset, SUTransform3DDecomposition * result ) {
+    
+    // Rotations are interpolated along the shorter of the two arcs between their quaternions (q and -q are the same rotation).
+    
+    const double * startQuaternion = start->quaternion;
+    const double * endQuaternion   = end->quaternion;
+    
+    double product = ( startQuaternion[ 0 ] * endQuaternion[ 0 ] ) + ( startQuaternion[ 1 ] * endQuaternion[ 1 ] ) +
+                     ( startQuaternion[ 2 ] * endQuaternion[ 2 ] ) + ( startQuaternion[ 3 ] * endQuaternion[ 3 ] );
+    double endSign = 1;
+    
+    if( product < 0 )
+    {
+        product = -product;
+        endSign = -1;
+    }
+    
+    double startWeight, endWeight;
+    
+    if( product < ( 1 - 1e-12 ) )
+    {
+        const double angle = acos( product );
+        const double sine  = sqrt( 1 - ( product * product ) );
+        
+        startWeight = sin( ( 1 - offset ) * angle ) / sine;
+        endWeight   = sin( offset * angle ) / sine * endSign;
+    }
+    else
+    {
+        // The rotations are (almost) the same, so the arc is (almost) a line.
+        
+        startWeight = ( 1 - offset );
+        endWeight   = offset * endSign;
+    }
+    
+    double quaternion[ 4 ];
+    
+    for( uint32_t i = 0; i < 4; i++ )
+    {
+        quaternion[ i ] = ( startQuaternion[ i ] * startWeight ) + ( endQuaternion[ i ] * endWeight );
+    }
+    
+    // The remaining components are interpolated linearly. The result may be the same as either decomposition, so it is only
+    // written once the quaternions have been read.
+    
+    for( uint32_t i = 0; i < 3; i++ )
+    {
+        result->scale[ i ]       = interpolateDouble( start->scale[ i ], end->scale[ i ], offset );
+        result->skew[ i ]        = interpolateDouble( start->skew[ i ], end->skew[ i ], offset );
+        result->translation[ i ] = interpolateDouble( start->translation[ i ], end->translation[ i ], offset );
+    }
+    
+    for( uint32_t i = 0; i < 4; i++ )
+    {
+        result->perspective[ i ] = interpolateDouble( start->perspective[ i ], end->perspective[ i ], offset );
+        result->quaternion[ i ]  = quaternion[ i ];
+    }
+}
+
+bool getTransform3DWithOffsetBetweenTransform3Ds( const double * start, const double * end, double offset, double * result ) {
+    
+    SUTransform3DDecomposition startDecomposition, endDecomposition;
+    
+    if( ( false == decomposeTransform3D( start, &startDecomposition ) ) || ( false == decomposeTransform3D( end, &endDecomposition ) ) )
+    {
+        memmove( result, ( offset < 0.5 ) ? start : end, 16 * sizeof( double ) );
+        return false;
+    }
+    
+    interpolateTransform3DDecompositions( &startDecomposition, &endDecomposition, offset, &startDecomposition );
+    recomposeTransform3D( &startDecomposition, result );
+    
+    return true;
+}
@@ -0,0 +1,140 @@
+//
+//  SUTransformDecomposition.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUTransformDecomposition_h
+#define SpringUtils_SUTransformDecomposition_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "SUBase.h"
+
+/** Decomposition and interpolation of affine and 3D transform matrices.
+ *
+ *  Interpolating a transform's matrix component by component doesn't interpolate what it does: a rotation by a half turn,
+ *  for instance, passes through a zero matrix. Instead, each transform is decomposed in to simple transforms (translation,
+ *  scale, shear, rotation and, for 3D transforms, perspective), which are interpolated and then recomposed. Rotations take the
+ *  shortest path. 3D transforms are decomposed much as the CSS Transforms specification describes, and their rotations are
+ *  interpolated by spherical linear interpolation of quaternions.
+ *
+ *  Decomposing a transform costs much more than recomposing one, so to interpolate between the same transforms many times,
+ *  decompose them once and interpolate their decompositions (SUInterpolationSession does this for NSValues).
+ *
+ *  This file is portable C, with no dependency on CoreGraphics. Affine transforms are 6 doubles, in the order of the fields of
+ *  CGAffineTransform (a, b, c, d, tx, ty). 3D transforms are 4x4 matrices of doubles, laid out as the fields of CATransform3D
+ *  (i.e. row by row, with the translation in elements 12 to 14), and transform row vectors. See SUTransformInterpolation.h
+ *  for functions which take CGAffineTransforms and CATransform3Ds.
+ */
+
+/** An affine transform, decomposed in to the transforms which are applied in order to produce it. */
+
+typedef struct _SUAffineTransformDecomposition {
+    
+    double scale[ 2 ];
+    double shear;           /**< The multiple of the scaled x axis which is added to the y axis. */
+    double rotation;        /**< The rotation, in radians, in (-π, π]. */
+    double translation[ 2 ];
+    
+} SUAffineTransformDecomposition;
+
+/** A 3D transform, decomposed in to the transforms which are applied in order to produce it. */
+
+typedef struct _SUTransform3DDecomposition {
+    
+    double scale[ 3 ];
+    double skew[ 3 ];           /**< The multiples of the scaled x axis added to the y axis, and of the x and y axes added to the z axis. */
+    double quaternion[ 4 ];     /**< The rotation, as a unit quaternion (x, y, z, w). */
+    double translation[ 3 ];
+    double perspective[ 4 ];
+    
+} SUTransform3DDecomposition;
+
+
+//---------------------------------------/
+/** @name Decomposing Affine Transforms */
+//---------------------------------------/
+
+
+/** Decomposes an affine transform. Every affine transform, including singular ones, can be decomposed.
+ *
+ *  @param  matrix          The transform's matrix, as 6 doubles (a, b, c, d, tx, ty).
+ *  @param  oDecomposition  On output, the transform's decomposition.
+ */
+
+SU_EXTERN void decomposeAffineMatrix( const double * matrix, SUAffineTransformDecomposition * oDecomposition );
+
+/** Recomposes an affine transform.
+ *
+ *  @param  decomposition   The transform's decomposition.
+ *  @param  matrix          On output, the transform's matrix, as 6 doubles (a, b, c, d, tx, ty).
+ */
+
+SU_EXTERN void recomposeAffineMatrix( const SUAffineTransformDecomposition * decomposition, double * matrix );
+
+/** Interpolates between two affine transform decompositions.
+ *
+ *  @param  start   The start decomposition. This is the decomposition returned when the offset is 0.
+ *  @param  end     The final decomposition. This is the decomposition returned when the offset is 1.
+ *  @param  offset  The offset.
+ *  @param  result  On output, the decomposition at distance `offset` in to the interpolation. This may be the same as `start` or `end`.
+ */
+
+SU_EXTERN void interpolateAffineTransformDecompositions( const SUAffineTransformDecomposition * start, const SUAffineTransformDecomposition * end,
+                                                         double offset, SUAffineTransformDecomposition * result );
+
+
+//-----------------------------------/
+/** @name Decomposing 3D Transforms */
+//-----------------------------------/
+
+
+/** Decomposes a 3D transform.
+ *
+ *  @param  matrix          The transform's matrix.
+ *  @param  oDecomposition  On output, the transform's decomposition.
+ *
+ *  @returns                true, or false if the transform can't be decomposed (if element 15 is 0, or the transform has a
+ *                          perspective component and is singular).
+ */
+
+SU_EXTERN bool decomposeTransform3D( const double * matrix, SUTransform3DDecomposition * oDecomposition );
+
+/** Recomposes a 3D transform.
+ *
+ *  @param  decomposition   The transform's decomposition.
+ *  @param  matrix          On output, the transform's matrix.
+ */
+
+SU_EXTERN void recomposeTransform3D( const SUTransform3DDecomposition * decomposition, double * matrix );
+
+/** Interpolates between two 3D transform decompositions.
+ *
+ *  @param  start   The start decomposition. This is the decomposition returned when the offset is 0.
+ *  @param  end     The final decomposition. This is the decomposition returned when the offset is 1.
+ *  @param  offset  The offset.
+ *  @param  result  On output, the decomposition at distance `offset` in to the interpolation. This may be the same as `start` or `end`.
+ */
+
+SU_EXTERN void interpolateTransform3DDecompositions( const SUTransform3DDecomposition * start, const SUTransform3DDecomposition * end,
+                                                     double offset, SUTransform3DDecomposition * result );
+
+/** Gets the 3D transform at a given offset between two 3D transforms.
+ *
+ *  @param  start   The start transform's matrix. This is the transform returned when the offset is 0.
+ *  @param  end     The final transform's matrix. This is the transform returned when the offset is 1.
+ *  @param  offset  The offset.
+ *  @param  result  On output, the matrix of the transform at distance `offset` in to an interpolation between the decompositions
+ *                  of `start` and `end`. If either can't be decomposed, this is `start` if the offset is less than 0.5, or `end`.
+ *
+ *  @returns        true, or false if either transform can't be decomposed.
+ */
+
+SU_EXTERN bool getTransform3DWithOffsetBetweenTransform3Ds( const double * start, const double * end, double offset, double * result );
+
+#endif
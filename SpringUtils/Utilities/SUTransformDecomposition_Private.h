@@ -0,0 +1,17 @@
+//
+//  SUTransformDecomposition_Private.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#include "SUTransformDecomposition.h"
+
+// Variants of the 4x4 matrix kernels which can be forced to use their scalar loops, for comparison against the SIMD kernels.
+// multiplyTransform3DKernel() computes a * b (a's transform followed by b's); `result` may be the same as `a` or `b`.
+
+SU_EXTERN void multiplyTransform3DKernel( const double * a, const double * b, double * result, bool vector );
+SU_EXTERN void recomposeTransform3DKernel( const SUTransform3DDecomposition * decomposition, double * matrix, bool vector );
@@ -0,0 +1,46 @@
+//
+//  SUTransformInterpolation.c
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUTransformInterpolation.h"
+
+#pragma mark -
+#pragma mark Affine Transforms
+
+void decomposeAffineTransform( CGAffineTransform transform, SUAffineTransformDecomposition * oDecomposition ) {
+    
+    const double matrix[ 6 ] = { transform.a, transform.b, transform.c, transform.d, transform.tx, transform.ty };
+    
+    decomposeAffineMatrix( matrix, oDecomposition );
+}
+
+CGAffineTransform recomposeAffineTransform( const SUAffineTransformDecomposition * decomposition ) {
+    
+    double matrix[ 6 ];
+    
+    recomposeAffineMatrix( decomposition, matrix );
+    
+    return (CGAffineTransform){ .a  = (CGFloat)matrix[ 0 ],
+                                .b  = (CGFloat)matrix[ 1 ],
+                                .c  = (CGFloat)matrix[ 2 ],
+                                .d  = (CGFloat)matrix[ 3 ],
+                                .tx = (CGFloat)matrix[ 4 ],
+                                .ty = (CGFloat)matrix[ 5 ] };
+}
+
+CGAffineTransform affineTransformWithOffsetBetweenAffineTransforms( CGAffineTransform start, CGAffineTransform end, SUInterpolationOffset offset ) {
+    
+    SUAffineTransformDecomposition startDecomposition, endDecomposition;
+    
+    decomposeAffineTransform( start, &startDecomposition );
+    decomposeAffineTransform( end, &endDecomposition );
+    interpolateAffineTransformDecompositions( &startDecomposition, &endDecomposition, offset, &startDecomposition );
+    
+    return recomposeAffineTransform( &startDecomposition );
+}
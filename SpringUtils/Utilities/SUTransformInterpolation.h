@@ -0,0 +1,74 @@
+//
+//  SUTransformInterpolation.h
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#ifndef SpringUtils_SUTransformInterpolation_h
+#define SpringUtils_SUTransformInterpolation_h
+
+#import "SUValueInterpolation.h"
+#import "SUTransformDecomposition.h"
+
+/** Interpolation of CGAffineTransforms and CATransform3Ds, by decomposition (see SUTransformDecomposition.h). */
+
+
+//-----------------------------------------/
+/** @name Interpolating Affine Transforms */
+//-----------------------------------------/
+
+
+/** Decomposes an affine transform. Every affine transform, including singular ones, can be decomposed.
+ *
+ *  @param  transform       The transform.
+ *  @param  oDecomposition  On output, the transform's decomposition.
+ */
+
+SU_EXTERN void decomposeAffineTransform( CGAffineTransform transform, SUAffineTransformDecomposition * oDecomposition );
+
+/** Returns the affine transform with a given decomposition. */
+
+SU_EXTERN CGAffineTransform recomposeAffineTransform( const SUAffineTransformDecomposition * decomposition );
+
+/** Returns the affine transform at a given offset between two affine transforms.
+ *
+ *  @param  start   The start transform. This is the transform returned when the offset is 0.
+ *  @param  end     The final transform. This is the transform returned when the offset is 1.
+ *  @param  offset  The offset.
+ *
+ *  @returns        The transform at distance `offset` in to an interpolation between the decompositions of `start` and `end`.
+ */
+
+SU_EXTERN CGAffineTransform affineTransformWithOffsetBetweenAffineTransforms( CGAffineTransform start, CGAffineTransform end, SUInterpolationOffset offset );
+
+
+//-------------------------------------/
+/** @name Interpolating 3D Transforms */
+//-------------------------------------/
+
+
+/** Copies a matrix of CGFloats (e.g. the fields of a CATransform3D, from `m11`) to a matrix of doubles. */
+
+SU_INLINE void getTransform3DFromCGFloats( const CGFloat * elements, double * matrix ) {
+    
+    for( UInt32 i = 0; i < 16; i++ )
+    {
+        matrix[ i ] = elements[ i ];
+    }
+}
+
+/** Copies a matrix of doubles to a matrix of CGFloats (e.g. the fields of a CATransform3D, from `m11`). */
+
+SU_INLINE void getCGFloatsFromTransform3D( const double * matrix, CGFloat * elements ) {
+    
+    for( UInt32 i = 0; i < 16; i++ )
+    {
+        elements[ i ] = (CGFloat)matrix[ i ];
+    }
+}
+
+#endif
@@ -9,6 +9,25 @@
 //
 
 #import "SUValueInterpolation.h"
+#import "SUValueInterpolation_Private.h"
+
+#if defined( __AVX__ )
+    #import <immintrin.h>
+    #define SU_INTERPOLATION_AVX 1
+#elif defined( __SSE2__ )
+    #import <emmintrin.h>
+    #define SU_INTERPOLATION_SSE2 1
+#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+    #import <arm_neon.h>
+    #define SU_INTERPOLATION_NEON 1
+    #if defined( __aarch64__ )
+        #define SU_INTERPOLATION_NEON_FLOAT64 1
+    #endif
+#endif
+
+// The array kernels must round exactly as the scalar functions do, so the compiler may not fuse multiplies and adds.
+
+#pragma STDC FP_CONTRACT OFF
 
 #pragma mark -
 #pragma mark C Types
@@ -53,3 +72,320 @@ CGRect rectWithOffsetBetweenRects( CGRect start, CGRect end, SUInterpolationOffs
     return (CGRect){    .origin = pointWithOffsetBetweenPoints( start.origin, end.origin, offset ),
                         .size   = sizeWithOffsetBetweenSizes( start.size, end.size, offset ) };
 }
+
+#pragma mark -
+#pragma mark Array Kernels
+
+// Each kernel computes start + ( ( end - start ) * offset ) for every element, in the same order of operations as the scalar
+// functions, so the vector loops and the scalar tails agree bit for bit. The offset variants apply each offset to
+// `componentsPerOffset` consecutive values (e.g. the x and y of a point), broadcasting it across the vector lanes they occupy.
+
+void interpolateFloat32Kernel( const float * starts, const float * ends, SUInterpolationOffset offset, float * results, size_t count, bool vector ) {
+    
+    size_t i = 0;
+    
+    if( vector )
+    {
+#if SU_INTERPOLATION_AVX
+        
+        const __m256 offsets = _mm256_set1_ps( offset );
+        
+        for( ; ( i + 8 ) <= count; i += 8 )
+        {
+            const __m256 start = _mm256_loadu_ps( starts + i );
+            _mm256_storeu_ps( results + i, _mm256_add_ps( start, _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( ends + i ), start ), offsets ) ) );
+        }
+        
+#elif SU_INTERPOLATION_SSE2
+        
+        const __m128 offsets = _mm_set1_ps( offset );
+        
+        for( ; ( i + 4 ) <= count; i += 4 )
+        {
+            const __m128 start = _mm_loadu_ps( starts + i );
+            _mm_storeu_ps( results + i, _mm_add_ps( start, _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( ends + i ), start ), offsets ) ) );
+        }
+        
+#elif SU_INTERPOLATION_NEON
+        
+        const float32x4_t offsets = vdupq_n_f32( offset );
+        
+        for( ; ( i + 4 ) <= count; i += 4 )
+        {
+            const float32x4_t start = vld1q_f32( starts + i );
+            vst1q_f32( results + i, vaddq_f32( start, vmulq_f32( vsubq_f32( vld1q_f32( ends + i ), start ), offsets ) ) );
+        }
+        
+#endif
+    }
+    
+    for( ; i < count; i++ )
+    {
+        results[ i ] = floatWithOffsetBetweenFloats( starts[ i ], ends[ i ], offset );
+    }
+}
+
+void interpolateFloat32WithOffsetsKernel( const float * starts, const float * ends, const SUInterpolationOffset * offsets, UInt32 componentsPerOffset, float * results, size_t count, bool vector ) {
+    
+    size_t i = 0;
+    
+    if( vector )
+    {
+#if SU_INTERPOLATION_AVX
+        
+        // Each vector covers 8 values, so 8, 4 or 2 offsets.
+        
+        const size_t offsetsPerVector = ( 8 / componentsPerOffset );
+        
+        for( ; ( i + offsetsPerVector ) <= count; i += offsetsPerVector )
+        {
+            const SUInterpolationOffset * o = ( offsets + i );
+            __m256 offset;
+            
+            if( 1 == componentsPerOffset )
+                offset = _mm256_loadu_ps( o );
+            else if( 2 == componentsPerOffset )
+                offset = _mm256_setr_ps( o[ 0 ], o[ 0 ], o[ 1 ], o[ 1 ], o[ 2 ], o[ 2 ], o[ 3 ], o[ 3 ] );
+            else
+                offset = _mm256_setr_ps( o[ 0 ], o[ 0 ], o[ 0 ], o[ 0 ], o[ 1 ], o[ 1 ], o[ 1 ], o[ 1 ] );
+            
+            const size_t v      = ( i * componentsPerOffset );
+            const __m256 start  = _mm256_loadu_ps( starts + v );
+            _mm256_storeu_ps( results + v, _mm256_add_ps( start, _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( ends + v ), start ), offset ) ) );
+        }
+        
+#elif SU_INTERPOLATION_SSE2
+        
+        // Each vector covers 4 values, so 4, 2 or 1 offsets.
+        
+        const size_t offsetsPerVector = ( 4 / componentsPerOffset );
+        
+        for( ; ( i + offsetsPerVector ) <= count; i += offsetsPerVector )
+        {
+            const SUInterpolationOffset * o = ( offsets + i );
+            __m128 offset;
+            
+            if( 1 == componentsPerOffset )
+                offset = _mm_loadu_ps( o );
+            else if( 2 == componentsPerOffset )
+                offset = _mm_setr_ps( o[ 0 ], o[ 0 ], o[ 1 ], o[ 1 ] );
+            else
+                offset = _mm_set1_ps( o[ 0 ] );
+            
+            const size_t v      = ( i * componentsPerOffset );
+            const __m128 start  = _mm_loadu_ps( starts + v );
+            _mm_storeu_ps( results + v, _mm_add_ps( start, _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( ends + v ), start ), offset ) ) );
+        }
+        
+#elif SU_INTERPOLATION_NEON
+        
+        const size_t offsetsPerVector = ( 4 / componentsPerOffset );
+        
+        for( ; ( i + offsetsPerVector ) <= count; i += offsetsPerVector )
+        {
+            const SUInterpolationOffset * o = ( offsets + i );
+            float32x4_t offset;
+            
+            if( 1 == componentsPerOffset )
+                offset = vld1q_f32( o );
+            else if( 2 == componentsPerOffset )
+                offset = vcombine_f32( vdup_n_f32( o[ 0 ] ), vdup_n_f32( o[ 1 ] ) );
+            else
+                offset = vdupq_n_f32( o[ 0 ] );
+            
+            const size_t v          = ( i * componentsPerOffset );
+            const float32x4_t start = vld1q_f32( starts + v );
+            vst1q_f32( results + v, vaddq_f32( start, vmulq_f32( vsubq_f32( vld1q_f32( ends + v ), start ), offset ) ) );
+        }
+        
+#endif
+    }
+    
+    for( ; i < count; i++ )
+    {
+        for( UInt32 component = 0; component < componentsPerOffset; component++ )
+        {
+            const size_t v = ( ( i * componentsPerOffset ) + component );
+            results[ v ]   = floatWithOffsetBetweenFloats( starts[ v ], ends[ v ], offsets[ i ] );
+        }
+    }
+}
+
+void interpolateFloat64Kernel( const double * starts, const double * ends, SUInterpolationOffset offset, double * results, size_t count, bool vector ) {
+    
+    size_t i = 0;
+    
+    if( vector )
+    {
+#if SU_INTERPOLATION_AVX
+        
+        const __m256d offsets = _mm256_set1_pd( offset );
+        
+        for( ; ( i + 4 ) <= count; i += 4 )
+        {
+            const __m256d start = _mm256_loadu_pd( starts + i );
+            _mm256_storeu_pd( results + i, _mm256_add_pd( start, _mm256_mul_pd( _mm256_sub_pd( _mm256_loadu_pd( ends + i ), start ), offsets ) ) );
+        }
+        
+#elif SU_INTERPOLATION_SSE2
+        
+        const __m128d offsets = _mm_set1_pd( offset );
+        
+        for( ; ( i + 2 ) <= count; i += 2 )
+        {
+            const __m128d start = _mm_loadu_pd( starts + i );
+            _mm_storeu_pd( results + i, _mm_add_pd( start, _mm_mul_pd( _mm_sub_pd( _mm_loadu_pd( ends + i ), start ), offsets ) ) );
+        }
+        
+#elif SU_INTERPOLATION_NEON_FLOAT64
+        
+        const float64x2_t offsets = vdupq_n_f64( offset );
+        
+        for( ; ( i + 2 ) <= count; i += 2 )
+        {
+            const float64x2_t start = vld1q_f64( starts + i );
+            vst1q_f64( results + i, vaddq_f64( start, vmulq_f64( vsubq_f64( vld1q_f64( ends + i ), start ), offsets ) ) );
+        }
+        
+#endif
+    }
+    
+    for( ; i < count; i++ )
+    {
+        results[ i ] = doubleWithOffsetBetweenDoubles( starts[ i ], ends[ i ], offset );
+    }
+}
+
+void interpolateFloat64WithOffsetsKernel( const double * starts, const double * ends, const SUInterpolationOffset * offsets, UInt32 componentsPerOffset, double * results, size_t count, bool vector ) {
+    
+    size_t i = 0;
+    
+    if( vector )
+    {
+#if SU_INTERPOLATION_AVX
+        
+        // Each vector covers 4 values, so 4, 2 or 1 offsets.
+        
+        const size_t offsetsPerVector = ( 4 / componentsPerOffset );
+        
+        for( ; ( i + offsetsPerVector ) <= count; i += offsetsPerVector )
+        {
+            const SUInterpolationOffset * o = ( offsets + i );
+            __m256d offset;
+            
+            if( 1 == componentsPerOffset )
+                offset = _mm256_cvtps_pd( _mm_loadu_ps( o ) );
+            else if( 2 == componentsPerOffset )
+                offset = _mm256_setr_pd( o[ 0 ], o[ 0 ], o[ 1 ], o[ 1 ] );
+            else
+                offset = _mm256_set1_pd( o[ 0 ] );
+            
+            const size_t v      = ( i * componentsPerOffset );
+            const __m256d start = _mm256_loadu_pd( starts + v );
+            _mm256_storeu_pd( results + v, _mm256_add_pd( start, _mm256_mul_pd( _mm256_sub_pd( _mm256_loadu_pd( ends + v ), start ), offset ) ) );
+        }
+        
+#elif SU_INTERPOLATION_SSE2 || SU_INTERPOLATION_NEON_FLOAT64
+        
+        // Each vector covers 2 values, so a point or rectangle takes one or two vectors per offset.
+        
+        if( 1 == componentsPerOffset )
+        {
+            for( ; ( i + 2 ) <= count; i += 2 )
+            {
+    #if SU_INTERPOLATION_SSE2
+                const __m128d offset = _mm_setr_pd( offsets[ i ], offsets[ i + 1 ] );
+                const __m128d start  = _mm_loadu_pd( starts + i );
+                _mm_storeu_pd( results + i, _mm_add_pd( start, _mm_mul_pd( _mm_sub_pd( _mm_loadu_pd( ends + i ), start ), offset ) ) );
+    #else
+                const float64x2_t offset = vcvt_f64_f32( vld1_f32( offsets + i ) );
+                const float64x2_t start  = vld1q_f64( starts + i );
+                vst1q_f64( results + i, vaddq_f64( start, vmulq_f64( vsubq_f64( vld1q_f64( ends + i ), start ), offset ) ) );
+    #endif
+            }
+        }
+        else
+        {
+            for( ; i < count; i++ )
+            {
+                for( UInt32 component = 0; component < componentsPerOffset; component += 2 )
+                {
+                    const size_t v = ( ( i * componentsPerOffset ) + component );
+    #if SU_INTERPOLATION_SSE2
+                    const __m128d offset = _mm_set1_pd( offsets[ i ] );
+                    const __m128d start  = _mm_loadu_pd( starts + v );
+                    _mm_storeu_pd( results + v, _mm_add_pd( start, _mm_mul_pd( _mm_sub_pd( _mm_loadu_pd( ends + v ), start ), offset ) ) );
+    #else
+                    const float64x2_t offset = vdupq_n_f64( offsets[ i ] );
+                    const float64x2_t start  = vld1q_f64( starts + v );
+                    vst1q_f64( results + v, vaddq_f64( start, vmulq_f64( vsubq_f64( vld1q_f64( ends + v ), start ), offset ) ) );
+    #endif
+                }
+            }
+        }
+        
+#endif
+    }
+    
+    for( ; i < count; i++ )
+    {
+        for( UInt32 component = 0; component < componentsPerOffset; component++ )
+        {
+            const size_t v = ( ( i * componentsPerOffset ) + component );
+            results[ v ]   = doubleWithOffsetBetweenDoubles( starts[ v ], ends[ v ], offsets[ i ] );
+        }
+    }
+}
+
+#pragma mark -
+#pragma mark Arrays
+
+// Points and rectangles are arrays of CGFloats, whose width depends on the platform.
+
+#if CGFLOAT_IS_DOUBLE
+    #define interpolateCGFloatKernel            interpolateFloat64Kernel
+    #define interpolateCGFloatWithOffsetsKernel interpolateFloat64WithOffsetsKernel
+#else
+    #define interpolateCGFloatKernel            interpolateFloat32Kernel
+    #define interpolateCGFloatWithOffsetsKernel interpolateFloat32WithOffsetsKernel
+#endif
+
+void getFloatsWithOffsetBetweenFloats( const float * starts, const float * ends, SUInterpolationOffset offset, float * results, size_t count ) {
+    
+    interpolateFloat32Kernel( starts, ends, offset, results, count, true );
+}
+
+void getFloatsWithOffsetsBetweenFloats( const float * starts, const float * ends, const SUInterpolationOffset * offsets, float * results, size_t count ) {
+    
+    interpolateFloat32WithOffsetsKernel( starts, ends, offsets, 1, results, count, true );
+}
+
+void getDoublesWithOffsetBetweenDoubles( const double * starts, const double * ends, SUInterpolationOffset offset, double * results, size_t count ) {
+    
+    interpolateFloat64Kernel( starts, ends, offset, results, count, true );
+}
+
+void getDoublesWithOffsetsBetweenDoubles( const double * starts, const double * ends, const SUInterpolationOffset * offsets, double * results, size_t count ) {
+    
+    interpolateFloat64WithOffsetsKernel( starts, ends, offsets, 1, results, count, true );
+}
+
+void getPointsWithOffsetBetweenPoints( const CGPoint * starts, const CGPoint * ends, SUInterpolationOffset offset, CGPoint * results, size_t count ) {
+    
+    interpolateCGFloatKernel( (const CGFloat *)starts, (const CGFloat *)ends, offset, (CGFloat *)results, count * 2, true );
+}
+
+void getPointsWithOffsetsBetweenPoints( const CGPoint * starts, const CGPoint * ends, const SUInterpolationOffset * offsets, CGPoint * results, size_t count ) {
+    
+    interpolateCGFloatWithOffsetsKernel( (const CGFloat *)starts, (const CGFloat *)ends, offsets, 2, (CGFloat *)results, count, true );
+}
+
+void getRectsWithOffsetBetweenRects( const CGRect * starts, const CGRect * ends, SUInterpolationOffset offset, CGRect * results, size_t count ) {
+    
+    interpolateCGFloatKernel( (const CGFloat *)starts, (const CGFloat *)ends, offset, (CGFloat *)results, count * 4, true );
+}
+
+void getRectsWithOffsetsBetweenRects( const CGRect * starts, const CGRect * ends, const SUInterpolationOffset * offsets, CGRect * results, size_t count ) {
+    
+    interpolateCGFloatWithOffsetsKernel( (const CGFloat *)starts, (const CGFloat *)ends, offsets, 4, (CGFloat *)results, count, true );
+}
@@ -0,0 +1,19 @@
+//
+//  SUValueInterpolation_Private.h
+//  SpringUtils
+//
+//  (c) 2013-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import "SUValueInterpolation.h"
+
+// Variants of the array interpolation kernels which can be forced to use their scalar loops, for comparison against the SIMD kernels.
+// The offset variants interpolate `componentsPerOffset` (1, 2 or 4) consecutive values by each offset, and `count` is the number of offsets.
+
+SU_EXTERN void interpolateFloat32Kernel( const float * starts, const float * ends, SUInterpolationOffset offset, float * results, size_t count, bool vector );
+SU_EXTERN void interpolateFloat32WithOffsetsKernel( const float * starts, const float * ends, const SUInterpolationOffset * offsets, UInt32 componentsPerOffset, float * results, size_t count, bool vector );
+SU_EXTERN void interpolateFloat64Kernel( const double * starts, const double * ends, SUInterpolationOffset offset, double * results, size_t count, bool vector );
+SU_EXTERN void interpolateFloat64WithOffsetsKernel( const double * starts, const double * ends, const SUInterpolationOffset * offsets, UInt32 componentsPerOffset, double * results, size_t count, bool vector );
@@ -18,10 +18,25 @@
 #import "SUAssociatedWeakObjects.h"
 
 #import "SUComparatorTools.h"
+#import "SUSoundCore.h"
 #import "SUSoundTools.h"
+#import "SUSoundStream.h"
+#import "SUSoundEffectCache.h"
+#import "SUSoundBank.h"
+#import "SUSoundInstrumentation.h"
+#import "SUSoundMixer.h"
+#import "SUPCMConversion.h"
+#import "SUSoundCompression.h"
+#import "SUSoundWaveform.h"
+#import "SUSoundResampler.h"
+#import "SUSoundAnalysis.h"
 
 #import "SUTimeFrame.h"
 
 #import "SUValueInterpolation.h"
+#import "SUKeyframeTrack.h"
+#import "SUStructInterpolation.h"
+#import "SUTransformDecomposition.h"
+#import "SUTransformInterpolation.h"
 
 #endif
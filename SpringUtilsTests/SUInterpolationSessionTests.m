@@ -0,0 +1,245 @@
+//
+//  SUInterpolationSessionTests.m
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import <XCTest/XCTest.h>
+#import "SUInterpolationSession.h"
+
+#import <malloc/malloc.h>
+#import "NSValue+SUInterpolable.h"
+#import <QuartzCore/CATransform3D.h>
+
+typedef struct {
+    
+    double x, y, z, w;
+    
+} SUTestQuadruple;
+
+/** Returns the number of heap blocks currently allocated, in every zone. */
+
+static long allocatedBlockCount( void ) {
+    
+    malloc_statistics_t statistics;
+    malloc_zone_statistics( NULL, &statistics );
+    
+    return (long)statistics.blocks_in_use;
+}
+
+@interface SUInterpolationSessionTests : XCTestCase
+
+@end
+
+@implementation SUInterpolationSessionTests
+
+- (void)testSessionsMatchBoxedInterpolation {
+    
+    NSNumber * fromNumber = @( 12.5 ), * toNumber = @( -3 );
+    SUInterpolationSession * numberSession = [SUInterpolationSession sessionWithFromValue: fromNumber toValue: toNumber];
+    
+    XCTAssertTrue( numberSession.isNumeric, @"Numbers should be numeric" );
+    XCTAssertEqual( 0, strcmp( numberSession.objCType, @encode( double ) ), @"Numbers should be interpolated as doubles" );
+    
+    for( SUInterpolationOffset offset = -0.5f; offset <= 1.5f; offset += 0.125f )
+    {
+        NSNumber * boxed = [NSNumber interpolatedValueWithOffset: offset betweenValue: fromNumber andValue: toNumber];
+        double value;
+        
+        [numberSession getValue: &value atOffset: offset];
+        
+        XCTAssertEqual( [numberSession valueAtOffset: offset], boxed.doubleValue, @"Session differs at offset %f", offset );
+        XCTAssertEqual( value, boxed.doubleValue, @"Session differs at offset %f", offset );
+        XCTAssertEqualObjects( [numberSession boxedValueAtOffset: offset], boxed, @"Session differs at offset %f", offset );
+    }
+    
+    // BOOLs snap in the middle.
+    
+    SUInterpolationSession * boolSession = [SUInterpolationSession sessionWithFromValue: @NO toValue: @YES];
+    BOOL flag;
+    
+    [boolSession getValue: &flag atOffset: 0.4f];
+    XCTAssertEqual( flag, NO, @"BOOL should not have snapped yet" );
+    
+    [boolSession getValue: &flag atOffset: 0.6f];
+    XCTAssertEqual( flag, YES, @"BOOL should have snapped" );
+    
+    // Structures are interpolated field by field.
+    
+    SUTestQuadruple from = { 0, 1, 2, 3 }, to = { 4, 5, 6, 7 }, value, boxedValue;
+    
+    NSValue * fromValue = [NSValue valueWithBytes: &from objCType: @encode( SUTestQuadruple )];
+    NSValue * toValue   = [NSValue valueWithBytes: &to objCType: @encode( SUTestQuadruple )];
+    SUInterpolationSession * structSession = [SUInterpolationSession sessionWithFromValue: fromValue toValue: toValue];
+    
+    XCTAssertFalse( structSession.isNumeric, @"Structures aren't numeric" );
+    XCTAssertEqual( structSession.valueSize, sizeof( SUTestQuadruple ), @"Session has the wrong value size" );
+    
+    [structSession getValue: &value atOffset: 0.25f];
+    [[NSValue interpolatedValueWithOffset: 0.25f betweenValue: fromValue andValue: toValue] getValue: &boxedValue];
+    
+    XCTAssertTrue( 0 == memcmp( &value, &boxedValue, sizeof( SUTestQuadruple ) ), @"Session differs from boxed interpolation" );
+    XCTAssertEqual( value.w, 4.0, @"Structure was not interpolated" );
+    
+    [[structSession boxedValueAtOffset: 0.25f] getValue: &boxedValue];
+    XCTAssertTrue( 0 == memcmp( &value, &boxedValue, sizeof( SUTestQuadruple ) ), @"Boxed accessor differs" );
+    XCTAssertEqual( [structSession boxedValueAtOffset: 1], toValue, @"Fixed points should return the values themselves" );
+}
+
+- (void)testSessionsInterpolateTransformsAsValuesDo {
+    
+    CGAffineTransform from = CGAffineTransformMake( 2, 1, -1, 3, 10, 20 ), to = CGAffineTransformMakeRotation( -2 ), transform, boxedTransform;
+    
+    NSValue * fromValue = [NSValue valueWithBytes: &from objCType: @encode( CGAffineTransform )];
+    NSValue * toValue   = [NSValue valueWithBytes: &to objCType: @encode( CGAffineTransform )];
+    SUInterpolationSession * session = [SUInterpolationSession sessionWithFromValue: fromValue toValue: toValue];
+    
+    for( SUInterpolationOffset offset = -0.5f; offset <= 1.5f; offset += 0.125f )
+    {
+        // At the fixed points, NSValue returns the values themselves, which sessions recompose.
+        
+        if( 0 == offset || 1 == offset )
+            continue;
+        
+        [session getValue: &transform atOffset: offset];
+        [[NSValue interpolatedValueWithOffset: offset betweenValue: fromValue andValue: toValue] getValue: &boxedTransform];
+        
+        XCTAssertTrue( 0 == memcmp( &transform, &boxedTransform, sizeof( CGAffineTransform ) ), @"Session differs at offset %f", offset );
+    }
+    
+    CATransform3D from3D = { 0, 0, -1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1 };
+    CATransform3D to3D   = { 1, 0, 0, 0, 0, 1, 0, -0.002, 0, 0, 2, 0, 5, 6, 7, 1 };
+    CATransform3D transform3D, boxedTransform3D;
+    
+    fromValue = [NSValue valueWithBytes: &from3D objCType: @encode( CATransform3D )];
+    toValue   = [NSValue valueWithBytes: &to3D objCType: @encode( CATransform3D )];
+    session   = [SUInterpolationSession sessionWithFromValue: fromValue toValue: toValue];
+    
+    XCTAssertEqual( session.valueSize, sizeof( CATransform3D ), @"Session has the wrong value size" );
+    
+    for( SUInterpolationOffset offset = -0.5f; offset <= 1.5f; offset += 0.125f )
+    {
+        if( 0 == offset || 1 == offset )
+            continue;
+        
+        [session getValue: &transform3D atOffset: offset];
+        [[session boxedValueAtOffset: offset] getValue: &boxedTransform3D];
+        
+        XCTAssertTrue( 0 == memcmp( &transform3D, &boxedTransform3D, sizeof( CATransform3D ) ), @"Boxed accessor differs at offset %f", offset );
+        
+        [[NSValue interpolatedValueWithOffset: offset betweenValue: fromValue andValue: toValue] getValue: &boxedTransform3D];
+        
+        XCTAssertTrue( 0 == memcmp( &transform3D, &boxedTransform3D, sizeof( CATransform3D ) ), @"Session differs at offset %f", offset );
+    }
+}
+
+- (void)testSessionsInterpolateGeometryAsValuesDo {
+    
+    CGRect from = CGRectMake( 0.1, -3.7, 100.3, 0.01 ), to = CGRectMake( 1e6 / 3, 2.9, -7.1, 55.55 ), rect, boxedRect;
+    
+    NSValue * fromValue = [NSValue valueWithBytes: &from objCType: @encode( CGRect )];
+    NSValue * toValue   = [NSValue valueWithBytes: &to objCType: @encode( CGRect )];
+    SUInterpolationSession * session = [SUInterpolationSession sessionWithFromValue: fromValue toValue: toValue];
+    
+    XCTAssertEqual( session.valueSize, sizeof( CGRect ), @"Session has the wrong value size" );
+    
+    for( SUInterpolationOffset offset = -0.5f; offset <= 1.5f; offset += 0.0625f )
+    {
+        if( 0 == offset || 1 == offset )
+            continue;
+        
+        [session getValue: &rect atOffset: offset];
+        [[NSValue interpolatedValueWithOffset: offset betweenValue: fromValue andValue: toValue] getValue: &boxedRect];
+        
+        XCTAssertTrue( 0 == memcmp( &rect, &boxedRect, sizeof( CGRect ) ), @"Session differs at offset %f", offset );
+        
+        [[session boxedValueAtOffset: offset] getValue: &boxedRect];
+        
+        XCTAssertTrue( 0 == memcmp( &rect, &boxedRect, sizeof( CGRect ) ), @"Boxed accessor differs at offset %f", offset );
+    }
+}
+
+- (void)testSessionsDoNotAllocatePerFrame {
+    
+    const int numberOfFrames = 10000;
+    
+    SUTestQuadruple from = { 0, 1, 2, 3 }, to = { 4, 5, 6, 7 }, value;
+    
+    NSValue * fromValue = [NSValue valueWithBytes: &from objCType: @encode( SUTestQuadruple )];
+    NSValue * toValue   = [NSValue valueWithBytes: &to objCType: @encode( SUTestQuadruple )];
+    NSNumber * fromNumber = @( 1234.5678 ), * toNumber = @( 9876.54321 );
+    
+    SUInterpolationSession * structSession = [SUInterpolationSession sessionWithFromValue: fromValue toValue: toValue];
+    SUInterpolationSession * numberSession = [SUInterpolationSession sessionWithFromValue: fromNumber toValue: toNumber];
+    
+    // Boxed results are retained until each run is measured, so that every allocation is still in use when it is counted.
+    
+    CFTypeRef * results = malloc( numberOfFrames * sizeof( CFTypeRef ) );
+    long allocations[ 4 ];
+    double sum = 0;
+    
+    @autoreleasepool {
+        
+        long blocks = allocatedBlockCount();
+        
+        for( int frame = 0; frame < numberOfFrames; frame++ )
+        {
+            results[ frame ] = CFBridgingRetain( [NSValue interpolatedValueWithOffset: ( frame + 0.5f ) / numberOfFrames betweenValue: fromValue andValue: toValue] );
+        }
+        
+        allocations[ 0 ] = ( allocatedBlockCount() - blocks );
+        
+        for( int frame = 0; frame < numberOfFrames; frame++ )
+        {
+            CFRelease( results[ frame ] );
+        }
+        
+        blocks = allocatedBlockCount();
+        
+        for( int frame = 0; frame < numberOfFrames; frame++ )
+        {
+            [structSession getValue: &value atOffset: ( frame + 0.5f ) / numberOfFrames];
+            sum += value.x;
+        }
+        
+        allocations[ 1 ] = ( allocatedBlockCount() - blocks );
+        blocks = allocatedBlockCount();
+        
+        for( int frame = 0; frame < numberOfFrames; frame++ )
+        {
+            results[ frame ] = CFBridgingRetain( [NSNumber interpolatedValueWithOffset: ( frame + 0.5f ) / numberOfFrames betweenValue: fromNumber andValue: toNumber] );
+        }
+        
+        allocations[ 2 ] = ( allocatedBlockCount() - blocks );
+        
+        for( int frame = 0; frame < numberOfFrames; frame++ )
+        {
+            CFRelease( results[ frame ] );
+        }
+        
+        blocks = allocatedBlockCount();
+        
+        for( int frame = 0; frame < numberOfFrames; frame++ )
+        {
+            sum += [numberSession valueAtOffset: ( frame + 0.5f ) / numberOfFrames];
+        }
+        
+        allocations[ 3 ] = ( allocatedBlockCount() - blocks );
+    }
+    
+    free( results );
+    
+    NSLog( @"Allocations per frame: structures %.2f boxed, %.2f with a session; numbers %.2f boxed, %.2f with a session (%f)",
+           (double)allocations[ 0 ] / numberOfFrames, (double)allocations[ 1 ] / numberOfFrames,
+           (double)allocations[ 2 ] / numberOfFrames, (double)allocations[ 3 ] / numberOfFrames, sum );
+    
+    XCTAssertTrue( allocations[ 0 ] >= numberOfFrames, @"Boxed interpolation should allocate every frame" );
+    XCTAssertTrue( allocations[ 1 ] < ( numberOfFrames / 100 ), @"Sessions should not allocate" );
+    XCTAssertTrue( allocations[ 3 ] < ( numberOfFrames / 100 ), @"Sessions should not allocate" );
+}
+
+@end
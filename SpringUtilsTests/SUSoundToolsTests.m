@@ -0,0 +1,1908 @@
+//
+//  SUSoundToolsTests.m
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import <XCTest/XCTest.h>
+#import "SUSoundTools.h"
+#import "SUSoundStream.h"
+#import "SUSoundEffectCache.h"
+#import "SUSoundBank.h"
+#import "SUSoundInstrumentation.h"
+#import "SUSoundInstrumentation_Private.h"
+#import "SUSoundCompression.h"
+#import "SUSoundWaveform.h"
+#import "SUSoundResampler_Private.h"
+#import "SUSoundAnalysis_Private.h"
+#import "SUSoundMixer_Private.h"
+#import "SUPCMConversion_Private.h"
+
+/** Creates in-memory LPCM audio data filled with pseudo-random samples. */
+
+static SUSoundEffectData createTestAudioData( BOOL floatSamples, UInt32 numberOfChannels, UInt32 numberOfFrames, unsigned int seed ) {
+    
+    SUSoundEffectData data = calloc( 1, sizeof( struct _SUSoundEffectData ) );
+    
+    const UInt32 bytesPerSample = floatSamples ? sizeof( float ) : sizeof( SInt16 );
+    
+    data->retainCount                   = 1;
+    data->dataFormat.mSampleRate        = 44100;
+    data->dataFormat.mFormatID          = kAudioFormatLinearPCM;
+    data->dataFormat.mFormatFlags       = kAudioFormatFlagsNativeEndian | kAudioFormatFlagIsPacked |
+                                          ( floatSamples ? kAudioFormatFlagIsFloat : kAudioFormatFlagIsSignedInteger );
+    data->dataFormat.mFramesPerPacket   = 1;
+    data->dataFormat.mChannelsPerFrame  = numberOfChannels;
+    data->dataFormat.mBitsPerChannel    = ( bytesPerSample * 8 );
+    data->dataFormat.mBytesPerFrame     = ( bytesPerSample * numberOfChannels );
+    data->dataFormat.mBytesPerPacket    = data->dataFormat.mBytesPerFrame;
+    
+    data->numberOfAudioDataBytes        = ( (UInt64)numberOfFrames * data->dataFormat.mBytesPerFrame );
+    data->numberOfPackets               = numberOfFrames;
+    data->numberOfFrames                = numberOfFrames;
+    data->audioData                     = malloc( (size_t)data->numberOfAudioDataBytes );
+    
+    srand( seed );
+    
+    for( UInt32 i = 0; i < ( numberOfFrames * numberOfChannels ); i++ )
+    {
+        if( floatSamples )
+            ((float *)data->audioData)[ i ] = ( ( (float)rand() / RAND_MAX ) * 2.0f ) - 1.0f;
+        else
+            ((SInt16 *)data->audioData)[ i ] = (SInt16)( rand() & 0xFFFF );
+    }
+    
+    return data;
+}
+
+/** Creates in-memory canonical audio data containing a sine wave with an amplitude of 0.5. */
+
+static SUSoundEffectData createTestToneAudioData( Float64 sampleRate, double frequency, UInt32 numberOfFrames ) {
+    
+    SUSoundEffectData data = calloc( 1, sizeof( struct _SUSoundEffectData ) );
+    
+    data->retainCount               = 1;
+    data->dataFormat                = canonicalAudioDataFormat( sampleRate, 1 );
+    data->numberOfAudioDataBytes    = ( (UInt64)numberOfFrames * sizeof( float ) );
+    data->numberOfPackets           = numberOfFrames;
+    data->numberOfFrames            = numberOfFrames;
+    data->maximumPacketSize         = sizeof( float );
+    data->audioData                 = malloc( (size_t)data->numberOfAudioDataBytes );
+    
+    for( UInt32 i = 0; i < numberOfFrames; i++ )
+    {
+        ((float *)data->audioData)[ i ] = (float)( 0.5 * sin( 2 * M_PI * frequency * i / sampleRate ) );
+    }
+    
+    return data;
+}
+
+@interface SUSoundToolsTests : XCTestCase
+
+@end
+
+@implementation SUSoundToolsTests
+
+#pragma mark -
+#pragma mark SUSoundMixer
+
+- (void)verifyVectorMixerMatchesScalarMixerWithOutputFormat: (SUSoundMixerSampleFormat)outputFormat {
+    
+    const UInt32 numberOfFrames = 2000;
+    
+    SUSoundMixer mixers[ 2 ];
+    
+    for( int m = 0; m < 2; m++ )
+    {
+        // Odd buffer and voice lengths exercise the scalar tails of the vector kernels,
+        // and the gain is high enough for the integer output to saturate.
+        
+        mixers[ m ] = createSoundMixer( 44100, outputFormat, 16, 333 );
+        setSoundMixerUsesVectorKernels( mixers[ m ], ( 1 == m ) );
+        
+        for( UInt32 v = 0; v < 4; v++ )
+        {
+            SUSoundEffectData data = createTestAudioData( ( v & 1 ), 1 + ( ( v >> 1 ) & 1 ), 1000 + ( v * 77 ), v );
+            
+            XCTAssertNotEqual( startSoundMixerVoice( mixers[ m ], data, 1.7f, -0.8f + ( 0.5f * v ) ), -1, @"Voice %u failed to start", v );
+            
+            freeAudioData( data );
+        }
+    }
+    
+    const size_t bytesPerFrame = soundMixerOutputFormat( mixers[ 0 ] ).mBytesPerFrame;
+    
+    void * scalarOutput = malloc( numberOfFrames * bytesPerFrame );
+    void * vectorOutput = malloc( numberOfFrames * bytesPerFrame );
+    
+    mixSoundMixerVoices( mixers[ 0 ], scalarOutput, numberOfFrames );
+    mixSoundMixerVoices( mixers[ 1 ], vectorOutput, numberOfFrames );
+    
+    XCTAssertTrue( 0 == memcmp( scalarOutput, vectorOutput, numberOfFrames * bytesPerFrame ),
+                   @"Vector mixer output differs from the scalar reference" );
+    
+    XCTAssertFalse( soundMixerVoiceIsPlaying( mixers[ 1 ], 0 ), @"Voice did not stop at the end of its audio data" );
+    
+    free( scalarOutput );
+    free( vectorOutput );
+    
+    freeSoundMixer( mixers[ 0 ] );
+    freeSoundMixer( mixers[ 1 ] );
+}
+
+- (void)testMixerVectorKernelsMatchScalarKernelsWithFloatOutput {
+    
+    [self verifyVectorMixerMatchesScalarMixerWithOutputFormat: SUSoundMixerSampleFormatFloat32];
+}
+
+- (void)testMixerVectorKernelsMatchScalarKernelsWithInt16Output {
+    
+    [self verifyVectorMixerMatchesScalarMixerWithOutputFormat: SUSoundMixerSampleFormatInt16];
+}
+
+- (void)testTriggeredVoicesStartAtExactFrames {
+    
+    const UInt32 numberOfProducers      = 4;
+    const UInt32 triggersPerProducer    = 50;
+    const UInt64 firstTriggerTime       = 10000;
+    const UInt64 triggerInterval        = 97;
+    
+    SUSoundMixer mixer = createSoundMixer( 44100, SUSoundMixerSampleFormatFloat32, 64, 256 );
+    
+    // A single-frame impulse, panned hard left so that each trigger appears in the left channel at its gain.
+    
+    SUSoundEffectData impulse = createTestAudioData( YES, 1, 8, 0 );
+    memset( impulse->audioData, 0, (size_t)impulse->numberOfAudioDataBytes );
+    ((float *)impulse->audioData)[ 0 ] = 1.0f;
+    
+    // ===================
+    //
+    // 1. Triggers in the current buffer, and in later buffers, start at their sample times.
+    //
+    // ===================
+    
+    XCTAssertTrue( triggerSoundMixerVoice( mixer, impulse, 5, 0.5f, -1.0f ), @"Trigger was not queued" );
+    XCTAssertTrue( triggerSoundMixerVoice( mixer, impulse, 300, 0.25f, -1.0f ), @"Trigger was not queued" );
+    XCTAssertTrue( triggerSoundMixerVoice( mixer, impulse, 1000, 2.0f, -1.0f ), @"Trigger was not queued" );
+    
+    float * output = malloc( 2 * 1000 * sizeof( float ) );
+    
+    const UInt64 expectedTimes[ 3 ] = { 5, 300, 1000 };
+    const float  expectedGains[ 3 ] = { 0.5f, 0.25f, 2.0f };
+    UInt32 numberOfImpulses         = 0;
+    
+    for( UInt32 b = 0; b < 4; b++ )
+    {
+        const UInt64 bufferStart = soundMixerSampleTime( mixer );
+        
+        mixSoundMixerVoices( mixer, output, 512 );
+        
+        for( UInt32 f = 0; f < 512; f++ )
+        {
+            if( 0 == output[ 2 * f ] )
+                continue;
+            
+            if( numberOfImpulses < 3 )
+            {
+                XCTAssertEqual( bufferStart + f, expectedTimes[ numberOfImpulses ], @"Impulse %u started at the wrong frame", numberOfImpulses );
+                XCTAssertEqual( output[ 2 * f ], expectedGains[ numberOfImpulses ], @"Impulse %u has the wrong gain", numberOfImpulses );
+            }
+            
+            numberOfImpulses++;
+        }
+    }
+    
+    XCTAssertEqual( numberOfImpulses, 3U, @"Wrong number of impulses" );
+    
+    // ===================
+    //
+    // 2. Triggers queued concurrently by several threads all start, on a grid of sample times.
+    //
+    // ===================
+    
+    dispatch_apply( numberOfProducers, dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 ), ^( size_t p ) {
+        
+        for( UInt32 i = 0; i < triggersPerProducer; i++ )
+        {
+            const UInt64 sampleTime = firstTriggerTime + ( ( ( p * triggersPerProducer ) + i ) * triggerInterval );
+            
+            XCTAssertTrue( triggerSoundMixerVoice( mixer, impulse, sampleTime, 1.0f, -1.0f ), @"Trigger was not queued" );
+        }
+    });
+    
+    const UInt64 lastTriggerTime        = firstTriggerTime + ( numberOfProducers * triggersPerProducer * triggerInterval );
+    UInt32 numberOfMisalignedImpulses   = 0;
+    numberOfImpulses                    = 0;
+    
+    while( soundMixerSampleTime( mixer ) < lastTriggerTime + 1000 )
+    {
+        const UInt64 bufferStart = soundMixerSampleTime( mixer );
+        
+        mixSoundMixerVoices( mixer, output, 1000 );
+        
+        for( UInt32 f = 0; f < 1000; f++ )
+        {
+            if( 0 == output[ 2 * f ] )
+                continue;
+            
+            numberOfImpulses++;
+            
+            if( 0 != ( ( bufferStart + f - firstTriggerTime ) % triggerInterval ) )
+                numberOfMisalignedImpulses++;
+        }
+    }
+    
+    XCTAssertEqual( numberOfImpulses, numberOfProducers * triggersPerProducer, @"Not every trigger started a voice" );
+    XCTAssertEqual( numberOfMisalignedImpulses, 0U, @"Triggered voices started at the wrong frames" );
+    
+    // Every voice has finished, so the mixer no longer holds any references.
+    
+    XCTAssertEqual( impulse->retainCount, 1U, @"Triggered voices leaked their audio data" );
+    
+    free( output );
+    
+    freeSoundMixer( mixer );
+    freeAudioData( impulse );
+}
+
+#pragma mark -
+#pragma mark SUPCMConversion
+
+- (void)testConversionVectorKernelsMatchScalarKernels {
+    
+    // An odd number of samples exercises the scalar tails of the vector kernels.
+    
+    const size_t numberOfFrames = 1001;
+    
+    SInt16 * int16Samples   = malloc( numberOfFrames * 2 * sizeof( SInt16 ) );
+    UInt8  * int24Samples   = malloc( numberOfFrames * 3 );
+    float  * floatSamples   = malloc( numberOfFrames * 2 * sizeof( float ) );
+    float  * scalarOutput   = malloc( numberOfFrames * 2 * sizeof( float ) );
+    float  * vectorOutput   = malloc( numberOfFrames * 2 * sizeof( float ) );
+    
+    srand( 6 );
+    
+    for( size_t i = 0; i < ( numberOfFrames * 2 ); i++ )
+    {
+        int16Samples[ i ] = (SInt16)( rand() & 0xFFFF );
+        floatSamples[ i ] = ( ( (float)rand() / RAND_MAX ) * 2.5f ) - 1.25f;
+    }
+    
+    for( size_t i = 0; i < ( numberOfFrames * 3 ); i++ )
+    {
+        int24Samples[ i ] = (UInt8)rand();
+    }
+    
+    convertInt16ToFloat32Kernel( int16Samples, scalarOutput, numberOfFrames, false );
+    convertInt16ToFloat32Kernel( int16Samples, vectorOutput, numberOfFrames, true );
+    XCTAssertTrue( 0 == memcmp( scalarOutput, vectorOutput, numberOfFrames * sizeof( float ) ), @"Int16 to float conversion differs" );
+    
+    convertFloat32ToInt16Kernel( floatSamples, (SInt16 *)scalarOutput, numberOfFrames, false );
+    convertFloat32ToInt16Kernel( floatSamples, (SInt16 *)vectorOutput, numberOfFrames, true );
+    XCTAssertTrue( 0 == memcmp( scalarOutput, vectorOutput, numberOfFrames * sizeof( SInt16 ) ), @"Float to int16 conversion differs" );
+    
+    convertPackedInt24ToFloat32Kernel( int24Samples, scalarOutput, numberOfFrames, false );
+    convertPackedInt24ToFloat32Kernel( int24Samples, vectorOutput, numberOfFrames, true );
+    XCTAssertTrue( 0 == memcmp( scalarOutput, vectorOutput, numberOfFrames * sizeof( float ) ), @"Int24 to float conversion differs" );
+    
+    const float * planes[ 2 ] = { floatSamples, floatSamples + numberOfFrames };
+    
+    interleaveFloat32Kernel( planes, 2, scalarOutput, numberOfFrames, false );
+    interleaveFloat32Kernel( planes, 2, vectorOutput, numberOfFrames, true );
+    XCTAssertTrue( 0 == memcmp( scalarOutput, vectorOutput, numberOfFrames * 2 * sizeof( float ) ), @"Interleaving differs" );
+    
+    float * deinterleaved[ 2 ] = { vectorOutput, vectorOutput + numberOfFrames };
+    
+    deinterleaveFloat32Kernel( scalarOutput, 2, deinterleaved, numberOfFrames, true );
+    XCTAssertTrue( 0 == memcmp( floatSamples, vectorOutput, numberOfFrames * 2 * sizeof( float ) ), @"Deinterleaving does not invert interleaving" );
+    
+    upmixMonoToStereoFloat32Kernel( floatSamples, scalarOutput, numberOfFrames, false );
+    upmixMonoToStereoFloat32Kernel( floatSamples, vectorOutput, numberOfFrames, true );
+    XCTAssertTrue( 0 == memcmp( scalarOutput, vectorOutput, numberOfFrames * 2 * sizeof( float ) ), @"Upmixing differs" );
+    
+    downmixStereoToMonoFloat32Kernel( floatSamples, scalarOutput, numberOfFrames, false );
+    downmixStereoToMonoFloat32Kernel( floatSamples, vectorOutput, numberOfFrames, true );
+    XCTAssertTrue( 0 == memcmp( scalarOutput, vectorOutput, numberOfFrames * sizeof( float ) ), @"Downmixing differs" );
+    
+    free( int16Samples );
+    free( int24Samples );
+    free( floatSamples );
+    free( scalarOutput );
+    free( vectorOutput );
+}
+
+- (void)testCopyingAudioDataInCanonicalFormat {
+    
+    SUSoundEffectData source = createTestAudioData( NO, 2, 1001, 6 );
+    SUSoundEffectData mono   = copyAudioDataInCanonicalFormat( source, 1 );
+    
+    XCTAssertTrue( NULL != mono, @"Stereo int16 audio data could not be converted" );
+    XCTAssertEqual( mono->numberOfFrames, (UInt64)1001, @"Converted audio data has the wrong length" );
+    XCTAssertEqual( mono->dataFormat.mBytesPerFrame, (UInt32)sizeof( float ), @"Converted audio data has the wrong format" );
+    
+    const SInt16 * samples = source->audioData;
+    
+    for( UInt32 i = 0; i < 1001; i++ )
+    {
+        const float expected = ( ( samples[ 2 * i ] / 32768.0f ) + ( samples[ ( 2 * i ) + 1 ] / 32768.0f ) ) * 0.5f;
+        XCTAssertEqual( ((float *)mono->audioData)[ i ], expected, @"Converted sample %u is wrong", i );
+    }
+    
+    XCTAssertTrue( NULL == copyAudioDataInCanonicalFormat( source, 0 ), @"Audio data was converted to no channels" );
+    
+    freeAudioData( mono );
+    freeAudioData( source );
+}
+
+- (void)testConversionKernelPerformance {
+    
+    const size_t numberOfSamples = ( 1 << 20 );
+    const int    repetitions     = 20;
+    
+    SInt16 * int16Samples = calloc( numberOfSamples, sizeof( SInt16 ) );
+    UInt8  * int24Samples = calloc( numberOfSamples, 3 );
+    float  * floatSamples = calloc( numberOfSamples, sizeof( float ) );
+    float  * output       = calloc( numberOfSamples, sizeof( float ) );
+    
+    for( int vector = 0; vector < 2; vector++ )
+    {
+        CFAbsoluteTime times[ 3 ] = { 0 };
+        
+        for( int r = 0; r < repetitions; r++ )
+        {
+            CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+            convertInt16ToFloat32Kernel( int16Samples, output, numberOfSamples, vector );
+            times[ 0 ] += ( CFAbsoluteTimeGetCurrent() - start );
+            
+            start = CFAbsoluteTimeGetCurrent();
+            convertFloat32ToInt16Kernel( floatSamples, (SInt16 *)output, numberOfSamples, vector );
+            times[ 1 ] += ( CFAbsoluteTimeGetCurrent() - start );
+            
+            start = CFAbsoluteTimeGetCurrent();
+            convertPackedInt24ToFloat32Kernel( int24Samples, output, numberOfSamples, vector );
+            times[ 2 ] += ( CFAbsoluteTimeGetCurrent() - start );
+        }
+        
+        const double samples = ( (double)numberOfSamples * repetitions ) / 1e6;
+        
+        NSLog( @"%@ kernels: int16->float %.0f, float->int16 %.0f, int24->float %.0f Msamples/s", ( vector ? @"Vector" : @"Scalar" ),
+               ( samples / times[ 0 ] ), ( samples / times[ 1 ] ), ( samples / times[ 2 ] ) );
+    }
+    
+    free( int16Samples );
+    free( int24Samples );
+    free( floatSamples );
+    free( output );
+}
+
+#pragma mark -
+#pragma mark SUSoundCore
+
+/** Writes a 16-bit PCM WAV file, with a chunk between its format and data chunks, and returns its path. */
+
+static NSString * writeTestWAVFile( const SInt16 * samples, UInt32 numberOfChannels, UInt32 numberOfFrames ) {
+    
+    const UInt32 dataSize = ( numberOfFrames * numberOfChannels * sizeof( SInt16 ) );
+    const UInt32 byteRate = ( 44100 * numberOfChannels * sizeof( SInt16 ) );
+    const UInt16 format[ 8 ] = { 1, numberOfChannels, 44100 & 0xFFFF, 44100 >> 16, byteRate & 0xFFFF, byteRate >> 16, numberOfChannels * 2, 16 };
+    
+    NSMutableData * file = [NSMutableData data];
+    
+    UInt32 riffSize   = ( 4 + 8 + sizeof( format ) + 8 + 2 + 8 + dataSize );
+    UInt32 formatSize = sizeof( format );
+    UInt32 listSize   = 2;
+    
+    [file appendBytes: "RIFF" length: 4];
+    [file appendBytes: &riffSize length: 4];
+    [file appendBytes: "WAVEfmt " length: 8];
+    [file appendBytes: &formatSize length: 4];
+    [file appendBytes: format length: sizeof( format )];
+    [file appendBytes: "LIST" length: 4];
+    [file appendBytes: &listSize length: 4];
+    [file appendBytes: "ab" length: 2];
+    [file appendBytes: "data" length: 4];
+    [file appendBytes: &dataSize length: 4];
+    [file appendBytes: samples length: dataSize];
+    
+    NSString * path = [NSTemporaryDirectory() stringByAppendingPathComponent: [[NSUUID UUID] UUIDString]];
+    [file writeToFile: path atomically: NO];
+    
+    return path;
+}
+
+- (void)testReadingWAVFileAndFillingBuffers {
+    
+    // Test files are little-endian.
+    
+    const UInt32 numberOfFrames = 10001;
+    SInt16 * samples = malloc( numberOfFrames * 2 * sizeof( SInt16 ) );
+    
+    for( UInt32 i = 0; i < ( numberOfFrames * 2 ); i++ )
+    {
+        samples[ i ] = (SInt16)( i * 7 );
+    }
+    
+    NSString * path = writeTestWAVFile( samples, 2, numberOfFrames );
+    
+    for( int mapped = 0; mapped < 2; mapped++ )
+    {
+        SUSoundEffectData data = readAudioDataFromWAVFile( path.fileSystemRepresentation, mapped ? SUAudioDataReadingMapped : SUAudioDataReadingOptionsNone );
+        
+        XCTAssertTrue( NULL != data, @"WAV file could not be read" );
+        XCTAssertEqual( data->numberOfFrames, (UInt64)numberOfFrames, @"WAV file has the wrong length" );
+        XCTAssertEqual( data->dataFormat.mChannelsPerFrame, (UInt32)2, @"WAV file has the wrong number of channels" );
+        XCTAssertEqual( ( NULL != data->mappedRegion ), (BOOL)mapped, @"WAV file was not read in the requested mode" );
+        
+        // Fill odd-sized buffers until the end of the data, and check they contain all of it.
+        
+        UInt8 bufferBytes[ 999 ];
+        SUSoundBuffer buffer = { .audioData = bufferBytes, .audioDataBytesCapacity = sizeof( bufferBytes ) };
+        
+        NSMutableData * filled = [NSMutableData data];
+        SInt64 playbackPosition = 0;
+        OSStatus err;
+        
+        do {
+            err = fillSoundBufferFromAudioData( &buffer, data, &playbackPosition );
+            [filled appendBytes: bufferBytes length: buffer.audioDataByteSize];
+        } while( noErr == err );
+        
+        XCTAssertEqual( err, (OSStatus)kAudioFileEndOfFileError, @"Filling did not end at the end of the data" );
+        XCTAssertTrue( [filled isEqualToData: [NSData dataWithBytes: samples length: numberOfFrames * 2 * sizeof( SInt16 )]], @"Filled data differs from the file" );
+        
+        freeAudioData( data );
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtPath: path error: NULL];
+    free( samples );
+}
+
+- (void)testReadingMappedAudioDataFromURL {
+    
+    const UInt32 numberOfFrames = 30011;
+    SInt16 * samples = malloc( numberOfFrames * sizeof( SInt16 ) );
+    
+    for( UInt32 i = 0; i < numberOfFrames; i++ )
+    {
+        samples[ i ] = (SInt16)( i * 13 );
+    }
+    
+    // The file's data chunk follows another chunk, so the audio data doesn't start on a page boundary.
+    
+    NSString * path = writeTestWAVFile( samples, 1, numberOfFrames );
+    NSURL * url = [NSURL fileURLWithPath: path];
+    
+    SUSoundEffectData data = readAudioDataFromURL( (__bridge CFURLRef)url, SUAudioDataReadingMapped );
+    
+    XCTAssertTrue( NULL != data, @"File could not be read" );
+    XCTAssertTrue( NULL != data->mappedRegion, @"Linear PCM audio data was not mapped" );
+    XCTAssertEqual( data->numberOfAudioDataBytes, (UInt64)( numberOfFrames * sizeof( SInt16 ) ), @"Mapped audio data has the wrong length" );
+    
+    UInt8 bufferBytes[ 4096 ];
+    SUSoundBuffer buffer = { .audioData = bufferBytes, .audioDataBytesCapacity = sizeof( bufferBytes ) };
+    
+    NSMutableData * filled = [NSMutableData data];
+    SInt64 playbackPosition = 0;
+    OSStatus err;
+    
+    do {
+        err = fillSoundBufferFromAudioData( &buffer, data, &playbackPosition );
+        [filled appendBytes: bufferBytes length: buffer.audioDataByteSize];
+    } while( noErr == err );
+    
+    XCTAssertEqual( err, (OSStatus)kAudioFileEndOfFileError, @"Filling did not end at the end of the data" );
+    XCTAssertTrue( [filled isEqualToData: [NSData dataWithBytes: samples length: numberOfFrames * sizeof( SInt16 )]], @"Mapped data differs from the file" );
+    
+    freeAudioData( data );
+    
+    [[NSFileManager defaultManager] removeItemAtPath: path error: NULL];
+    free( samples );
+}
+
+/** Fills an AudioQueue buffer from a sound stream, waiting for the producer thread to read the next chunk. */
+
+static OSStatus fillBufferFromSoundStreamWaiting( AudioQueueBufferRef buffer, SUSoundStream stream, SInt64 * ioPlaybackPosition ) {
+    
+    OSStatus err = kSUAudioDataNotReadyError;
+    
+    for( int attempt = 0; ( kSUAudioDataNotReadyError == err ) && ( attempt < 5000 ); attempt++ )
+    {
+        err = fillBufferFromSoundStream( buffer, stream, ioPlaybackPosition );
+        
+        if( kSUAudioDataNotReadyError == err )
+        {
+            usleep( 1000 );
+        }
+    }
+    
+    return err;
+}
+
+- (void)testSoundStreamFillsChunksInOrder {
+    
+    const UInt32 numberOfFrames = 20011;
+    SInt16 * samples = malloc( numberOfFrames * sizeof( SInt16 ) );
+    
+    for( UInt32 i = 0; i < numberOfFrames; i++ )
+    {
+        samples[ i ] = (SInt16)( i * 11 );
+    }
+    
+    NSString * path = writeTestWAVFile( samples, 1, numberOfFrames );
+    AudioFileID audioFile = NULL;
+    
+    XCTAssertEqual( AudioFileOpenURL( (__bridge CFURLRef)[NSURL fileURLWithPath: path], kAudioFileReadPermission, 0, &audioFile ), (OSStatus)noErr, @"File could not be opened" );
+    
+    // A ring which is much smaller than the file, so the producer has to wait for the consumer to free chunks.
+    
+    SUSoundStream stream = createSoundStream( audioFile, 1000, 0, 3, 0 );
+    XCTAssertTrue( NULL != stream, @"Stream could not be created" );
+    
+    UInt8 bufferBytes[ 1000 ];
+    AudioQueueBuffer buffer = { .mAudioDataBytesCapacity = sizeof( bufferBytes ), .mAudioData = bufferBytes };
+    
+    NSMutableData * filled = [NSMutableData data];
+    SInt64 playbackPosition = 0;
+    OSStatus err;
+    
+    do {
+        err = fillBufferFromSoundStreamWaiting( &buffer, stream, &playbackPosition );
+        [filled appendBytes: bufferBytes length: buffer.mAudioDataByteSize];
+        
+        XCTAssertEqual( playbackPosition, (SInt64)filled.length, @"Stream did not advance the playback cursor" );
+    } while( noErr == err );
+    
+    XCTAssertEqual( err, (OSStatus)kAudioFileEndOfFileError, @"Stream did not end at the end of the file" );
+    XCTAssertTrue( [filled isEqualToData: [NSData dataWithBytes: samples length: numberOfFrames * sizeof( SInt16 )]], @"Streamed data differs from the file" );
+    
+    // Once the end has been reached, the stream keeps reporting it rather than underrunning.
+    
+    const UInt64 underrunCount = soundStreamUnderrunCount( stream );
+    
+    XCTAssertEqual( fillBufferFromSoundStream( &buffer, stream, &playbackPosition ), (OSStatus)kAudioFileEndOfFileError, @"Stream did not stay at the end of the file" );
+    XCTAssertEqual( buffer.mAudioDataByteSize, (UInt32)0, @"Stream filled a buffer after the end of the file" );
+    XCTAssertEqual( soundStreamUnderrunCount( stream ), underrunCount, @"Reading past the end of the file was counted as an underrun" );
+    
+    freeSoundStream( stream );
+    AudioFileClose( audioFile );
+    
+    [[NSFileManager defaultManager] removeItemAtPath: path error: NULL];
+    free( samples );
+}
+
+- (void)testSoundStreamSeeksAndCountsUnderruns {
+    
+    const UInt32 numberOfFrames = 20011;
+    SInt16 * samples = malloc( numberOfFrames * sizeof( SInt16 ) );
+    
+    for( UInt32 i = 0; i < numberOfFrames; i++ )
+    {
+        samples[ i ] = (SInt16)( i * 17 );
+    }
+    
+    NSString * path = writeTestWAVFile( samples, 1, numberOfFrames );
+    AudioFileID audioFile = NULL;
+    
+    XCTAssertEqual( AudioFileOpenURL( (__bridge CFURLRef)[NSURL fileURLWithPath: path], kAudioFileReadPermission, 0, &audioFile ), (OSStatus)noErr, @"File could not be opened" );
+    
+    SUSoundStream stream = createSoundStream( audioFile, 1000, 0, 4, 0 );
+    
+    UInt8 bufferBytes[ 1000 ];
+    AudioQueueBuffer buffer = { .mAudioDataBytesCapacity = sizeof( bufferBytes ), .mAudioData = bufferBytes };
+    
+    SInt64 playbackPosition = 0;
+    
+    XCTAssertEqual( fillBufferFromSoundStreamWaiting( &buffer, stream, &playbackPosition ), (OSStatus)noErr, @"Stream did not fill the first chunk" );
+    XCTAssertTrue( 0 == memcmp( bufferBytes, samples, sizeof( bufferBytes ) ), @"First chunk differs from the file" );
+    
+    // Seek explicitly.
+    
+    playbackPosition = 12346;
+    seekSoundStream( stream, playbackPosition );
+    
+    XCTAssertEqual( fillBufferFromSoundStreamWaiting( &buffer, stream, &playbackPosition ), (OSStatus)noErr, @"Stream did not fill after seeking" );
+    XCTAssertEqual( buffer.mAudioDataByteSize, (UInt32)sizeof( bufferBytes ), @"Chunk after seeking has the wrong length" );
+    XCTAssertTrue( 0 == memcmp( bufferBytes, (UInt8 *)samples + 12346, sizeof( bufferBytes ) ), @"Chunk after seeking differs from the file" );
+    XCTAssertEqual( playbackPosition, (SInt64)( 12346 + sizeof( bufferBytes ) ), @"Playback cursor was not advanced after seeking" );
+    
+    // Moving the playback cursor without seeking discards the chunks which were read ahead, and counts an underrun.
+    
+    XCTAssertEqual( fillBufferFromSoundStreamWaiting( &buffer, stream, &playbackPosition ), (OSStatus)noErr, @"Stream did not read ahead" );
+    
+    const UInt64 underrunCount = soundStreamUnderrunCount( stream );
+    playbackPosition = 2000;
+    
+    XCTAssertEqual( fillBufferFromSoundStream( &buffer, stream, &playbackPosition ), (OSStatus)kSUAudioDataNotReadyError, @"Stream filled from a stale chunk" );
+    XCTAssertEqual( buffer.mAudioDataByteSize, (UInt32)0, @"Stream filled a buffer while restarting" );
+    XCTAssertEqual( soundStreamUnderrunCount( stream ), underrunCount + 1, @"Restarting the stream was not counted as an underrun" );
+    
+    XCTAssertEqual( fillBufferFromSoundStreamWaiting( &buffer, stream, &playbackPosition ), (OSStatus)noErr, @"Stream did not fill after the cursor moved" );
+    XCTAssertTrue( 0 == memcmp( bufferBytes, (UInt8 *)samples + 2000, sizeof( bufferBytes ) ), @"Chunk after the cursor moved differs from the file" );
+    
+    freeSoundStream( stream );
+    AudioFileClose( audioFile );
+    
+    [[NSFileManager defaultManager] removeItemAtPath: path error: NULL];
+    free( samples );
+}
+
+/** Creates VBR audio data with contiguous, pseudo-random packets. */
+
+static SUSoundEffectData createTestVBRAudioData( BOOL variableFrames, UInt64 numberOfPackets, unsigned int seed ) {
+    
+    SUSoundEffectData data = calloc( 1, sizeof( struct _SUSoundEffectData ) );
+    
+    data->retainCount                   = 1;
+    data->dataFormat.mSampleRate        = 44100;
+    data->dataFormat.mFormatID          = kAudioFormatMPEG4AAC;
+    data->dataFormat.mFramesPerPacket   = variableFrames ? 0 : 1024;
+    data->numberOfPackets               = numberOfPackets;
+    data->packetDescriptions            = malloc( (size_t)numberOfPackets * sizeof( AudioStreamPacketDescription ) );
+    
+    srand( seed );
+    
+    for( UInt64 i = 0; i < numberOfPackets; i++ )
+    {
+        AudioStreamPacketDescription * packet = &data->packetDescriptions[ i ];
+        
+        packet->mStartOffset            = data->numberOfAudioDataBytes;
+        packet->mDataByteSize           = 1 + ( rand() % 700 );
+        packet->mVariableFramesInPacket = variableFrames ? ( 256 * ( rand() % 4 ) ) : 0;
+        
+        data->numberOfAudioDataBytes   += packet->mDataByteSize;
+        data->maximumPacketSize         = MAX( data->maximumPacketSize, packet->mDataByteSize );
+        data->numberOfFrames           += variableFrames ? packet->mVariableFramesInPacket : 1024;
+    }
+    
+    data->audioData = malloc( (size_t)data->numberOfAudioDataBytes );
+    
+    for( UInt64 i = 0; i < data->numberOfAudioDataBytes; i++ )
+    {
+        ((UInt8 *)data->audioData)[ i ] = (UInt8)rand();
+    }
+    
+    if( variableFrames )
+    {
+        data->packetStartFrames = malloc( (size_t)numberOfPackets * sizeof( UInt64 ) );
+        
+        for( UInt64 i = 0, frame = 0; i < numberOfPackets; frame += data->packetDescriptions[ i++ ].mVariableFramesInPacket )
+        {
+            data->packetStartFrames[ i ] = frame;
+        }
+    }
+    
+    return data;
+}
+
+- (void)verifyCompactPacketTableWithVariableFrames: (BOOL)variableFrames {
+    
+    const UInt64 numberOfPackets = 10007;
+    
+    SUSoundEffectData full    = createTestVBRAudioData( variableFrames, numberOfPackets, 8 );
+    SUSoundEffectData compact = createTestVBRAudioData( variableFrames, numberOfPackets, 8 );
+    
+    const UInt64 bytesSaved = compactAudioDataPacketTable( compact );
+    
+    XCTAssertTrue( NULL != compact->packetTable, @"Packet table was not compacted" );
+    XCTAssertTrue( NULL == compact->packetDescriptions, @"Packet descriptions were not freed" );
+    XCTAssertEqual( audioDataResidentSize( full ) - audioDataResidentSize( compact ), bytesSaved, @"Reported saving is wrong" );
+    
+    NSLog( @"Compact packet table saved %llu of %llu bytes of packet metadata for %llu packets", bytesSaved,
+           ( audioDataResidentSize( full ) - full->numberOfAudioDataBytes ), numberOfPackets );
+    
+    for( SInt64 frame = 0; frame < (SInt64)full->numberOfFrames; frame += 97 )
+    {
+        XCTAssertEqual( packetIndexForFrame( full, frame ), packetIndexForFrame( compact, frame ), @"Frame %lld maps to a different packet", frame );
+    }
+    
+    for( SInt64 byte = 0; byte < (SInt64)full->numberOfAudioDataBytes; byte += 41 )
+    {
+        XCTAssertEqual( packetIndexForByteOffset( full, byte ), packetIndexForByteOffset( compact, byte ), @"Byte %lld maps to a different packet", byte );
+    }
+    
+    // Fill from positions throughout the data, including ones between checkpoints.
+    
+    UInt8 fullBytes[ 5000 ], compactBytes[ 5000 ];
+    AudioStreamPacketDescription fullPackets[ 7 ], compactPackets[ 7 ];
+    
+    SUSoundBuffer fullBuffer    = { fullBytes,    sizeof( fullBytes ),    0, fullPackets,    7, 0 };
+    SUSoundBuffer compactBuffer = { compactBytes, sizeof( compactBytes ), 0, compactPackets, 7, 0 };
+    
+    for( SInt64 start = 0; start < (SInt64)numberOfPackets; start += 1001 )
+    {
+        SInt64 fullPosition = start, compactPosition = start;
+        OSStatus fullErr, compactErr;
+        
+        do {
+            fullErr    = fillSoundBufferFromAudioData( &fullBuffer, full, &fullPosition );
+            compactErr = fillSoundBufferFromAudioData( &compactBuffer, compact, &compactPosition );
+            
+            XCTAssertEqual( fullErr, compactErr, @"Fill result differs" );
+            XCTAssertEqual( fullPosition, compactPosition, @"Playback position differs" );
+            XCTAssertEqual( fullBuffer.audioDataByteSize, compactBuffer.audioDataByteSize, @"Filled byte count differs" );
+            XCTAssertTrue( 0 == memcmp( fullBytes, compactBytes, fullBuffer.audioDataByteSize ), @"Filled data differs" );
+            XCTAssertTrue( 0 == memcmp( fullPackets, compactPackets, fullBuffer.packetDescriptionCount * sizeof( AudioStreamPacketDescription ) ),
+                           @"Filled packet descriptions differ" );
+            
+        } while( noErr == fullErr );
+    }
+    
+    freeAudioData( full );
+    freeAudioData( compact );
+}
+
+- (void)testCompactPacketTableWithConstantFrames {
+    
+    [self verifyCompactPacketTableWithVariableFrames: NO];
+}
+
+- (void)testCompactPacketTableWithVariableFrames {
+    
+    [self verifyCompactPacketTableWithVariableFrames: YES];
+}
+
+/** Checks the packets found for frames, bytes and times against a walk through every packet of the audio data. */
+
+- (void)verifySeekingAudioData: (SUSoundEffectData)data {
+    
+    const BOOL hasPacketDescriptions = ( NULL != data->packetDescriptions );
+    const Float64 sampleRate         = data->dataFormat.mSampleRate;
+    
+    UInt64 startFrame = 0;
+    SInt64 startByte  = 0;
+    
+    for( UInt64 packet = 0; packet < data->numberOfPackets; packet++ )
+    {
+        const UInt64 numberOfFrames = ( NULL != data->packetStartFrames ) ? data->packetDescriptions[ packet ].mVariableFramesInPacket : data->dataFormat.mFramesPerPacket;
+        const UInt32 numberOfBytes  = hasPacketDescriptions ? data->packetDescriptions[ packet ].mDataByteSize : data->dataFormat.mBytesPerPacket;
+        
+        if( hasPacketDescriptions )
+            startByte = data->packetDescriptions[ packet ].mStartOffset;
+        
+        // Check the first, middle and last frames and bytes of every packet. Times are in the middle of a frame, so that they
+        // round to it.
+        
+        const UInt64 framesInPacket[ 3 ] = { 0, numberOfFrames / 2, numberOfFrames - 1 };
+        
+        for( int i = 0; ( i < 3 ) && ( numberOfFrames > 0 ); i++ )
+        {
+            const UInt64 frame = ( startFrame + framesInPacket[ i ] );
+            SInt64 position;
+            
+            XCTAssertEqual( packetIndexForFrame( data, (SInt64)frame ), (SInt64)packet, @"Frame %llu maps to the wrong packet", frame );
+            XCTAssertEqual( seekAudioDataToTime( data, ( frame + 0.5 ) / sampleRate, &position ), (OSStatus)noErr, @"Seeking to frame %llu failed", frame );
+            XCTAssertEqual( position, hasPacketDescriptions ? (SInt64)packet : startByte, @"Seeking to frame %llu found the wrong position", frame );
+        }
+        
+        XCTAssertEqual( packetIndexForByteOffset( data, startByte ), (SInt64)packet, @"Byte %lld maps to the wrong packet", startByte );
+        XCTAssertEqual( packetIndexForByteOffset( data, startByte + ( numberOfBytes / 2 ) ), (SInt64)packet, @"Byte %lld maps to the wrong packet", startByte );
+        XCTAssertEqual( packetIndexForByteOffset( data, startByte + numberOfBytes - 1 ), (SInt64)packet, @"Byte %lld maps to the wrong packet", startByte );
+        
+        startFrame += numberOfFrames;
+        startByte  += numberOfBytes;
+    }
+    
+    XCTAssertEqual( startFrame, data->numberOfFrames, @"Test audio data has the wrong number of frames" );
+    
+    // Frames, bytes and times outside of the audio data.
+    
+    SInt64 position = 12345;
+    
+    XCTAssertEqual( packetIndexForFrame( data, -1 ), (SInt64)-1, @"Negative frames are outside of the audio data" );
+    XCTAssertEqual( packetIndexForFrame( data, (SInt64)data->numberOfFrames ), (SInt64)-1, @"Frames past the end are outside of the audio data" );
+    XCTAssertEqual( packetIndexForByteOffset( data, -1 ), (SInt64)-1, @"Negative bytes are outside of the audio data" );
+    XCTAssertEqual( packetIndexForByteOffset( data, (SInt64)data->numberOfAudioDataBytes ), (SInt64)-1, @"Bytes past the end are outside of the audio data" );
+    
+    XCTAssertEqual( seekAudioDataToTime( data, -0.5 / sampleRate, &position ), (OSStatus)kAudioFilePositionError, @"Negative times can't be sought" );
+    XCTAssertEqual( seekAudioDataToTime( data, -1, &position ), (OSStatus)kAudioFilePositionError, @"Negative times can't be sought" );
+    XCTAssertEqual( seekAudioDataToTime( data, ( data->numberOfFrames + 0.5 ) / sampleRate, &position ), (OSStatus)kAudioFilePositionError, @"Times past the end can't be sought" );
+    XCTAssertEqual( seekAudioDataToTime( data, 1e6, &position ), (OSStatus)kAudioFilePositionError, @"Times past the end can't be sought" );
+    XCTAssertEqual( position, (SInt64)12345, @"Failed seeks should not change the position" );
+}
+
+- (void)testSeekingCBRAudioData {
+    
+    SUSoundEffectData data = createTestAudioData( NO, 2, 10007, 11 );
+    
+    [self verifySeekingAudioData: data];
+    
+    freeAudioData( data );
+}
+
+- (void)testSeekingVBRAudioDataWithConstantFrames {
+    
+    SUSoundEffectData data = createTestVBRAudioData( NO, 5003, 12 );
+    
+    [self verifySeekingAudioData: data];
+    
+    freeAudioData( data );
+}
+
+- (void)testSeekingVBRAudioDataWithFrameIndex {
+    
+    // Some packets have no frames, so several packets start at the same frame.
+    
+    SUSoundEffectData data = createTestVBRAudioData( YES, 5003, 13 );
+    
+    [self verifySeekingAudioData: data];
+    
+    freeAudioData( data );
+}
+
+- (void)testSoundBufferPlanMatchesPacketByPacketFill {
+    
+    SUSoundEffectData data = createTestVBRAudioData( NO, 100000, 10 );
+    
+    UInt8 loopBytes[ 4096 ], planBytes[ 4096 ];
+    AudioStreamPacketDescription loopPackets[ 64 ], planPackets[ 64 ];
+    
+    SUSoundBuffer loopBuffer = { loopBytes, sizeof( loopBytes ), 0, loopPackets, 64, 0 };
+    SUSoundBuffer planBuffer = { planBytes, sizeof( planBytes ), 0, planPackets, 64, 0 };
+    
+    SUSoundBufferPlan plan = createSoundBufferPlan( data, sizeof( loopBytes ), 64 );
+    XCTAssertTrue( NULL != plan, @"Buffer plan could not be created" );
+    
+    // Play from the start, then from a position in the middle of a slice.
+    
+    const SInt64 startPositions[ 2 ] = { 0, 12345 };
+    
+    for( int i = 0; i < 2; i++ )
+    {
+        SInt64 loopPosition = startPositions[ i ], planPosition = startPositions[ i ];
+        OSStatus loopErr, planErr;
+        
+        do {
+            loopErr = fillSoundBufferFromAudioData( &loopBuffer, data, &loopPosition );
+            planErr = fillSoundBufferFromPlan( &planBuffer, plan, &planPosition );
+            
+            XCTAssertEqual( loopErr, planErr, @"Fill result differs" );
+            XCTAssertEqual( loopPosition, planPosition, @"Playback position differs" );
+            XCTAssertEqual( loopBuffer.audioDataByteSize, planBuffer.audioDataByteSize, @"Filled byte count differs" );
+            XCTAssertEqual( loopBuffer.packetDescriptionCount, planBuffer.packetDescriptionCount, @"Filled packet count differs" );
+            XCTAssertTrue( 0 == memcmp( loopBytes, planBytes, loopBuffer.audioDataByteSize ), @"Filled data differs" );
+            XCTAssertTrue( 0 == memcmp( loopPackets, planPackets, loopBuffer.packetDescriptionCount * sizeof( AudioStreamPacketDescription ) ),
+                           @"Filled packet descriptions differ" );
+            
+        } while( noErr == loopErr );
+    }
+    
+    // Two voices playing the plan from different slices, filled alternately, each fill the same buffers as on their own.
+    
+    SInt64 secondStart = 0;
+    
+    for( int i = 0; i < 100; i++ )
+    {
+        fillSoundBufferFromAudioData( &loopBuffer, data, &secondStart );
+    }
+    
+    SInt64 loopPositions[ 2 ] = { 0, secondStart }, planPositions[ 2 ] = { 0, secondStart };
+    OSStatus loopErrs[ 2 ]    = { noErr, noErr };
+    
+    while( ( noErr == loopErrs[ 0 ] ) || ( noErr == loopErrs[ 1 ] ) )
+    {
+        for( int voice = 0; voice < 2; voice++ )
+        {
+            if( noErr != loopErrs[ voice ] )
+                continue;
+            
+            loopErrs[ voice ]      = fillSoundBufferFromAudioData( &loopBuffer, data, &loopPositions[ voice ] );
+            const OSStatus planErr = fillSoundBufferFromPlan( &planBuffer, plan, &planPositions[ voice ] );
+            
+            XCTAssertEqual( loopErrs[ voice ], planErr, @"Fill result differs for voice %d", voice );
+            XCTAssertEqual( loopPositions[ voice ], planPositions[ voice ], @"Playback position differs for voice %d", voice );
+            XCTAssertEqual( loopBuffer.audioDataByteSize, planBuffer.audioDataByteSize, @"Filled byte count differs for voice %d", voice );
+            XCTAssertTrue( 0 == memcmp( loopBytes, planBytes, loopBuffer.audioDataByteSize ), @"Filled data differs for voice %d", voice );
+        }
+    }
+    
+    // Compare the time taken to play the whole sound.
+    
+    for( int usePlan = 0; usePlan < 2; usePlan++ )
+    {
+        const CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        
+        for( int r = 0; r < 10; r++ )
+        {
+            SInt64 position = 0;
+            while( noErr == ( usePlan ? fillSoundBufferFromPlan( &planBuffer, plan, &position ) : fillSoundBufferFromAudioData( &loopBuffer, data, &position ) ) );
+        }
+        
+        NSLog( @"Filled %llu packets 10 times %@ in %.2f ms", data->numberOfPackets, ( usePlan ? @"from a plan" : @"packet by packet" ),
+               ( CFAbsoluteTimeGetCurrent() - start ) * 1000 );
+    }
+    
+    freeSoundBufferPlan( plan );
+    freeAudioData( data );
+}
+
+- (void)testScheduledLoopIsSampleAccurate {
+    
+    // Each frame of the test data holds its own index, plus one.
+    
+    const UInt32 numberOfFrames = 1000;
+    SUSoundEffectData data      = createTestAudioData( NO, 2, numberOfFrames, 0 );
+    
+    for( UInt32 i = 0; i < numberOfFrames; i++ )
+    {
+        ((UInt32 *)data->audioData)[ i ] = ( i + 1 );
+    }
+    
+    UInt32 frames[ 300 ];
+    SUSoundBuffer buffer = { .audioData = frames, .audioDataBytesCapacity = sizeof( frames ) };
+    
+    SUSoundPlaybackSchedule schedule = { .startDelay = 37, .loopStartFrame = 100, .loopEndFrame = 873 };
+    SInt64 playbackPosition          = 0;
+    UInt64 outputFrame               = 0;
+    
+    for( int i = 0; i < 50; i++ )
+    {
+        XCTAssertEqual( fillSoundBufferFromAudioDataWithSchedule( &buffer, data, &schedule, &playbackPosition ), noErr, @"Looping fill reached the end of the data" );
+        XCTAssertEqual( buffer.audioDataByteSize, (UInt32)sizeof( frames ), @"Looping fill did not fill the buffer" );
+        
+        for( UInt32 j = 0; j < ( buffer.audioDataByteSize / sizeof( UInt32 ) ); j++, outputFrame++ )
+        {
+            // 37 frames of silence, then frames up to the loop end, then the loop repeats.
+            
+            UInt64 expectedFrame = ( outputFrame - 37 );
+            
+            if( expectedFrame >= 873 )
+                expectedFrame = 100 + ( ( expectedFrame - 873 ) % 773 );
+            
+            const UInt32 expected = ( outputFrame < 37 ) ? 0 : (UInt32)( expectedFrame + 1 );
+            
+            if( frames[ j ] != expected )
+            {
+                XCTFail( @"Output frame %llu is %u, expected %u", outputFrame, frames[ j ], expected );
+                freeAudioData( data );
+                return;
+            }
+        }
+    }
+    
+    freeAudioData( data );
+}
+
+- (void)testLoopStitchesPacketsAcrossSeam {
+    
+    SUSoundEffectData data = createTestVBRAudioData( NO, 500, 11 );
+    
+    UInt8 bytes[ 4096 ];
+    AudioStreamPacketDescription packets[ 40 ];
+    SUSoundBuffer buffer = { bytes, sizeof( bytes ), 0, packets, 40, 0 };
+    
+    // Loop points within a packet are rounded down to the start of the packet, so this loops over packets 100 to 399.
+    
+    SUSoundPlaybackSchedule schedule = { .loopStartFrame = ( 100 * 1024 ) + 5, .loopEndFrame = ( 400 * 1024 ) + 700 };
+    SInt64 playbackPosition          = 0;
+    UInt64 outputPacket              = 0;
+    
+    SUSoundPlaybackSchedule delayedSchedule = { .startDelay = 10 };
+    XCTAssertEqual( fillSoundBufferFromAudioDataWithSchedule( &buffer, data, &delayedSchedule, &playbackPosition ), kAudioFileOperationNotSupportedError,
+                    @"A start delay was filled for VBR data" );
+    
+    for( int i = 0; i < 200; i++ )
+    {
+        XCTAssertEqual( fillSoundBufferFromAudioDataWithSchedule( &buffer, data, &schedule, &playbackPosition ), noErr, @"Looping fill reached the end of the data" );
+        
+        UInt32 byteOffset = 0;
+        
+        for( UInt32 j = 0; j < buffer.packetDescriptionCount; j++, outputPacket++ )
+        {
+            const UInt64 sourceIndex = ( outputPacket < 400 ) ? outputPacket : ( 100 + ( ( outputPacket - 400 ) % 300 ) );
+            const AudioStreamPacketDescription * source = &data->packetDescriptions[ sourceIndex ];
+            
+            XCTAssertEqual( packets[ j ].mStartOffset, (SInt64)byteOffset, @"Packet %llu is not rebased to its buffer", outputPacket );
+            XCTAssertEqual( packets[ j ].mDataByteSize, source->mDataByteSize, @"Packet %llu has the wrong size", outputPacket );
+            XCTAssertTrue( 0 == memcmp( bytes + byteOffset, data->audioData + source->mStartOffset, source->mDataByteSize ), @"Packet %llu has the wrong data", outputPacket );
+            
+            byteOffset += source->mDataByteSize;
+        }
+        
+        XCTAssertEqual( byteOffset, buffer.audioDataByteSize, @"Buffer contains bytes outside of its packets" );
+    }
+    
+    freeAudioData( data );
+}
+
+- (void)testCompressedAudioDataDecodesWhileFilling {
+    
+    // Two tones and a little noise, for 10 seconds.
+    
+    const UInt32 numberOfFrames = ( 44100 * 10 ) + 77;
+    SUSoundEffectData data      = createTestAudioData( NO, 2, numberOfFrames, 0 );
+    SInt16 * samples            = data->audioData;
+    
+    srand( 12 );
+    
+    for( UInt32 i = 0; i < numberOfFrames; i++ )
+    {
+        const double time = ( i / 44100.0 );
+        
+        samples[ ( i * 2 ) ]     = (SInt16)( ( 12000 * sin( 2 * M_PI * 440 * time ) ) + ( 3000 * sin( 2 * M_PI * 3100 * time ) ) + ( ( rand() % 200 ) - 100 ) );
+        samples[ ( i * 2 ) + 1 ] = (SInt16)( 9000 * sin( ( 2 * M_PI * 220 * time ) + 1 ) );
+    }
+    
+    SInt16 * original = malloc( (size_t)data->numberOfAudioDataBytes );
+    memcpy( original, samples, (size_t)data->numberOfAudioDataBytes );
+    
+    const UInt64 uncompressedSize = audioDataResidentSize( data );
+    
+    XCTAssertTrue( compressAudioData( data ) > 0, @"Audio data was not compressed" );
+    XCTAssertTrue( NULL == data->audioData, @"Compressed audio data kept its uncompressed bytes" );
+    XCTAssertTrue( ( uncompressedSize / (double)audioDataResidentSize( data ) ) > 3.5, @"Compressed audio data is too large" );
+    
+    // Decode everything, and check the signal-to-noise ratio.
+    
+    SInt16 * decoded = malloc( (size_t)data->numberOfAudioDataBytes );
+    decodeCompressedAudio( data->compressedAudio, 0, numberOfFrames, decoded );
+    
+    double signal = 0, noise = 0;
+    
+    for( UInt32 i = 0; i < ( numberOfFrames * 2 ); i++ )
+    {
+        signal += ( (double)original[ i ] * original[ i ] );
+        noise  += ( (double)( original[ i ] - decoded[ i ] ) * ( original[ i ] - decoded[ i ] ) );
+    }
+    
+    const double signalToNoise = ( 10 * log10( signal / noise ) );
+    XCTAssertTrue( signalToNoise > 30, @"Compressed audio data has a signal-to-noise ratio of %.1f dB", signalToNoise );
+    
+    // Buffers are filled with whole frames, matching the decoded audio.
+    
+    UInt8 bytes[ 4098 ];
+    SUSoundBuffer buffer     = { .audioData = bytes, .audioDataBytesCapacity = sizeof( bytes ) };
+    SInt64 playbackPosition  = 0;
+    UInt64 numberOfBytesRead = 0;
+    OSStatus err;
+    
+    const CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    
+    do {
+        err = fillSoundBufferFromAudioData( &buffer, data, &playbackPosition );
+        
+        XCTAssertEqual( buffer.audioDataByteSize % 4, (UInt32)0, @"Buffer contains a partial frame" );
+        XCTAssertTrue( 0 == memcmp( bytes, (UInt8 *)decoded + numberOfBytesRead, buffer.audioDataByteSize ), @"Filled audio differs from decoded audio" );
+        
+        numberOfBytesRead += buffer.audioDataByteSize;
+        
+    } while( noErr == err );
+    
+    NSLog( @"Filled 10 seconds of compressed audio in %.3f ms (SNR %.1f dB)", ( CFAbsoluteTimeGetCurrent() - start ) * 1000, signalToNoise );
+    
+    XCTAssertEqual( numberOfBytesRead, data->numberOfAudioDataBytes, @"Wrong number of bytes filled" );
+    
+    // Decoding can start from any frame.
+    
+    for( int i = 0; i < 100; i++ )
+    {
+        const UInt32 firstFrame = ( rand() % numberOfFrames );
+        const UInt32 length     = MIN( 1000, numberOfFrames - firstFrame );
+        
+        decodeCompressedAudio( data->compressedAudio, firstFrame, length, (SInt16 *)bytes );
+        XCTAssertTrue( 0 == memcmp( bytes, decoded + ( firstFrame * 2 ), length * 4 ), @"Decoding from frame %u differs", firstFrame );
+    }
+    
+    free( original );
+    free( decoded );
+    freeAudioData( data );
+}
+
+- (void)testProgressiveReadingFillsUpToWatermark {
+    
+    const UInt32 numberOfFrames = ( 44100 * 20 ) + 3;
+    SInt16 * samples = malloc( numberOfFrames * 2 * sizeof( SInt16 ) );
+    
+    for( UInt32 i = 0; i < ( numberOfFrames * 2 ); i++ )
+    {
+        samples[ i ] = (SInt16)( i * 11 );
+    }
+    
+    NSString * path  = writeTestWAVFile( samples, 2, numberOfFrames );
+    CFURLRef fileURL = (__bridge_retained CFURLRef)[NSURL fileURLWithPath: path];
+    
+    const CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    SUSoundEffectData data     = readAudioDataFromURLProgressively( fileURL, 4096 );
+    const CFAbsoluteTime ready = CFAbsoluteTimeGetCurrent();
+    
+    XCTAssertTrue( NULL != data, @"File could not be read" );
+    XCTAssertTrue( audioDataPacketsAvailable( data ) >= 4096, @"Initial packets were not read before returning" );
+    XCTAssertEqual( data->numberOfFrames, (UInt64)numberOfFrames, @"Audio data has the wrong length" );
+    
+    // Packets which haven't been read yet can't be found by their bytes.
+    
+    const SInt64 lastByte = (SInt64)data->numberOfAudioDataBytes - 1;
+    
+    XCTAssertTrue( ( -1 == packetIndexForByteOffset( data, lastByte ) ) || ( audioDataPacketsAvailable( data ) == data->numberOfPackets ),
+                   @"Found a packet which hasn't been read" );
+    
+    // Fill until the end of the data, waiting whenever the fill reaches the packets read so far.
+    
+    UInt8 bufferBytes[ 4096 ];
+    SUSoundBuffer buffer = { .audioData = bufferBytes, .audioDataBytesCapacity = sizeof( bufferBytes ) };
+    
+    NSMutableData * filled  = [NSMutableData data];
+    SInt64 playbackPosition = 0;
+    UInt32 numberOfWaits    = 0;
+    OSStatus err;
+    
+    do {
+        err = fillSoundBufferFromAudioData( &buffer, data, &playbackPosition );
+        
+        XCTAssertTrue( (UInt64)playbackPosition <= ( audioDataPacketsAvailable( data ) * data->dataFormat.mBytesPerPacket ), @"Filled past the watermark" );
+        
+        [filled appendBytes: bufferBytes length: buffer.audioDataByteSize];
+        
+        if( kSUAudioDataNotReadyError == err )
+        {
+            numberOfWaits++;
+            usleep( 100 );
+            err = noErr;
+        }
+        
+    } while( noErr == err );
+    
+    NSLog( @"Progressive read returned after %.3f ms; filled %lu bytes with %u waits in %.3f ms", ( ready - start ) * 1000,
+           (unsigned long)filled.length, numberOfWaits, ( CFAbsoluteTimeGetCurrent() - start ) * 1000 );
+    
+    XCTAssertEqual( err, (OSStatus)kAudioFileEndOfFileError, @"Filling did not end at the end of the data" );
+    XCTAssertEqual( audioDataLoadingStatus( data ), (OSStatus)noErr, @"Reading did not finish" );
+    XCTAssertEqual( packetIndexForByteOffset( data, lastByte ), (SInt64)( data->numberOfPackets - 1 ), @"Last packet can't be found after reading finished" );
+    XCTAssertTrue( [filled isEqualToData: [NSData dataWithBytes: samples length: numberOfFrames * 2 * sizeof( SInt16 )]], @"Filled data differs from the file" );
+    
+    freeAudioData( data );
+    
+    // Releasing the audio data before reading finishes stops the background thread.
+    
+    freeAudioData( readAudioDataFromURLProgressively( fileURL, 0 ) );
+    
+    [[NSFileManager defaultManager] removeItemAtPath: path error: NULL];
+    CFRelease( fileURL );
+    free( samples );
+}
+
+- (void)testReadingIdenticalAudioDataSharesIt {
+    
+    const UInt32 numberOfFrames = 10007;
+    SInt16 * samples = malloc( numberOfFrames * 2 * sizeof( SInt16 ) );
+    
+    for( UInt32 i = 0; i < ( numberOfFrames * 2 ); i++ )
+    {
+        samples[ i ] = (SInt16)( i * 13 );
+    }
+    
+    // The same sound under two names, and a different one.
+    
+    NSString * path      = writeTestWAVFile( samples, 2, numberOfFrames );
+    NSString * otherPath = writeTestWAVFile( samples, 2, numberOfFrames );
+    
+    samples[ numberOfFrames ] ^= 1;
+    
+    NSString * differentPath = writeTestWAVFile( samples, 2, numberOfFrames );
+    
+    const SUAudioDataDeduplicationStatistics before = audioDataDeduplicationStatistics();
+    
+    SUSoundEffectData data      = readAudioDataFromWAVFile( path.fileSystemRepresentation, SUAudioDataReadingShared );
+    SUSoundEffectData otherData = readAudioDataFromWAVFile( otherPath.fileSystemRepresentation, SUAudioDataReadingShared );
+    SUSoundEffectData different = readAudioDataFromWAVFile( differentPath.fileSystemRepresentation, SUAudioDataReadingShared );
+    SUSoundEffectData unique    = readAudioDataFromWAVFile( otherPath.fileSystemRepresentation, SUAudioDataReadingOptionsNone );
+    SUSoundEffectData converted = readAudioDataFromWAVFile( otherPath.fileSystemRepresentation, SUAudioDataReadingShared | SUAudioDataReadingCanonicalFormat );
+    
+    XCTAssertTrue( data == otherData, @"Identical audio data was not shared" );
+    XCTAssertEqual( data->retainCount, (UInt32)2, @"Shared audio data was not retained" );
+    XCTAssertTrue( ( data != different ) && ( data != unique ) && ( data != converted ), @"Different audio data was shared" );
+    
+    SUAudioDataDeduplicationStatistics statistics = audioDataDeduplicationStatistics();
+    
+    XCTAssertEqual( statistics.numberOfSharedReads - before.numberOfSharedReads, (UInt64)1, @"Shared read was not counted" );
+    XCTAssertEqual( statistics.numberOfResidentBytesSaved - before.numberOfResidentBytesSaved, audioDataResidentSize( unique ), @"Saved bytes were not counted" );
+    
+    // Shared audio data can't be modified in place, since the other owner may be playing it.
+    
+    XCTAssertFalse( measureAudioDataLevels( data ), @"Shared audio data was modified" );
+    XCTAssertEqual( trimAudioDataSilence( data, 0.5f ), (UInt64)0, @"Shared audio data was modified" );
+    XCTAssertEqual( compressAudioData( data ), (UInt64)0, @"Shared audio data was modified" );
+    XCTAssertTrue( measureAudioDataLevels( unique ), @"Unshared audio data was not modified" );
+    
+    // Freeing releases one reference; the saving lasts until the last one is released.
+    
+    freeAudioData( otherData );
+    
+    XCTAssertEqual( ((SInt16 *)data->audioData)[ 1 ], (SInt16)13, @"Shared audio data was freed while referenced" );
+    XCTAssertEqual( audioDataDeduplicationStatistics().numberOfResidentBytesSaved, statistics.numberOfResidentBytesSaved, @"Saved bytes changed before the last release" );
+    
+    freeAudioData( data );
+    
+    statistics = audioDataDeduplicationStatistics();
+    
+    XCTAssertEqual( statistics.numberOfResidentBytesSaved, before.numberOfResidentBytesSaved, @"Saved bytes were not released" );
+    XCTAssertEqual( statistics.numberOfBytesSaved - before.numberOfBytesSaved, audioDataResidentSize( unique ), @"Total saved bytes changed" );
+    
+    freeAudioData( different );
+    freeAudioData( unique );
+    freeAudioData( converted );
+    
+    for( NSString * p in @[ path, otherPath, differentPath ] )
+    {
+        [[NSFileManager defaultManager] removeItemAtPath: p error: NULL];
+    }
+    
+    free( samples );
+}
+
+/** Writes a 16-bit stereo WAV file whose samples are derived from the given seed, and returns its URL. */
+
+static NSURL * writeTestWAVFileWithSeed( UInt32 numberOfFrames, int seed ) {
+    
+    SInt16 * samples = malloc( numberOfFrames * 2 * sizeof( SInt16 ) );
+    
+    for( UInt32 i = 0; i < ( numberOfFrames * 2 ); i++ )
+    {
+        samples[ i ] = (SInt16)( ( i * 7 ) + ( seed * 1001 ) );
+    }
+    
+    NSString * path = writeTestWAVFile( samples, 2, numberOfFrames );
+    free( samples );
+    
+    return [NSURL fileURLWithPath: path];
+}
+
+- (void)testSoundEffectCacheEvictsLeastRecentlyUsedEntries {
+    
+    NSURL * first  = writeTestWAVFileWithSeed( 10000, 1 );
+    NSURL * second = writeTestWAVFileWithSeed( 10000, 2 );
+    NSURL * third  = writeTestWAVFileWithSeed( 10000, 3 );
+    
+    // Room for two of the files.
+    
+    SUSoundEffectCache cache = createSoundEffectCache( 100 * 1024, SUAudioDataReadingOptionsNone );
+    
+    SUSoundEffectData firstData  = readAudioDataFromCache( cache, (__bridge CFURLRef)first );
+    SUSoundEffectData secondData = readAudioDataFromCache( cache, (__bridge CFURLRef)second );
+    SUSoundEffectData firstAgain = readAudioDataFromCache( cache, (__bridge CFURLRef)first );
+    
+    const UInt64 cost = audioDataResidentSize( firstData );
+    XCTAssertTrue( ( cost * 2 <= 100 * 1024 ) && ( cost * 3 > 100 * 1024 ), @"Test files are the wrong size for the budget" );
+    
+    SUSoundEffectCacheStatistics statistics = soundEffectCacheStatistics( cache );
+    
+    XCTAssertTrue( firstData == firstAgain, @"Cached audio data was not returned" );
+    XCTAssertEqual( statistics.hits, (UInt64)1, @"Cache hit was not counted" );
+    XCTAssertEqual( statistics.misses, (UInt64)2, @"Cache misses were not counted" );
+    XCTAssertEqual( statistics.residentBytes, cost * 2, @"Resident bytes are wrong" );
+    
+    // The second file is now the least-recently-used, so it is evicted to make room for the third.
+    
+    SUSoundEffectData thirdData = readAudioDataFromCache( cache, (__bridge CFURLRef)third );
+    statistics = soundEffectCacheStatistics( cache );
+    
+    XCTAssertEqual( statistics.evictions, (UInt64)1, @"Entry was not evicted to fit the budget" );
+    XCTAssertEqual( statistics.numberOfEntries, (UInt64)2, @"Wrong number of entries" );
+    XCTAssertEqual( statistics.residentBytes, cost * 2, @"Resident bytes are over budget" );
+    
+    SUSoundEffectData firstOnceMore = readAudioDataFromCache( cache, (__bridge CFURLRef)first );
+    XCTAssertEqual( soundEffectCacheStatistics( cache ).hits, (UInt64)2, @"Most-recently-used entry was evicted" );
+    
+    SUSoundEffectData secondAgain = readAudioDataFromCache( cache, (__bridge CFURLRef)second );
+    XCTAssertEqual( soundEffectCacheStatistics( cache ).misses, (UInt64)4, @"Least-recently-used entry was not evicted" );
+    
+    // Evicted audio data stays alive while it is referenced.
+    
+    XCTAssertEqual( ((SInt16 *)secondData->audioData)[ 0 ], (SInt16)2002, @"Evicted audio data was freed while referenced" );
+    
+    freeAudioData( firstData );
+    freeAudioData( secondData );
+    freeAudioData( firstAgain );
+    freeAudioData( thirdData );
+    freeAudioData( firstOnceMore );
+    freeAudioData( secondAgain );
+    
+    freeSoundEffectCache( cache );
+    
+    for( NSURL * url in @[ first, second, third ] )
+    {
+        [[NSFileManager defaultManager] removeItemAtURL: url error: NULL];
+    }
+}
+
+- (void)testSoundEffectCacheCoalescesConcurrentLoads {
+    
+    NSURL * url = writeTestWAVFileWithSeed( 44100 * 10, 4 );
+    
+    SUSoundEffectCache cache = createSoundEffectCache( 16 * 1024 * 1024, SUAudioDataReadingOptionsNone );
+    
+    const size_t numberOfRequests = 8;
+    SUSoundEffectData * results   = calloc( numberOfRequests, sizeof( SUSoundEffectData ) );
+    
+    dispatch_apply( numberOfRequests, dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 ), ^( size_t i ) {
+        results[ i ] = readAudioDataFromCache( cache, (__bridge CFURLRef)url );
+    });
+    
+    // Every request after the first either waited for its load or hit the entry it inserted, so the file was read once.
+    
+    const SUSoundEffectCacheStatistics statistics = soundEffectCacheStatistics( cache );
+    
+    XCTAssertEqual( statistics.misses, (UInt64)1, @"Concurrent loads of the same file were not coalesced" );
+    XCTAssertEqual( statistics.hits, (UInt64)( numberOfRequests - 1 ), @"Coalesced loads were not counted as hits" );
+    XCTAssertEqual( statistics.numberOfEntries, (UInt64)1, @"Wrong number of entries" );
+    
+    for( size_t i = 0; i < numberOfRequests; i++ )
+    {
+        XCTAssertTrue( results[ i ] == results[ 0 ], @"Request %zu returned different audio data", i );
+        freeAudioData( results[ i ] );
+    }
+    
+    free( results );
+    freeSoundEffectCache( cache );
+    
+    [[NSFileManager defaultManager] removeItemAtURL: url error: NULL];
+}
+
+- (void)testFreeingSoundEffectCacheWaitsForLoads {
+    
+    NSURL * url = writeTestWAVFileWithSeed( 44100 * 10, 6 );
+    
+    SUSoundEffectCache cache = createSoundEffectCache( 16 * 1024 * 1024, SUAudioDataReadingOptionsNone );
+    
+    __block SUSoundEffectData data = NULL;
+    dispatch_semaphore_t started   = dispatch_semaphore_create( 0 );
+    dispatch_group_t group         = dispatch_group_create();
+    
+    dispatch_group_async( group, dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 ), ^{
+        dispatch_semaphore_signal( started );
+        data = readAudioDataFromCache( cache, (__bridge CFURLRef)url );
+    });
+    
+    // Free the cache while the file is (most likely) still being read. The load must complete without touching the freed cache.
+    
+    dispatch_semaphore_wait( started, DISPATCH_TIME_FOREVER );
+    freeSoundEffectCache( cache );
+    
+    dispatch_group_wait( group, DISPATCH_TIME_FOREVER );
+    
+    XCTAssertTrue( NULL != data, @"Audio data was not read" );
+    
+    freeAudioData( data );
+    
+    [[NSFileManager defaultManager] removeItemAtURL: url error: NULL];
+}
+
+- (void)testSoundEffectCacheChargesSharedAudioDataOnce {
+    
+    // The same sound under two names, which shared reads deduplicate.
+    
+    NSURL * url      = writeTestWAVFileWithSeed( 10000, 5 );
+    NSURL * otherURL = writeTestWAVFileWithSeed( 10000, 5 );
+    
+    SUSoundEffectCache cache = createSoundEffectCache( 1024 * 1024, SUAudioDataReadingShared );
+    
+    SUSoundEffectData data      = readAudioDataFromCache( cache, (__bridge CFURLRef)url );
+    SUSoundEffectData otherData = readAudioDataFromCache( cache, (__bridge CFURLRef)otherURL );
+    
+    XCTAssertTrue( data == otherData, @"Identical audio data was not shared" );
+    
+    const UInt64 cost = audioDataResidentSize( data );
+    SUSoundEffectCacheStatistics statistics = soundEffectCacheStatistics( cache );
+    
+    XCTAssertEqual( statistics.numberOfEntries, (UInt64)2, @"Wrong number of entries" );
+    XCTAssertEqual( statistics.residentBytes, cost, @"Shared audio data was charged more than once" );
+    
+    // A budget which fits the data once keeps both entries. Below that, both are evicted.
+    
+    setSoundEffectCacheByteBudget( cache, cost );
+    XCTAssertEqual( soundEffectCacheStatistics( cache ).evictions, (UInt64)0, @"Entries sharing audio data were evicted early" );
+    
+    setSoundEffectCacheByteBudget( cache, cost - 1 );
+    statistics = soundEffectCacheStatistics( cache );
+    
+    XCTAssertEqual( statistics.numberOfEntries, (UInt64)0, @"Entries sharing audio data were not evicted" );
+    XCTAssertEqual( statistics.residentBytes, (UInt64)0, @"Resident bytes were not released" );
+    
+    freeAudioData( data );
+    freeAudioData( otherData );
+    
+    freeSoundEffectCache( cache );
+    
+    [[NSFileManager defaultManager] removeItemAtURL: url error: NULL];
+    [[NSFileManager defaultManager] removeItemAtURL: otherURL error: NULL];
+}
+
+- (void)testTrimmingSilenceMeasuresLevels {
+    
+    // A tone from frame 3000 to 7000 of 10000, with quiet noise (below the silence threshold) before and after it.
+    
+    const UInt32 numberOfFrames = 10000;
+    SInt16 * samples = malloc( numberOfFrames * 2 * sizeof( SInt16 ) );
+    double sumOfSquares = 0;
+    
+    for( UInt32 frame = 0; frame < numberOfFrames; frame++ )
+    {
+        for( UInt32 channel = 0; channel < 2; channel++ )
+        {
+            SInt16 sample = (SInt16)( ( ( frame + channel ) % 5 ) - 2 );
+            
+            if( ( frame >= 3000 ) && ( frame < 7000 ) )
+                sample = (SInt16)( 16384 * sin( frame * 0.05 ) * ( channel ? 0.5 : 1 ) );
+            
+            samples[ ( frame * 2 ) + channel ] = sample;
+        }
+    }
+    
+    // The first and last audible frames are only audible in one channel.
+    
+    samples[ 3000 * 2 ]         = 0;
+    samples[ ( 3000 * 2 ) + 1 ] = 1000;
+    samples[ 6999 * 2 ]         = -32768;
+    samples[ ( 6999 * 2 ) + 1 ] = 0;
+    
+    for( UInt32 i = ( 3000 * 2 ); i < ( 7000 * 2 ); i++ )
+    {
+        sumOfSquares += ( ( samples[ i ] / 32768.0 ) * ( samples[ i ] / 32768.0 ) );
+    }
+    
+    NSString * path = writeTestWAVFile( samples, 2, numberOfFrames );
+    
+    for( int mapped = 0; mapped < 2; mapped++ )
+    {
+        const SUAudioDataReadingOptions options = ( SUAudioDataReadingTrimSilence | SUAudioDataReadingWaveform );
+        SUSoundEffectData data = readAudioDataFromWAVFile( path.fileSystemRepresentation, options | ( mapped ? SUAudioDataReadingMapped : 0 ) );
+        
+        XCTAssertTrue( NULL != data, @"WAV file could not be read" );
+        
+        if( NULL == data )
+            continue;
+        
+        XCTAssertEqual( data->numberOfFrames, (UInt64)4000, @"Silence was not trimmed" );
+        XCTAssertEqual( data->numberOfPackets, (UInt64)4000, @"Packets were not trimmed" );
+        XCTAssertEqual( data->numberOfAudioDataBytes, (UInt64)( 4000 * 4 ), @"Audio bytes were not trimmed" );
+        XCTAssertEqual( data->levels.numberOfLeadingFramesTrimmed, (UInt64)3000, @"Wrong number of leading frames trimmed" );
+        XCTAssertEqual( data->levels.numberOfTrailingFramesTrimmed, (UInt64)3000, @"Wrong number of trailing frames trimmed" );
+        XCTAssertTrue( 0 == memcmp( data->audioData, samples + ( 3000 * 2 ), 4000 * 4 ), @"Audible frames were not kept" );
+        XCTAssertEqual( soundWaveformNumberOfFrames( data->waveform ), (UInt64)4000, @"Waveform was built before trimming" );
+        
+        XCTAssertTrue( data->levels.measured, @"Levels were not measured" );
+        XCTAssertEqual( data->levels.peak, 1.0f, @"Wrong peak level" );
+        XCTAssertEqualWithAccuracy( data->levels.rms, sqrt( sumOfSquares / ( 4000 * 2 ) ), 1e-5, @"Wrong RMS level" );
+        XCTAssertEqualWithAccuracy( audioDataNormalizingGain( data, 0.5f ), 0.5f, 1e-6, @"Wrong normalizing gain" );
+        
+        freeAudioData( data );
+    }
+    
+    // The SIMD scan matches the scalar reference, including its tail.
+    
+    float * floatSamples = malloc( 4099 * sizeof( float ) );
+    
+    for( UInt32 i = 0; i < 4099; i++ )
+    {
+        floatSamples[ i ] = ( ( i % 97 ) == 5 ) ? ( 0.5f - ( ( i % 3 ) * 0.3f ) ) : ( ( ( i % 11 ) - 5.0f ) * 1e-5f );
+    }
+    
+    for( size_t numberOfSamples = 4090; numberOfSamples <= 4099; numberOfSamples++ )
+    {
+        SUSoundSampleScan scalarScan, vectorScan;
+        
+        scanFloat32LevelsKernel( floatSamples, numberOfSamples, kSUAudioDataSilenceThreshold, &scalarScan, false );
+        scanFloat32LevelsKernel( floatSamples, numberOfSamples, kSUAudioDataSilenceThreshold, &vectorScan, true );
+        
+        XCTAssertTrue( 0 == memcmp( &scalarScan, &vectorScan, sizeof( SUSoundSampleScan ) ), @"Vector scan differs from the scalar reference" );
+        XCTAssertEqual( scalarScan.firstAudibleSample, (size_t)5, @"Wrong first audible sample" );
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtPath: path error: NULL];
+    
+    free( floatSamples );
+    free( samples );
+}
+
+#pragma mark -
+#pragma mark SUSoundBank
+
+- (void)testSoundBankLoadsFilesInToArena {
+    
+    const UInt32 numberOfFiles  = 12;
+    const UInt32 numberOfFrames = 4001;
+    
+    SInt16 * samples = malloc( numberOfFrames * 2 * sizeof( SInt16 ) );
+    
+    for( UInt32 i = 0; i < ( numberOfFrames * 2 ); i++ )
+    {
+        samples[ i ] = (SInt16)( i * 13 );
+    }
+    
+    // Every fourth file is missing, and files alternate between mono and stereo.
+    
+    NSMutableArray * paths = [NSMutableArray array];
+    CFURLRef fileURLs[ numberOfFiles ];
+    
+    for( UInt32 i = 0; i < numberOfFiles; i++ )
+    {
+        NSString * path = ( 3 == ( i % 4 ) ) ? @"/nonexistent.wav" : writeTestWAVFile( samples, 1 + ( i & 1 ), numberOfFrames );
+        
+        [paths addObject: path];
+        fileURLs[ i ] = (__bridge_retained CFURLRef)[NSURL fileURLWithPath: path];
+    }
+    
+    SUSoundBank bank = createSoundBankFromURLs( fileURLs, numberOfFiles, 4 );
+    const SUSoundBankStatistics statistics = soundBankStatistics( bank );
+    
+    XCTAssertTrue( NULL != bank, @"Sound bank could not be created" );
+    XCTAssertEqual( soundBankCount( bank ), numberOfFiles, @"Sound bank has the wrong number of entries" );
+    XCTAssertEqual( statistics.numberOfFailedFiles, (UInt32)3, @"Missing files were not reported" );
+    
+    NSLog( @"Loaded %u files in %.2f ms (%.2f ms summed over files) on %u threads, in to a %llu byte arena", numberOfFiles,
+           statistics.loadTime * 1000, statistics.totalFileLoadTime * 1000, statistics.numberOfThreads, statistics.arenaSize );
+    
+    // Keep one sound effect beyond the lifetime of the bank.
+    
+    SUSoundEffectData retained = retainAudioData( soundBankAudioData( bank )[ 1 ] );
+    
+    for( UInt32 i = 0; i < numberOfFiles; i++ )
+    {
+        SUSoundEffectData data = soundBankAudioData( bank )[ i ];
+        
+        if( 3 == ( i % 4 ) )
+        {
+            XCTAssertTrue( NULL == data, @"Missing file %u has audio data", i );
+            continue;
+        }
+        
+        XCTAssertTrue( NULL != data, @"File %u could not be read", i );
+        XCTAssertEqual( data->numberOfFrames, (UInt64)numberOfFrames, @"File %u has the wrong length", i );
+        XCTAssertTrue( 0 == memcmp( data->audioData, samples, (size_t)data->numberOfAudioDataBytes ), @"File %u has the wrong audio data", i );
+        
+        NSLog( @"File %u loaded in %.3f ms", i, soundBankFileLoadTime( bank, i ) * 1000 );
+    }
+    
+    freeSoundBank( bank );
+    
+    XCTAssertTrue( 0 == memcmp( retained->audioData, samples, (size_t)retained->numberOfAudioDataBytes ), @"Retained audio data was freed with the bank" );
+    freeAudioData( retained );
+    
+    for( UInt32 i = 0; i < numberOfFiles; i++ )
+    {
+        [[NSFileManager defaultManager] removeItemAtPath: paths[ i ] error: NULL];
+        CFRelease( fileURLs[ i ] );
+    }
+    
+    free( samples );
+}
+
+#pragma mark -
+#pragma mark SUSoundInstrumentation
+
+- (void)testInstrumentationRecordsFills {
+    
+    SUSoundEffectData data = createTestAudioData( NO, 2, 44100, 5 );
+    
+    char audioBytes[ 4096 ];
+    SUSoundBuffer buffer = { .audioData = audioBytes, .audioDataBytesCapacity = sizeof( audioBytes ) };
+    
+    resetSoundInstrumentationStatistics();
+    
+    SInt64 playbackPosition = 0;
+    UInt64 numberOfFills    = 0;
+    
+    while( noErr == fillSoundBufferFromAudioData( &buffer, data, &playbackPosition ) )
+    {
+        numberOfFills++;
+    }
+    
+    numberOfFills++;
+    
+    const SUSoundInstrumentationStatistics statistics = soundInstrumentationStatistics();
+    
+    if( false == soundInstrumentationIsEnabled() )
+    {
+        XCTAssertEqual( statistics.numberOfFills, (UInt64)0, @"Fills were recorded in an uninstrumented build" );
+        freeAudioData( data );
+        return;
+    }
+    
+    UInt64 numberOfTimedFills = 0;
+    UInt64 numberOfDeadlines  = 0;
+    
+    for( UInt32 i = 0; i < kSUSoundInstrumentationDurationBuckets; i++ )
+    {
+        numberOfTimedFills += statistics.durationHistogram[ i ];
+    }
+    
+    for( UInt32 i = 0; i < kSUSoundInstrumentationDeadlineBuckets; i++ )
+    {
+        numberOfDeadlines += statistics.deadlineHistogram[ i ];
+    }
+    
+    XCTAssertEqual( statistics.numberOfFills, numberOfFills, @"Wrong number of fills recorded" );
+    XCTAssertEqual( statistics.numberOfBytes, (UInt64)data->numberOfAudioDataBytes, @"Wrong number of bytes recorded" );
+    XCTAssertEqual( numberOfTimedFills, numberOfFills, @"Duration histogram does not count every fill" );
+    XCTAssertEqual( numberOfDeadlines, numberOfFills, @"Deadline histogram does not count every fill" );
+    XCTAssertEqual( statistics.numberOfViolatingFills, (UInt64)0, @"Filling from memory allocated or took a lock" );
+    
+    NSLog( @"%llu fills, mean %.2f us, max %.2f us, %llu missed deadlines", statistics.numberOfFills,
+           ( statistics.totalDuration / 1000.0 ) / statistics.numberOfFills, statistics.maximumDuration / 1000.0,
+           statistics.deadlineHistogram[ kSUSoundInstrumentationDeadlineBuckets - 1 ] );
+    
+    freeAudioData( data );
+}
+
+- (void)testInstrumentationFlagsAllocationsAndLocksDuringFills {
+    
+    SInt16 samples[ 256 ] = { 0 };
+    NSString * path = writeTestWAVFile( samples, 2, 128 );
+    
+    resetSoundInstrumentationStatistics();
+    
+    // Reading audio data inside a fill allocates and takes SpringUtils' own locks, which dyld interposing does not see.
+    
+    SU_SOUND_INSTRUMENTATION_BEGIN( instrumentation );
+    
+    SUSoundEffectData data = readAudioDataFromWAVFile( path.fileSystemRepresentation, SUAudioDataReadingOptionsNone );
+    audioDataDeduplicationStatistics();
+    
+    SU_SOUND_INSTRUMENTATION_END( instrumentation, 0, 0, 0 );
+    
+    const SUSoundInstrumentationStatistics statistics = soundInstrumentationStatistics();
+    
+    if( soundInstrumentationIsEnabled() )
+    {
+        XCTAssertTrue( statistics.numberOfAllocations > 0, @"Allocations during a fill were not counted" );
+        XCTAssertTrue( statistics.numberOfLocks > 0, @"Locks during a fill were not counted" );
+        XCTAssertEqual( statistics.numberOfViolatingFills, (UInt64)1, @"Fill was not flagged as a violation" );
+    }
+    else
+    {
+        XCTAssertEqual( statistics.numberOfViolatingFills, (UInt64)0, @"Violations were recorded in an uninstrumented build" );
+    }
+    
+    freeAudioData( data );
+    
+    [[NSFileManager defaultManager] removeItemAtPath: path error: NULL];
+}
+
+#pragma mark -
+#pragma mark SUSoundWaveform
+
+- (void)testWaveformPeaksMatchSamples {
+    
+    // 1, 2 and 4 channels are reduced with vector code; 3 channels with scalar code.
+    
+    for( UInt32 numberOfChannels = 1; numberOfChannels <= 4; numberOfChannels++ )
+    {
+        const UInt32 numberOfFrames = ( 44100 * 30 ) + 17;
+        SUSoundEffectData data      = createTestAudioData( YES, numberOfChannels, numberOfFrames, numberOfChannels );
+        const float * samples       = data->audioData;
+        
+        const CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        SUSoundWaveform waveform   = createSoundWaveform( data );
+        const CFAbsoluteTime built = CFAbsoluteTimeGetCurrent();
+        
+        XCTAssertTrue( NULL != waveform, @"Waveform could not be built" );
+        
+        // Query a whole-file overview, a zoomed-in range and a range running off the end; each peak must match the blocks it overlaps.
+        
+        const UInt64 ranges[ 3 ][ 3 ] = { { 0, numberOfFrames, 1920 }, { 123457, 9000, 700 }, { numberOfFrames - 50000, 100000, 300 } };
+        SUSoundWaveformPeak peaks[ 1920 ];
+        
+        for( UInt32 r = 0; r < 3; r++ )
+        {
+            const UInt64 firstFrame    = ranges[ r ][ 0 ];
+            const UInt64 length        = ranges[ r ][ 1 ];
+            const UInt32 numberOfPeaks = (UInt32)ranges[ r ][ 2 ];
+            
+            UInt64 framesPerBlock = kSUSoundWaveformFramesPerBlock;
+            
+            while( ( framesPerBlock * 2 ) <= ( length / numberOfPeaks ) )
+                framesPerBlock *= 2;
+            
+            for( UInt32 channel = 0; channel < numberOfChannels; channel++ )
+            {
+                getSoundWaveformPeaks( waveform, channel, firstFrame, length, peaks, numberOfPeaks );
+                
+                for( UInt32 i = 0; i < numberOfPeaks; i += 7 )
+                {
+                    const UInt64 peakStart = firstFrame + ( ( length * i ) / numberOfPeaks );
+                    const UInt64 peakEnd   = MIN( firstFrame + ( ( length * ( i + 1 ) ) / numberOfPeaks ), numberOfFrames );
+                    
+                    if( peakStart >= numberOfFrames )
+                    {
+                        XCTAssertTrue( ( 0 == peaks[ i ].maximum ) && ( 0 == peaks[ i ].rms ), @"Peak beyond the end of the data is not empty" );
+                        continue;
+                    }
+                    
+                    const UInt64 blockStart = ( ( peakStart / framesPerBlock ) * framesPerBlock );
+                    const UInt64 blockEnd   = MIN( ( ( ( peakEnd - 1 ) / framesPerBlock ) + 1 ) * framesPerBlock, numberOfFrames );
+                    
+                    float minimum = INFINITY, maximum = -INFINITY;
+                    double sumOfSquares = 0;
+                    
+                    for( UInt64 frame = blockStart; frame < blockEnd; frame++ )
+                    {
+                        const float x = samples[ ( frame * numberOfChannels ) + channel ];
+                        
+                        minimum       = MIN( minimum, x );
+                        maximum       = MAX( maximum, x );
+                        sumOfSquares += ( x * x );
+                    }
+                    
+                    XCTAssertEqual( peaks[ i ].minimum, minimum, @"Wrong minimum for channel %u of %u", channel, numberOfChannels );
+                    XCTAssertEqual( peaks[ i ].maximum, maximum, @"Wrong maximum for channel %u of %u", channel, numberOfChannels );
+                    XCTAssertEqualWithAccuracy( peaks[ i ].rms, sqrt( sumOfSquares / ( blockEnd - blockStart ) ), 1e-4, @"Wrong RMS for channel %u of %u", channel, numberOfChannels );
+                }
+            }
+        }
+        
+        // Overviews cost O(pixels), whatever the length of the audio data.
+        
+        const CFAbsoluteTime queryStart = CFAbsoluteTimeGetCurrent();
+        
+        for( int i = 0; i < 100; i++ )
+        {
+            getSoundWaveformPeaks( waveform, 0, 0, numberOfFrames, peaks, 1920 );
+        }
+        
+        NSLog( @"%u channels: built a %llu byte waveform in %.2f ms; 1920-pixel overview in %.2f us", numberOfChannels, soundWaveformSize( waveform ),
+               ( built - start ) * 1000, ( CFAbsoluteTimeGetCurrent() - queryStart ) * 10000 );
+        
+        // Peak files round-trip.
+        
+        NSString * path = [NSTemporaryDirectory() stringByAppendingPathComponent: [[NSUUID UUID] UUIDString]];
+        
+        XCTAssertEqual( writeSoundWaveformToFile( waveform, path.fileSystemRepresentation ), (OSStatus)noErr, @"Waveform could not be written" );
+        
+        SUSoundWaveform readWaveform = readSoundWaveformFromFile( path.fileSystemRepresentation );
+        SUSoundWaveformPeak readPeaks[ 1920 ];
+        
+        XCTAssertTrue( NULL != readWaveform, @"Waveform could not be read" );
+        
+        getSoundWaveformPeaks( readWaveform, numberOfChannels - 1, 0, numberOfFrames, readPeaks, 1920 );
+        getSoundWaveformPeaks( waveform, numberOfChannels - 1, 0, numberOfFrames, peaks, 1920 );
+        
+        XCTAssertTrue( 0 == memcmp( peaks, readPeaks, sizeof( peaks ) ), @"Read waveform differs from the written one" );
+        
+        // A header which describes a larger pyramid than the file holds is rejected before the pyramid is allocated.
+        
+        NSFileHandle * file = [NSFileHandle fileHandleForUpdatingAtPath: path];
+        const UInt64 hugeNumberOfFrames = ( 1ULL << 50 );
+        
+        [file seekToFileOffset: 16];
+        [file writeData: [NSData dataWithBytes: &hugeNumberOfFrames length: sizeof( hugeNumberOfFrames )]];
+        [file closeFile];
+        
+        XCTAssertTrue( NULL == readSoundWaveformFromFile( path.fileSystemRepresentation ), @"Waveform with a corrupt header was read" );
+        
+        [[NSFileManager defaultManager] removeItemAtPath: path error: NULL];
+        
+        // A zero-width overview has no peaks.
+        
+        getSoundWaveformPeaks( waveform, 0, 0, numberOfFrames, peaks, 0 );
+        
+        freeSoundWaveform( readWaveform );
+        freeSoundWaveform( waveform );
+        freeAudioData( data );
+    }
+}
+
+#pragma mark -
+#pragma mark SUSoundResampler
+
+- (void)testResamplerQualityAndThroughputFrom48kTo44k {
+    
+    // Tones in the passband are reproduced at the new rate; tones above the new Nyquist frequency are removed.
+    
+    const double frequencies[] = { 1000, 10000, 19000, 23500 };
+    
+    for( int i = 0; i < 4; i++ )
+    {
+        SUSoundEffectData tone      = createTestToneAudioData( 48000, frequencies[ i ], 96000 );
+        SUSoundEffectData resampled = copyAudioDataWithSampleRate( tone, 44100 );
+        
+        XCTAssertTrue( NULL != resampled, @"Audio data could not be resampled" );
+        XCTAssertEqual( resampled->numberOfFrames, (UInt64)88200, @"Resampled audio data has the wrong length" );
+        XCTAssertEqual( resampled->dataFormat.mSampleRate, 44100.0, @"Resampled audio data has the wrong sample rate" );
+        
+        const float * samples = resampled->audioData;
+        double signal = 0, noise = 0;
+        
+        for( UInt32 frame = kSUSoundResamplerNumberOfTaps; frame < ( 88200 - kSUSoundResamplerNumberOfTaps ); frame++ )
+        {
+            const double expected = ( frequencies[ i ] < 22050 ) ? ( 0.5 * sin( 2 * M_PI * frequencies[ i ] * frame / 44100 ) ) : 0;
+            
+            signal += ( expected * expected );
+            noise  += ( ( samples[ frame ] - expected ) * ( samples[ frame ] - expected ) );
+        }
+        
+        if( frequencies[ i ] < 22050 )
+        {
+            NSLog( @"48k->44.1k: %.0f Hz tone, SNR %.1f dB", frequencies[ i ], 10 * log10( signal / noise ) );
+            XCTAssertTrue( ( signal / noise ) > 1e8, @"%.0f Hz tone was not reproduced", frequencies[ i ] );
+        }
+        else
+        {
+            NSLog( @"48k->44.1k: %.0f Hz tone, attenuated by %.1f dB", frequencies[ i ], 10 * log10( ( 0.125 * ( 88200 - 2 * kSUSoundResamplerNumberOfTaps ) ) / noise ) );
+            XCTAssertTrue( noise < ( 0.125 * ( 88200 - 2 * kSUSoundResamplerNumberOfTaps ) * 1e-3 ), @"%.0f Hz tone was not removed", frequencies[ i ] );
+        }
+        
+        freeAudioData( resampled );
+        freeAudioData( tone );
+    }
+    
+    // The vector and scalar kernels produce identical output. Time each over 10 seconds of stereo audio.
+    
+    SUSoundEffectData samples  = createTestAudioData( NO, 2, 480000, 11 );
+    SUSoundEffectData source   = copyAudioDataInCanonicalFormat( samples, 2 );
+    float * outputs[ 2 ]       = { malloc( 441000 * 2 * sizeof( float ) ), malloc( 441000 * 2 * sizeof( float ) ) };
+    SUSoundResampler resampler = createSoundResampler( 48000, 44100, 2 );
+    
+    for( int vector = 0; vector < 2; vector++ )
+    {
+        resetSoundResampler( resampler );
+        
+        size_t numberOfFramesUsed = 0;
+        
+        const CFAbsoluteTime start  = CFAbsoluteTimeGetCurrent();
+        const size_t numberOfFrames = resampleFloat32Kernel( resampler, source->audioData, 480000, &numberOfFramesUsed, outputs[ vector ], 441000, vector );
+        const CFAbsoluteTime time   = ( CFAbsoluteTimeGetCurrent() - start );
+        
+        XCTAssertEqual( numberOfFramesUsed, (size_t)480000, @"Input was not used" );
+        XCTAssertTrue( numberOfFrames > ( 441000 - kSUSoundResamplerNumberOfTaps ), @"Output is too short" );
+        
+        NSLog( @"%@ resampler: 48k->44.1k stereo at %.1f Mframes/s (%.0fx real time)", ( vector ? @"Vector" : @"Scalar" ), ( numberOfFrames / time ) / 1e6, 10 / time );
+    }
+    
+    XCTAssertTrue( 0 == memcmp( outputs[ 0 ], outputs[ 1 ], ( 441000 - kSUSoundResamplerNumberOfTaps ) * 2 * sizeof( float ) ), @"Vector and scalar kernels differ" );
+    
+    freeSoundResampler( resampler );
+    free( outputs[ 0 ] );
+    free( outputs[ 1 ] );
+    freeAudioData( source );
+    freeAudioData( samples );
+}
+
+- (void)testStreamingResamplerMatchesOfflineConversion {
+    
+    SUSoundEffectData source = createTestAudioData( NO, 2, 48017, 12 );
+    source->dataFormat.mSampleRate = 48000;
+    
+    SUSoundEffectData resampled = copyAudioDataWithSampleRate( source, 44100 );
+    SUSoundResampler resampler  = createSoundResampler( 48000, 44100, 2 );
+    
+    float * output          = malloc( (size_t)resampled->numberOfAudioDataBytes + 4096 );
+    float   buffer[ 333 * 2 ];
+    UInt64  numberOfFrames  = 0;
+    SInt64  position        = 0;
+    OSStatus err            = noErr;
+    
+    while( noErr == err )
+    {
+        SUSoundBuffer soundBuffer = { .audioData = buffer, .audioDataBytesCapacity = sizeof( buffer ) };
+        
+        err = fillSoundBufferFromAudioDataResampled( &soundBuffer, source, resampler, &position );
+        
+        XCTAssertTrue( ( noErr == err ) || ( kAudioFileEndOfFileError == err ), @"Resampled fill failed" );
+        XCTAssertTrue( ( noErr != err ) || ( soundBuffer.audioDataByteSize == sizeof( buffer ) ), @"Buffer was not filled" );
+        
+        memcpy( output + ( numberOfFrames * 2 ), buffer, soundBuffer.audioDataByteSize );
+        numberOfFrames += ( soundBuffer.audioDataByteSize / ( 2 * sizeof( float ) ) );
+    }
+    
+    XCTAssertEqual( numberOfFrames, resampled->numberOfFrames, @"Streamed output has the wrong length" );
+    XCTAssertTrue( 0 == memcmp( output, resampled->audioData, (size_t)resampled->numberOfAudioDataBytes ), @"Streamed output differs from offline conversion" );
+    
+    // Audio data at another rate is rejected.
+    
+    SUSoundBuffer soundBuffer = { .audioData = buffer, .audioDataBytesCapacity = sizeof( buffer ) };
+    source->dataFormat.mSampleRate = 44100;
+    position = 0;
+    
+    XCTAssertEqual( fillSoundBufferFromAudioDataResampled( &soundBuffer, source, resampler, &position ), (OSStatus)kAudioFileUnsupportedDataFormatError,
+                    @"Audio data at the wrong rate was resampled" );
+    
+    free( output );
+    freeSoundResampler( resampler );
+    freeAudioData( resampled );
+    freeAudioData( source );
+}
+
+@end
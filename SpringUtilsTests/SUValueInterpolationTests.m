@@ -0,0 +1,685 @@
+//
+//  SUValueInterpolationTests.m
+//  SpringUtils
+//
+//  (c) 2014-present, SpringsUp
+//
+//  Licensed under the SpringUtils license, which may be obtained from:
+//  https://raw.github.com/springsup/SpringUtils/master/LICENSE
+//
+
+#import <XCTest/XCTest.h>
+#import "SUValueInterpolation_Private.h"
+#import "SUKeyframeTrack.h"
+#import "SUStructInterpolation.h"
+#import "SUTransformInterpolation.h"
+#import "SUTransformDecomposition_Private.h"
+#import "NSValue+SUInterpolable.h"
+#import "SUInterpolationSession.h"
+
+#import <QuartzCore/CATransform3D.h>
+
+/** Returns a pseudo-random number in [minimum, maximum). */
+
+static double randomDouble( double minimum, double maximum ) {
+    
+    return minimum + ( ( (double)rand() / ( (double)RAND_MAX + 1 ) ) * ( maximum - minimum ) );
+}
+
+/** A structure with a field of every kind an interpolation plan handles. */
+
+typedef struct _SUTestInterpolatedStruct {
+    
+    char character;
+    double real;
+    short shorts[ 3 ];
+    struct { float x, y; } points[ 2 ];
+    unsigned char byte;
+    bool flag;
+    void * pointer;
+    long long longLong;
+    
+} SUTestInterpolatedStruct;
+
+/** Structures interpolated by registered interpolators. */
+
+typedef struct _SUTestRegisteredStruct { int value; } SUTestRegisteredStruct;
+typedef struct _SUTestReplacedStruct { int value; } SUTestReplacedStruct;
+
+static NSValue * interpolateRegisteredStruct( NSValue * start, NSValue * end, SUInterpolationOffset offset ) {
+    
+    SUTestRegisteredStruct result = { 42 };
+    return [NSValue valueWithBytes: &result objCType: @encode( SUTestRegisteredStruct )];
+}
+
+static NSValue * interpolateReplacedStruct( NSValue * start, NSValue * end, SUInterpolationOffset offset ) {
+    
+    SUTestReplacedStruct result = { (int)( offset * 100 ) };
+    return [NSValue valueWithBytes: &result objCType: @encode( SUTestReplacedStruct )];
+}
+
+/** Interpolates affine transforms as NSValue does, counting its calls, so that registering it leaves other tests' results unchanged. */
+
+static int32_t numberOfRegisteredAffineInterpolations;
+
+static NSValue * interpolateAffineTransformCountingCalls( NSValue * start, NSValue * end, SUInterpolationOffset offset ) {
+    
+    CGAffineTransform startTransform, endTransform;
+    
+    [start getValue: &startTransform];
+    [end getValue: &endTransform];
+    __atomic_fetch_add( &numberOfRegisteredAffineInterpolations, 1, __ATOMIC_RELAXED );
+    
+    CGAffineTransform result = affineTransformWithOffsetBetweenAffineTransforms( startTransform, endTransform, offset );
+    return [NSValue valueWithBytes: &result objCType: @encode( CGAffineTransform )];
+}
+
+@interface SUValueInterpolationTests : XCTestCase
+
+@end
+
+@implementation SUValueInterpolationTests
+
+#pragma mark -
+#pragma mark Interpolating Arrays
+
+- (void)testArrayInterpolationMatchesScalarFunctions {
+    
+    // Counts up to 41 exercise every combination of vector loop and scalar tail.
+    
+    const size_t maximumCount = 41;
+    
+    float  floatStarts[ maximumCount * 4 ], floatEnds[ maximumCount * 4 ], floatResults[ maximumCount * 4 ], scalarFloatResults[ maximumCount * 4 ];
+    double doubleStarts[ maximumCount * 4 ], doubleEnds[ maximumCount * 4 ], doubleResults[ maximumCount * 4 ], scalarDoubleResults[ maximumCount * 4 ];
+    SUInterpolationOffset offsets[ maximumCount ];
+    
+    srand( 20 );
+    
+    for( size_t i = 0; i < ( maximumCount * 4 ); i++ )
+    {
+        floatStarts[ i ]  = (float)randomDouble( -1000, 1000 );
+        floatEnds[ i ]    = (float)randomDouble( -1000, 1000 );
+        doubleStarts[ i ] = randomDouble( -1e6, 1e6 );
+        doubleEnds[ i ]   = randomDouble( -1e6, 1e6 );
+    }
+    
+    for( size_t i = 0; i < maximumCount; i++ )
+    {
+        offsets[ i ] = (SUInterpolationOffset)randomDouble( -0.25, 1.25 );
+    }
+    
+    for( size_t count = 0; count <= maximumCount; count++ )
+    {
+        // A single offset.
+        
+        getFloatsWithOffsetBetweenFloats( floatStarts, floatEnds, 0.3f, floatResults, count );
+        getDoublesWithOffsetBetweenDoubles( doubleStarts, doubleEnds, 0.3f, doubleResults, count );
+        
+        for( size_t i = 0; i < count; i++ )
+        {
+            XCTAssertEqual( floatResults[ i ], floatWithOffsetBetweenFloats( floatStarts[ i ], floatEnds[ i ], 0.3f ), @"Float %zu of %zu differs", i, count );
+            XCTAssertEqual( doubleResults[ i ], doubleWithOffsetBetweenDoubles( doubleStarts[ i ], doubleEnds[ i ], 0.3f ), @"Double %zu of %zu differs", i, count );
+        }
+        
+        // An offset per value, or per point or rectangle.
+        
+        for( UInt32 componentsPerOffset = 1; componentsPerOffset <= 4; componentsPerOffset *= 2 )
+        {
+            interpolateFloat32WithOffsetsKernel( floatStarts, floatEnds, offsets, componentsPerOffset, floatResults, count, true );
+            interpolateFloat32WithOffsetsKernel( floatStarts, floatEnds, offsets, componentsPerOffset, scalarFloatResults, count, false );
+            interpolateFloat64WithOffsetsKernel( doubleStarts, doubleEnds, offsets, componentsPerOffset, doubleResults, count, true );
+            interpolateFloat64WithOffsetsKernel( doubleStarts, doubleEnds, offsets, componentsPerOffset, scalarDoubleResults, count, false );
+            
+            XCTAssertTrue( 0 == memcmp( floatResults, scalarFloatResults, count * componentsPerOffset * sizeof( float ) ),
+                           @"Vector float kernel differs from the scalar reference with %u components", componentsPerOffset );
+            XCTAssertTrue( 0 == memcmp( doubleResults, scalarDoubleResults, count * componentsPerOffset * sizeof( double ) ),
+                           @"Vector double kernel differs from the scalar reference with %u components", componentsPerOffset );
+            
+            for( size_t i = 0; i < ( count * componentsPerOffset ); i++ )
+            {
+                XCTAssertEqual( scalarFloatResults[ i ], floatWithOffsetBetweenFloats( floatStarts[ i ], floatEnds[ i ], offsets[ i / componentsPerOffset ] ), @"Float %zu differs", i );
+            }
+        }
+    }
+    
+    // Points and rectangles are interpolated at CGFloat precision.
+    
+    CGRect startRects[ maximumCount ], endRects[ maximumCount ], rects[ maximumCount ];
+    CGPoint points[ maximumCount ];
+    
+    for( size_t i = 0; i < maximumCount; i++ )
+    {
+        startRects[ i ] = CGRectMake( (CGFloat)doubleStarts[ i * 4 ], (CGFloat)doubleStarts[ ( i * 4 ) + 1 ], (CGFloat)doubleStarts[ ( i * 4 ) + 2 ], (CGFloat)doubleStarts[ ( i * 4 ) + 3 ] );
+        endRects[ i ]   = CGRectMake( (CGFloat)doubleEnds[ i * 4 ], (CGFloat)doubleEnds[ ( i * 4 ) + 1 ], (CGFloat)doubleEnds[ ( i * 4 ) + 2 ], (CGFloat)doubleEnds[ ( i * 4 ) + 3 ] );
+    }
+    
+    getRectsWithOffsetsBetweenRects( startRects, endRects, offsets, rects, maximumCount );
+    
+    for( size_t i = 0; i < maximumCount; i++ )
+    {
+        const CGFloat offset = offsets[ i ];
+        
+        XCTAssertEqual( rects[ i ].origin.x, startRects[ i ].origin.x + ( ( endRects[ i ].origin.x - startRects[ i ].origin.x ) * offset ), @"Rect %zu differs", i );
+        XCTAssertEqual( rects[ i ].size.height, startRects[ i ].size.height + ( ( endRects[ i ].size.height - startRects[ i ].size.height ) * offset ), @"Rect %zu differs", i );
+        XCTAssertEqualWithAccuracy( rects[ i ].size.width, rectWithOffsetBetweenRects( startRects[ i ], endRects[ i ], offsets[ i ] ).size.width, 0.5, @"Rect %zu differs", i );
+    }
+    
+    // Results can be written over the inputs, e.g. to move points towards their targets in place.
+    
+    for( size_t i = 0; i < maximumCount; i++ )
+    {
+        points[ i ] = startRects[ i ].origin;
+    }
+    
+    getPointsWithOffsetsBetweenPoints( points, points, offsets, points, maximumCount );
+    
+    for( size_t i = 0; i < maximumCount; i++ )
+    {
+        XCTAssertTrue( CGPointEqualToPoint( points[ i ], startRects[ i ].origin ), @"Point %zu changed", i );
+    }
+    
+    getPointsWithOffsetBetweenPoints( points, points + 1, 1.0f, points, maximumCount - 1 );
+    
+    for( size_t i = 0; i < ( maximumCount - 1 ); i++ )
+    {
+        XCTAssertTrue( CGPointEqualToPoint( points[ i ], startRects[ i + 1 ].origin ), @"Point %zu was not moved", i );
+    }
+}
+
+- (void)testArrayInterpolationPerformance {
+    
+    const size_t numberOfValues = ( 1 << 20 );
+    const size_t numberOfRects  = ( numberOfValues / 4 );
+    const int numberOfPasses    = 20;
+    
+    float * floatStarts             = malloc( numberOfValues * sizeof( float ) );
+    float * floatEnds               = malloc( numberOfValues * sizeof( float ) );
+    float * floatResults            = malloc( numberOfValues * sizeof( float ) );
+    CGRect * startRects             = malloc( numberOfRects * sizeof( CGRect ) );
+    CGRect * endRects               = malloc( numberOfRects * sizeof( CGRect ) );
+    CGRect * rects                  = malloc( numberOfRects * sizeof( CGRect ) );
+    SUInterpolationOffset * offsets = malloc( numberOfValues * sizeof( SUInterpolationOffset ) );
+    
+    for( size_t i = 0; i < numberOfValues; i++ )
+    {
+        floatStarts[ i ] = (float)i;
+        floatEnds[ i ]   = -(float)i;
+        offsets[ i ]     = ( ( i % 100 ) / 100.0f );
+    }
+    
+    for( size_t i = 0; i < numberOfRects; i++ )
+    {
+        startRects[ i ] = CGRectMake( i, i, 10, 10 );
+        endRects[ i ]   = CGRectMake( -(CGFloat)i, 0, 20, 5 );
+    }
+    
+    // Per-element calls, then the array functions.
+    
+    CFAbsoluteTime times[ 4 ] = { 0, 0, 0, 0 };
+    
+    for( int pass = 0; pass < numberOfPasses; pass++ )
+    {
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        
+        for( size_t i = 0; i < numberOfValues; i++ )
+        {
+            floatResults[ i ] = floatWithOffsetBetweenFloats( floatStarts[ i ], floatEnds[ i ], offsets[ i ] );
+        }
+        
+        times[ 0 ] += ( CFAbsoluteTimeGetCurrent() - start );
+        start = CFAbsoluteTimeGetCurrent();
+        
+        getFloatsWithOffsetsBetweenFloats( floatStarts, floatEnds, offsets, floatResults, numberOfValues );
+        
+        times[ 1 ] += ( CFAbsoluteTimeGetCurrent() - start );
+        start = CFAbsoluteTimeGetCurrent();
+        
+        for( size_t i = 0; i < numberOfRects; i++ )
+        {
+            rects[ i ] = rectWithOffsetBetweenRects( startRects[ i ], endRects[ i ], offsets[ i ] );
+        }
+        
+        times[ 2 ] += ( CFAbsoluteTimeGetCurrent() - start );
+        start = CFAbsoluteTimeGetCurrent();
+        
+        getRectsWithOffsetsBetweenRects( startRects, endRects, offsets, rects, numberOfRects );
+        
+        times[ 3 ] += ( CFAbsoluteTimeGetCurrent() - start );
+    }
+    
+    NSLog( @"Floats: per-element %.0f, array %.0f Mvalues/s. Rects: per-element %.0f, array %.0f Mrects/s",
+           ( numberOfPasses * numberOfValues ) / times[ 0 ] / 1e6, ( numberOfPasses * numberOfValues ) / times[ 1 ] / 1e6,
+           ( numberOfPasses * numberOfRects ) / times[ 2 ] / 1e6, ( numberOfPasses * numberOfRects ) / times[ 3 ] / 1e6 );
+    
+    XCTAssertEqual( floatResults[ 150 ], floatWithOffsetBetweenFloats( 150, -150, 0.5f ), @"Array interpolation gave the wrong result" );
+    
+    free( floatStarts );
+    free( floatEnds );
+    free( floatResults );
+    free( startRects );
+    free( endRects );
+    free( rects );
+    free( offsets );
+}
+
+#pragma mark -
+#pragma mark Keyframe Tracks
+
+- (void)testKeyframeTracksMatchBruteForceEvaluation {
+    
+    const UInt32 numberOfKeys       = 40;
+    const UInt32 numberOfComponents = 3;
+    
+    double times[ numberOfKeys ];
+    float keyValues[ numberOfKeys * numberOfComponents ];
+    SUKeyframeInterpolation interpolations[ numberOfKeys ];
+    double time = 0;
+    
+    srand( 21 );
+    
+    // Key 10 is at the same time as key 9, so the values jump there.
+    
+    for( UInt32 key = 0; key < numberOfKeys; key++ )
+    {
+        time += ( 10 == key ) ? 0 : randomDouble( 0.1, 2 );
+        
+        times[ key ]          = time;
+        interpolations[ key ] = (SUKeyframeInterpolation)( key % 3 );
+        
+        for( UInt32 component = 0; component < numberOfComponents; component++ )
+        {
+            keyValues[ ( key * numberOfComponents ) + component ] = (float)randomDouble( -10, 10 );
+        }
+    }
+    
+    SUKeyframeTrack track = createKeyframeTrack( times, keyValues, interpolations, numberOfKeys, numberOfComponents );
+    XCTAssertTrue( NULL != track, @"Failed to create a track" );
+    XCTAssertEqual( keyframeTrackNumberOfKeys( track ), numberOfKeys, @"Wrong number of keys" );
+    XCTAssertEqual( keyframeTrackNumberOfComponents( track ), numberOfComponents, @"Wrong number of components" );
+    
+    // Sequential evaluation through the cursor, random seeks through the cursor, and binary search must all agree.
+    
+    SUKeyframeCursor cursor = { 0 };
+    float values[ numberOfComponents ], searchedValues[ numberOfComponents ];
+    
+    for( UInt32 i = 0; i < 20000; i++ )
+    {
+        const double evaluationTime = ( i < 10000 ) ? ( -1 + ( ( time + 2 ) * i / 10000 ) ) : randomDouble( -1, time + 1 );
+        
+        evaluateKeyframeTrack( track, evaluationTime, &cursor, values );
+        evaluateKeyframeTrack( track, evaluationTime, NULL, searchedValues );
+        
+        XCTAssertTrue( 0 == memcmp( values, searchedValues, sizeof( values ) ), @"Cursor and binary search differ at %f", evaluationTime );
+        
+        // Find the segment the slow way, and check the linear and step segments' values.
+        
+        UInt32 segment = 0;
+        
+        for( UInt32 key = 0; key < ( numberOfKeys - 1 ); key++ )
+        {
+            if( times[ key ] <= evaluationTime )
+                segment = key;
+        }
+        
+        for( UInt32 component = 0; component < numberOfComponents; component++ )
+        {
+            const float start = keyValues[ ( segment * numberOfComponents ) + component ];
+            const float end   = keyValues[ ( ( segment + 1 ) * numberOfComponents ) + component ];
+            
+            if( evaluationTime <= times[ 0 ] )
+                XCTAssertEqual( values[ component ], keyValues[ component ], @"Wrong value before the first key" );
+            else if( evaluationTime >= times[ numberOfKeys - 1 ] )
+                XCTAssertEqual( values[ component ], keyValues[ ( ( numberOfKeys - 1 ) * numberOfComponents ) + component ], @"Wrong value after the last key" );
+            else if( SUKeyframeInterpolationStep == interpolations[ segment ] )
+                XCTAssertEqual( values[ component ], start, @"Wrong step value at %f", evaluationTime );
+            else if( SUKeyframeInterpolationLinear == interpolations[ segment ] )
+                XCTAssertEqualWithAccuracy( values[ component ], floatWithOffsetBetweenFloats( start, end, (SUInterpolationOffset)( ( evaluationTime - times[ segment ] ) / ( times[ segment + 1 ] - times[ segment ] ) ) ), 1e-4f, @"Wrong linear value at %f", evaluationTime );
+        }
+    }
+    
+    freeKeyframeTrack( track );
+    
+    // Cubic segments pass through every key.
+    
+    for( UInt32 key = 0; key < numberOfKeys; key++ )
+    {
+        interpolations[ key ] = SUKeyframeInterpolationCubic;
+    }
+    
+    track = createKeyframeTrack( times, keyValues, interpolations, numberOfKeys, numberOfComponents );
+    
+    for( UInt32 key = 1; key < numberOfKeys; key++ )
+    {
+        if( times[ key ] == times[ key - 1 ] )
+            continue;
+        
+        evaluateKeyframeTrack( track, times[ key ] - 1e-9, NULL, values );
+        
+        for( UInt32 component = 0; component < numberOfComponents; component++ )
+        {
+            XCTAssertEqualWithAccuracy( values[ component ], keyValues[ ( key * numberOfComponents ) + component ], 1e-3f, @"Cubic segment misses key %u", key );
+        }
+    }
+    
+    freeKeyframeTrack( track );
+    
+    // Key times may not decrease.
+    
+    XCTAssertTrue( NULL == createKeyframeTrack( (double[]){ 1, 0 }, keyValues, NULL, 2, 1 ), @"Created a track with decreasing times" );
+}
+
+- (void)testKeyframeTrackPerformance {
+    
+    const UInt32 numberOfTracks = 1000;
+    const UInt32 numberOfKeys   = 300;
+    const UInt32 numberOfFrames = 600;
+    
+    SUKeyframeTrack * tracks    = malloc( numberOfTracks * sizeof( SUKeyframeTrack ) );
+    SUKeyframeCursor * cursors  = calloc( numberOfTracks, sizeof( SUKeyframeCursor ) );
+    float * values              = malloc( numberOfTracks * 2 * sizeof( float ) );
+    double times[ numberOfKeys ];
+    float keyValues[ numberOfKeys * 2 ];
+    SUKeyframeInterpolation interpolations[ numberOfKeys ];
+    
+    for( UInt32 key = 0; key < numberOfKeys; key++ )
+    {
+        times[ key ]                 = key;
+        keyValues[ key * 2 ]         = (float)randomDouble( 0, 100 );
+        keyValues[ ( key * 2 ) + 1 ] = (float)randomDouble( 0, 100 );
+        interpolations[ key ]        = (SUKeyframeInterpolation)( key % 3 );
+    }
+    
+    for( UInt32 i = 0; i < numberOfTracks; i++ )
+    {
+        tracks[ i ] = createKeyframeTrack( times, keyValues, interpolations, numberOfKeys, 2 );
+    }
+    
+    // Play every track through at once, then evaluate the same frames by binary search.
+    
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    
+    for( UInt32 frame = 0; frame < numberOfFrames; frame++ )
+    {
+        evaluateKeyframeTracks( tracks, cursors, numberOfTracks, ( (double)frame * numberOfKeys / numberOfFrames ), values );
+    }
+    
+    const CFAbsoluteTime cursorTime = ( CFAbsoluteTimeGetCurrent() - start );
+    start = CFAbsoluteTimeGetCurrent();
+    
+    for( UInt32 frame = 0; frame < numberOfFrames; frame++ )
+    {
+        for( UInt32 i = 0; i < numberOfTracks; i++ )
+        {
+            evaluateKeyframeTrack( tracks[ i ], ( (double)frame * numberOfKeys / numberOfFrames ), NULL, values + ( i * 2 ) );
+        }
+    }
+    
+    const CFAbsoluteTime searchTime = ( CFAbsoluteTimeGetCurrent() - start );
+    
+    NSLog( @"Keyframe tracks: cursor %.1f, binary search %.1f Mevaluations/s",
+           ( numberOfFrames * numberOfTracks ) / cursorTime / 1e6, ( numberOfFrames * numberOfTracks ) / searchTime / 1e6 );
+    
+    for( UInt32 i = 0; i < numberOfTracks; i++ )
+    {
+        freeKeyframeTrack( tracks[ i ] );
+    }
+    
+    free( tracks );
+    free( cursors );
+    free( values );
+}
+
+
+#pragma mark -
+#pragma mark Interpolating Structures
+
+- (void)testStructInterpolationPlansMatchCompilerLayout {
+    
+    SUStructInterpolationPlan plan = structInterpolationPlanForType( @encode( SUTestInterpolatedStruct ) );
+    
+    XCTAssertTrue( NULL != plan, @"Failed to compile a plan" );
+    XCTAssertEqual( structInterpolationPlanSize( plan ), sizeof( SUTestInterpolatedStruct ), @"Plan has the wrong size" );
+    XCTAssertEqual( plan, structInterpolationPlanForType( @encode( SUTestInterpolatedStruct ) ), @"Plan was not cached" );
+    XCTAssertEqual( structInterpolationPlanSize( structInterpolationPlanForType( @encode( CGAffineTransform ) ) ), sizeof( CGAffineTransform ), @"Plan has the wrong size" );
+    
+    SUTestInterpolatedStruct start = { -100, 1, { 0, -32000, 5 }, { { 0, 0 }, { 0, 2 } }, 0, false, &start, 1 };
+    SUTestInterpolatedStruct end   = { 100, 3, { 10, 32000, 5 }, { { 1, 0 }, { 0, 4 } }, 255, true, &end, 1001 };
+    SUTestInterpolatedStruct result;
+    
+    interpolateStructWithPlan( plan, &start, &end, 0.25f, &result );
+    
+    XCTAssertEqual( result.character, (char)-50, @"Wrong char" );
+    XCTAssertEqual( result.real, doubleWithOffsetBetweenDoubles( 1, 3, 0.25f ), @"Wrong double" );
+    XCTAssertEqual( result.shorts[ 0 ], (short)3, @"Integers should round to the nearest value" );
+    XCTAssertEqual( result.shorts[ 1 ], (short)-16000, @"Wrong short" );
+    XCTAssertEqual( result.shorts[ 2 ], (short)5, @"Wrong short" );
+    XCTAssertEqual( result.points[ 0 ].x, 0.25f, @"Wrong nested float" );
+    XCTAssertEqual( result.points[ 1 ].y, 2.5f, @"Wrong nested float" );
+    XCTAssertEqual( result.byte, (unsigned char)64, @"Wrong unsigned char" );
+    XCTAssertEqual( result.flag, false, @"bools should snap at the middle" );
+    XCTAssertEqual( result.pointer, (void *)&start, @"Pointers should snap at the middle" );
+    XCTAssertEqual( result.longLong, 251LL, @"Wrong long long" );
+    
+    // Springs overshoot; integers are clamped to their range.
+    
+    interpolateStructWithPlan( plan, &start, &end, 1.5f, &result );
+    
+    XCTAssertEqual( result.character, (char)127, @"Integers should be clamped" );
+    XCTAssertEqual( result.shorts[ 1 ], (short)32767, @"Integers should be clamped" );
+    XCTAssertEqual( result.byte, (unsigned char)255, @"Integers should be clamped" );
+    XCTAssertEqual( result.pointer, (void *)&end, @"Pointers should snap at the middle" );
+    
+    // Bitfields and opaque structures can't be interpolated.
+    
+    XCTAssertTrue( NULL == structInterpolationPlanForType( "{Bits=b3i}" ), @"Compiled a plan for a bitfield" );
+    XCTAssertTrue( NULL == structInterpolationPlanForType( "{Opaque}" ), @"Compiled a plan for an opaque structure" );
+}
+
+- (void)testValuesInterpolateArbitraryStructures {
+    
+    SUTestInterpolatedStruct start = { 0, 0, { 0, 0, 0 }, { { 0, 0 }, { 0, 0 } }, 0, false, NULL, 0 };
+    SUTestInterpolatedStruct end   = { 10, 10, { 10, 10, 10 }, { { 10, 10 }, { 10, 10 } }, 10, true, NULL, 10 };
+    SUTestInterpolatedStruct result;
+    
+    NSValue * startValue = [NSValue valueWithBytes: &start objCType: @encode( SUTestInterpolatedStruct )];
+    NSValue * endValue   = [NSValue valueWithBytes: &end objCType: @encode( SUTestInterpolatedStruct )];
+    NSValue * value      = [NSValue interpolatedValueWithOffset: 0.75f betweenValue: startValue andValue: endValue];
+    
+    XCTAssertEqual( 0, strcmp( value.objCType, @encode( SUTestInterpolatedStruct ) ), @"Interpolated value has the wrong type" );
+    
+    [value getValue: &result];
+    
+    XCTAssertEqual( result.real, 7.5, @"Structure was not interpolated" );
+    XCTAssertEqual( result.points[ 1 ].y, 7.5f, @"Structure was not interpolated" );
+    XCTAssertEqual( result.longLong, 8LL, @"Structure was not interpolated" );
+    XCTAssertEqual( result.flag, true, @"Structure was not interpolated" );
+}
+
+
+- (void)testRegisteredInterpolatorsCanBeUsedFromAnyThread {
+    
+    SUTestRegisteredStruct registeredStart = { 0 }, registeredEnd = { 10 };
+    SUTestReplacedStruct replacedStart     = { 0 }, replacedEnd   = { 10 };
+    
+    NSValue * registeredStartValue  = [NSValue valueWithBytes: &registeredStart objCType: @encode( SUTestRegisteredStruct )];
+    NSValue * registeredEndValue    = [NSValue valueWithBytes: &registeredEnd objCType: @encode( SUTestRegisteredStruct )];
+    NSValue * replacedStartValue    = [NSValue valueWithBytes: &replacedStart objCType: @encode( SUTestReplacedStruct )];
+    NSValue * replacedEndValue      = [NSValue valueWithBytes: &replacedEnd objCType: @encode( SUTestReplacedStruct )];
+    
+    [NSValue registerInterpolator: interpolateRegisteredStruct forObjCType: @encode( SUTestRegisteredStruct )];
+    
+    // Look the interpolators up on many threads while others are registered. Registered types are matched by their contents,
+    // not the address of their type string.
+    
+    __block int32_t failures = 0;
+    
+    dispatch_apply( 64, dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 ), ^( size_t iteration ) {
+        
+        if( 0 == ( iteration % 8 ) )
+        {
+            char type[ 32 ];
+            snprintf( type, sizeof( type ), "{SUTestDummy%zu=i}", iteration );
+            
+            [NSValue registerInterpolator: interpolateRegisteredStruct forObjCType: type];
+            char * replacedType = strdup( @encode( SUTestReplacedStruct ) );
+            [NSValue registerInterpolator: interpolateReplacedStruct forObjCType: replacedType];
+            free( replacedType );
+        }
+        
+        for( int i = 0; i < 1000; i++ )
+        {
+            SUTestRegisteredStruct result;
+            [[NSValue interpolatedValueWithOffset: 0.5f betweenValue: registeredStartValue andValue: registeredEndValue] getValue: &result];
+            
+            if( 42 != result.value )
+                __atomic_fetch_add( &failures, 1, __ATOMIC_RELAXED );
+        }
+    });
+    
+    XCTAssertEqual( failures, 0, @"Registered interpolator was not used" );
+    
+    SUTestReplacedStruct result;
+    [[NSValue interpolatedValueWithOffset: 0.25f betweenValue: replacedStartValue andValue: replacedEndValue] getValue: &result];
+    
+    XCTAssertEqual( result.value, 25, @"Registered interpolator was not used" );
+}
+
+
+#pragma mark -
+#pragma mark Interpolating Transforms
+
+- (void)testTransformDecompositionsRecomposeTheirTransforms {
+    
+    srand( 25 );
+    
+    for( int i = 0; i < 1000; i++ )
+    {
+        // Affine transforms, including singular ones.
+        
+        CGAffineTransform affine = CGAffineTransformMake( randomDouble( -2, 2 ), randomDouble( -2, 2 ), randomDouble( -2, 2 ),
+                                                          randomDouble( -2, 2 ), randomDouble( -100, 100 ), randomDouble( -100, 100 ) );
+        if( 0 == ( i % 10 ) )
+        {
+            affine.c = ( affine.a * 2 );
+            affine.d = ( affine.b * 2 );
+        }
+        
+        SUAffineTransformDecomposition affineDecomposition;
+        decomposeAffineTransform( affine, &affineDecomposition );
+        CGAffineTransform recomposedAffine = recomposeAffineTransform( &affineDecomposition );
+        
+        XCTAssertEqualWithAccuracy( recomposedAffine.a, affine.a, 1e-9, @"Affine transform %d was not recomposed", i );
+        XCTAssertEqualWithAccuracy( recomposedAffine.b, affine.b, 1e-9, @"Affine transform %d was not recomposed", i );
+        XCTAssertEqualWithAccuracy( recomposedAffine.c, affine.c, 1e-9, @"Affine transform %d was not recomposed", i );
+        XCTAssertEqualWithAccuracy( recomposedAffine.d, affine.d, 1e-9, @"Affine transform %d was not recomposed", i );
+        XCTAssertEqual( recomposedAffine.tx, affine.tx, @"Affine transform %d was not recomposed", i );
+        
+        // 3D transforms, with and without perspective (of a realistic size: CATransform3D's m34 is usually -1 / distance).
+        
+        double matrix[ 16 ], recomposed[ 16 ], scalarRecomposed[ 16 ];
+        
+        for( int element = 0; element < 16; element++ )
+        {
+            matrix[ element ] = ( 3 == ( element % 4 ) ) ? randomDouble( -0.01, 0.01 ) : randomDouble( -2, 2 );
+        }
+        
+        matrix[ 15 ] = 1;
+        
+        if( 0 == ( i % 2 ) )
+            matrix[ 3 ] = matrix[ 7 ] = matrix[ 11 ] = 0;
+        
+        SUTransform3DDecomposition decomposition;
+        XCTAssertTrue( decomposeTransform3D( matrix, &decomposition ), @"Transform %d was not decomposed", i );
+        
+        recomposeTransform3DKernel( &decomposition, recomposed, true );
+        recomposeTransform3DKernel( &decomposition, scalarRecomposed, false );
+        
+        XCTAssertTrue( 0 == memcmp( recomposed, scalarRecomposed, sizeof( recomposed ) ), @"Vector and scalar kernels differ" );
+        
+        for( int element = 0; element < 16; element++ )
+        {
+            XCTAssertEqualWithAccuracy( recomposed[ element ], matrix[ element ], 1e-5, @"Transform %d was not recomposed", i );
+        }
+    }
+    
+    // Scaling to zero can be interpolated, unless the transform also has a perspective.
+    
+    SUTransform3DDecomposition decomposition;
+    double zero[ 16 ] = { [ 15 ] = 1 };
+    
+    XCTAssertTrue( decomposeTransform3D( zero, &decomposition ), @"Singular transforms should be decomposed" );
+    
+    zero[ 11 ] = -0.002;
+    
+    XCTAssertFalse( decomposeTransform3D( zero, &decomposition ), @"Singular transforms with perspective can't be decomposed" );
+}
+
+- (void)testValuesInterpolateTransformsByDecomposition {
+    
+    // Half way through a rotation by almost a half turn, a transform is rotated by almost a quarter turn (a component-wise
+    // interpolation would be almost zero).
+    
+    CGAffineTransform start = CGAffineTransformMakeTranslation( 10, 20 ), end = CGAffineTransformMake( -1, 0.1, -0.1, -1, 30, 40 ), result;
+    
+    NSValue * startValue = [NSValue valueWithBytes: &start objCType: @encode( CGAffineTransform )];
+    NSValue * endValue   = [NSValue valueWithBytes: &end objCType: @encode( CGAffineTransform )];
+    
+    [[NSValue interpolatedValueWithOffset: 0.5f betweenValue: startValue andValue: endValue] getValue: &result];
+    
+    const double scale = ( 1 + sqrt( 1.01 ) ) / 2;
+    const double angle = atan2( 0.1, -1 ) / 2;
+    
+    XCTAssertEqualWithAccuracy( result.a, scale * cos( angle ), 1e-9, @"Transform was not interpolated by its rotation" );
+    XCTAssertEqualWithAccuracy( result.b, scale * sin( angle ), 1e-9, @"Transform was not interpolated by its rotation" );
+    XCTAssertEqualWithAccuracy( result.tx, 20, 1e-9, @"Transform was not translated" );
+    
+    // Rotations take the shorter way around.
+    
+    start = CGAffineTransformMakeRotation( 3 );
+    end   = CGAffineTransformMakeRotation( -3 );
+    
+    result = affineTransformWithOffsetBetweenAffineTransforms( start, end, 0.5f );
+    
+    XCTAssertEqualWithAccuracy( result.a, -1, 1e-9, @"Rotation took the longer way around" );
+    
+    // 3D rotations about the z axis are interpolated like affine ones.
+    
+    CATransform3D start3D = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    CATransform3D end3D   = { 0, 1, 0, 0, -1, 0, 0, 0, 0, 0, 1, 0, 100, 0, 0, 1 };
+    CATransform3D result3D;
+    
+    startValue = [NSValue valueWithBytes: &start3D objCType: @encode( CATransform3D )];
+    endValue   = [NSValue valueWithBytes: &end3D objCType: @encode( CATransform3D )];
+    
+    [[NSValue interpolatedValueWithOffset: 0.5f betweenValue: startValue andValue: endValue] getValue: &result3D];
+    
+    XCTAssertEqualWithAccuracy( result3D.m11, M_SQRT1_2, 1e-9, @"Transform was not interpolated by its rotation" );
+    XCTAssertEqualWithAccuracy( result3D.m12, M_SQRT1_2, 1e-9, @"Transform was not interpolated by its rotation" );
+    XCTAssertEqualWithAccuracy( result3D.m21, -M_SQRT1_2, 1e-9, @"Transform was not interpolated by its rotation" );
+    XCTAssertEqualWithAccuracy( result3D.m33, 1, 1e-9, @"Transform was not interpolated by its rotation" );
+    XCTAssertEqualWithAccuracy( result3D.m41, 50, 1e-9, @"Transform was not translated" );
+    XCTAssertEqualWithAccuracy( result3D.m44, 1, 1e-9, @"Transform was not normalised" );
+}
+
+- (void)testRegisteredInterpolatorsTakePrecedenceOverTransformDecomposition {
+    
+    CGAffineTransform start = CGAffineTransformMakeRotation( 1 ), end = CGAffineTransformMakeScale( 2, 3 ), result;
+    
+    NSValue * startValue = [NSValue valueWithBytes: &start objCType: @encode( CGAffineTransform )];
+    NSValue * endValue   = [NSValue valueWithBytes: &end objCType: @encode( CGAffineTransform )];
+    
+    [NSValue registerInterpolator: interpolateAffineTransformCountingCalls forObjCType: @encode( CGAffineTransform )];
+    
+    const int32_t before = __atomic_load_n( &numberOfRegisteredAffineInterpolations, __ATOMIC_RELAXED );
+    
+    [[NSValue interpolatedValueWithOffset: 0.5f betweenValue: startValue andValue: endValue] getValue: &result];
+    
+    XCTAssertEqual( __atomic_load_n( &numberOfRegisteredAffineInterpolations, __ATOMIC_RELAXED ) - before, 1, @"Registered interpolator was not used" );
+    
+    SUInterpolationSession * session = [SUInterpolationSession sessionWithFromValue: startValue toValue: endValue];
+    [session getValue: &result atOffset: 0.5f];
+    
+    XCTAssertEqual( __atomic_load_n( &numberOfRegisteredAffineInterpolations, __ATOMIC_RELAXED ) - before, 2, @"Session did not use the registered interpolator" );
+}
+
+@end